@@ -1,267 +1,380 @@
 /**
  * Simple assembler for 16-bit GPR CPU.
+ *
+ * Single pass over the source: lines are sliced in place (string_view, no
+ * per-line allocation), mnemonics are looked up in a compile-time hash
+ * table, and label operands are recorded as fixups that are patched once
+ * every label is known. The optional peephole pass runs on the finished
+ * word stream (peephole.cpp). Lexing and encoding live in lexer.h, shared
+ * with the incremental assembler (incremental.cpp).
  */
 
 #include "assembler.h"
-#include <sstream>
-#include <map>
+#include "parsed_line.h"
+#include "peephole.h"
+#include "lexer.h"
+#include "metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <fstream>
+#include <cstring>
+#include <string_view>
 
-static int getOpcode(const std::string& mnem) {
-    if (mnem == "HALT") return 0;
-    if (mnem == "MOVI") return 1;
-    if (mnem == "MOV")  return 2;
-    if (mnem == "LOAD") return 3;
-    if (mnem == "STORE") return 4;
-    if (mnem == "ADD")  return 5;
-    if (mnem == "SUB")  return 6;
-    if (mnem == "AND")  return 7;
-    if (mnem == "OR")   return 8;
-    if (mnem == "XOR")  return 9;
-    if (mnem == "NOT")  return 10;
-    if (mnem == "SHL")  return 11;
-    if (mnem == "SHR")  return 12;
-    if (mnem == "JMP")  return 13;
-    if (mnem == "JZ")   return 14;
-    if (mnem == "NOP")  return 15;
-    return -1;
-}
+// =============================================================================
+// LABEL TABLE (flat, open addressing, case-insensitive keys into the source)
+// =============================================================================
 
-static char toUpperChar(char c) {
-    if (c >= 'a' && c <= 'z') return static_cast<char>(c - 32);
-    return c;
-}
+namespace {
 
-static std::string toUpper(std::string s) {
-    for (char& c : s) c = toUpperChar(c);
-    return s;
-}
+class LabelTable {
+public:
+    LabelTable() : slots(64), used(0) {}
 
-static uint16_t parseNumber(const std::string& s) {
-    size_t idx = 0;
-    unsigned long v = std::stoul(s, &idx, 0);
-    return static_cast<uint16_t>(v & 0xFFFFu);
-}
+    /** Define or redefine a label (the last definition wins, as before). */
+    void define(std::string_view name, uint16_t value) {
+        if ((used + 1) * 2 > slots.size())
+            grow();
+        uint32_t h = hash(name);
+        Slot& s = slots[findSlot(name, h)];
+        if (s.name.empty()) {
+            s.name = name;
+            s.hash = h;
+            s.index = static_cast<uint32_t>(order.size());
+            ++used;
+            order.push_back(name);
+        }
+        s.value = value;
+    }
 
-static bool parseReg(const std::string& s, uint8_t& r) {
-    std::string t = s;
-    while (t.size() >= 2 && t[0] == '(' && t.back() == ')')
-        t = t.substr(1, t.size() - 2);  // (R0) -> R0
-    if (t.size() < 2 || (t[0] != 'R' && t[0] != 'r')) return false;
-    int n = std::stoi(t.substr(1), nullptr, 10);
-    if (n < 0 || n > 7) return false;
-    r = static_cast<uint8_t>(n);
-    return true;
-}
+    bool lookup(std::string_view name, uint16_t& value) const {
+        const Slot& s = slots[findSlot(name, hash(name))];
+        if (s.name.empty()) return false;
+        value = s.value;
+        return true;
+    }
 
-static std::string trim(const std::string& s) {
-    size_t a = s.find_first_not_of(" \t\r\n");
-    if (a == std::string::npos) return "";
-    size_t b = s.find_last_not_of(" \t\r\n");
-    return s.substr(a, b - a + 1);
-}
+    /** Position of a defined label in names(). */
+    uint32_t indexOf(std::string_view name) const {
+        return slots[findSlot(name, hash(name))].index;
+    }
 
-static std::string stripComment(const std::string& line) {
-    size_t p = line.find(';');
-    if (p != std::string::npos)
-        return trim(line.substr(0, p));
-    return trim(line);
-}
+    /** Names in order of first definition. */
+    const std::vector<std::string_view>& names() const { return order; }
 
-static void tokenize(const std::string& line, std::vector<std::string>& tokens) {
-    tokens.clear();
-    std::string cur;
-    for (size_t i = 0; i <= line.size(); ++i) {
-        char c = (i < line.size()) ? line[i] : ' ';
-        if ((c == ' ' || c == '\t' || c == '\r' || c == '\n') || c == ',') {
-            if (!cur.empty()) {
-                tokens.push_back(cur);
-                cur.clear();
-            }
-        } else {
-            cur += c;
+private:
+    struct Slot {
+        std::string_view name;      // Empty = free
+        uint32_t hash;
+        uint32_t index;             // Position in order
+        uint16_t value;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<std::string_view> order;
+    size_t used;
+
+    static uint32_t hash(std::string_view s) {
+        uint32_t h = 2166136261u;   // FNV-1a over upper-cased bytes
+        for (char c : s)
+            h = (h ^ static_cast<unsigned char>(toUpperChar(c))) * 16777619u;
+        return h;
+    }
+
+    static bool sameName(std::string_view a, std::string_view b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); ++i)
+            if (toUpperChar(a[i]) != toUpperChar(b[i])) return false;
+        return true;
+    }
+
+    /** Slot holding name, or the free slot where it would go. */
+    size_t findSlot(std::string_view name, uint32_t h) const {
+        size_t mask = slots.size() - 1;
+        for (size_t i = h & mask;; i = (i + 1) & mask) {
+            const Slot& s = slots[i];
+            if (s.name.empty() || (s.hash == h && sameName(s.name, name)))
+                return i;
         }
     }
-    if (!cur.empty()) tokens.push_back(cur);
-}
 
-static uint16_t encMOVI(uint8_t rd, uint16_t imm9) {
-    return (1u << 12) | ((rd & 7u) << 9) | (imm9 & 0x1FFu);
-}
-static uint16_t encRR(uint8_t op, uint8_t rd, uint8_t rs) {
-    return ((op & 15u) << 12) | ((rd & 7u) << 9) | ((rs & 7u) << 6);
+    void grow() {
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        for (const Slot& s : old) {
+            if (s.name.empty()) continue;
+            slots[findSlot(s.name, s.hash)] = s;
+        }
+    }
+};
+
+/** Label operand to patch once all labels are defined. */
+struct Fixup {
+    enum Kind : uint8_t {
+        Imm9,       // MOVI immediate: low 9 bits
+        Reg,        // Register-operand slot given as a label: low 3 bits
+        Branch,     // MOVI R7 of a JMP/JZ label, or the far form past 9 bits
+        Wide,       // Literal word of MOVW Rd, label: all 16 bits
+        Dead        // Word was overwritten later (.ORG back over it)
+    };
+    std::string_view name;
+    size_t lineNum;
+    uint16_t address;
+    Kind kind;
+    bool split;     // Branch: its second word was overwritten later
+};
+
+} // namespace
+
+// =============================================================================
+// RESULTS
+// =============================================================================
+
+static AssembleResult fail(const std::string& error, size_t lineNum) {
+    return AssembleResult{false, error, lineNum};
 }
 
-AssembleResult assemble(const std::string& source, uint16_t* mem, size_t memSize) {
-    AssembleResult res{true, "", 0};
-    std::map<std::string, uint16_t> labels;
+// =============================================================================
+// LISTING
+// =============================================================================
 
-    // First pass: collect labels and compute instruction addresses
-    std::istringstream iss1(source);
-    std::string line;
+/**
+ * One row per source line, with the words it emitted (address after
+ * optimization, "----" if removed, and why) followed by a summary line.
+ */
+static void writeListing(std::string& out, std::string_view source, const std::vector<PeepholeWord>& words,
+                         const std::vector<size_t>& wordLine, const std::string& summary) {
+    out.clear();
+    char buf[32];
+    size_t next = 0;
     size_t lineNum = 0;
-    uint16_t pc = 0;
-
-    while (std::getline(iss1, line)) {
+    for (const char* p = source.data(), *end = p + source.size(); p < end;) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (!eol) eol = end;
+        std::string_view line(p, static_cast<size_t>(eol - p));
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        p = eol + 1;
         ++lineNum;
-        std::string rest = stripComment(line);
-        if (rest.empty()) continue;
 
-        if (rest.back() == ':') {
-            std::string name = trim(rest.substr(0, rest.size() - 1));
-            if (!name.empty()) labels[toUpper(name)] = pc;
-            continue;
+        bool first = true;
+        for (; next < words.size() && wordLine[next] == lineNum; ++next, first = false) {
+            const PeepholeWord& w = words[next];
+            if (w.removed)
+                std::snprintf(buf, sizeof buf, "----  %04X  %5zu  ", w.word, lineNum);
+            else
+                std::snprintf(buf, sizeof buf, "%04X  %04X  %5zu  ", w.newAddress, w.word, lineNum);
+            out += buf;
+            if (first)
+                out += line;
+            if (w.note) {
+                out += first ? "    ; " : "; ";
+                out += w.note;
+            }
+            out += '\n';
+        }
+        if (first) {
+            std::snprintf(buf, sizeof buf, "            %5zu  ", lineNum);
+            out += buf;
+            out += line;
+            out += '\n';
         }
+    }
+    out += "; ";
+    out += summary;
+    out += '\n';
+}
 
-        std::vector<std::string> tok;
-        tokenize(rest, tok);
-        if (tok.empty()) continue;
+// =============================================================================
+// ASSEMBLE
+// =============================================================================
 
-        std::string cmd = toUpper(tok[0]);
+/** assemble() itself; lineNum ends as the number of lines read. */
+static AssembleResult assembleSource(const std::string& source, uint16_t* mem, size_t memSize,
+                                     AssembleInfo* info, const AssembleOptions& options, size_t& lineNum) {
+    LabelTable labels;
+    std::vector<Fixup> fixups;
+    std::vector<uint64_t> hasFixup((memSize + 63) / 64);  // Bit per word with a pending fixup
+    std::vector<uint64_t> written(info ? (memSize + 63) / 64 : 0);  // Bit per word stored (info only)
+    Tokens t;
+    lineNum = 0;
 
-        if (cmd == ".ORG") {
-            if (tok.size() < 2) {
-                res.ok = false; res.error = ".ORG requires address"; res.lineNum = lineNum;
-                return res;
-            }
-            pc = parseNumber(tok[1]);
-            continue;
+    // Every stored word in order (info only), for the peephole pass, the listing
+    // and the line table. A region is a run of consecutive addresses;
+    // .WORD addr value is outside any.
+    enum class Emit { Code, BranchMovi, Data, AbsoluteData };
+    bool trackWords = info != nullptr;
+    std::vector<PeepholeWord> emitted;
+    std::vector<size_t> emittedLine;
+    int32_t regions = 0;
+    uint32_t regionNext = ~0u;      // Address that continues the current region
+
+    // A label or number operand: numbers (leading digit or sign) are encoded
+    // now, anything else is patched after the pass
+    auto operand = [&](std::string_view arg, uint16_t address, Fixup::Kind kind,
+                       size_t lineNum, uint16_t& value) {
+        char c = arg[0];
+        if ((c >= '0' && c <= '9') || c == '-' || c == '+') {
+            if (parseNumber(arg, value))
+                return true;
         }
-        if (cmd == ".WORD") {
-            if (tok.size() == 1) {
-                res.ok = false; res.error = ".WORD requires value"; res.lineNum = lineNum;
-                return res;
-            }
-            if (tok.size() == 2) {
-                pc++;  // .WORD value at current pc
-            }
-            continue;
+        fixups.push_back(Fixup{arg, lineNum, address, kind, false});
+        hasFixup[address >> 6] |= 1ull << (address & 63);
+        if (kind == Fixup::Branch) {
+            uint16_t tail = static_cast<uint16_t>(address + 1);
+            hasFixup[tail >> 6] |= 1ull << (tail & 63);
         }
+        value = 0;
+        return false;
+    };
 
-        int op = getOpcode(cmd);
-        if (op >= 0) {
-            pc++;
-            continue;
+    // A later write to a word that is waiting for a fixup cancels the fixup,
+    // so the last write wins as if labels had been known up front; one to the
+    // second word of a JMP/JZ label rules out its far form
+    size_t lineFixups = 0;     // Fixups recorded before the current line
+    auto store = [&](uint16_t address, uint16_t word, Emit kind = Emit::Code) {
+        if ((hasFixup[address >> 6] >> (address & 63)) & 1u) {
+            for (size_t i = 0; i < lineFixups; ++i) {
+                if (fixups[i].address == address)
+                    fixups[i].kind = Fixup::Dead;
+                else if (fixups[i].kind == Fixup::Branch && static_cast<uint16_t>(fixups[i].address + 1) == address)
+                    fixups[i].split = true;
+            }
         }
-        res.ok = false; res.error = "Unknown: " + cmd; res.lineNum = lineNum;
-        return res;
-    }
+        if (info)
+            written[address >> 6] |= 1ull << (address & 63);
+        mem[address] = word;
+        if (trackWords) {
+            int32_t region = -1;
+            if (kind != Emit::AbsoluteData) {
+                if (address != regionNext)
+                    ++regions;
+                region = regions - 1;
+                regionNext = uint32_t(address) + 1;
+            }
+            bool data = kind == Emit::Data || kind == Emit::AbsoluteData;
+            emitted.push_back(PeepholeWord{address, word, -1, region, data, kind == Emit::BranchMovi,
+                                           false, address, nullptr});
+            emittedLine.push_back(lineNum);
+        }
+    };
 
-    // Second pass: emit
-    pc = 0;
-    iss1.clear();
-    iss1.str(source);
-    lineNum = 0;
+    const char* p = source.data();
+    const char* end = p + source.size();
+    uint16_t pc = 0;
 
-    while (std::getline(iss1, line)) {
+    while (p < end) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (!eol) eol = end;
+        std::string_view line(p, static_cast<size_t>(eol - p));
+        p = eol + 1;
         ++lineNum;
-        std::string rest = stripComment(line);
+        lineFixups = fixups.size();
+
+        size_t semi = line.find(';');
+        std::string_view rest = trim(semi == std::string_view::npos ? line : line.substr(0, semi));
         if (rest.empty()) continue;
 
-        if (rest.back() == ':') continue;
+        if (rest.back() == ':') {
+            std::string_view name = trim(rest.substr(0, rest.size() - 1));
+            if (!name.empty()) labels.define(name, pc);
+            continue;
+        }
 
-        std::vector<std::string> tok;
-        tokenize(rest, tok);
-        if (tok.empty()) continue;
+        tokenize(rest, t);
+        if (t.count == 0) continue;
 
-        std::string cmd = toUpper(tok[0]);
+        int op = getOpcode(t.tok[0]);
+        if (op < 0)
+            return fail("Unknown: " + toUpper(t.tok[0]), lineNum);
 
-        if (cmd == ".ORG") {
-            if (tok.size() >= 2) pc = parseNumber(tok[1]);
+        // --- Directives ---
+        if (op == DIRECTIVE_ORG) {
+            if (t.count < 2) return fail(".ORG requires address", lineNum);
+            if (!parseNumber(t.tok[1], pc)) return fail("Invalid number", lineNum);
             continue;
         }
-        if (cmd == ".WORD") {
-            if (tok.size() >= 2) {
-                uint16_t val = parseNumber(tok[1]);
-                if (tok.size() >= 3) {
-                    uint16_t addr = parseNumber(tok[1]);
-                    val = parseNumber(tok[2]);
-                    if (addr < memSize) mem[addr] = val;
-                } else {
-                    if (pc < memSize) mem[pc] = val;
-                    pc++;
-                }
+        if (op == DIRECTIVE_WORD) {
+            if (t.count == 1) return fail(".WORD requires value", lineNum);
+            uint16_t val;
+            if (!parseNumber(t.tok[1], val)) return fail("Invalid number", lineNum);
+            if (t.count >= 3) {
+                uint16_t addr = val;
+                if (!parseNumber(t.tok[2], val)) return fail("Invalid number", lineNum);
+                if (addr < memSize) store(addr, val, Emit::AbsoluteData);
+            } else {
+                if (pc < memSize) store(pc, val, Emit::Data);
+                pc++;
             }
             continue;
         }
 
-        int op = getOpcode(cmd);
-        if (op < 0) {
-            res.ok = false; res.error = "Unknown: " + cmd; res.lineNum = lineNum;
-            return res;
-        }
-
-        if (pc >= memSize) {
-            res.ok = false; res.error = "Program too large"; res.lineNum = lineNum;
-            return res;
-        }
+        // --- Instructions ---
+        if (pc >= memSize)
+            return fail("Program too large", lineNum);
 
         uint16_t inst = 0;
 
         switch (op) {
             case 0: inst = 0x0000; break;
             case 1: {
-                if (tok.size() < 3) {
-                    res.ok = false; res.error = "MOVI Rd, imm"; res.lineNum = lineNum;
-                    return res;
-                }
+                if (t.count < 3) return fail("MOVI Rd, imm", lineNum);
                 uint8_t rd;
-                if (!parseReg(tok[1], rd)) {
-                    res.ok = false; res.error = "Invalid register"; res.lineNum = lineNum;
-                    return res;
-                }
+                if (!parseReg(t.tok[1], rd)) return fail("Invalid register", lineNum);
                 uint16_t imm;
-                std::string immStr = tok[2];
-                if (labels.count(toUpper(immStr)))
-                    imm = labels[toUpper(immStr)];
-                else
-                    imm = parseNumber(immStr);
-                imm &= 0x1FF;
-                inst = encMOVI(rd, imm);
+                if (operand(t.tok[2], pc, Fixup::Imm9, lineNum, imm) && imm > 0x1FF) {
+                    // Past 9 bits: MOVW Rd, imm
+                    if (static_cast<size_t>(pc) + 1 >= memSize)
+                        return fail("Program too large", lineNum);
+                    store(pc++, encExt(EXT_MOVW, rd));
+                    inst = imm;
+                    break;
+                }
+                inst = encMOVI(rd, imm & 0x1FF);
+                break;
+            }
+            case MNEMONIC_MOVW: {
+                if (t.count < 3) return fail("MOVW Rd, value", lineNum);
+                uint8_t rd;
+                if (!parseReg(t.tok[1], rd)) return fail("Invalid register", lineNum);
+                if (static_cast<size_t>(pc) + 1 >= memSize)
+                    return fail("Program too large", lineNum);
+                store(pc, encExt(EXT_MOVW, rd));
+                ++pc;
+                operand(t.tok[2], pc, Fixup::Wide, lineNum, inst);
                 break;
             }
             case 13: case 14: {  // JMP, JZ - accept label or register
-                if (tok.size() < 2) {
-                    res.ok = false; res.error = "JMP/JZ needs target"; res.lineNum = lineNum;
-                    return res;
-                }
-                std::string arg = tok[1];
+                if (t.count < 2) return fail("JMP/JZ needs target", lineNum);
                 uint8_t rs;
-                if (parseReg(arg, rs)) {
+                if (parseReg(t.tok[1], rs)) {
                     inst = encRR(static_cast<uint8_t>(op), 0, rs);  // Rd unused
-                } else {
-                    uint16_t target = labels.count(toUpper(arg)) ? labels[toUpper(arg)] : parseNumber(arg);
-                    if (target > 0x1FF) {
-                        res.ok = false;
-                        res.error = "Jump target > 511 (MOVI 9-bit limit); use register";
-                        res.lineNum = lineNum;
-                        return res;
-                    }
-                    mem[pc++] = encMOVI(7, target);       // MOVI R7, target
-                    inst = encRR(static_cast<uint8_t>(op), 0, 7);   // JMP/JZ R7
+                    break;
                 }
+                // MOVI R7, target; JMP/JZ R7, or past 9 bits JMPW/JZW R7, target
+                if (static_cast<size_t>(pc) + 1 >= memSize)
+                    return fail("Program too large", lineNum);
+                uint16_t target;
+                if (operand(t.tok[1], pc, Fixup::Branch, lineNum, target) && target > 0x1FF) {
+                    store(pc++, encFarBranch(static_cast<unsigned>(op)));
+                    inst = target;
+                    break;
+                }
+                store(pc++, encMOVI(7, target), Emit::BranchMovi);
+                inst = encRR(static_cast<uint8_t>(op), 0, 7);
                 break;
             }
             case 2: case 3: case 4: case 5: case 6: case 7: case 8: case 9:
             case 10: case 11: case 12: {
-                if (tok.size() < 2) {
-                    res.ok = false; res.error = "Needs operands"; res.lineNum = lineNum;
-                    return res;
-                }
+                if (t.count < 2) return fail("Needs operands", lineNum);
                 uint8_t rd, rs = 0;
-                if (!parseReg(tok[1], rd)) {
-                    res.ok = false; res.error = "Invalid Rd"; res.lineNum = lineNum;
-                    return res;
-                }
+                if (!parseReg(t.tok[1], rd)) return fail("Invalid Rd", lineNum);
                 if (op == 10 || op == 11 || op == 12) {
                     rs = rd;
-                } else if (tok.size() >= 3) {
-                    std::string arg = tok[2];
-                    if (parseReg(arg, rs)) { /* ok */ }
-                    else {
-                        uint16_t val = labels.count(toUpper(arg)) ? labels[toUpper(arg)] : parseNumber(arg);
-                        rs = static_cast<uint8_t>(val & 7);
-                    }
+                } else if (t.count >= 3 && !parseReg(t.tok[2], rs)) {
+                    uint16_t val;
+                    operand(t.tok[2], pc, Fixup::Reg, lineNum, val);
+                    rs = static_cast<uint8_t>(val & 7);
                 }
                 inst = encRR(static_cast<uint8_t>(op), rd, rs);
                 break;
@@ -270,15 +383,150 @@ AssembleResult assemble(const std::string& source, uint16_t* mem, size_t memSize
             default: break;
         }
 
-        mem[pc++] = inst;
+        store(pc++, inst);
+    }
+
+    // --- Patch label operands ---
+    for (const Fixup& f : fixups) {
+        uint16_t value;
+        if (!labels.lookup(f.name, value))
+            return fail("Unknown label: " + toUpper(f.name), f.lineNum);
+        switch (f.kind) {
+            case Fixup::Imm9:
+                if (value > 0x1FF)
+                    return fail(ERROR_MOVI_LABEL_FAR, f.lineNum);
+                mem[f.address] = static_cast<uint16_t>((mem[f.address] & ~0x1FFu) | (value & 0x1FFu));
+                break;
+            case Fixup::Reg:
+                mem[f.address] = static_cast<uint16_t>((mem[f.address] & ~(7u << 6)) | ((value & 7u) << 6));
+                break;
+            case Fixup::Branch:
+                if (value <= 0x1FF) {
+                    mem[f.address] = encMOVI(7, value);
+                    break;
+                }
+                if (f.split)
+                    return fail("Far jump target: its second word was overwritten", f.lineNum);
+                // Far form: JMPW/JZW R7 in place of the MOVI, the target in place of JMP/JZ R7
+                mem[f.address] = encFarBranch(mem[f.address + 1] >> 12);
+                mem[f.address + 1] = value;
+                break;
+            case Fixup::Wide:
+                mem[f.address] = value;
+                break;
+            case Fixup::Dead:
+                break;
+        }
+    }
+
+    // --- Peephole pass and listing ---
+    if (trackWords) {
+        std::vector<int32_t> wordAt(memSize, -1);  // Last stored word per address
+        for (size_t i = 0; i < emitted.size(); ++i)
+            wordAt[emitted[i].address] = static_cast<int32_t>(i);
+        for (PeepholeWord& w : emitted)
+            w.word = mem[w.address];
+
+        PeepholeResult pr{false, "", 0, 0, 0};
+        for (const Fixup& f : fixups) {
+            if (f.kind == Fixup::Reg) {
+                pr.reason = "label used as a register operand";
+                pr.blockingWord = static_cast<size_t>(wordAt[f.address]);
+                break;
+            }
+            if (f.kind != Fixup::Dead)
+                emitted[wordAt[f.address]].label = static_cast<int32_t>(labels.indexOf(f.name));
+        }
+        for (size_t i = 0; i < emitted.size() && pr.reason.empty(); ++i) {
+            uint16_t w = emitted[i].word;
+            if (!emitted[i].data && (w >> 12) == 15 && (w & 0x3Fu) >= EXT_MOVW && (w & 0x3Fu) <= EXT_JZW) {
+                pr.reason = "two-word instruction (MOVW, or JMP/JZ past 511)";
+                pr.blockingWord = i;
+            }
+        }
+
+        const std::vector<std::string_view>& names = labels.names();
+        std::vector<uint16_t> values(names.size());
+        for (size_t i = 0; i < names.size(); ++i)
+            labels.lookup(names[i], values[i]);
+
+        std::string summary;
+        if (options.optimize && pr.reason.empty())
+            pr = peephole(emitted, values);
+        if (pr.applied) {
+            for (const PeepholeWord& w : emitted)
+                mem[w.address] = 0;
+            std::fill(written.begin(), written.end(), 0);
+            for (const PeepholeWord& w : emitted) {
+                if (w.removed) continue;
+                mem[w.newAddress] = w.word;
+                written[w.newAddress >> 6] |= 1ull << (w.newAddress & 63);
+            }
+            for (size_t i = 0; i < names.size(); ++i)
+                labels.define(names[i], values[i]);
+            summary = std::to_string(emitted.size()) + " words -> " +
+                      std::to_string(emitted.size() - pr.removed) + " words (" +
+                      std::to_string(pr.removed) + " removed, " + std::to_string(pr.rewritten) + " folded)";
+        } else if (options.optimize) {
+            summary = "not optimized: " + pr.reason + " (line " +
+                      std::to_string(emittedLine[pr.blockingWord]) + ")";
+        } else {
+            summary = std::to_string(emitted.size()) + " words";
+        }
+        if (options.optimize)
+            info->optimizeNote = summary;
+        if (options.listing)
+            writeListing(info->listing, source, emitted, emittedLine, summary);
+
+        info->lines.clear();
+        for (size_t i = 0; i < emitted.size(); ++i) {
+            const PeepholeWord& w = emitted[i];
+            if (w.removed || wordAt[w.address] != static_cast<int32_t>(i))
+                continue;   // Dropped, or overwritten by a later write
+            info->lines.push_back(AssembleLine{w.newAddress, static_cast<uint32_t>(emittedLine[i])});
+        }
+        std::sort(info->lines.begin(), info->lines.end(),
+                  [](const AssembleLine& a, const AssembleLine& b) { return a.address < b.address; });
+    }
+
+    // --- Layout: maximal runs of written words, then labels ---
+    if (info) {
+        info->segments.clear();
+        for (size_t a = 0; a < memSize;) {
+            if (!((written[a >> 6] >> (a & 63)) & 1u)) {
+                ++a;
+                continue;
+            }
+            size_t first = a;
+            while (a < memSize && ((written[a >> 6] >> (a & 63)) & 1u))
+                ++a;
+            info->segments.push_back(AssembleSegment{static_cast<uint32_t>(first),
+                                                     static_cast<uint32_t>(a - first)});
+        }
+        info->symbols.clear();
+        for (std::string_view name : labels.names()) {
+            uint16_t value = 0;
+            labels.lookup(name, value);
+            info->symbols.push_back(AssembleSymbol{toUpper(name), value});
+        }
     }
-    return res;
+    return AssembleResult{true, "", 0};
+}
+
+AssembleResult assemble(const std::string& source, uint16_t* mem, size_t memSize,
+                        AssembleInfo* info, const AssembleOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    size_t lines;
+    AssembleResult r = assembleSource(source, mem, memSize, info, options, lines);
+    countAssemble(lines, start);
+    return r;
 }
 
-AssembleResult assembleFile(const char* path, uint16_t* mem, size_t memSize) {
+AssembleResult assembleFile(const char* path, uint16_t* mem, size_t memSize,
+                            AssembleInfo* info, const AssembleOptions& options) {
     std::ifstream in(path, std::ios::binary);
     if (!in) return AssembleResult{false, "Cannot open file", 0};
     std::string source((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
     in.close();
-    return assemble(source, mem, memSize);
+    return assemble(source, mem, memSize, info, options);
 }
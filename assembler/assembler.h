@@ -18,13 +18,60 @@ struct AssembleResult {
     size_t lineNum;
 };
 
+/** Contiguous run of words written by the program ([address, address + length)). */
+struct AssembleSegment {
+    uint32_t address;
+    uint32_t length;
+};
+
+/** Label and the address it resolved to (name upper-cased). */
+struct AssembleSymbol {
+    std::string name;
+    uint16_t value;
+};
+
+/** Source line a word was assembled from. */
+struct AssembleLine {
+    uint16_t address;
+    uint32_t line;
+};
+
+/** Layout of an assembled program, e.g. for writing a binary image. */
+struct AssembleInfo {
+    std::vector<AssembleSegment> segments;  // Ascending, non-overlapping
+    std::vector<AssembleSymbol> symbols;    // In order of first definition
+    std::vector<AssembleLine> lines;        // One per written word, ascending address
+    std::string optimizeNote;               // Words saved, or why optimize did not apply
+    std::string listing;                    // Filled if AssembleOptions::listing
+};
+
+/** Optional assembler passes. */
+struct AssembleOptions {
+    bool optimize = false;      // Peephole pass over the output (see peephole.h)
+    bool listing = false;       // Address / word / source listing into AssembleInfo
+};
+
 /**
  * Assemble source code into memory.
- * Returns AssembleResult; on success, instructions/data are written to mem.
+ * Returns AssembleResult; on success, instructions/data are written to mem
+ * and, if info is given, the written segments and labels are stored there.
+ *
+ * With options.optimize, redundant instructions (the MOVI R7 reloads of
+ * JMP/JZ label, NOPs, MOV Rx, Rx, constant ALU sequences) are dropped or
+ * folded and the code is relocated. That needs every jump target and code
+ * address to come from a label and the program not to read or write its own
+ * code; when the pass cannot prove a program safe it leaves it unchanged and
+ * says why in info->optimizeNote. Final flags and memory are kept, and so
+ * are registers other than those holding a label address (which moves with
+ * its label); PC and cycle counts are not.
  */
-AssembleResult assemble(const std::string& source, uint16_t* mem, size_t memSize);
+AssembleResult assemble(const std::string& source, uint16_t* mem, size_t memSize,
+                        AssembleInfo* info = nullptr,
+                        const AssembleOptions& options = AssembleOptions());
 
 /** Load and assemble a .asm file. */
-AssembleResult assembleFile(const char* path, uint16_t* mem, size_t memSize);
+AssembleResult assembleFile(const char* path, uint16_t* mem, size_t memSize,
+                            AssembleInfo* info = nullptr,
+                            const AssembleOptions& options = AssembleOptions());
 
 #endif // ASSEMBLER_H
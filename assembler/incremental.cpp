@@ -0,0 +1,245 @@
+/**
+ * Incremental assembler for 16-bit GPR CPU.
+ *
+ * Each line is parsed into a ParsedLine that does not depend on where the
+ * line ends up; a layout walks those records like assemble()'s single pass
+ * (same checks, in the same order, so errors match) and then resolves every
+ * word against the final label values. The result is compared word by word
+ * with what mem already holds.
+ */
+
+#include "incremental.h"
+#include "metrics.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+uint64_t hashText(std::string_view s) {
+    uint64_t h = 0xcbf29ce484222325ull;     // FNV-1a
+    for (char c : s)
+        h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+    return h;
+}
+
+AssembleResult fail(const std::string& error, size_t lineNum) {
+    return AssembleResult{false, error, lineNum};
+}
+
+/** Drop caches once they hold this many lines more than the source. */
+constexpr size_t CACHE_SLACK = 1024;
+
+} // namespace
+
+IncrementalAssembler::IncrementalAssembler(uint16_t* mem, size_t memSize)
+    : mem(mem), memSize(memSize), image(mem, mem + memSize), base(image) {}
+
+// =============================================================================
+// LAYOUT
+// =============================================================================
+
+uint32_t IncrementalAssembler::lineFor(std::string_view text) {
+    uint64_t h = hashText(text);
+    auto it = cache.find(h);
+    if (it != cache.end() && parsed[it->second].text == text)
+        return it->second;
+    uint32_t index = static_cast<uint32_t>(parsed.size());
+    parsed.emplace_back();
+    parsed.back().text = text;
+    parseLine(text, parsed.back(), labels);
+    if (it == cache.end())
+        cache.emplace(h, index);    // A colliding line stays uncached
+    ++stats.parsedLines;
+    return index;
+}
+
+AssembleResult IncrementalAssembler::relayout() {
+    stats.relaid = true;
+    valid = false;
+    auto lineAt = [this](size_t i) -> const ParsedLine& { return parsed[lines[i].parsed]; };
+    next.owner.assign(memSize, LineLayout::NO_OWNER);
+    AssembleResult r = layoutLines(
+        lines.size(), lineAt, [this](size_t i, uint16_t pc) { lines[i].address = pc; }, memSize, labels.size(), next);
+    auto liveWords = [this](size_t i) {
+        uint32_t slot = static_cast<uint32_t>(i) << 1;
+        size_t a = lines[i].address;
+        return (next.owner[a] == slot ? 1u : 0u) | (a + 1 < memSize && next.owner[a + 1] == (slot | 1) ? 2u : 0u);
+    };
+    if (r.ok)
+        r = checkLabelOperands(lines.size(), lineAt, liveWords, next.labelValue, labels);
+    if (!r.ok)
+        return r;
+
+    // --- Patch the words that changed ---
+    changed.clear();
+    for (size_t a = 0; a < memSize; ++a) {
+        uint32_t o = next.owner[a];
+        uint16_t w = o == LineLayout::NO_OWNER
+                         ? base[a]
+                         : resolveWord(lineAt(o >> 1), o & 1, next.labelValue, !(o & 1) || next.owner[a - 1] == (o & ~1u));
+        if (w != image[a]) {
+            image[a] = w;
+            mem[a] = w;
+            changed.push_back(static_cast<uint32_t>(a));
+        }
+    }
+    std::swap(current, next);
+    valid = true;
+
+    // --- Layout for callers: runs of written words, labels, line per word ---
+    info.segments.clear();
+    info.lines.clear();
+    for (size_t a = 0; a < memSize; ++a) {
+        uint32_t o = current.owner[a];
+        if (o == LineLayout::NO_OWNER)
+            continue;
+        if (!info.segments.empty() && info.segments.back().address + info.segments.back().length == a)
+            ++info.segments.back().length;
+        else
+            info.segments.push_back(AssembleSegment{static_cast<uint32_t>(a), 1});
+        info.lines.push_back(AssembleLine{static_cast<uint16_t>(a), (o >> 1) + 1});
+    }
+    info.symbols.clear();
+    for (uint32_t id : current.labelOrder)
+        info.symbols.push_back(AssembleSymbol{labels[id], static_cast<uint16_t>(current.labelValue[id])});
+    return r;
+}
+
+bool IncrementalAssembler::patchInPlace(size_t first, const std::vector<uint32_t>& replacement) {
+    if (!valid)
+        return false;
+    // --- Check: every address, label and store stays where it is ---
+    for (size_t i = 0; i < replacement.size(); ++i) {
+        const ParsedLine& before = parsed[lines[first + i].parsed];
+        const ParsedLine& after = parsed[replacement[i]];
+        if (after.kind != before.kind || after.words != before.words)
+            return false;
+        if (after.kind != ParsedLine::Blank && after.kind != ParsedLine::Word && after.kind != ParsedLine::Instr)
+            return false;
+        if (after.fixup != ParsedLine::None) {
+            int32_t value = after.label < current.labelValue.size() ? current.labelValue[after.label] : -1;
+            uint32_t slot = static_cast<uint32_t>(first + i) << 1;
+            uint16_t address = lines[first + i].address;
+            if (value < 0 || (after.fixup == ParsedLine::Imm9 && value > 0x1FF && current.owner[address] == slot) ||
+                (after.fixup == ParsedLine::Branch && value > 0x1FF && current.owner[address] == slot &&
+                 current.owner[address + 1] != (slot | 1)))
+                return false;   // An error: the full layout reports it in order
+        }
+    }
+
+    // --- Re-encode the words each line still owns ---
+    changed.clear();
+    for (size_t i = 0; i < replacement.size(); ++i) {
+        Line& line = lines[first + i];
+        line.parsed = replacement[i];
+        const ParsedLine& p = parsed[line.parsed];
+        uint32_t slot = static_cast<uint32_t>(first + i) << 1;
+        bool headLive = line.address < memSize && current.owner[line.address] == slot;
+        for (unsigned k = 0; k < p.words; ++k) {
+            size_t a = static_cast<size_t>(line.address) + k;
+            if (a >= memSize || current.owner[a] != (slot | k))
+                continue;       // Not stored, or overwritten by a later line
+            uint16_t w = resolveWord(p, k, current.labelValue, headLive);
+            if (w != image[a]) {
+                image[a] = w;
+                mem[a] = w;
+                changed.push_back(static_cast<uint32_t>(a));
+            }
+        }
+    }
+    stats.relaid = false;
+    return true;
+}
+
+// =============================================================================
+// PUBLIC API
+// =============================================================================
+
+void IncrementalAssembler::finish(std::vector<AssembleSegment>* dirty) {
+    stats.changedWords = changed.size();
+    if (!dirty)
+        return;
+    dirty->clear();
+    std::sort(changed.begin(), changed.end());
+    for (uint32_t a : changed) {
+        if (!dirty->empty() && dirty->back().address + dirty->back().length == a)
+            ++dirty->back().length;
+        else
+            dirty->push_back(AssembleSegment{a, 1});
+    }
+}
+
+/** Rebuild the cache from the current lines once edits have left it mostly stale. */
+void IncrementalAssembler::compact() {
+    if (parsed.size() <= 2 * lines.size() + CACHE_SLACK)
+        return;
+    std::vector<ParsedLine> kept;
+    std::vector<uint32_t> remap(parsed.size(), LineLayout::NO_OWNER);
+    for (Line& line : lines) {
+        if (remap[line.parsed] == LineLayout::NO_OWNER) {
+            remap[line.parsed] = static_cast<uint32_t>(kept.size());
+            kept.push_back(std::move(parsed[line.parsed]));
+        }
+        line.parsed = remap[line.parsed];
+    }
+    parsed.swap(kept);
+    cache.clear();
+    for (size_t i = 0; i < parsed.size(); ++i)
+        cache.emplace(hashText(parsed[i].text), static_cast<uint32_t>(i));
+}
+
+AssembleResult IncrementalAssembler::assemble(std::string_view source, std::vector<AssembleSegment>* dirty) {
+    auto start = std::chrono::steady_clock::now();
+    stats = Stats();
+    lines.clear();
+    forEachSourceLine(source, [this](std::string_view text) { lines.push_back(Line{lineFor(text), 0}); });
+    AssembleResult r = relayout();
+    if (r.ok)
+        finish(dirty);
+    else if (dirty)
+        dirty->clear();
+    compact();
+    countAssemble(lines.size(), start);
+    return r;
+}
+
+AssembleResult IncrementalAssembler::edit(size_t first, size_t count, std::string_view text,
+                                          std::vector<AssembleSegment>* dirty) {
+    auto start = std::chrono::steady_clock::now();
+    stats = Stats();
+    if (dirty)
+        dirty->clear();
+    if (first == 0 || first > lines.size() + 1 || count > lines.size() + 1 - first)
+        return fail("Edit past the end of the source", first);
+
+    std::vector<uint32_t> replacement;
+    forEachSourceLine(text, [&](std::string_view line) { replacement.push_back(lineFor(line)); });
+    if (replacement.size() == count && patchInPlace(first - 1, replacement)) {
+        finish(dirty);
+        countAssemble(replacement.size(), start);
+        return AssembleResult{true, "", 0};
+    }
+
+    auto at = lines.begin() + static_cast<std::ptrdiff_t>(first - 1);
+    at = lines.erase(at, at + static_cast<std::ptrdiff_t>(count));
+    std::vector<Line> inserted;
+    for (uint32_t index : replacement)
+        inserted.push_back(Line{index, 0});
+    lines.insert(at, inserted.begin(), inserted.end());
+
+    AssembleResult r = relayout();
+    if (r.ok)
+        finish(dirty);
+    compact();
+    countAssemble(replacement.size(), start);
+    return r;
+}
+
+std::string IncrementalAssembler::source() const {
+    std::string out;
+    for (const Line& line : lines) {
+        out += parsed[line.parsed].text;
+        out += '\n';
+    }
+    return out;
+}
@@ -0,0 +1,105 @@
+/**
+ * Incremental assembler for 16-bit GPR CPU.
+ * Keeps one program assembled into memory and, after an edit, re-parses
+ * only the changed lines and writes only the words whose value changed.
+ */
+
+#ifndef GPR_INCREMENTAL_H
+#define GPR_INCREMENTAL_H
+
+#include "assembler.h"
+#include "parsed_line.h"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * IncrementalAssembler: mem always holds what assemble() would write for the
+ * current source into mem as it was when the assembler was created.
+ *
+ * Lines are parsed on their own and cached by a hash of their text, so each
+ * distinct line is tokenized once however often it moves. An edit that keeps
+ * every address and label in place (same number of lines, each one replaced
+ * by one of the same kind and size: instruction, .WORD value or blank; no
+ * labels, .ORG or .WORD addr value) re-encodes just its own words against the
+ * current label table. Any other change lays the cached lines out again (no
+ * lexing) and resolves every label operand. Either way only words whose value
+ * changed are written to mem, and their ranges are returned as dirty so the
+ * caller can invalidate exactly those predecoded entries and JIT blocks
+ * (GPRCPU::invalidateDecodeCache(first, count), or write them through a Bus).
+ *
+ * The peephole pass and listing (AssembleOptions) are not available here.
+ * A failed assemble() / edit() keeps the new source but leaves mem and
+ * layout() as they were; the next successful one patches from there.
+ */
+class IncrementalAssembler {
+public:
+    /** Words the program never writes keep the values mem holds now. */
+    IncrementalAssembler(uint16_t* mem, size_t memSize);
+
+    /**
+     * Make source the whole program, as assemble(source, mem, memSize) would.
+     * dirty, if given, receives the written ranges (ascending, merged).
+     */
+    AssembleResult assemble(std::string_view source, std::vector<AssembleSegment>* dirty = nullptr);
+
+    /**
+     * Replace count lines starting at line first (1-based) by the lines of
+     * text ('\n'-separated, the last one unterminated or not). Empty text
+     * deletes; count 0 inserts before line first (lineCount() + 1 appends).
+     */
+    AssembleResult edit(size_t first, size_t count, std::string_view text,
+                        std::vector<AssembleSegment>* dirty = nullptr);
+
+    /** Segments, symbols and line table of the last successful assembly. */
+    const AssembleInfo& layout() const { return info; }
+
+    /** Current source, every line '\n'-terminated. */
+    std::string source() const;
+
+    size_t lineCount() const { return lines.size(); }
+
+    /** Work done by the last assemble() / edit(). */
+    struct Stats {
+        size_t parsedLines = 0;     // Lines tokenized (not found in the cache)
+        size_t changedWords = 0;    // Words written to mem
+        bool relaid = false;        // Laid out again (false = patched in place)
+    };
+    const Stats& lastStats() const { return stats; }
+
+private:
+    struct Line {
+        uint32_t parsed;        // Index into parsed
+        uint16_t address;       // PC at the start of the line (last layout)
+    };
+
+    uint16_t* mem;
+    size_t memSize;
+    std::vector<uint16_t> image;        // Current word per address (base value where unwritten)
+    std::vector<uint16_t> base;         // mem when the assembler was created
+    LineLayout current;                 // Of the last successful assembly
+
+    std::vector<Line> lines;
+    std::vector<ParsedLine> parsed;
+    std::unordered_map<uint64_t, uint32_t> cache;   // Text hash -> index into parsed
+
+    LabelNames labels;
+
+    bool valid = false;                 // Last layout matches lines (in-place edits allowed)
+    AssembleInfo info;
+    Stats stats;
+
+    LineLayout next;                    // Layout scratch, kept to avoid reallocating
+    std::vector<uint32_t> changed;      // Addresses written by the last call
+
+    uint32_t lineFor(std::string_view text);
+    bool patchInPlace(size_t first, const std::vector<uint32_t>& replacement);
+    AssembleResult relayout();
+    void finish(std::vector<AssembleSegment>* dirty);
+    void compact();
+};
+
+#endif // GPR_INCREMENTAL_H
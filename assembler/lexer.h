@@ -0,0 +1,206 @@
+/**
+ * Lexing and encoding helpers shared by the assemblers (internal to the
+ * assembler): tokens, numbers, registers, mnemonics and instruction words.
+ */
+
+#ifndef GPR_LEXER_H
+#define GPR_LEXER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// =============================================================================
+// LEXING
+// =============================================================================
+
+inline char toUpperChar(char c) {
+    if (c >= 'a' && c <= 'z') return static_cast<char>(c - 32);
+    return c;
+}
+
+inline std::string toUpper(std::string_view s) {
+    std::string out(s);
+    for (char& c : out) c = toUpperChar(c);
+    return out;
+}
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+inline std::string_view trim(std::string_view s) {
+    size_t a = 0, b = s.size();
+    while (a < b && isSpace(s[a])) ++a;
+    while (b > a && isSpace(s[b - 1])) --b;
+    return s.substr(a, b - a);
+}
+
+/** Tokens of one line; only the first MAX_TOKENS are kept, count is exact. */
+struct Tokens {
+    static constexpr size_t MAX_TOKENS = 4;
+    std::string_view tok[MAX_TOKENS];
+    size_t count;
+};
+
+inline void tokenize(std::string_view line, Tokens& t) {
+    t.count = 0;
+    size_t i = 0;
+    while (i < line.size()) {
+        while (i < line.size() && (isSpace(line[i]) || line[i] == ','))
+            ++i;
+        size_t start = i;
+        while (i < line.size() && !isSpace(line[i]) && line[i] != ',')
+            ++i;
+        if (i > start) {
+            if (t.count < Tokens::MAX_TOKENS)
+                t.tok[t.count] = line.substr(start, i - start);
+            ++t.count;
+        }
+    }
+}
+
+/**
+ * Parse an integer like std::stoul(s, nullptr, 0): optional sign, 0x/0 prefix
+ * for hex/octal, stops at the first non-digit. False if there are no digits.
+ */
+inline bool parseNumber(std::string_view s, uint16_t& out) {
+    size_t i = 0;
+    bool negative = false;
+    if (i < s.size() && (s[i] == '+' || s[i] == '-'))
+        negative = s[i++] == '-';
+
+    unsigned base = 10;
+    if (i + 1 < s.size() && s[i] == '0' && (s[i + 1] == 'x' || s[i + 1] == 'X')) {
+        base = 16;
+        i += 2;
+    } else if (i < s.size() && s[i] == '0') {
+        base = 8;
+    }
+
+    unsigned long v = 0;
+    size_t digits = 0;
+    for (; i < s.size(); ++i, ++digits) {
+        char c = s[i];
+        unsigned d;
+        if (c >= '0' && c <= '9') d = static_cast<unsigned>(c - '0');
+        else if (c >= 'a' && c <= 'f') d = static_cast<unsigned>(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') d = static_cast<unsigned>(c - 'A' + 10);
+        else break;
+        if (d >= base) break;
+        v = v * base + d;
+    }
+    if (digits == 0)
+        return false;
+    out = static_cast<uint16_t>((negative ? 0ul - v : v) & 0xFFFFu);
+    return true;
+}
+
+inline bool parseReg(std::string_view t, uint8_t& r) {
+    while (t.size() >= 2 && t.front() == '(' && t.back() == ')')
+        t = t.substr(1, t.size() - 2);  // (R0) -> R0
+    if (t.size() < 2 || (t[0] != 'R' && t[0] != 'r')) return false;
+    // Decimal after 'R', ignoring any trailing characters (like std::stoi)
+    size_t i = 1;
+    bool negative = false;
+    if (t[i] == '+' || t[i] == '-')
+        negative = t[i++] == '-';
+    int n = 0;
+    size_t digits = 0;
+    for (; i < t.size() && t[i] >= '0' && t[i] <= '9' && n <= 7; ++i, ++digits)
+        n = n * 10 + (t[i] - '0');
+    if (digits == 0 || negative || n > 7) return false;
+    r = static_cast<uint8_t>(n);
+    return true;
+}
+
+// =============================================================================
+// MNEMONIC TABLE (built at compile time)
+// =============================================================================
+// Up to 8 upper-cased characters are packed into a uint64_t key; a
+// multiplicative hash picks the slot and the key comparison is exact.
+
+inline constexpr int DIRECTIVE_ORG = 16;
+inline constexpr int DIRECTIVE_WORD = 17;
+inline constexpr int MNEMONIC_MOVW = 18;    // Extended op, no opcode of its own
+
+constexpr uint64_t packMnemonic(const char* s, size_t n) {
+    uint64_t key = 0;
+    for (size_t i = 0; i < n; ++i) {
+        char c = s[i];
+        if (c >= 'a' && c <= 'z') c = static_cast<char>(c - 32);
+        key |= static_cast<uint64_t>(static_cast<unsigned char>(c)) << (8 * i);
+    }
+    return key;
+}
+
+inline constexpr size_t MNEMONIC_SLOTS = 64;
+
+constexpr size_t mnemonicSlot(uint64_t key) {
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 58);
+}
+
+struct MnemonicTable {
+    uint64_t key[MNEMONIC_SLOTS];
+    int8_t code[MNEMONIC_SLOTS];    // Opcode 0-15, DIRECTIVE_*, MNEMONIC_MOVW, -1 = empty
+};
+
+constexpr MnemonicTable buildMnemonicTable() {
+    const char* names[] = {"HALT", "MOVI", "MOV", "LOAD", "STORE", "ADD", "SUB", "AND",
+                           "OR", "XOR", "NOT", "SHL", "SHR", "JMP", "JZ", "NOP",
+                           ".ORG", ".WORD", "MOVW"};
+    MnemonicTable t{};
+    for (size_t i = 0; i < MNEMONIC_SLOTS; ++i)
+        t.code[i] = -1;
+    for (size_t i = 0; i < sizeof names / sizeof names[0]; ++i) {
+        size_t n = 0;
+        while (names[i][n]) ++n;
+        uint64_t key = packMnemonic(names[i], n);
+        size_t slot = mnemonicSlot(key);
+        while (t.code[slot] >= 0)
+            slot = (slot + 1) & (MNEMONIC_SLOTS - 1);
+        t.key[slot] = key;
+        t.code[slot] = static_cast<int8_t>(i);
+    }
+    return t;
+}
+
+inline constexpr MnemonicTable MNEMONICS = buildMnemonicTable();
+
+/** Opcode 0-15, DIRECTIVE_ORG / DIRECTIVE_WORD, MNEMONIC_MOVW, or -1 if unknown. */
+inline int getOpcode(std::string_view mnem) {
+    if (mnem.empty() || mnem.size() > 8) return -1;
+    uint64_t key = packMnemonic(mnem.data(), mnem.size());
+    for (size_t slot = mnemonicSlot(key);; slot = (slot + 1) & (MNEMONIC_SLOTS - 1)) {
+        if (MNEMONICS.code[slot] < 0) return -1;
+        if (MNEMONICS.key[slot] == key) return MNEMONICS.code[slot];
+    }
+}
+
+// =============================================================================
+// ENCODING
+// =============================================================================
+
+inline uint16_t encMOVI(uint8_t rd, uint16_t imm9) {
+    return (1u << 12) | ((rd & 7u) << 9) | (imm9 & 0x1FFu);
+}
+inline uint16_t encRR(uint8_t op, uint8_t rd, uint8_t rs) {
+    return ((op & 15u) << 12) | ((rd & 7u) << 9) | ((rs & 7u) << 6);
+}
+
+/** Extended ops (NOP opcode, bits [5:0]); the 16-bit literal is the next word. */
+inline constexpr uint16_t EXT_MOVW = 1;     // Rd = literal
+inline constexpr uint16_t EXT_JMPW = 2;     // Rd = literal; JMP Rd
+inline constexpr uint16_t EXT_JZW = 3;      // Rd = literal; JZ Rd
+
+inline uint16_t encExt(uint16_t ext, uint8_t rd) {
+    return (15u << 12) | ((rd & 7u) << 9) | (ext & 0x3Fu);
+}
+
+/** First word of the far form of JMP / JZ label (op 13 / 14) through R7. */
+inline uint16_t encFarBranch(unsigned op) {
+    return encExt(op == 13 ? EXT_JMPW : EXT_JZW, 7);
+}
+
+#endif // GPR_LEXER_H
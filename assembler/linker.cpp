@@ -0,0 +1,244 @@
+/**
+ * Multi-module assembler for 16-bit GPR CPU.
+ *
+ * Phase 1 runs on a pool of threads, one module at a time: read, parse every
+ * line (parsed_line.cpp) and lay the module out on its own, keeping only the
+ * words it stores last. Phase 2, the link, is serial and touches no source
+ * text: merge the label tables, resolve label operands against the global
+ * table, check for overlaps and write the words.
+ */
+
+#include "linker.h"
+#include "parsed_line.h"
+#include "metrics.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+namespace {
+
+constexpr size_t NO_MODULE = SIZE_MAX;
+constexpr uint32_t NO_LINE = ~0u;
+
+/** A word a module stores last at its address. */
+struct ModuleStore {
+    uint16_t address;
+    uint8_t word;           // Index into the line's words
+    uint32_t line;          // 0-based
+};
+
+/** One module after phase 1. */
+struct Module {
+    std::vector<ParsedLine> lines;
+    LabelNames names;
+    std::vector<uint16_t> address;      // Per line: where it starts
+    std::vector<ModuleStore> stores;
+    std::vector<uint8_t> live;          // Per line: bit k set if word k is the last store to its address
+    std::vector<int32_t> labelValue;    // Per id, -1 = not defined here
+    std::vector<uint32_t> labelOrder;   // Defined ids, in order of first definition
+    std::vector<uint32_t> labelLine;    // Per id: 0-based line of its first definition
+    AssembleResult result{true, "", 0};
+};
+
+/** Parse and lay out one module; scratch is the worker's, reused across modules. */
+void buildModule(std::string_view source, size_t memSize, Module& m, LineLayout& scratch) {
+    forEachSourceLine(source, [&m](std::string_view text) {
+        m.lines.emplace_back();
+        parseLine(text, m.lines.back(), m.names);
+    });
+    m.address.resize(m.lines.size());
+    auto lineAt = [&m](size_t i) -> const ParsedLine& { return m.lines[i]; };
+    m.result = layoutLines(m.lines.size(), lineAt, [&m](size_t i, uint16_t pc) { m.address[i] = pc; }, memSize,
+                           m.names.size(), scratch);
+    if (!m.result.ok) {
+        scratch.owner.clear();      // Partly filled: the next module starts from scratch
+        return;
+    }
+
+    // --- Keep the last store to each word, and which words of each line survived;
+    //     clear each owner entry after its last reader, ready for the next module ---
+    m.live.assign(m.lines.size(), 0);
+    m.labelLine.assign(m.names.size(), NO_LINE);
+    for (size_t i = 0; i < m.lines.size(); ++i) {
+        const ParsedLine& p = m.lines[i];
+        uint32_t slot = static_cast<uint32_t>(i) << 1;
+        size_t first = p.kind == ParsedLine::WordAt ? p.value : m.address[i];
+        unsigned words = p.kind == ParsedLine::WordAt ? 1 : p.words;
+        if (p.kind == ParsedLine::Label && m.labelLine[p.label] == NO_LINE)
+            m.labelLine[p.label] = static_cast<uint32_t>(i);
+        for (unsigned k = 0; k < words; ++k) {
+            size_t a = first + k;
+            if (a < memSize && scratch.owner[a] == (slot | k)) {
+                m.live[i] |= static_cast<uint8_t>(1u << k);
+                m.stores.push_back(ModuleStore{static_cast<uint16_t>(a), static_cast<uint8_t>(k),
+                                               static_cast<uint32_t>(i)});
+                scratch.owner[a] = LineLayout::NO_OWNER;
+            }
+        }
+    }
+    m.labelValue = scratch.labelValue;
+    m.labelOrder = scratch.labelOrder;
+}
+
+/** Phase 1 over count modules; source(i, storage) yields module i's text or false (error set). */
+template <typename Source>
+void buildModules(size_t count, size_t memSize, const LinkOptions& options, std::vector<Module>& modules,
+                  Source source) {
+    modules.resize(count);
+    unsigned n = options.threads ? options.threads : std::thread::hardware_concurrency();
+    if (n == 0)
+        n = 1;
+    if (n > count)
+        n = static_cast<unsigned>(count);
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        LineLayout scratch;
+        std::string storage;
+        for (size_t i; (i = next.fetch_add(1)) < count;) {
+            std::string_view text;
+            if (source(i, storage, text, modules[i].result))
+                buildModule(text, memSize, modules[i], scratch);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < n; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread& t : threads)
+        t.join();
+}
+
+LinkResult failAt(std::string error, size_t module, size_t lineNum, size_t otherModule = NO_MODULE,
+                  size_t otherLine = 0) {
+    return LinkResult{false, std::move(error), module, lineNum, otherModule, otherLine};
+}
+
+/** Phase 2. */
+LinkResult link(std::vector<Module>& modules, uint16_t* mem, size_t memSize, AssembleInfo* info) {
+    for (size_t m = 0; m < modules.size(); ++m)
+        if (!modules[m].result.ok)
+            return failAt(modules[m].result.error, m, modules[m].result.lineNum);
+
+    // --- Global labels, in module order ---
+    struct Symbol {
+        const std::string* name;
+        uint16_t value;
+        size_t module;
+        uint32_t line;
+    };
+    std::unordered_map<std::string_view, uint32_t> globalIds;
+    std::vector<Symbol> symbols;
+    for (size_t m = 0; m < modules.size(); ++m) {
+        const Module& mod = modules[m];
+        for (uint32_t id : mod.labelOrder) {
+            const std::string& name = mod.names[id];
+            auto inserted = globalIds.emplace(name, static_cast<uint32_t>(symbols.size()));
+            if (!inserted.second) {
+                const Symbol& other = symbols[inserted.first->second];
+                return failAt("Duplicate label: " + name, m, mod.labelLine[id] + 1, other.module, other.line + 1);
+            }
+            symbols.push_back(Symbol{&name, static_cast<uint16_t>(mod.labelValue[id]), m, mod.labelLine[id]});
+        }
+    }
+
+    // --- Label operands: each module's names against the global table ---
+    std::vector<std::vector<int32_t>> resolved(modules.size());
+    for (size_t m = 0; m < modules.size(); ++m) {
+        const Module& mod = modules[m];
+        std::vector<int32_t>& values = resolved[m];
+        values.assign(mod.names.size(), -1);
+        for (uint32_t id = 0; id < mod.names.size(); ++id) {
+            auto it = globalIds.find(mod.names[id]);
+            if (it != globalIds.end())
+                values[id] = symbols[it->second].value;
+        }
+        AssembleResult r = checkLabelOperands(
+            mod.lines.size(), [&mod](size_t i) -> const ParsedLine& { return mod.lines[i]; },
+            [&mod](size_t i) { return mod.live[i]; }, values, mod.names);
+        if (!r.ok)
+            return failAt(r.error, m, r.lineNum);
+    }
+
+    // --- Overlaps: every word has at most one module ---
+    std::vector<uint32_t> moduleAt(memSize, NO_LINE);
+    std::vector<uint32_t> lineAt(memSize);
+    for (size_t m = 0; m < modules.size(); ++m) {
+        for (const ModuleStore& s : modules[m].stores) {
+            if (moduleAt[s.address] != NO_LINE) {
+                char buf[48];
+                std::snprintf(buf, sizeof buf, "Overlaps another module at 0x%04X", s.address);
+                return failAt(buf, m, s.line + 1, moduleAt[s.address], lineAt[s.address] + 1);
+            }
+            moduleAt[s.address] = static_cast<uint32_t>(m);
+            lineAt[s.address] = s.line;
+        }
+    }
+
+    // --- Write ---
+    for (size_t m = 0; m < modules.size(); ++m)
+        for (const ModuleStore& s : modules[m].stores)
+            mem[s.address] = resolveWord(modules[m].lines[s.line], s.word, resolved[m], modules[m].live[s.line] & 1);
+    if (info) {
+        info->segments.clear();
+        info->lines.clear();
+        for (size_t a = 0; a < memSize; ++a) {
+            if (moduleAt[a] == NO_LINE)
+                continue;
+            if (!info->segments.empty() && info->segments.back().address + info->segments.back().length == a)
+                ++info->segments.back().length;
+            else
+                info->segments.push_back(AssembleSegment{static_cast<uint32_t>(a), 1});
+        }
+        info->symbols.clear();
+        for (const Symbol& s : symbols)
+            info->symbols.push_back(AssembleSymbol{*s.name, s.value});
+    }
+    return LinkResult{true, "", NO_MODULE, 0, NO_MODULE, 0};
+}
+
+/** link(), counted as one assembler call over every module's lines. */
+LinkResult linkAndCount(std::vector<Module>& modules, uint16_t* mem, size_t memSize, AssembleInfo* info,
+                        std::chrono::steady_clock::time_point start) {
+    LinkResult r = link(modules, mem, memSize, info);
+    size_t lines = 0;
+    for (const Module& m : modules)
+        lines += m.lines.size();
+    countAssemble(lines, start);
+    return r;
+}
+
+} // namespace
+
+LinkResult linkSources(const std::vector<std::string_view>& sources, uint16_t* mem, size_t memSize,
+                       AssembleInfo* info, const LinkOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Module> modules;
+    buildModules(sources.size(), memSize, options, modules,
+                 [&sources](size_t i, std::string&, std::string_view& text, AssembleResult&) {
+                     text = sources[i];
+                     return true;
+                 });
+    return linkAndCount(modules, mem, memSize, info, start);
+}
+
+LinkResult linkFiles(const std::vector<std::string>& paths, uint16_t* mem, size_t memSize,
+                     AssembleInfo* info, const LinkOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Module> modules;
+    buildModules(paths.size(), memSize, options, modules,
+                 [&paths](size_t i, std::string& storage, std::string_view& text, AssembleResult& error) {
+                     std::ifstream in(paths[i], std::ios::binary);
+                     if (!in) {
+                         error = AssembleResult{false, "Cannot open file", 0};
+                         return false;
+                     }
+                     storage.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+                     text = storage;
+                     return true;
+                 });
+    return linkAndCount(modules, mem, memSize, info, start);
+}
@@ -0,0 +1,59 @@
+/**
+ * Multi-module assembler for 16-bit GPR CPU.
+ * Assembles many source files in parallel and links them into one program:
+ * one global label table, cross-module label operands, overlap checks.
+ */
+
+#ifndef GPR_LINKER_H
+#define GPR_LINKER_H
+
+#include "assembler.h"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct LinkOptions {
+    unsigned threads = 0;       // 0 = std::thread::hardware_concurrency()
+};
+
+/**
+ * Outcome of a link. On failure, module and lineNum (1-based, 0 = the whole
+ * file) locate the error; other is the location it conflicts with, for
+ * duplicate labels and overlapping modules (SIZE_MAX module = none).
+ */
+struct LinkResult {
+    bool ok;
+    std::string error;
+    size_t module;
+    size_t lineNum;
+    size_t otherModule;
+    size_t otherLine;
+};
+
+/**
+ * Assemble each source as a module and link them into mem.
+ *
+ * Modules are lexed, parsed and laid out in parallel; each starts at
+ * address 0 and places its segments with .ORG. Inside a module the rules of
+ * assemble() hold, later writes replacing earlier ones. Across modules:
+ *  - labels are global, and a label defined by two modules is an error;
+ *  - a label operand may name a label of any module;
+ *  - two modules writing the same word is an error.
+ * A single module links to exactly what assemble() writes. Errors come in
+ * the order: per-module syntax and size errors (lowest module first), then
+ * duplicate labels, label operands and overlaps.
+ *
+ * info, if given, receives the segments and the symbols (module order,
+ * then order of definition). info->lines stays empty: a line number alone
+ * does not say which module it is in. mem is left unchanged on failure.
+ */
+LinkResult linkSources(const std::vector<std::string_view>& sources, uint16_t* mem, size_t memSize,
+                       AssembleInfo* info = nullptr, const LinkOptions& options = LinkOptions());
+
+/** Like linkSources() over the contents of paths, which are read in parallel too. */
+LinkResult linkFiles(const std::vector<std::string>& paths, uint16_t* mem, size_t memSize,
+                     AssembleInfo* info = nullptr, const LinkOptions& options = LinkOptions());
+
+#endif // GPR_LINKER_H
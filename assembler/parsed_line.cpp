@@ -0,0 +1,181 @@
+/**
+ * 16-bit GPR CPU assembler - Parsed lines (see parsed_line.h)
+ */
+
+#include "parsed_line.h"
+#include "lexer.h"
+
+namespace {
+
+/** A number operand (leading digit or sign); anything else is a label. */
+bool numericOperand(std::string_view arg, uint16_t& value) {
+    char c = arg[0];
+    return ((c >= '0' && c <= '9') || c == '-' || c == '+') && parseNumber(arg, value);
+}
+
+} // namespace
+
+uint32_t LabelNames::intern(std::string_view name) {
+    std::string key = toUpper(name);
+    auto it = ids.find(key);
+    if (it != ids.end())
+        return it->second;
+    uint32_t id = static_cast<uint32_t>(names.size());
+    ids.emplace(key, id);
+    names.push_back(std::move(key));
+    return id;
+}
+
+// The body follows assemble()'s line loop; the address checks are in layoutLines()
+void parseLine(std::string_view text, ParsedLine& p, LabelNames& labels) {
+    auto error = [&p](uint8_t words, std::string message) {
+        p.kind = ParsedLine::Error;
+        p.words = words;
+        p.error = std::move(message);
+    };
+
+    size_t semi = text.find(';');
+    std::string_view rest = trim(semi == std::string_view::npos ? text : text.substr(0, semi));
+    if (rest.empty())
+        return;
+
+    if (rest.back() == ':') {
+        std::string_view name = trim(rest.substr(0, rest.size() - 1));
+        if (!name.empty()) {
+            p.kind = ParsedLine::Label;
+            p.label = labels.intern(name);
+        }
+        return;
+    }
+
+    Tokens t;
+    tokenize(rest, t);
+    if (t.count == 0)
+        return;
+
+    int op = getOpcode(t.tok[0]);
+    if (op < 0)
+        return error(0, "Unknown: " + toUpper(t.tok[0]));
+
+    // --- Directives ---
+    if (op == DIRECTIVE_ORG) {
+        if (t.count < 2) return error(0, ".ORG requires address");
+        if (!parseNumber(t.tok[1], p.value)) return error(0, "Invalid number");
+        p.kind = ParsedLine::Org;
+        return;
+    }
+    if (op == DIRECTIVE_WORD) {
+        if (t.count == 1) return error(0, ".WORD requires value");
+        if (!parseNumber(t.tok[1], p.word[0])) return error(0, "Invalid number");
+        if (t.count >= 3) {
+            p.value = p.word[0];
+            if (!parseNumber(t.tok[2], p.word[0])) return error(0, "Invalid number");
+            p.kind = ParsedLine::WordAt;
+        } else {
+            p.kind = ParsedLine::Word;
+            p.words = 1;
+        }
+        return;
+    }
+
+    // --- Instructions (a Program too large check comes before any error) ---
+    p.kind = ParsedLine::Instr;
+    p.words = 1;
+    switch (op) {
+        case 0: p.word[0] = 0x0000; break;
+        case 1: {
+            if (t.count < 3) return error(1, "MOVI Rd, imm");
+            uint8_t rd;
+            if (!parseReg(t.tok[1], rd)) return error(1, "Invalid register");
+            uint16_t imm = 0;
+            if (!numericOperand(t.tok[2], imm)) {
+                p.fixup = ParsedLine::Imm9;
+                p.label = labels.intern(t.tok[2]);
+            } else if (imm > 0x1FF) {
+                p.words = 2;    // MOVW Rd, imm
+                p.word[0] = encExt(EXT_MOVW, rd);
+                p.word[1] = imm;
+                break;
+            }
+            p.word[0] = encMOVI(rd, imm & 0x1FF);
+            break;
+        }
+        case MNEMONIC_MOVW: {
+            if (t.count < 3) return error(1, "MOVW Rd, value");
+            uint8_t rd;
+            if (!parseReg(t.tok[1], rd)) return error(1, "Invalid register");
+            p.words = 2;
+            p.word[0] = encExt(EXT_MOVW, rd);
+            if (!numericOperand(t.tok[2], p.word[1])) {
+                p.fixup = ParsedLine::Wide;
+                p.label = labels.intern(t.tok[2]);
+                p.word[1] = 0;
+            }
+            break;
+        }
+        case 13: case 14: {
+            if (t.count < 2) return error(1, "JMP/JZ needs target");
+            uint8_t rs;
+            if (parseReg(t.tok[1], rs)) {
+                p.word[0] = encRR(static_cast<uint8_t>(op), 0, rs);
+                break;
+            }
+            p.words = 2;        // MOVI R7, target; JMP/JZ R7, or past 9 bits JMPW/JZW R7, target
+            uint16_t target = 0;
+            if (numericOperand(t.tok[1], target)) {
+                if (target > 0x1FF) {
+                    p.word[0] = encFarBranch(static_cast<unsigned>(op));
+                    p.word[1] = target;
+                    break;
+                }
+            } else {
+                p.fixup = ParsedLine::Branch;
+                p.label = labels.intern(t.tok[1]);
+            }
+            p.word[0] = encMOVI(7, target);
+            p.word[1] = encRR(static_cast<uint8_t>(op), 0, 7);
+            break;
+        }
+        case 2: case 3: case 4: case 5: case 6: case 7: case 8: case 9:
+        case 10: case 11: case 12: {
+            if (t.count < 2) return error(1, "Needs operands");
+            uint8_t rd, rs = 0;
+            if (!parseReg(t.tok[1], rd)) return error(1, "Invalid Rd");
+            if (op == 10 || op == 11 || op == 12) {
+                rs = rd;
+            } else if (t.count >= 3 && !parseReg(t.tok[2], rs)) {
+                uint16_t val = 0;
+                if (!numericOperand(t.tok[2], val)) {
+                    p.fixup = ParsedLine::Reg;
+                    p.label = labels.intern(t.tok[2]);
+                }
+                rs = static_cast<uint8_t>(val & 7);
+            }
+            p.word[0] = encRR(static_cast<uint8_t>(op), rd, rs);
+            break;
+        }
+        case 15: p.word[0] = 0xF000; break;
+        default: break;
+    }
+}
+
+uint16_t resolveWord(const ParsedLine& p, unsigned k, const std::vector<int32_t>& labelValue, bool headLive) {
+    uint16_t w = p.word[k];
+    if (p.fixup == ParsedLine::None)
+        return w;
+    uint16_t value = static_cast<uint16_t>(labelValue[p.label]);
+    if (k == 1) {
+        if (p.fixup == ParsedLine::Wide)
+            return value;
+        // A far JMP/JZ rewrites its second word only along with the first
+        if (p.fixup == ParsedLine::Branch && value > 0x1FF && headLive)
+            return value;
+        return w;
+    }
+    switch (p.fixup) {
+        case ParsedLine::Imm9: return static_cast<uint16_t>((w & ~0x1FFu) | (value & 0x1FFu));
+        case ParsedLine::Reg: return static_cast<uint16_t>((w & ~(7u << 6)) | ((value & 7u) << 6));
+        case ParsedLine::Branch: return value > 0x1FF ? encFarBranch(p.word[1] >> 12) : encMOVI(7, value);
+        default: return w;
+    }
+}
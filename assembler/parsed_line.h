@@ -0,0 +1,161 @@
+/**
+ * Address-independent parse of one source line, and assemble()'s address
+ * pass over such lines (internal to the assembler). Shared by the
+ * incremental assembler and the linker.
+ */
+
+#ifndef GPR_PARSED_LINE_H
+#define GPR_PARSED_LINE_H
+
+#include "assembler.h"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/** Error for MOVI Rd, label when the label does not fit 9 bits (assemble() reports it too). */
+inline constexpr const char* ERROR_MOVI_LABEL_FAR = "Label past 511: use MOVW";
+
+/** Label names interned to small ids (case-insensitive, stored upper-cased). */
+class LabelNames {
+public:
+    uint32_t intern(std::string_view name);
+
+    size_t size() const { return names.size(); }
+    const std::string& operator[](uint32_t id) const { return names[id]; }
+
+private:
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<std::string> names;
+};
+
+/** One source line parsed on its own: everything but its address. */
+struct ParsedLine {
+    enum Kind : uint8_t { Blank, Label, Org, Word, WordAt, Instr, Error };
+    enum Fixup : uint8_t { None, Imm9, Reg, Branch, Wide };
+
+    std::string text;       // The line as written (kept by the incremental assembler only)
+    Kind kind = Blank;
+    Fixup fixup = None;     // Label operand of word[0] (Wide: of word[1])
+    uint8_t words = 0;      // Word: 1; Instr: 1, or 2 (JMP/JZ label, MOVW); Error: size checked before it
+    uint16_t value = 0;     // Org: address; WordAt: target address
+    uint16_t word[2] = {};  // Encodings, label operand bits zero; Word / WordAt: the value
+    uint32_t label = 0;     // Label: defined id; fixup: operand id
+    std::string error;
+};
+
+/** Parse text (one line, no '\n') like one iteration of assemble()'s loop; p.text is not set. */
+void parseLine(std::string_view text, ParsedLine& p, LabelNames& labels);
+
+/**
+ * Word k of p with its label operand (if any) set from labelValue. headLive:
+ * word 0 is the last store to its address (a JMP/JZ label past 511 takes its
+ * far form in both words, or keeps JMP/JZ R7 as word 1 when word 0 is gone).
+ */
+uint16_t resolveWord(const ParsedLine& p, unsigned k, const std::vector<int32_t>& labelValue, bool headLive);
+
+/** Call f for each '\n'-separated line of text (no line after a final '\n'). */
+template <typename F>
+void forEachSourceLine(std::string_view text, F f) {
+    for (size_t pos = 0; pos < text.size();) {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string_view::npos)
+            eol = text.size();
+        f(text.substr(pos, eol - pos));
+        pos = eol + 1;
+    }
+}
+
+/** Addresses and labels of a run of parsed lines. */
+struct LineLayout {
+    static constexpr uint32_t NO_OWNER = ~0u;
+
+    std::vector<uint32_t> owner;        // Per word: line index << 1 | word of its last store, or NO_OWNER
+    std::vector<int32_t> labelValue;    // Per label id, -1 = undefined
+    std::vector<uint32_t> labelOrder;   // Label ids in order of first definition
+};
+
+/**
+ * assemble()'s pass over count parsed lines: lineAt(i) returns line i and
+ * setAddress(i, pc) receives the address it starts at. Applies the same
+ * checks in the same order, so the first error (1-based line) matches.
+ * Label operands are not checked; see checkLabelOperands(). out.owner must
+ * be empty or memSize NO_OWNER entries on entry.
+ */
+template <typename LineAt, typename SetAddress>
+AssembleResult layoutLines(size_t count, LineAt lineAt, SetAddress setAddress, size_t memSize,
+                           size_t labelCount, LineLayout& out) {
+    if (out.owner.size() != memSize)
+        out.owner.assign(memSize, LineLayout::NO_OWNER);
+    out.labelValue.assign(labelCount, -1);
+    out.labelOrder.clear();
+    uint16_t pc = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const ParsedLine& p = lineAt(i);
+        uint32_t slot = static_cast<uint32_t>(i) << 1;
+        setAddress(i, pc);
+        switch (p.kind) {
+            case ParsedLine::Blank:
+                break;
+            case ParsedLine::Label:
+                if (out.labelValue[p.label] < 0)
+                    out.labelOrder.push_back(p.label);
+                out.labelValue[p.label] = pc;
+                break;
+            case ParsedLine::Org:
+                pc = p.value;
+                break;
+            case ParsedLine::Word:
+                if (pc < memSize)
+                    out.owner[pc] = slot;
+                pc++;
+                break;
+            case ParsedLine::WordAt:
+                if (p.value < memSize)
+                    out.owner[p.value] = slot;
+                break;
+            case ParsedLine::Instr:
+            case ParsedLine::Error:
+                if (p.words >= 1 && pc >= memSize)
+                    return AssembleResult{false, "Program too large", i + 1};
+                if (p.words == 2 && static_cast<size_t>(pc) + 1 >= memSize)
+                    return AssembleResult{false, "Program too large", i + 1};
+                if (p.kind == ParsedLine::Error)
+                    return AssembleResult{false, p.error, i + 1};
+                out.owner[pc] = slot;
+                if (p.words == 2)
+                    out.owner[pc + 1] = slot | 1;
+                pc = static_cast<uint16_t>(pc + p.words);
+                break;
+        }
+    }
+    return AssembleResult{true, "", 0};
+}
+
+/**
+ * assemble()'s label operand checks, in line order: every operand must name
+ * a label in labelValue (even if its word was overwritten later), a surviving
+ * MOVI label must fit 9 bits, and a JMP/JZ label past 9 bits needs both words
+ * where its first survived. liveWords(i) has bit k set if word k of line i is
+ * still the last store to its address.
+ */
+template <typename LineAt, typename LiveWords>
+AssembleResult checkLabelOperands(size_t count, LineAt lineAt, LiveWords liveWords,
+                                  const std::vector<int32_t>& labelValue, const LabelNames& names) {
+    for (size_t i = 0; i < count; ++i) {
+        const ParsedLine& p = lineAt(i);
+        if (p.kind != ParsedLine::Instr || p.fixup == ParsedLine::None)
+            continue;
+        if (labelValue[p.label] < 0)
+            return AssembleResult{false, "Unknown label: " + names[p.label], i + 1};
+        if (p.fixup == ParsedLine::Imm9 && labelValue[p.label] > 0x1FF && (liveWords(i) & 1))
+            return AssembleResult{false, ERROR_MOVI_LABEL_FAR, i + 1};
+        if (p.fixup == ParsedLine::Branch && labelValue[p.label] > 0x1FF && liveWords(i) == 1)
+            return AssembleResult{false, "Far jump target: its second word was overwritten", i + 1};
+    }
+    return AssembleResult{true, "", 0};
+}
+
+#endif // GPR_PARSED_LINE_H
@@ -0,0 +1,622 @@
+/**
+ * Peephole optimizer for assembled GPR programs.
+ *
+ * Each round runs two analyses over the control-flow graph of the emitted
+ * instructions:
+ *   - forward: what every register and the flags hold (a constant, a label
+ *     address, or unknown) before each instruction
+ *   - backward: which registers and flags are still read afterwards
+ * and then applies one class of changes:
+ *   A. state-preserving: NOPs, MOVIs and MOV Rx, Rx whose register and flags
+ *      already hold exactly what they would write
+ *   B. redundant: the same instructions when only their flag update differs
+ *      and the flags are dead, and ALU results with constant operands folded
+ *      into MOVI (register values are unchanged, only dead flags may differ)
+ *   C. dead writes: instructions whose register and flag results are never
+ *      read (register values change, but only where nothing reads them)
+ * Changes within a class never invalidate each other, but across classes
+ * they can (a B-removal may rely on the value a C-removal deletes), so a
+ * round applies the first class that finds anything and the analyses are
+ * rerun. Everything stops when a round finds nothing to do. Registers and
+ * flags are live at HALT (final state is observable); PC and the cycle count
+ * are expected to change.
+ */
+
+#include "peephole.h"
+
+namespace {
+
+// =============================================================================
+// INSTRUCTION FIELDS
+// =============================================================================
+
+enum Op : unsigned {
+    HALT = 0, MOVI, MOV, LOAD, STORE, ADD, SUB, AND, OR, XOR, NOT, SHL, SHR, JMP, JZ, NOP
+};
+
+unsigned opOf(uint16_t w) { return w >> 12; }
+unsigned rdOf(uint16_t w) { return (w >> 9) & 7u; }
+unsigned rsOf(uint16_t w) { return (w >> 6) & 7u; }
+
+uint16_t encMOVI(unsigned rd, uint16_t imm9) {
+    return static_cast<uint16_t>((1u << 12) | ((rd & 7u) << 9) | (imm9 & 0x1FFu));
+}
+
+constexpr unsigned FLAGS_BIT = 1u << 8;
+constexpr unsigned ALL_STATE = 0x1FFu;       // R0-R7 + flags
+
+/** Registers (bits 0-7) and flags (bit 8) read by an instruction. */
+unsigned uses(uint16_t w) {
+    unsigned rd = 1u << rdOf(w), rs = 1u << rsOf(w);
+    switch (opOf(w)) {
+        case HALT: return ALL_STATE;
+        case MOV: case LOAD: case NOT: return rs;
+        case STORE: case ADD: case SUB: case AND: case OR: case XOR: return rd | rs;
+        case SHL: case SHR: return rd;
+        case JMP: return rs;
+        case JZ: return rs | FLAGS_BIT;
+        default: return 0;
+    }
+}
+
+/** Registers and flags written. */
+unsigned defs(uint16_t w) {
+    switch (opOf(w)) {
+        case MOVI: case MOV: case LOAD: case ADD: case SUB: case AND: case OR: case XOR:
+        case NOT: case SHL: case SHR:
+            return (1u << rdOf(w)) | FLAGS_BIT;
+        default:
+            return 0;
+    }
+}
+
+// =============================================================================
+// ABSTRACT VALUES
+// =============================================================================
+
+/** A register value or the value the flags were computed from. */
+struct Val {
+    enum Kind : uint8_t { Top, Const, Label, Unknown };
+    Kind kind;
+    uint32_t x;         // Constant, or label index
+
+    bool operator==(const Val& o) const { return kind == o.kind && x == o.x; }
+    bool operator!=(const Val& o) const { return !(*this == o); }
+};
+
+const Val TOP = {Val::Top, 0};
+const Val UNKNOWN = {Val::Unknown, 0};
+
+Val constant(uint32_t v) { return Val{Val::Const, v & 0xFFFFu}; }
+
+Val meet(const Val& a, const Val& b) {
+    if (a.kind == Val::Top) return b;
+    if (b.kind == Val::Top) return a;
+    return a == b ? a : UNKNOWN;
+}
+
+/**
+ * Machine state before an instruction. flags is the value a "Result" flag
+ * update (MOVI/MOV/LOAD/logic) was computed from; any other flag update, or
+ * an unknown value, is UNKNOWN. mayLabel has a bit per register that can
+ * hold a label address on some path (even where R[] is UNKNOWN after a merge).
+ */
+struct State {
+    Val R[8];
+    Val flags;
+    uint8_t mayLabel;
+    bool reached;
+
+    bool operator==(const State& o) const {
+        if (reached != o.reached || flags != o.flags || mayLabel != o.mayLabel) return false;
+        for (unsigned i = 0; i < 8; ++i)
+            if (R[i] != o.R[i]) return false;
+        return true;
+    }
+};
+
+State unreached() {
+    State s;
+    for (Val& v : s.R) v = TOP;
+    s.flags = TOP;
+    s.mayLabel = 0;
+    s.reached = false;
+    return s;
+}
+
+State entryState() {
+    State s;
+    for (Val& v : s.R) v = UNKNOWN;
+    s.flags = UNKNOWN;
+    s.mayLabel = 0;
+    s.reached = true;
+    return s;
+}
+
+void meetInto(State& into, const State& from) {
+    for (unsigned i = 0; i < 8; ++i)
+        into.R[i] = meet(into.R[i], from.R[i]);
+    into.flags = meet(into.flags, from.flags);
+    into.mayLabel |= from.mayLabel;
+    into.reached = true;
+}
+
+/** Result of a constant ALU operation, or false if not computable. */
+bool fold(uint16_t w, const State& s, uint16_t& result) {
+    const Val& a = s.R[rdOf(w)];
+    const Val& b = s.R[rsOf(w)];
+    unsigned op = opOf(w);
+    bool same = rdOf(w) == rsOf(w);
+    if ((op == XOR || op == SUB) && same) {
+        result = 0;
+        return true;
+    }
+    bool needA = op != MOV && op != NOT;
+    bool needB = op != SHL && op != SHR;
+    if ((needA && a.kind != Val::Const) || (needB && b.kind != Val::Const))
+        return false;
+    uint16_t va = static_cast<uint16_t>(a.x), vb = static_cast<uint16_t>(b.x);
+    switch (op) {
+        case MOV: result = vb; return true;
+        case ADD: result = static_cast<uint16_t>(va + vb); return true;
+        case SUB: result = static_cast<uint16_t>(va - vb); return true;
+        case AND: result = va & vb; return true;
+        case OR:  result = va | vb; return true;
+        case XOR: result = va ^ vb; return true;
+        case NOT: result = static_cast<uint16_t>(~vb); return true;
+        case SHL: result = static_cast<uint16_t>(va << 1); return true;
+        case SHR: result = static_cast<uint16_t>(va >> 1); return true;
+        default: return false;
+    }
+}
+
+/** Flag update of an op is a "Result" one (same as MOVI of its result). */
+bool resultFlags(unsigned op) {
+    return op == MOVI || op == MOV || op == LOAD || op == AND || op == OR || op == XOR || op == NOT;
+}
+
+/** State after executing word w (a code word, not data). */
+State transfer(const PeepholeWord& pw, const State& in) {
+    State s = in;
+    uint16_t w = pw.word;
+    unsigned op = opOf(w), rd = rdOf(w), rs = rsOf(w);
+    switch (op) {
+        case MOVI: {
+            Val v = pw.label >= 0 ? Val{Val::Label, static_cast<uint32_t>(pw.label)} : constant(w & 0x1FFu);
+            s.R[rd] = v;
+            s.flags = v;
+            s.mayLabel = static_cast<uint8_t>(pw.label >= 0 ? s.mayLabel | (1u << rd) : s.mayLabel & ~(1u << rd));
+            break;
+        }
+        case MOV:
+            s.R[rd] = in.R[rs];
+            s.flags = in.R[rs];
+            s.mayLabel = static_cast<uint8_t>((s.mayLabel & ~(1u << rd)) | (((in.mayLabel >> rs) & 1u) << rd));
+            break;
+        case LOAD:
+            s.R[rd] = UNKNOWN;
+            s.flags = UNKNOWN;
+            s.mayLabel = static_cast<uint8_t>(s.mayLabel & ~(1u << rd));
+            break;
+        case ADD: case SUB: case AND: case OR: case XOR: case NOT: case SHL: case SHR: {
+            uint16_t r;
+            if (fold(w, in, r)) {
+                s.R[rd] = constant(r);
+                s.flags = resultFlags(op) ? constant(r) : UNKNOWN;
+                s.mayLabel = static_cast<uint8_t>(s.mayLabel & ~(1u << rd));
+            } else if ((op == AND || op == OR) && rd == rs) {
+                s.flags = in.R[rd];     // Value unchanged
+            } else {
+                s.R[rd] = UNKNOWN;
+                s.flags = UNKNOWN;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return s;
+}
+
+// =============================================================================
+// CONTROL FLOW
+// =============================================================================
+
+struct Graph {
+    std::vector<int32_t> at;        // Address -> word index (-1 = none)
+    const std::vector<PeepholeWord>* words;
+    const std::vector<uint16_t>* labels;
+    bool badJump;
+    size_t badWord;
+    std::string reason;
+};
+
+constexpr int32_t EXIT = -1;        // Leaves the program (HALT, or runs off the end)
+
+/**
+ * First kept word at or after address in region, or EXIT. A word of another
+ * region right behind it (an absolute .WORD) is returned as is, so running
+ * into it is caught as reaching data.
+ */
+int32_t keptFrom(const Graph& g, uint32_t address, int32_t region) {
+    for (; address < 65536; ++address) {
+        int32_t n = g.at[address];
+        if (n < 0)
+            return EXIT;
+        if ((*g.words)[n].region != region || !(*g.words)[n].removed)
+            return n;
+    }
+    return EXIT;
+}
+
+/** Word after i in execution order, or EXIT. */
+int32_t fallthrough(const Graph& g, size_t i) {
+    const PeepholeWord& w = (*g.words)[i];
+    return keptFrom(g, uint32_t(w.address) + 1, w.region);
+}
+
+/** Word at a label, or EXIT if nothing was emitted there. */
+int32_t atLabel(const Graph& g, uint32_t label) {
+    uint16_t address = (*g.labels)[label];
+    int32_t n = g.at[address];
+    return n < 0 ? EXIT : keptFrom(g, address, (*g.words)[n].region);
+}
+
+/**
+ * Successors of word i given the state before it. Records (in g) the first
+ * jump through a non-label register and the first fall into data.
+ */
+void successors(Graph& g, size_t i, const State& in, int32_t out[2], size_t& n) {
+    n = 0;
+    const PeepholeWord& w = (*g.words)[i];
+    unsigned op = opOf(w.word);
+    if (op == HALT)
+        return;
+    if (op == JMP || op == JZ) {
+        const Val& target = in.R[rsOf(w.word)];
+        if (target.kind == Val::Label) {
+            out[n++] = atLabel(g, target.x);
+        } else if (target.kind != Val::Top && !g.badJump) {
+            g.badJump = true;
+            g.badWord = i;
+            g.reason = "jump target is not a known label";
+        }
+        if (op == JMP)
+            return;
+    }
+    out[n++] = fallthrough(g, i);
+}
+
+/**
+ * False (g.reason set) if a reachable word uses a label address as anything
+ * but a jump target or a pointer to data: relocation would change the result.
+ */
+bool checkLabelUse(Graph& g, const PeepholeWord& w, const State& in) {
+    unsigned op = opOf(w.word), rd = rdOf(w.word), rs = rsOf(w.word);
+    auto isLabel = [&](unsigned r) { return ((in.mayLabel >> r) & 1u) != 0; };
+    auto isCode = [&](unsigned r) {     // Unknown which label: assume code
+        if (in.R[r].kind != Val::Label)
+            return true;
+        int32_t n = atLabel(g, in.R[r].x);
+        return n >= 0 && !(*g.words)[n].data;
+    };
+    switch (op) {
+        case ADD: case AND: case OR: case NOT: case SHL: case SHR:
+        case SUB: case XOR:
+            if (rd == rs && (op == AND || op == OR || op == SUB || op == XOR))
+                return true;    // Value unchanged, or zero
+            if (isLabel(rd) || isLabel(rs)) {
+                g.reason = "label address used in arithmetic";
+                return false;
+            }
+            return true;
+        case STORE:
+            if (isLabel(rd)) {
+                g.reason = "label address stored to memory";
+                return false;
+            }
+            if (isLabel(rs) && isCode(rs)) {
+                g.reason = "program writes its own code";
+                return false;
+            }
+            return true;
+        case LOAD:
+            if (isLabel(rs) && isCode(rs)) {
+                g.reason = "program reads its own code";
+                return false;
+            }
+            return true;
+        default:
+            return true;
+    }
+}
+
+// =============================================================================
+// ANALYSES
+// =============================================================================
+
+/** Forward constants/labels; false (g.reason set) if the graph is not safe. */
+bool analyzeValues(Graph& g, std::vector<State>& in) {
+    const std::vector<PeepholeWord>& words = *g.words;
+    in.assign(words.size(), unreached());
+    std::vector<size_t> work;
+    int32_t entry = g.at[0] < 0 ? EXIT : keptFrom(g, 0, words[g.at[0]].region);
+    if (entry == EXIT)
+        return true;    // Nothing runs from reset: nothing to optimize
+    in[entry] = entryState();
+    work.push_back(static_cast<size_t>(entry));
+
+    std::vector<bool> queued(words.size(), false);
+    queued[entry] = true;
+    while (!work.empty()) {
+        size_t i = work.back();
+        work.pop_back();
+        queued[i] = false;
+        if (words[i].data) {
+            g.reason = "execution can reach a .WORD";
+            g.badWord = i;
+            return false;
+        }
+        if (!checkLabelUse(g, words[i], in[i])) {
+            g.badWord = i;
+            return false;
+        }
+        State out = transfer(words[i], in[i]);
+        int32_t succ[2];
+        size_t n;
+        successors(g, i, in[i], succ, n);
+        for (size_t k = 0; k < n; ++k) {
+            if (succ[k] == EXIT)
+                continue;
+            State merged = in[succ[k]];
+            meetInto(merged, out);
+            if (!(merged == in[succ[k]])) {
+                in[succ[k]] = merged;
+                if (!queued[succ[k]]) {
+                    queued[succ[k]] = true;
+                    work.push_back(static_cast<size_t>(succ[k]));
+                }
+            }
+        }
+    }
+    return !g.badJump;
+}
+
+/** Backward liveness: state read after each word (bits as in uses()). */
+void analyzeLiveness(Graph& g, const std::vector<State>& in, std::vector<unsigned>& liveOut) {
+    const std::vector<PeepholeWord>& words = *g.words;
+    std::vector<unsigned> liveIn(words.size(), 0);
+    liveOut.assign(words.size(), 0);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = words.size(); i-- > 0;) {
+            if (!in[i].reached || words[i].removed)
+                continue;
+            int32_t succ[2];
+            size_t n;
+            successors(g, i, in[i], succ, n);
+            unsigned out = opOf(words[i].word) == HALT ? ALL_STATE : 0;
+            for (size_t k = 0; k < n; ++k)
+                out |= succ[k] == EXIT ? ALL_STATE : liveIn[succ[k]];
+            unsigned li = uses(words[i].word) | (out & ~defs(words[i].word));
+            if (out != liveOut[i] || li != liveIn[i]) {
+                liveOut[i] = out;
+                liveIn[i] = li;
+                changed = true;
+            }
+        }
+    }
+}
+
+// =============================================================================
+// TRANSFORMATIONS
+// =============================================================================
+
+const char FOLDED[] = "folded: constant result";
+
+enum class Pass { Preserving, Redundant, DeadWrites };
+
+/** Apply one class of changes; returns how many words changed. */
+size_t applyRound(std::vector<PeepholeWord>& words, const std::vector<State>& in,
+                  const std::vector<unsigned>& liveOut, Pass pass, size_t& removed, size_t& rewritten) {
+    size_t changes = 0;
+    for (size_t i = 0; i < words.size(); ++i) {
+        PeepholeWord& w = words[i];
+        if (w.removed || w.data || !in[i].reached)
+            continue;
+        const State& s = in[i];
+        unsigned op = opOf(w.word), rd = rdOf(w.word), rs = rsOf(w.word);
+        bool flagsDead = !(liveOut[i] & FLAGS_BIT);
+        bool rdDead = !(liveOut[i] & (1u << rd));
+
+        // What the instruction writes, for the "already there" checks
+        Val wrote = TOP;
+        if (op == MOVI)
+            wrote = w.label >= 0 ? Val{Val::Label, static_cast<uint32_t>(w.label)} : constant(w.word & 0x1FFu);
+        else if (op == MOV && rd == rs)
+            wrote = s.R[rd];
+        bool valueKept = wrote.kind != Val::Top && wrote.kind != Val::Unknown && s.R[rd] == wrote;
+
+        const char* note = nullptr;
+        bool remove = false;
+        if (pass == Pass::Preserving) {
+            if (op == NOP) {
+                note = "removed: NOP";
+                remove = true;
+            } else if (valueKept && s.flags == wrote) {
+                note = op == MOVI ? "removed: register and flags already hold this value"
+                                  : "removed: MOV to itself, flags unchanged";
+                remove = true;
+            }
+        } else if (pass == Pass::Redundant) {
+            if (valueKept && flagsDead) {
+                note = op == MOVI ? "removed: register already holds this value, flags unused"
+                                  : "removed: MOV to itself, flags unused";
+                remove = true;
+            } else if (op == MOV && rd == rs && flagsDead) {
+                note = "removed: MOV to itself, flags unused";
+                remove = true;
+            } else if (op != MOVI && op != LOAD && defs(w.word)) {
+                uint16_t r;
+                if (fold(w.word, s, r) && r <= 0x1FF && (flagsDead || resultFlags(op))) {
+                    w.word = encMOVI(rd, r);
+                    w.label = -1;
+                    w.note = FOLDED;
+                    ++rewritten;
+                    ++changes;
+                }
+            }
+        } else if (defs(w.word) && op != LOAD && rdDead && flagsDead) {
+            note = "removed: result never read";
+            remove = true;
+        }
+        if (remove) {
+            if (w.note == FOLDED)
+                --rewritten;    // Counted once, as removed
+            w.removed = true;
+            w.note = note;
+            ++removed;
+            ++changes;
+        }
+    }
+    return changes;
+}
+
+} // namespace
+
+// =============================================================================
+// DRIVER
+// =============================================================================
+
+PeepholeResult peephole(std::vector<PeepholeWord>& words, std::vector<uint16_t>& labels) {
+    PeepholeResult result{false, "", 0, 0, 0};
+
+    Graph g;
+    g.at.assign(65536, -1);
+    g.words = &words;
+    g.labels = &labels;
+    for (size_t i = 0; i < words.size(); ++i) {
+        words[i].removed = false;
+        words[i].newAddress = words[i].address;
+        words[i].note = nullptr;
+        if (g.at[words[i].address] >= 0) {
+            result.reason = "words written more than once";
+            result.blockingWord = i;
+            return result;
+        }
+        g.at[words[i].address] = static_cast<int32_t>(i);
+        if (words[i].branchMovi && words[i].label < 0) {
+            result.reason = "jump to a numeric address";
+            result.blockingWord = i;
+            return result;
+        }
+        // A MOVI holds the low 9 bits of its label: keep those equal to the label
+        if (words[i].label >= 0 && labels[words[i].label] > 0x1FF) {
+            result.reason = "label operand above 511";
+            result.blockingWord = i;
+            return result;
+        }
+    }
+
+    // --- Rounds until nothing changes (bounded; each round removes or folds) ---
+    std::vector<PeepholeWord> original = words;
+    std::vector<State> in;
+    std::vector<unsigned> liveOut;
+    for (unsigned round = 0; round < 64; ++round) {
+        g.badJump = false;
+        if (!analyzeValues(g, in)) {
+            words = original;   // Every change so far assumed this graph
+            result.removed = result.rewritten = 0;
+            result.reason = g.reason;
+            result.blockingWord = g.badWord;
+            return result;
+        }
+        analyzeLiveness(g, in, liveOut);
+        size_t changes = 0;
+        for (Pass pass : {Pass::Preserving, Pass::Redundant, Pass::DeadWrites}) {
+            changes = applyRound(words, in, liveOut, pass, result.removed, result.rewritten);
+            if (changes)
+                break;
+        }
+        if (changes == 0)
+            break;
+    }
+
+    // --- Relocate: compact each region, then move labels with their words ---
+    std::vector<uint32_t> regionEnd, regionNewEnd;
+    std::vector<int32_t> regionLastKept;
+    for (size_t i = 0; i < words.size(); ++i) {
+        PeepholeWord& w = words[i];
+        if (w.region < 0)
+            continue;
+        size_t r = static_cast<size_t>(w.region);
+        if (r >= regionEnd.size()) {
+            regionEnd.resize(r + 1, 0);
+            regionNewEnd.resize(r + 1, 0);
+            regionLastKept.resize(r + 1, -1);
+        }
+        if (regionEnd[r] == 0)
+            regionNewEnd[r] = w.address;    // First word of the region
+        regionEnd[r] = uint32_t(w.address) + 1;
+        w.newAddress = static_cast<uint16_t>(regionNewEnd[r]);
+        if (!w.removed) {
+            ++regionNewEnd[r];
+            regionLastKept[r] = static_cast<int32_t>(i);
+        }
+    }
+
+    // A region that shrinks leaves a gap (zero words: HALT) behind it. That is
+    // only safe if nothing falls through its end into the word of another
+    // region there, e.g. code placed before an earlier .ORG block
+    for (size_t r = 0; r < regionEnd.size(); ++r) {
+        if (regionEnd[r] == 0 || regionNewEnd[r] == regionEnd[r] || regionEnd[r] >= 65536 ||
+            g.at[regionEnd[r]] < 0)
+            continue;
+        int32_t last = regionLastKept[r];
+        unsigned op = last < 0 ? NOP : opOf(words[last].word);
+        if (last >= 0 && (op == HALT || op == JMP || words[last].data))
+            continue;
+        words = original;
+        result.removed = result.rewritten = 0;
+        result.reason = "code falls through into another .ORG block";
+        result.blockingWord = last >= 0 ? static_cast<size_t>(last) : static_cast<size_t>(g.at[regionEnd[r] - 1]);
+        return result;
+    }
+
+    std::vector<uint16_t> oldLabels = labels;
+    for (uint16_t& label : labels) {
+        int32_t i = g.at[label];
+        if (i >= 0 && words[i].region >= 0) {
+            int32_t k = keptFrom(g, label, words[i].region);
+            bool inRegion = k >= 0 && words[k].region == words[i].region;
+            label = static_cast<uint16_t>(inRegion ? words[k].newAddress : regionNewEnd[words[i].region]);
+        } else if (i < 0) {
+            // Just past the end of a region (e.g. a label before .ORG)
+            int32_t prev = label > 0 ? g.at[label - 1] : -1;
+            if (prev >= 0 && words[prev].region >= 0)
+                label = static_cast<uint16_t>(regionNewEnd[words[prev].region]);
+        }
+    }
+
+    // --- Re-encode label operands at their new values ---
+    // The flags of a MOVI of a label see whether it is zero (JZ label tests
+    // exactly that), so no label operand may move onto address 0
+    for (size_t i = 0; i < words.size(); ++i) {
+        PeepholeWord& w = words[i];
+        if (w.removed || w.label < 0 || opOf(w.word) != MOVI)
+            continue;
+        if ((oldLabels[w.label] == 0) != (labels[w.label] == 0)) {
+            words = original;
+            labels = oldLabels;
+            result.removed = result.rewritten = 0;
+            result.reason = "a label operand would move to address 0";
+            result.blockingWord = i;
+            return result;
+        }
+        w.word = encMOVI(rdOf(w.word), labels[w.label] & 0x1FFu);
+    }
+
+    result.applied = true;
+    return result;
+}
@@ -0,0 +1,50 @@
+/**
+ * Peephole optimizer for assembled GPR programs (internal to the assembler).
+ * Works on the emitted word stream plus the label table, removes or rewrites
+ * instructions that provably do not change architectural state, and
+ * relocates everything after them.
+ */
+
+#ifndef GPR_PEEPHOLE_H
+#define GPR_PEEPHOLE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/** One emitted word, in emission order. */
+struct PeepholeWord {
+    uint16_t address;       // Address it was assembled at
+    uint16_t word;          // Encoded word (rewritten in place when folded)
+    int32_t label;          // Label index of a MOVI immediate, -1 if numeric
+    int32_t region;         // Contiguous run it belongs to; -1 = .WORD addr value
+    bool data;              // .WORD value: never treated as an instruction
+    bool branchMovi;        // MOVI R7 emitted for JMP/JZ label/number
+
+    // --- Filled in by peephole() ---
+    bool removed;
+    uint16_t newAddress;
+    const char* note;       // Why it was removed or rewritten (nullptr = unchanged)
+};
+
+struct PeepholeResult {
+    bool applied;           // False: program left unchanged (reason says why)
+    std::string reason;
+    size_t removed;         // Words dropped
+    size_t rewritten;       // Words replaced by an equivalent MOVI
+    size_t blockingWord;    // Index into words of the word that blocked it
+};
+
+/**
+ * Optimize words in place. labels holds every label's address and is updated
+ * to the relocated addresses; MOVI words with a label operand are re-encoded.
+ *
+ * Branch and data addresses must come from labels: the pass refuses (and
+ * changes nothing) if a JMP/JZ target is not a known label, if execution can
+ * run into a .WORD, if the stream was emitted with overlapping writes, or if
+ * code that shrinks can fall through into a word emitted by another .ORG.
+ */
+PeepholeResult peephole(std::vector<PeepholeWord>& words, std::vector<uint16_t>& labels);
+
+#endif // GPR_PEEPHOLE_H
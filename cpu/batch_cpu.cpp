@@ -0,0 +1,414 @@
+/**
+ * 16-bit GPR CPU Emulator - Batch engine implementation
+ */
+
+#include "batch_cpu.h"
+#include <cstring>
+
+// =============================================================================
+// LANE VECTORS
+// =============================================================================
+// One Vec holds a 16-bit value for every lane of a group. With GCC/Clang
+// vector extensions each operation below is a single AVX2 instruction (or a
+// pair of SSE2/NEON instructions); elsewhere a plain array loop is used.
+// Masks are 0xFFFF (lane selected) or 0x0000 per lane.
+
+namespace {
+
+constexpr size_t W = BatchCPU::GROUP_LANES;
+
+#if defined(__GNUC__)
+
+typedef uint16_t Vec __attribute__((vector_size(W * sizeof(uint16_t))));
+
+inline Vec splat(uint16_t x) {
+    Vec v = {};
+    return v + x;
+}
+inline Vec eq(Vec a, Vec b) { return (Vec)(a == b); }
+inline Vec shl1(Vec a) { return a << 1; }
+inline Vec shr1(Vec a) { return a >> 1; }
+
+#else
+
+struct Vec {
+    uint16_t v[W];
+    uint16_t& operator[](size_t i) { return v[i]; }
+    uint16_t operator[](size_t i) const { return v[i]; }
+};
+
+#define GPR_VEC_BINOP(OP)                            \
+    inline Vec operator OP(Vec a, Vec b) {           \
+        Vec r;                                       \
+        for (size_t i = 0; i < W; ++i)               \
+            r.v[i] = static_cast<uint16_t>(a.v[i] OP b.v[i]); \
+        return r;                                    \
+    }
+GPR_VEC_BINOP(+)
+GPR_VEC_BINOP(-)
+GPR_VEC_BINOP(&)
+GPR_VEC_BINOP(|)
+GPR_VEC_BINOP(^)
+#undef GPR_VEC_BINOP
+
+inline Vec operator~(Vec a) {
+    Vec r;
+    for (size_t i = 0; i < W; ++i)
+        r.v[i] = static_cast<uint16_t>(~a.v[i]);
+    return r;
+}
+inline Vec splat(uint16_t x) {
+    Vec r;
+    for (size_t i = 0; i < W; ++i)
+        r.v[i] = x;
+    return r;
+}
+inline Vec eq(Vec a, Vec b) {
+    Vec r;
+    for (size_t i = 0; i < W; ++i)
+        r.v[i] = a.v[i] == b.v[i] ? 0xFFFFu : 0u;
+    return r;
+}
+inline Vec shl1(Vec a) {
+    Vec r;
+    for (size_t i = 0; i < W; ++i)
+        r.v[i] = static_cast<uint16_t>(a.v[i] << 1);
+    return r;
+}
+inline Vec shr1(Vec a) {
+    Vec r;
+    for (size_t i = 0; i < W; ++i)
+        r.v[i] = static_cast<uint16_t>(a.v[i] >> 1);
+    return r;
+}
+
+#endif
+
+inline Vec load(const uint16_t* p) {
+    Vec v;
+    std::memcpy(&v, p, sizeof v);
+    return v;
+}
+inline void store(uint16_t* p, Vec v) { std::memcpy(p, &v, sizeof v); }
+
+/** Per lane: m ? a : b */
+inline Vec select(Vec m, Vec a, Vec b) { return (a & m) | (b & ~m); }
+
+/** Masked register write: only selected lanes take the new value. */
+inline void storeMasked(uint16_t* p, Vec m, Vec v) { store(p, select(m, v, load(p))); }
+
+inline bool none(Vec m) {
+    uint64_t bits[W * sizeof(uint16_t) / sizeof(uint64_t)];
+    std::memcpy(bits, &m, sizeof bits);
+    uint64_t any = 0;
+    for (uint64_t b : bits)
+        any |= b;
+    return any == 0;
+}
+inline bool same(Vec a, Vec b) { return std::memcmp(&a, &b, sizeof a) == 0; }
+
+} // namespace
+
+// =============================================================================
+// CONSTRUCTION & PER-INSTANCE ACCESS
+// =============================================================================
+
+BatchCPU::BatchCPU(const uint16_t* img, size_t lanes)
+    : image(img, img + MEMORY_SIZE),
+      laneCount(lanes),
+      groups((lanes + GROUP_LANES - 1) / GROUP_LANES),
+      overlays(lanes) {
+    reset();
+}
+
+void BatchCPU::reset() {
+    std::memset(groups.data(), 0, groups.size() * sizeof(Group));
+    std::memset(overlays.data(), 0, overlays.size() * sizeof(Overlay));
+    for (size_t lane = 0; lane < laneCount; ++lane) {
+        Group& g = groups[lane / GROUP_LANES];
+        size_t i = lane % GROUP_LANES;
+        // FLAGS = 0 expressed lazily: a nonzero, non-negative Result
+        g.flagOp[i] = static_cast<uint16_t>(FlagOp::Result);
+        g.flagResult[i] = 1;
+        g.active[i] = 0xFFFFu;
+    }
+    // Padding lanes of the last group stay inactive
+}
+
+unsigned BatchCPU::homeSlot(uint16_t address) {
+    // Multiplicative hash: spreads nearby code and data addresses across slots
+    return ((static_cast<uint32_t>(address) * 40503u) >> 10) & (OVERLAY_WORDS - 1);
+}
+
+bool BatchCPU::lookup(size_t lane, uint16_t address, uint16_t& value) const {
+    const Overlay& o = overlays[lane];
+    unsigned slot = homeSlot(address);
+    if (!(o.filter >> slot & 1u))
+        return false;
+    for (size_t n = 0; n < OVERLAY_WORDS && (o.used >> slot & 1u); ++n) {
+        if (o.keys[slot] == address) {
+            value = o.values[slot];
+            return true;
+        }
+        slot = (slot + 1) & (OVERLAY_WORDS - 1);
+    }
+    return false;
+}
+
+bool BatchCPU::insert(size_t lane, uint16_t address, uint16_t value) {
+    Overlay& o = overlays[lane];
+    unsigned home = homeSlot(address);
+    unsigned slot = home;
+    for (size_t n = 0; n < OVERLAY_WORDS; ++n) {
+        if (!(o.used >> slot & 1u)) {
+            o.used |= uint64_t(1) << slot;
+            o.filter |= uint64_t(1) << home;
+            groups[lane / GROUP_LANES].overlayFilter |= uint64_t(1) << home;
+            o.keys[slot] = address;
+            o.values[slot] = value;
+            return true;
+        }
+        if (o.keys[slot] == address) {
+            o.values[slot] = value;
+            return true;
+        }
+        slot = (slot + 1) & (OVERLAY_WORDS - 1);
+    }
+    return false;   // Overlay full
+}
+
+bool BatchCPU::write(size_t lane, uint16_t address, uint16_t value) {
+    return lane < laneCount && insert(lane, address, value);
+}
+
+uint16_t BatchCPU::read(size_t lane, uint16_t address) const {
+    uint16_t value;
+    if (lane < laneCount && lookup(lane, address, value))
+        return value;
+    return image[address];
+}
+
+uint16_t BatchCPU::reg(size_t lane, unsigned r) const {
+    return groups[lane / GROUP_LANES].R[r & 7][lane % GROUP_LANES];
+}
+
+uint16_t BatchCPU::pc(size_t lane) const {
+    return groups[lane / GROUP_LANES].PC[lane % GROUP_LANES];
+}
+
+uint16_t BatchCPU::flags(size_t lane) const {
+    const Group& g = groups[lane / GROUP_LANES];
+    size_t i = lane % GROUP_LANES;
+    CPUState s = {};
+    s.flagOp = static_cast<FlagOp>(g.flagOp[i]);
+    s.flagResult = g.flagResult[i];
+    s.flagOperand = g.flagOperand[i];
+    return s.flags();
+}
+
+bool BatchCPU::halted(size_t lane) const {
+    return groups[lane / GROUP_LANES].halted[lane % GROUP_LANES] != 0;
+}
+
+bool BatchCPU::faulted(size_t lane) const {
+    return groups[lane / GROUP_LANES].faulted[lane % GROUP_LANES] != 0;
+}
+
+uint64_t BatchCPU::cycles(size_t lane) const {
+    return groups[lane / GROUP_LANES].cycles[lane % GROUP_LANES];
+}
+
+// =============================================================================
+// LOCKSTEP EXECUTION
+// =============================================================================
+
+void BatchCPU::run(uint64_t maxCycles) {
+    // Groups are independent; each runs to completion while its registers
+    // stay in L1.
+    for (size_t g = 0; g < groups.size(); ++g)
+        runGroup(g, maxCycles);
+}
+
+void BatchCPU::runGroup(size_t gi, uint64_t maxCycles) {
+    Group& g = groups[gi];
+    const size_t firstLane = gi * GROUP_LANES;
+
+    // Lanes still running (not halted or faulted) and under the budget
+    Vec active = load(g.active);
+    for (size_t i = 0; i < W; ++i)
+        if (g.cycles[i] >= maxCycles)
+            active[i] = 0;
+    bool converged = false;     // All active lanes share one PC
+    uint16_t pc = 0;
+    uint64_t steps = 0;         // Upper bound on any lane's cycle count this run
+    for (uint64_t c : g.cycles)
+        steps = c > steps ? c : steps;
+
+    while (!none(active)) {
+        // --- SCHEDULE: lowest pending PC; lanes elsewhere sit out this step ---
+        Vec m = active;
+        if (converged) {
+            pc = g.PC[0];
+            for (size_t i = 0; i < W; ++i)
+                if (active[i]) {
+                    pc = g.PC[i];
+                    break;
+                }
+        } else {
+            unsigned lowest = 0x10000u;
+            unsigned highest = 0;
+            for (size_t i = 0; i < W; ++i)
+                if (active[i]) {
+                    lowest = g.PC[i] < lowest ? g.PC[i] : lowest;
+                    highest = g.PC[i] > highest ? g.PC[i] : highest;
+                }
+            pc = static_cast<uint16_t>(lowest);
+            if (lowest == highest)
+                converged = true;
+            else
+                m = active & eq(load(g.PC), splat(pc));
+        }
+
+        // --- FETCH: shared image, unless a lane has overwritten this word ---
+        uint16_t word = image[pc];
+        if (g.overlayFilter >> homeSlot(pc) & 1u) {
+            uint16_t laneWord[W];
+            bool first = true;
+            for (size_t i = 0; i < W; ++i) {
+                if (!m[i])
+                    continue;
+                laneWord[i] = image[pc];
+                lookup(firstLane + i, pc, laneWord[i]);
+                if (first) {
+                    word = laneWord[i];
+                    first = false;
+                }
+            }
+            // Lanes holding a different word run it on a later step
+            for (size_t i = 0; i < W; ++i)
+                if (m[i] && laneWord[i] != word) {
+                    m[i] = 0;
+                    converged = false;
+                }
+        }
+
+        // --- DECODE (once for the whole group) ---
+        const uint8_t op = static_cast<uint8_t>((word >> 12) & 0xFu);
+        const uint8_t rd = static_cast<uint8_t>((word >> 9) & 0x7u);
+        const uint8_t rs = static_cast<uint8_t>((word >> 6) & 0x7u);
+        const uint16_t imm = word & 0x1FFu;
+
+        // --- EXECUTE: vector ops on all lanes, committed under the mask ---
+        Vec nextPC = splat(static_cast<uint16_t>(pc + 1));
+        Vec newPC = select(m, nextPC, load(g.PC));
+        bool counted = true;
+
+        auto setFlags = [&](FlagOp kind, Vec result, Vec operand) {
+            storeMasked(g.flagOp, m, splat(static_cast<uint16_t>(kind)));
+            storeMasked(g.flagResult, m, result);
+            storeMasked(g.flagOperand, m, operand);
+        };
+        auto writeRd = [&](FlagOp kind, Vec result, Vec operand) {
+            storeMasked(g.R[rd], m, result);
+            setFlags(kind, result, operand);
+        };
+
+        Vec a = load(g.R[rd]);
+        Vec b = load(g.R[rs]);
+        switch (static_cast<Opcode>(op)) {
+            case Opcode::HALT:
+                storeMasked(g.halted, m, splat(0xFFFFu));
+                active = active & ~m;
+                counted = false;
+                break;
+            case Opcode::MOVI: writeRd(FlagOp::Result, splat(imm), a); break;
+            case Opcode::MOV:  writeRd(FlagOp::Result, b, a); break;
+            case Opcode::LOAD: {
+                Vec v = a;
+                for (size_t i = 0; i < W; ++i)
+                    if (m[i]) {
+                        uint16_t addr = b[i];
+                        uint16_t value = image[addr];
+                        lookup(firstLane + i, addr, value);
+                        v[i] = value;
+                    }
+                writeRd(FlagOp::Result, v, a);
+                break;
+            }
+            case Opcode::STORE:
+                for (size_t i = 0; i < W; ++i)
+                    if (m[i] && !insert(firstLane + i, b[i], a[i])) {
+                        g.faulted[i] = 0xFFFFu;
+                        active[i] = 0;
+                        m[i] = 0;
+                        newPC[i] = g.PC[i];     // Stop at the faulting STORE
+                    }
+                // A store may hit code another lane is about to fetch
+                converged = false;
+                break;
+            case Opcode::ADD:  writeRd(FlagOp::Add, a + b, a); break;
+            case Opcode::SUB:  writeRd(FlagOp::Sub, a - b, a); break;
+            case Opcode::AND:  writeRd(FlagOp::Result, a & b, a); break;
+            case Opcode::OR:   writeRd(FlagOp::Result, a | b, a); break;
+            case Opcode::XOR:  writeRd(FlagOp::Result, a ^ b, a); break;
+            case Opcode::NOT:  writeRd(FlagOp::Result, ~b, a); break;
+            case Opcode::SHL:  writeRd(FlagOp::Shl, shl1(a), a); break;
+            case Opcode::SHR:  writeRd(FlagOp::Shr, shr1(a), a); break;
+            case Opcode::JMP:
+                newPC = select(m, b, newPC);
+                converged = false;
+                break;
+            case Opcode::JZ: {
+                Vec taken = m & eq(load(g.flagResult), splat(0));
+                newPC = select(taken, b, newPC);
+                converged = false;
+                break;
+            }
+            case Opcode::NOP: {
+                ExtOp ext = extOp(word);
+                if (ext == ExtOp::NOP)
+                    break;
+                // The literal, per lane: a lane may have overwritten it
+                const uint16_t at = static_cast<uint16_t>(pc + 1);
+                Vec lit = splat(image[at]);
+                if (g.overlayFilter >> homeSlot(at) & 1u)
+                    for (size_t i = 0; i < W; ++i)
+                        if (m[i]) {
+                            uint16_t value = image[at];
+                            lookup(firstLane + i, at, value);
+                            lit[i] = value;
+                        }
+                writeRd(FlagOp::Result, lit, a);
+                if (ext == ExtOp::MOVW) {
+                    newPC = select(m, splat(static_cast<uint16_t>(pc + 2)), newPC);
+                } else if (ext == ExtOp::JMPW) {
+                    newPC = select(m, lit, newPC);
+                    converged = false;
+                } else {
+                    // JZW: taken on the flags of its own literal, i.e. only to 0
+                    Vec taken = m & eq(lit, splat(0));
+                    newPC = select(taken, lit, select(m, splat(static_cast<uint16_t>(pc + 2)), newPC));
+                    converged = false;
+                }
+                break;
+            }
+        }
+        store(g.PC, newPC);
+
+        // --- ACCOUNT: per-lane cycles; budget checked once any lane could hit it ---
+        if (counted) {
+            for (size_t i = 0; i < W; ++i)
+                g.cycles[i] += m[i] & 1u;
+            if (++steps >= maxCycles) {
+                for (size_t i = 0; i < W; ++i)
+                    if (g.cycles[i] >= maxCycles)
+                        active[i] = 0;
+            }
+        }
+        // Lanes that stopped (HALT, fault, budget) no longer pin the schedule
+        if (converged && !same(active, m))
+            converged = false;
+    }
+    // Budget stops are not sticky: a later run() resumes those lanes
+    store(g.active, load(g.active) & ~load(g.halted) & ~load(g.faulted));
+}
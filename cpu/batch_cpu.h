@@ -0,0 +1,100 @@
+/**
+ * 16-bit GPR CPU Emulator - Batch engine
+ * Runs many independent copies of one program in lockstep, SIMD across CPUs.
+ */
+
+#ifndef GPR_BATCH_CPU_H
+#define GPR_BATCH_CPU_H
+
+#include "gpr_cpu.h"
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/**
+ * BatchCPU: N CPU instances sharing one read-only program image.
+ *
+ * Registers are kept in struct-of-arrays form per group of GROUP_LANES
+ * instances (all R0s together, all R1s together, ...), so each instruction
+ * executes as a handful of vector operations for the whole group. Lanes that
+ * diverge at JZ/JMP are masked: the group always executes the lowest pending
+ * PC and the lanes waiting elsewhere rejoin when they reach it.
+ *
+ * Each instance writes into its own small memory overlay (OVERLAY_WORDS
+ * distinct addresses); reads fall through to the shared image. An instance
+ * whose overlay fills up stops with faulted() set.
+ */
+class BatchCPU {
+public:
+    /** Lanes per group: one 256-bit vector of 16-bit registers (AVX2 / 2x NEON). */
+    static constexpr size_t GROUP_LANES = 16;
+
+    /** Distinct addresses each instance may write. */
+    static constexpr size_t OVERLAY_WORDS = 64;
+
+    /** image: MEMORY_SIZE words as written by assemble() (copied). */
+    BatchCPU(const uint16_t* image, size_t lanes);
+
+    size_t lanes() const { return laneCount; }
+
+    /** Reset every instance: registers clear, PC=0, flags clear, overlay empty. */
+    void reset();
+
+    /** Write one instance's memory (e.g. operands at 0x100/0x101). False if its overlay is full. */
+    bool write(size_t lane, uint16_t address, uint16_t value);
+
+    /** Read one instance's view of memory. */
+    uint16_t read(size_t lane, uint16_t address) const;
+
+    /**
+     * Run every instance until it halts, faults or has executed maxCycles
+     * cycles in total since reset() (counted like GPRCPU::run(): HALT itself
+     * is not counted). Instances stopped by the budget resume on the next run().
+     */
+    void run(uint64_t maxCycles = UINT64_MAX);
+
+    // --- Per-instance results ---
+    uint16_t reg(size_t lane, unsigned r) const;
+    uint16_t pc(size_t lane) const;
+    uint16_t flags(size_t lane) const;
+    bool halted(size_t lane) const;
+    bool faulted(size_t lane) const;
+    uint64_t cycles(size_t lane) const;
+
+private:
+    /** One group of lanes in struct-of-arrays layout. */
+    struct alignas(64) Group {
+        uint16_t R[8][GROUP_LANES];
+        uint16_t PC[GROUP_LANES];
+        uint16_t flagResult[GROUP_LANES];    // Lazy flags, as in CPUState
+        uint16_t flagOperand[GROUP_LANES];
+        uint16_t flagOp[GROUP_LANES];        // FlagOp, widened to the lane width
+        uint16_t active[GROUP_LANES];        // 0xFFFF while the lane still runs
+        uint16_t halted[GROUP_LANES];
+        uint16_t faulted[GROUP_LANES];
+        uint64_t cycles[GROUP_LANES];
+        uint64_t overlayFilter;              // Union of the lanes' overlay filters
+    };
+
+    /** Per-instance written words: open addressing on OVERLAY_WORDS slots. */
+    struct Overlay {
+        uint64_t used;      // Slot occupied
+        uint64_t filter;    // Home slot of every stored address (fast miss test)
+        uint16_t keys[OVERLAY_WORDS];
+        uint16_t values[OVERLAY_WORDS];
+    };
+
+    std::vector<uint16_t> image;
+    size_t laneCount;
+    std::vector<Group> groups;
+    std::vector<Overlay> overlays;
+
+    static unsigned homeSlot(uint16_t address);
+    bool lookup(size_t lane, uint16_t address, uint16_t& value) const;
+    bool insert(size_t lane, uint16_t address, uint16_t value);
+
+    /** Run one group until all of its lanes have stopped. */
+    void runGroup(size_t g, uint64_t maxCycles);
+};
+
+#endif // GPR_BATCH_CPU_H
@@ -0,0 +1,38 @@
+/**
+ * 16-bit GPR CPU Emulator - Block-transfer (DMA) device
+ */
+
+#include "dma.h"
+
+uint16_t DmaDevice::read(uint16_t address) {
+    unsigned reg = address & (PAGE_WORDS - 1);
+    if (reg == DMA_CTRL)
+        return status;
+    return reg < DMA_CTRL ? regs[reg] : 0;
+}
+
+void DmaDevice::write(uint16_t address, uint16_t value) {
+    unsigned reg = address & (PAGE_WORDS - 1);
+    if (reg < DMA_CTRL) {
+        regs[reg] = value;
+        return;
+    }
+    if (reg != DMA_CTRL)
+        return;
+    if (busy) {
+        status = DMA_REFUSED;   // Stored by a device the running transfer writes to
+        return;
+    }
+    // Registers as of the start: a transfer over this page may store to them
+    uint16_t count = regs[DMA_COUNT];
+    bool ok = false;
+    busy = true;
+    if (value == DMA_COPY)
+        ok = bus.copyWords(regs[DMA_DST], regs[DMA_SRC], count);
+    else if (value == DMA_FILL)
+        ok = bus.fillWords(regs[DMA_DST], regs[DMA_VALUE], count);
+    busy = false;
+    status = ok ? DMA_OK : DMA_REFUSED;
+    if (ok)
+        moved += count;
+}
@@ -0,0 +1,67 @@
+/**
+ * 16-bit GPR CPU Emulator - Block-transfer (DMA) device
+ *
+ * An MmioDevice that copies or fills blocks of guest memory in one STORE,
+ * through Bus::copyWords() / Bus::fillWords(). Map it on any free page:
+ *
+ *     DmaDevice dma(bus);
+ *     bus.mapDevice(page, 1, &dma);
+ *
+ * Registers are words at the start of the page:
+ *
+ *     +0 DMA_SRC    Copy: first source word
+ *     +1 DMA_DST    First destination word
+ *     +2 DMA_COUNT  Words to transfer
+ *     +3 DMA_VALUE  Fill: the value written
+ *     +4 DMA_CTRL   STORE DMA_COPY or DMA_FILL: run the transfer;
+ *                   LOAD: DMA_OK, or DMA_REFUSED if the last one did not run
+ *
+ * The other registers read back what was stored and keep their values, so a
+ * guest changes only what differs between transfers.
+ */
+
+#ifndef GPR_DMA_H
+#define GPR_DMA_H
+
+#include "gpr_cpu.h"
+
+constexpr uint16_t DMA_SRC = 0;
+constexpr uint16_t DMA_DST = 1;
+constexpr uint16_t DMA_COUNT = 2;
+constexpr uint16_t DMA_VALUE = 3;
+constexpr uint16_t DMA_CTRL = 4;
+
+/** Commands stored to DMA_CTRL. */
+constexpr uint16_t DMA_COPY = 1;
+constexpr uint16_t DMA_FILL = 2;
+
+/** Status read from DMA_CTRL. */
+constexpr uint16_t DMA_OK = 0;
+constexpr uint16_t DMA_REFUSED = 1;    // Unknown command, a range past 0xFFFF, or started during a transfer
+
+/**
+ * DmaDevice: the transfer runs inside the STORE to DMA_CTRL, so it costs the
+ * guest one cycle whatever its length, on every engine. The destination is
+ * written through the Bus, so predecoded and translated code over it is
+ * dropped, device pages in either range see every word, and snapshots track
+ * the pages written.
+ */
+class DmaDevice : public MmioDevice {
+public:
+    explicit DmaDevice(Bus& bus) : bus(bus) {}
+
+    uint16_t read(uint16_t address) override;
+    void write(uint16_t address, uint16_t value) override;
+
+    /** Words written by completed transfers since construction. */
+    uint64_t wordsMoved() const { return moved; }
+
+private:
+    Bus& bus;
+    uint16_t regs[DMA_CTRL] = {};   // SRC, DST, COUNT, VALUE
+    uint16_t status = DMA_OK;
+    bool busy = false;              // A device in the range may store to DMA_CTRL
+    uint64_t moved = 0;
+};
+
+#endif // GPR_DMA_H
@@ -3,31 +3,349 @@
  */
 
 #include "gpr_cpu.h"
-#include <iostream>
-#include <iomanip>
+#include "trace.h"
+#include "jit.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// =============================================================================
+// MEMORY IMAGE
+// =============================================================================
+
+/** Shared by every all-zero page of every image. */
+static const uint16_t ZERO_PAGE[PAGE_WORDS] = {};
+
+std::shared_ptr<const MemoryImage> MemoryImage::copyOf(const uint16_t* words) {
+    uint16_t* copy = new uint16_t[MEMORY_SIZE];
+    std::memcpy(copy, words, MEMORY_SIZE * sizeof(uint16_t));
+    std::shared_ptr<const uint16_t> owned(copy, std::default_delete<uint16_t[]>());
+    MemoryImage* image = new MemoryImage(std::move(owned));
+    for (size_t p = 0; p < PAGE_COUNT; ++p)
+        image->pages[p] = copy + (p << PAGE_SHIFT);
+    return std::shared_ptr<const MemoryImage>(image);
+}
+
+std::shared_ptr<const MemoryImage> MemoryImage::zero() {
+    static const std::shared_ptr<const MemoryImage> image = [] {
+        const uint16_t* pages[PAGE_COUNT] = {};
+        return fromPages(pages, nullptr);
+    }();
+    return image;
+}
+
+std::shared_ptr<const MemoryImage> MemoryImage::fromPages(const uint16_t* const* pages,
+                                                          std::shared_ptr<const void> storage) {
+    MemoryImage* image = new MemoryImage(std::move(storage));
+    for (size_t p = 0; p < PAGE_COUNT; ++p)
+        image->pages[p] = pages[p] ? pages[p] : ZERO_PAGE;
+    return std::shared_ptr<const MemoryImage>(image);
+}
+
+void MemoryImage::copyTo(uint16_t* out) const {
+    for (size_t p = 0; p < PAGE_COUNT; ++p)
+        std::memcpy(out + (p << PAGE_SHIFT), pages[p], PAGE_WORDS * sizeof(uint16_t));
+}
 
 // =============================================================================
 // BUS
 // =============================================================================
 
-Bus::Bus() {
-    memory = new uint16_t[MEMORY_SIZE]();
+/** Index of the lowest set bit (bits != 0). */
+static size_t lowestBit(uint64_t bits) {
+#if defined(__GNUC__)
+    return static_cast<size_t>(__builtin_ctzll(bits));
+#else
+    size_t n = 0;
+    while (!(bits & 1u)) {
+        bits >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+Bus::Bus() : Bus(MemoryImage::zero()) {
+}
+
+Bus::Bus(std::shared_ptr<const MemoryImage> image)
+    : Bus(std::move(image), nullptr) {
+}
+
+Bus::Bus(std::shared_ptr<const MemoryImage> image, uint16_t* storage)
+    : base(std::move(image)), memory(storage), tag(0), watcher(nullptr), ownsMemory(!storage), deviceReadCount(0),
+      deviceWriteCount(0), publishedReads(0), publishedWrites(0) {
+    // Left uninitialized: a page is only touched once it is made private
+    if (ownsMemory)
+        memory = new uint16_t[MEMORY_SIZE];
+    std::memset(devices, 0, sizeof devices);
+    std::memset(dirty, 0, sizeof dirty);
+    std::memset(watched, 0, sizeof watched);
+    std::memset(changed, 0, sizeof changed);
+    for (size_t p = 0; p < PAGE_COUNT; ++p)
+        remap(p);
 }
 
 Bus::~Bus() {
-    delete[] memory;
+    if (ownsMemory)
+        delete[] memory;
+}
+
+// --- Slow paths (page-table entry was nullptr) ---
+
+uint16_t Bus::readSlow(uint16_t address) const {
+    // Only device pages have no readable memory behind them
+    ++deviceReadCount;
+    return devices[address >> PAGE_SHIFT]->read(address);
+}
+
+void Bus::writeSlow(uint16_t address, uint16_t value) {
+    size_t p = address >> PAGE_SHIFT;
+    if (MmioDevice* device = devices[p]) {
+        ++deviceWriteCount;
+        device->write(address, value);
+        return;
+    }
+    writablePage(p)[address & (PAGE_WORDS - 1)] = value;
+    if (watcher && ((watched[p >> 6] >> (p & 63)) & 1u))
+        watcher->onBusWrite(address);
+}
+
+// --- Page state ---
+
+void Bus::remap(size_t p) {
+    if (devices[p]) {
+        readMap[p] = nullptr;
+        writeMap[p] = nullptr;
+        return;
+    }
+    uint16_t* copy = isDirty(p) ? memory + (p << PAGE_SHIFT) : nullptr;
+    bool isWatched = (watched[p >> 6] >> (p & 63)) & 1u;
+    readMap[p] = copy ? copy : base->page(p);
+    writeMap[p] = isWatched || !isChanged(p) ? nullptr : copy;
+}
+
+void Bus::makePrivate(size_t p) {
+    std::memcpy(memory + (p << PAGE_SHIFT), base->page(p), PAGE_WORDS * sizeof(uint16_t));
+    dirty[p >> 6] |= uint64_t(1) << (p & 63);
+    changed[p >> 6] |= uint64_t(1) << (p & 63);
+    remap(p);
+}
+
+void Bus::restorePage(size_t p) {
+    dirty[p >> 6] &= ~(uint64_t(1) << (p & 63));
+    changed[p >> 6] |= uint64_t(1) << (p & 63);
+    remap(p);
+}
+
+void Bus::markChanged(size_t p) {
+    changed[p >> 6] |= uint64_t(1) << (p & 63);
+    remap(p);
+}
+
+uint16_t* Bus::writablePage(size_t p) {
+    if (!isDirty(p))
+        makePrivate(p);
+    else if (!isChanged(p))
+        markChanged(p);
+    return memory + (p << PAGE_SHIFT);
 }
 
-uint16_t Bus::read(uint16_t address) const {
-    // address is 16-bit so 0..65535; cast to size_t for comparison with MEMORY_SIZE
-    if (static_cast<size_t>(address) < MEMORY_SIZE)
-        return memory[address];
-    return 0;
+void Bus::addWatch(size_t p) {
+    watched[p >> 6] |= uint64_t(1) << (p & 63);
+    remap(p);
 }
 
-void Bus::write(uint16_t address, uint16_t value) {
-    if (static_cast<size_t>(address) < MEMORY_SIZE)
-        memory[address] = value;
+void Bus::clearWatches() {
+    std::memset(watched, 0, sizeof watched);
+    for (size_t p = 0; p < PAGE_COUNT; ++p)
+        remap(p);
+}
+
+void Bus::setWatcher(BusWatcher* w) {
+    watcher = w;
+    clearWatches();
+}
+
+// --- Block transfers ---
+
+void Bus::copyRun(size_t dst, size_t src, size_t n, bool backward) {
+    size_t dp = dst >> PAGE_SHIFT, sp = src >> PAGE_SHIFT;
+    if (devices[dp] || devices[sp]) {
+        for (size_t i = 0; i < n; ++i) {
+            size_t k = backward ? n - 1 - i : i;
+            write(static_cast<uint16_t>(dst + k), read(static_cast<uint16_t>(src + k)));
+        }
+        return;
+    }
+    uint16_t* to = writablePage(dp) + (dst & (PAGE_WORDS - 1));
+    // Read the source pointer after writablePage(): dp may be sp, now private
+    const uint16_t* from = readMap[sp] + (src & (PAGE_WORDS - 1));
+    std::memmove(to, from, n * sizeof(uint16_t));
+    if (watcher && isWatched(dp))
+        watcher->onBusReload(static_cast<uint16_t>(dst), n);
+}
+
+bool Bus::copyWords(uint16_t dst, uint16_t src, size_t count) {
+    if (count > MEMORY_SIZE - dst || count > MEMORY_SIZE - src)
+        return false;
+    // Runs end at whichever range reaches a page boundary first. Overlapping
+    // with dst above src, they go back to front so no source word is
+    // overwritten before it is read.
+    bool backward = dst > src && dst < src + count;
+    for (size_t left = count; left;) {
+        size_t n;
+        if (backward) {
+            size_t dEnd = dst + left, sEnd = src + left;
+            n = std::min({left, ((dEnd - 1) & (PAGE_WORDS - 1)) + 1, ((sEnd - 1) & (PAGE_WORDS - 1)) + 1});
+            copyRun(dEnd - n, sEnd - n, n, true);
+        } else {
+            size_t d = dst + (count - left), s = src + (count - left);
+            n = std::min({left, PAGE_WORDS - (d & (PAGE_WORDS - 1)), PAGE_WORDS - (s & (PAGE_WORDS - 1))});
+            copyRun(d, s, n, false);
+        }
+        left -= n;
+    }
+    return true;
+}
+
+bool Bus::fillWords(uint16_t dst, uint16_t value, size_t count) {
+    if (count > MEMORY_SIZE - dst)
+        return false;
+    for (size_t a = dst, end = dst + count; a < end;) {
+        size_t p = a >> PAGE_SHIFT;
+        size_t n = std::min(end - a, PAGE_WORDS - (a & (PAGE_WORDS - 1)));
+        if (devices[p]) {
+            deviceWriteCount += n;
+            for (size_t i = 0; i < n; ++i)
+                devices[p]->write(static_cast<uint16_t>(a + i), value);
+        } else {
+            std::fill_n(writablePage(p) + (a & (PAGE_WORDS - 1)), n, value);
+            if (watcher && isWatched(p))
+                watcher->onBusReload(static_cast<uint16_t>(a), n);
+        }
+        a += n;
+    }
+    return true;
+}
+
+// --- Device region table ---
+
+bool Bus::mapDevice(size_t firstPage, size_t pageCount, MmioDevice* device) {
+    if (!device || firstPage >= PAGE_COUNT || pageCount > PAGE_COUNT - firstPage)
+        return false;
+    for (size_t p = firstPage; p < firstPage + pageCount; ++p)
+        if (devices[p])
+            return false;
+    for (size_t p = firstPage; p < firstPage + pageCount; ++p) {
+        devices[p] = device;
+        remap(p);
+    }
+    // Code cached from these pages no longer reflects what a fetch would read
+    if (watcher)
+        watcher->onBusReload(static_cast<uint16_t>(firstPage << PAGE_SHIFT), pageCount * PAGE_WORDS);
+    return true;
+}
+
+void Bus::unmapDevice(size_t firstPage, size_t pageCount) {
+    if (firstPage >= PAGE_COUNT)
+        return;
+    if (pageCount > PAGE_COUNT - firstPage)
+        pageCount = PAGE_COUNT - firstPage;
+    for (size_t p = firstPage; p < firstPage + pageCount; ++p) {
+        devices[p] = nullptr;
+        remap(p);
+    }
+    if (watcher)
+        watcher->onBusReload(static_cast<uint16_t>(firstPage << PAGE_SHIFT), pageCount * PAGE_WORDS);
+}
+
+// --- Reset / rebase / fork ---
+
+void Bus::reset() {
+    // Walk the bitmap one set bit at a time: clean pages cost nothing
+    for (size_t w = 0; w < PAGE_COUNT / 64; ++w) {
+        while (dirty[w]) {
+            size_t p = w * 64 + lowestBit(dirty[w]);
+            restorePage(p);
+            if (watcher && isWatched(p))
+                watcher->onBusReload(static_cast<uint16_t>(p << PAGE_SHIFT), PAGE_WORDS);
+        }
+    }
+}
+
+void Bus::setBase(std::shared_ptr<const MemoryImage> image) {
+    base = std::move(image);
+    std::memset(dirty, 0, sizeof dirty);
+    std::memset(changed, 0xFF, sizeof changed);
+    for (size_t p = 0; p < PAGE_COUNT; ++p)
+        remap(p);
+    if (watcher)
+        watcher->onBusReload(0, MEMORY_SIZE);
+}
+
+void Bus::copyFrom(const Bus& other) {
+    if (base != other.base)
+        setBase(other.base);
+    for (size_t w = 0; w < PAGE_COUNT / 64; ++w) {
+        uint64_t pages = dirty[w] | other.dirty[w];
+        while (pages) {
+            size_t p = w * 64 + lowestBit(pages);
+            pages &= pages - 1;
+            loadPage(p, other.isDirty(p) ? other.memory + (p << PAGE_SHIFT) : nullptr);
+        }
+    }
+}
+
+void Bus::clearChanged(uint64_t newTag) {
+    tag = newTag;
+    for (size_t w = 0; w < PAGE_COUNT / 64; ++w) {
+        uint64_t pages = changed[w];
+        changed[w] = 0;
+        for (; pages; pages &= pages - 1)
+            remap(w * 64 + lowestBit(pages));
+    }
+}
+
+void Bus::loadPage(size_t p, const uint16_t* words) {
+    if (words) {
+        if (!isDirty(p)) {
+            dirty[p >> 6] |= uint64_t(1) << (p & 63);
+            changed[p >> 6] |= uint64_t(1) << (p & 63);
+            remap(p);
+        } else if (!isChanged(p)) {
+            markChanged(p);
+        }
+        std::memcpy(memory + (p << PAGE_SHIFT), words, PAGE_WORDS * sizeof(uint16_t));
+    } else {
+        restorePage(p);
+    }
+    if (watcher && isWatched(p))
+        watcher->onBusReload(static_cast<uint16_t>(p << PAGE_SHIFT), PAGE_WORDS);
+}
+
+void Bus::publishDeviceCounts(MetricShard& shard) {
+    shard.add(Metric::DeviceReads, deviceReadCount - publishedReads);
+    shard.add(Metric::DeviceWrites, deviceWriteCount - publishedWrites);
+    publishedReads = deviceReadCount;
+    publishedWrites = deviceWriteCount;
+}
+
+size_t Bus::dirtyPages() const {
+    size_t n = 0;
+    for (uint64_t w : dirty)
+        for (; w; w &= w - 1)
+            ++n;
+    return n;
+}
+
+uint16_t* Bus::getMemory() {
+    for (size_t p = 0; p < PAGE_COUNT; ++p)
+        if (!devices[p] && !isDirty(p))
+            makePrivate(p);
+    tag = 0;    // Writes through the pointer cannot be tracked
+    return memory;
 }
 
 // =============================================================================
@@ -62,233 +380,642 @@ uint16_t GPRCPU::decodeImm9(uint16_t inst) {
 // FLAG UPDATES
 // =============================================================================
 
+// Only JZ reads a flag, so instructions just record what they computed;
+// CPUState::flags() derives Z/C/N when the value is actually needed.
+
 void GPRCPU::setResultFlags(uint16_t result) {
-    state.FLAGS &= ~(FLAG_ZERO | FLAG_CARRY | FLAG_NEGATIVE); // Clear all first
-    if (result == 0)
-        state.FLAGS |= FLAG_ZERO;
-    if (result & 0x8000u)  // Bit 15 set = negative in 16-bit signed view
-        state.FLAGS |= FLAG_NEGATIVE;
-}
-
-void GPRCPU::setAddFlags(uint16_t a, uint16_t b, uint16_t result) {
-    state.FLAGS &= ~(FLAG_ZERO | FLAG_CARRY | FLAG_NEGATIVE);
-    if (result == 0)
-        state.FLAGS |= FLAG_ZERO;
-    if (result & 0x8000u)
-        state.FLAGS |= FLAG_NEGATIVE;
-    // Carry: overflow from bit 15 (sum of two 16-bit values produced 17-bit result)
-    if ((a + b) > 0xFFFFu)
-        state.FLAGS |= FLAG_CARRY;
-}
-
-void GPRCPU::setSubFlags(uint16_t a, uint16_t b, uint16_t result) {
-    state.FLAGS &= ~(FLAG_ZERO | FLAG_CARRY | FLAG_NEGATIVE);
-    if (result == 0)
-        state.FLAGS |= FLAG_ZERO;
-    if (result & 0x8000u)
-        state.FLAGS |= FLAG_NEGATIVE;
-    // Carry here means "no borrow": a >= b. So carry set when a >= b.
-    if (a >= b)
-        state.FLAGS |= FLAG_CARRY;
+    state.flagOp = FlagOp::Result;
+    state.flagResult = result;
+}
+
+void GPRCPU::setAddFlags(uint16_t a, uint16_t result) {
+    // Carry: overflow from bit 15, i.e. the 16-bit sum wrapped below a
+    state.flagOp = FlagOp::Add;
+    state.flagResult = result;
+    state.flagOperand = a;
+}
+
+void GPRCPU::setSubFlags(uint16_t a, uint16_t result) {
+    // Carry here means "no borrow": a >= b, which is the same as result <= a
+    state.flagOp = FlagOp::Sub;
+    state.flagResult = result;
+    state.flagOperand = a;
+}
+
+void GPRCPU::setShiftFlags(FlagOp op, uint16_t val, uint16_t result) {
+    // Carry: the bit shifted out of val (bit 15 for SHL, bit 0 for SHR)
+    state.flagOp = op;
+    state.flagResult = result;
+    state.flagOperand = val;
+}
+
+// =============================================================================
+// INSTRUCTION HANDLERS (one per opcode, selected once at predecode time)
+// =============================================================================
+
+struct OpHandlers {
+    static void HALT(GPRCPU& cpu, const DecodedOp&) {
+        cpu.state.halted = true;
+    }
+
+    static void MOVI(GPRCPU& cpu, const DecodedOp& d) {
+        // Rd = 9-bit immediate (zero-extended to 16 bits)
+        CPUState& state = cpu.state;
+        state.R[d.rd] = d.imm;
+        cpu.setResultFlags(state.R[d.rd]);
+    }
+
+    static void MOV(GPRCPU& cpu, const DecodedOp& d) {
+        CPUState& state = cpu.state;
+        state.R[d.rd] = state.R[d.rs];
+        cpu.setResultFlags(state.R[d.rd]);
+    }
+
+    static void LOAD(GPRCPU& cpu, const DecodedOp& d) {
+        CPUState& state = cpu.state;
+        uint16_t addr = state.R[d.rs];
+        state.R[d.rd] = cpu.bus.read(addr);
+        cpu.setResultFlags(state.R[d.rd]);
+    }
+
+    static void STORE(GPRCPU& cpu, const DecodedOp& d) {
+        CPUState& state = cpu.state;
+        uint16_t addr = state.R[d.rs];
+        cpu.bus.write(addr, state.R[d.rd]);
+    }
+
+    static void ADD(GPRCPU& cpu, const DecodedOp& d) {
+        CPUState& state = cpu.state;
+        uint16_t a = state.R[d.rd], b = state.R[d.rs];
+        uint16_t result = a + b;
+        state.R[d.rd] = result;
+        cpu.setAddFlags(a, result);
+    }
+
+    static void SUB(GPRCPU& cpu, const DecodedOp& d) {
+        CPUState& state = cpu.state;
+        uint16_t a = state.R[d.rd], b = state.R[d.rs];
+        uint16_t result = a - b;
+        state.R[d.rd] = result;
+        cpu.setSubFlags(a, result);
+    }
+
+    static void AND(GPRCPU& cpu, const DecodedOp& d) {
+        CPUState& state = cpu.state;
+        state.R[d.rd] = state.R[d.rd] & state.R[d.rs];
+        cpu.setResultFlags(state.R[d.rd]);
+    }
+
+    static void OR(GPRCPU& cpu, const DecodedOp& d) {
+        CPUState& state = cpu.state;
+        state.R[d.rd] = state.R[d.rd] | state.R[d.rs];
+        cpu.setResultFlags(state.R[d.rd]);
+    }
+
+    static void XOR(GPRCPU& cpu, const DecodedOp& d) {
+        CPUState& state = cpu.state;
+        state.R[d.rd] = state.R[d.rd] ^ state.R[d.rs];
+        cpu.setResultFlags(state.R[d.rd]);
+    }
+
+    static void NOT(GPRCPU& cpu, const DecodedOp& d) {
+        CPUState& state = cpu.state;
+        state.R[d.rd] = ~state.R[d.rs];
+        cpu.setResultFlags(state.R[d.rd]);
+    }
+
+    static void SHL(GPRCPU& cpu, const DecodedOp& d) {
+        CPUState& state = cpu.state;
+        uint16_t val = state.R[d.rd];
+        state.R[d.rd] = val << 1;
+        cpu.setShiftFlags(FlagOp::Shl, val, state.R[d.rd]);
+    }
+
+    static void SHR(GPRCPU& cpu, const DecodedOp& d) {
+        CPUState& state = cpu.state;
+        uint16_t val = state.R[d.rd];
+        state.R[d.rd] = val >> 1;
+        cpu.setShiftFlags(FlagOp::Shr, val, state.R[d.rd]);
+    }
+
+    static void JMP(GPRCPU& cpu, const DecodedOp& d) {
+        cpu.state.PC = cpu.state.R[d.rs];
+    }
+
+    static void JZ(GPRCPU& cpu, const DecodedOp& d) {
+        CPUState& state = cpu.state;
+        if (state.zero())
+            state.PC = state.R[d.rs];
+    }
+
+    static void NOP(GPRCPU&, const DecodedOp&) {
+    }
+
+    // --- Extended ops: d.imm is the literal; PC is past the first word on entry ---
+
+    static void MOVW(GPRCPU& cpu, const DecodedOp& d) {
+        MOVI(cpu, d);
+        cpu.state.PC += 1;
+    }
+
+    static void JMPW(GPRCPU& cpu, const DecodedOp& d) {
+        MOVI(cpu, d);
+        cpu.state.PC = d.imm;
+    }
+
+    static void JZW(GPRCPU& cpu, const DecodedOp& d) {
+        MOVI(cpu, d);
+        // Like MOVI_JZ: the flags come from the literal, so only 0 is taken
+        if (d.imm == 0)
+            cpu.state.PC = 0;
+        else
+            cpu.state.PC += 1;
+    }
+
+    // --- Fused pairs (Threaded engine): d is a MOVI Rx, (&d)[1] the next
+    // word, which uses Rx as its address. PC is past the MOVI on entry. ---
+
+    static void MOVI_JMP(GPRCPU& cpu, const DecodedOp& d) {
+        MOVI(cpu, d);
+        cpu.state.PC = d.imm;
+    }
+
+    static void MOVI_JZ(GPRCPU& cpu, const DecodedOp& d) {
+        MOVI(cpu, d);
+        // JZ tests the flags MOVI just set: only a zero target is taken
+        if (d.imm == 0)
+            cpu.state.PC = 0;
+        else
+            cpu.state.PC += 1;
+    }
+
+    static void MOVI_LOAD(GPRCPU& cpu, const DecodedOp& d) {
+        MOVI(cpu, d);
+        cpu.state.PC += 1;      // Past the LOAD, as if fetched (retryLoad() finds it at PC - 1)
+        LOAD(cpu, (&d)[1]);
+    }
+
+    static void MOVI_STORE(GPRCPU& cpu, const DecodedOp& d) {
+        MOVI(cpu, d);
+        cpu.state.PC += 1;
+        STORE(cpu, (&d)[1]);
+    }
+};
+
+/** Handler per opcode, indexed by the 4-bit opcode field. */
+static const DecodedOp::Handler HANDLERS[16] = {
+    OpHandlers::HALT, OpHandlers::MOVI, OpHandlers::MOV, OpHandlers::LOAD,
+    OpHandlers::STORE, OpHandlers::ADD, OpHandlers::SUB, OpHandlers::AND,
+    OpHandlers::OR, OpHandlers::XOR, OpHandlers::NOT, OpHandlers::SHL,
+    OpHandlers::SHR, OpHandlers::JMP, OpHandlers::JZ, OpHandlers::NOP
+};
+
+void GPRCPU::predecode(DecodedOp& d, uint16_t instruction) {
+    d.word = instruction;
+    d.op = decodeOpcode(instruction);
+    d.rd = decodeRd(instruction);
+    d.rs = decodeRs(instruction);
+    d.imm = decodeImm9(instruction);
+    d.dispatch = d.op;
+    d.handler = HANDLERS[d.op];
+}
+
+/** Handler per extended op, indexed by ExtOp (NOP unused). */
+static const DecodedOp::Handler EXT_HANDLERS[4] = {
+    OpHandlers::NOP, OpHandlers::MOVW, OpHandlers::JMPW, OpHandlers::JZW
+};
+
+void GPRCPU::decodeExt(DecodedOp& d, uint16_t pc) {
+    // The literal is part of the instruction: a write to it drops the entry
+    // like a pair's second word (onBusWrite() clears address - 1)
+    const uint16_t next = static_cast<uint16_t>(pc + 1);
+    bus.watchPage(next >> PAGE_SHIFT);
+    d.imm = bus.read(next);
+    unsigned ext = static_cast<unsigned>(extOp(d.word));
+    d.handler = EXT_HANDLERS[ext];
+    d.dispatch = static_cast<uint8_t>(EXT_MOVW + ext - 1);
+}
+
+void GPRCPU::fusePair(DecodedOp& d, uint16_t pc) {
+    // 0xFFFF is never kept decoded by the threaded engine, and looking ahead
+    // into a device page would be a guest-visible read
+    const uint16_t next = static_cast<uint16_t>(pc + 1);
+    if (pc >= 0xFFFE || bus.deviceAt(next >> PAGE_SHIFT))
+        return;
+    uint16_t word = bus.read(next);
+    if (decodeRs(word) != d.rd)
+        return;
+    uint8_t pair;
+    switch (static_cast<Opcode>(decodeOpcode(word))) {
+        case Opcode::JMP: pair = PAIR_MOVI_JMP; break;
+        case Opcode::JZ: pair = PAIR_MOVI_JZ; break;
+        case Opcode::LOAD: pair = PAIR_MOVI_LOAD; break;
+        case Opcode::STORE: pair = PAIR_MOVI_STORE; break;
+        default: return;
+    }
+    // The pair is dropped with either word: onBusWrite() clears address - 1 too
+    DecodedOp& n = decoded[next];
+    bus.watchPage(next >> PAGE_SHIFT);
+    if (!n.handler)
+        predecode(n, word);
+    d.dispatch = pair;
 }
 
 // =============================================================================
 // CPU CONSTRUCTION & RESET
 // =============================================================================
 
-GPRCPU::GPRCPU(Bus& bus) : bus(bus), tracing(false) {
+GPRCPU::GPRCPU(Bus& bus, Engine engine) : GPRCPU(bus, engine, nullptr) {
+}
+
+GPRCPU::GPRCPU(Bus& bus, Engine engine, DecodedOp* decodeStorage)
+    : bus(bus), decoded(decodeStorage), tracing(false), engine(engine), stopPending(false),
+      stopCause(StopReason::Halted), retryPending(false), jitRunning(false), retryFlags(0),
+      resumePC(UINT32_MAX), breakpointCount(0), eventsPending(false) {
+    // The Bus reports code writes to one watcher: a second CPU would leave the first running stale code
+    if (bus.getWatcher()) {
+        std::fprintf(stderr, "GPRCPU: the Bus already has a CPU (one CPU per Bus)\n");
+        std::abort();
+    }
+    if (!decoded) {
+        ownedDecoded.reset(new DecodedOp[MEMORY_SIZE]());
+        decoded = ownedDecoded.get();
+    }
+    if (engine == Engine::Jit) {
+        jit = Jit::create(bus);
+        if (!jit)
+            this->engine = Engine::Interpreter;
+    }
+    bus.setWatcher(this);
     reset();
 }
 
+GPRCPU::~GPRCPU() {
+    // Invalidations since the last run
+    if (eventsPending)
+        publishEvents(localMetrics());
+    if (bus.getWatcher() == this)
+        bus.setWatcher(nullptr);
+}
+
 void GPRCPU::reset() {
     for (unsigned i = 0; i < 8; ++i)
         state.R[i] = 0;
     state.PC = 0;
     state.FLAGS = 0;
+    state.flagResult = 0;
+    state.flagOperand = 0;
+    state.flagOp = FlagOp::Materialized;
     state.halted = false;
 }
 
 // =============================================================================
-// FETCH-DECODE-EXECUTE (one step)
+// PREDECODE CACHE INVALIDATION
 // =============================================================================
 
-bool GPRCPU::step() {
-    if (state.halted)
-        return false;
+void GPRCPU::invalidateDecodeCache() {
+    counts[Metric::DecodeFlushes] += 1;
+    eventsPending = true;
+    // Entries are only filled by decodeAt(), which watches their page first,
+    // so unwatched pages hold none: the cost scales with the code pages run
+    for (size_t p = 0; p < PAGE_COUNT; ++p) {
+        if (!bus.isWatched(p))
+            continue;
+        DecodedOp* page = decoded + (p << PAGE_SHIFT);
+        for (size_t i = 0; i < PAGE_WORDS; ++i)
+            page[i].handler = nullptr;
+    }
+    if (jit)
+        jit->flush();
+    // Pages are watched again as code is decoded / translated from them
+    bus.clearWatches();
+}
 
-    // --- FETCH: Read instruction at PC from memory via bus ---
-    uint16_t instruction = bus.read(state.PC);
+void GPRCPU::onBusWrite(uint16_t address) {
+    decoded[address].handler = nullptr;
+    decoded[static_cast<uint16_t>(address - 1)].handler = nullptr;  // A pair may end here
+    counts[Metric::CodeWrites] += 1;
+    eventsPending = true;
+    if (jit)
+        counts[Metric::JitBlocksInvalidated] += jit->invalidate(address);
+}
 
-    if (tracing) {
-        std::cout << "\n--- Cycle @ PC=0x" << std::hex << std::setw(4) << std::setfill('0') << state.PC << " ---\n";
-        std::cout << "  Instruction: 0x" << std::setw(4) << instruction << "\n";
-        std::cout << "  R0=" << std::setw(4) << state.R[0] << " R1=" << std::setw(4) << state.R[1]
-                  << " R2=" << std::setw(4) << state.R[2] << " R3=" << std::setw(4) << state.R[3]
-                  << " R4=" << std::setw(4) << state.R[4] << " R5=" << std::setw(4) << state.R[5]
-                  << " R6=" << std::setw(4) << state.R[6] << " R7=" << std::setw(4) << state.R[7] << "\n";
-        std::cout << "  FLAGS: Z=" << ((state.FLAGS & FLAG_ZERO) ? 1 : 0)
-                  << " C=" << ((state.FLAGS & FLAG_CARRY) ? 1 : 0)
-                  << " N=" << ((state.FLAGS & FLAG_NEGATIVE) ? 1 : 0) << "\n";
-        std::cout << std::dec;
+void GPRCPU::onBusReload(uint16_t first, size_t count) {
+    if (count >= MEMORY_SIZE) {
+        invalidateDecodeCache();
+        return;
     }
+    decoded[static_cast<uint16_t>(first - 1)].handler = nullptr;   // A pair may end in the range
+    for (size_t i = 0; i < count; ++i)
+        decoded[static_cast<uint16_t>(first + i)].handler = nullptr;
+    counts[Metric::CodeWrites] += count;
+    eventsPending = true;
+    if (jit)
+        for (size_t i = 0; i < count; ++i)
+            counts[Metric::JitBlocksInvalidated] += jit->invalidate(static_cast<uint16_t>(first + i));
+}
 
-    // --- DECODE: Advance PC to next instruction (most instructions are 1 word) ---
-    state.PC += 1;
-
-    // --- EXECUTE: Perform the operation ---
-    execute(instruction);
+// =============================================================================
+// FETCH-DECODE-EXECUTE / RUN (trace policy chosen here, once per call)
+// =============================================================================
 
-    return !state.halted;
+bool GPRCPU::step() {
+    if (tracing) {
+        TextTrace trace;
+        return step(trace);
+    }
+    NoTrace trace;
+    return step(trace);
 }
 
-void GPRCPU::execute(uint16_t instruction) {
-    uint8_t op = decodeOpcode(instruction);
-    uint8_t rd = decodeRd(instruction);
-    uint8_t rs = decodeRs(instruction);
-    uint16_t imm9 = decodeImm9(instruction);
+size_t GPRCPU::run() {
+    return static_cast<size_t>(runFor(UINT64_MAX).cycles);
+}
 
-    switch (static_cast<Opcode>(op)) {
-        case Opcode::HALT:
-            state.halted = true;
-            if (tracing) std::cout << "  [EXEC] HALT\n";
-            break;
+RunResult GPRCPU::runFor(uint64_t maxCycles) {
+    RunResult r = runSlice(maxCycles);
+    countRun(r);
+    return r;
+}
 
-        case Opcode::MOVI: {
-            // Rd = 9-bit immediate (zero-extended to 16 bits)
-            state.R[rd] = imm9;
-            setResultFlags(state.R[rd]);
-            if (tracing) std::cout << "  [EXEC] MOVI R" << static_cast<unsigned>(rd) << ", " << imm9 << "\n";
-            break;
-        }
+RunResult GPRCPU::runSlice(uint64_t maxCycles) {
+    if (tracing) {
+        TextTrace trace;
+        return runSlice(trace, maxCycles);
+    }
+    NoTrace trace;
+    return runSlice(trace, maxCycles);
+}
 
-        case Opcode::MOV: {
-            state.R[rd] = state.R[rs];
-            setResultFlags(state.R[rd]);
-            if (tracing) std::cout << "  [EXEC] MOV R" << static_cast<unsigned>(rd) << ", R" << static_cast<unsigned>(rs) << "\n";
+RunResult GPRCPU::runUntil(std::chrono::steady_clock::time_point deadline) {
+    RunResult total{0, StopReason::Deadline};
+    while (std::chrono::steady_clock::now() < deadline) {
+        RunResult slice = runSlice(DEADLINE_SLICE);
+        total.cycles += slice.cycles;
+        if (slice.reason != StopReason::Budget) {
+            total.reason = slice.reason;
             break;
         }
+    }
+    countRun(total);
+    return total;
+}
 
-        case Opcode::LOAD: {
-            uint16_t addr = state.R[rs];
-            state.R[rd] = bus.read(addr);
-            setResultFlags(state.R[rd]);
-            if (tracing) std::cout << "  [EXEC] LOAD R" << static_cast<unsigned>(rd) << ", (R" << static_cast<unsigned>(rs)
-                << ")  ; R" << static_cast<unsigned>(rd) << " = mem[0x" << std::hex << std::setw(4) << std::setfill('0') << addr
-                << "] = 0x" << state.R[rd] << std::dec << "\n";
-            break;
-        }
+// =============================================================================
+// METRICS
+// =============================================================================
 
-        case Opcode::STORE: {
-            uint16_t addr = state.R[rs];
-            bus.write(addr, state.R[rd]);
-            if (tracing) std::cout << "  [EXEC] STORE R" << static_cast<unsigned>(rd) << ", (R" << static_cast<unsigned>(rs)
-                << ")  ; mem[0x" << std::hex << std::setw(4) << std::setfill('0') << addr << "] = 0x" << state.R[rd] << std::dec << "\n";
-            break;
-        }
+static_assert(static_cast<size_t>(Metric::RunsYield) - static_cast<size_t>(Metric::RunsHalted) ==
+                  static_cast<size_t>(StopReason::Yield),
+              "Metric::Runs* follow StopReason");
+
+void GPRCPU::countRun(const RunResult& r) {
+    Metric reason = static_cast<Metric>(static_cast<size_t>(Metric::RunsHalted) + static_cast<size_t>(r.reason));
+    counts[Metric::Instructions] += r.cycles;
+    counts[reason] += 1;
+    MetricShard& shard = localMetrics();
+    shard.add(Metric::Instructions, r.cycles);
+    shard.add(reason, 1);
+    if (eventsPending)
+        publishEvents(shard);
+    bus.publishMetrics(shard);
+}
 
-        case Opcode::ADD: {
-            uint16_t a = state.R[rd], b = state.R[rs];
-            uint16_t result = a + b;
-            state.R[rd] = result;
-            setAddFlags(a, b, result);
-            if (tracing) std::cout << "  [EXEC] ADD R" << static_cast<unsigned>(rd) << ", R" << static_cast<unsigned>(rs)
-                << "  ; R" << static_cast<unsigned>(rd) << " = 0x" << std::hex << std::setw(4) << a << " + 0x" << b << " = 0x" << result << std::dec << "\n";
-            break;
-        }
+void GPRCPU::publishEvents(MetricShard& shard) {
+    for (size_t i = static_cast<size_t>(Metric::CodeWrites); i <= static_cast<size_t>(Metric::JitBlocksInvalidated); ++i)
+        if (counts.values[i] != published.values[i])
+            shard.add(static_cast<Metric>(i), counts.values[i] - published.values[i]);
+    published = counts;
+    eventsPending = false;
+}
 
-        case Opcode::SUB: {
-            uint16_t a = state.R[rd], b = state.R[rs];
-            uint16_t result = a - b;
-            state.R[rd] = result;
-            setSubFlags(a, b, result);
-            if (tracing) std::cout << "  [EXEC] SUB R" << static_cast<unsigned>(rd) << ", R" << static_cast<unsigned>(rs)
-                << "  ; R" << static_cast<unsigned>(rd) << " = 0x" << std::hex << std::setw(4) << a << " - 0x" << b << " = 0x" << result << std::dec << "\n";
-            break;
-        }
+MetricValues GPRCPU::getMetrics() const {
+    MetricValues v = counts;
+    v[Metric::DeviceReads] = bus.deviceReads();
+    v[Metric::DeviceWrites] = bus.deviceWrites();
+    return v;
+}
 
-        case Opcode::AND: {
-            state.R[rd] = state.R[rd] & state.R[rs];
-            setResultFlags(state.R[rd]);
-            if (tracing) std::cout << "  [EXEC] AND R" << static_cast<unsigned>(rd) << ", R" << static_cast<unsigned>(rs) << "\n";
-            break;
-        }
+// =============================================================================
+// RUN CONTROL (stop requests, breakpoints)
+// =============================================================================
 
-        case Opcode::OR: {
-            state.R[rd] = state.R[rd] | state.R[rs];
-            setResultFlags(state.R[rd]);
-            if (tracing) std::cout << "  [EXEC] OR R" << static_cast<unsigned>(rd) << ", R" << static_cast<unsigned>(rs) << "\n";
-            break;
-        }
+void GPRCPU::stop(StopReason reason) {
+    stopPending = true;
+    stopCause = reason;
+    if (jit)
+        jit->requestExit();
+}
 
-        case Opcode::XOR: {
-            state.R[rd] = state.R[rd] ^ state.R[rs];
-            setResultFlags(state.R[rd]);
-            if (tracing) std::cout << "  [EXEC] XOR R" << static_cast<unsigned>(rd) << ", R" << static_cast<unsigned>(rs) << "\n";
-            break;
-        }
+uint16_t GPRCPU::retryLoad() {
+    // Translated code has stored its registers before calling into the Bus
+    CPUState live;
+    if (jitRunning)
+        jit->peekState(live);
+    else
+        live = state;
+    uint16_t pc = static_cast<uint16_t>(live.PC - 1);     // The LOAD in flight
+    retryPending = true;
+    retryFlags = live.flags();
+    stop(StopReason::Yield);
+    return live.R[decodeRd(bus.read(pc))];
+}
 
-        case Opcode::NOT: {
-            state.R[rd] = ~state.R[rs];
-            setResultFlags(state.R[rd]);
-            if (tracing) std::cout << "  [EXEC] NOT R" << static_cast<unsigned>(rd) << ", R" << static_cast<unsigned>(rs)
-                << "  ; R" << static_cast<unsigned>(rd) << " = ~R" << static_cast<unsigned>(rs) << "\n";
-            break;
-        }
+void GPRCPU::setBreakpoint(uint16_t address) {
+    if (!breakpoints) {
+        breakpoints.reset(new uint64_t[MEMORY_SIZE / 64]);
+        std::memset(breakpoints.get(), 0, MEMORY_SIZE / 8);
+    }
+    uint64_t bit = uint64_t(1) << (address & 63);
+    if (!(breakpoints[address >> 6] & bit)) {
+        breakpoints[address >> 6] |= bit;
+        ++breakpointCount;
+    }
+}
 
-        case Opcode::SHL: {
-            uint16_t val = state.R[rd];
-            state.R[rd] = val << 1;
-            state.FLAGS &= ~(FLAG_ZERO | FLAG_CARRY | FLAG_NEGATIVE);
-            if (state.R[rd] == 0) state.FLAGS |= FLAG_ZERO;
-            if (state.R[rd] & 0x8000u) state.FLAGS |= FLAG_NEGATIVE;
-            if (val & 0x8000u) state.FLAGS |= FLAG_CARRY; // bit 15 was set, so it carried out
-            if (tracing) std::cout << "  [EXEC] SHL R" << static_cast<unsigned>(rd) << "  ; R" << static_cast<unsigned>(rd)
-                << " = 0x" << std::hex << std::setw(4) << std::setfill('0') << val << " << 1 = 0x" << state.R[rd] << std::dec << "\n";
-            break;
-        }
+void GPRCPU::clearBreakpoint(uint16_t address) {
+    uint64_t bit = uint64_t(1) << (address & 63);
+    if (isBreakpoint(address)) {
+        breakpoints[address >> 6] &= ~bit;
+        --breakpointCount;
+    }
+}
 
-        case Opcode::SHR: {
-            uint16_t val = state.R[rd];
-            state.R[rd] = val >> 1;
-            state.FLAGS &= ~(FLAG_ZERO | FLAG_CARRY | FLAG_NEGATIVE);
-            if (state.R[rd] == 0) state.FLAGS |= FLAG_ZERO;
-            if (state.R[rd] & 0x8000u) state.FLAGS |= FLAG_NEGATIVE;
-            if (val & 1u) state.FLAGS |= FLAG_CARRY; // bit 0 was set, carried out
-            if (tracing) std::cout << "  [EXEC] SHR R" << static_cast<unsigned>(rd) << "  ; R" << static_cast<unsigned>(rd)
-                << " = 0x" << std::hex << std::setw(4) << std::setfill('0') << val << " >> 1 = 0x" << state.R[rd] << std::dec << "\n";
-            break;
-        }
+void GPRCPU::clearBreakpoints() {
+    if (breakpoints)
+        std::memset(breakpoints.get(), 0, MEMORY_SIZE / 8);
+    breakpointCount = 0;
+}
 
-        case Opcode::JMP: {
-            state.PC = state.R[rs];
-            if (tracing) std::cout << "  [EXEC] JMP R" << static_cast<unsigned>(rs) << "  ; PC = 0x" << std::hex << std::setw(4) << state.PC << std::dec << "\n";
-            break;
-        }
+// =============================================================================
+// JIT ENGINE
+// =============================================================================
 
-        case Opcode::JZ: {
-            if (state.FLAGS & FLAG_ZERO) {
-                state.PC = state.R[rs];
-                if (tracing) std::cout << "  [EXEC] JZ R" << static_cast<unsigned>(rs) << "  ; Z=1, PC = 0x" << std::hex << std::setw(4) << state.PC << std::dec << "\n";
-            } else {
-                if (tracing) std::cout << "  [EXEC] JZ R" << static_cast<unsigned>(rs) << "  ; Z=0, no jump\n";
-            }
-            break;
+RunResult GPRCPU::runJit(uint64_t maxCycles) {
+    uint64_t cycles = 0;
+    StopReason reason;
+    if (takeStop(reason, cycles))
+        return {0, reason};
+    if (state.halted)
+        return {0, StopReason::Halted};
+
+    // Translated code covers whole blocks while they fit in the budget; it
+    // counts the HALT it executes, which run() does not.
+    while (!state.halted && cycles < maxCycles) {
+        jitRunning = true;
+        uint64_t executed = jit->execute(state, maxCycles - cycles);
+        jitRunning = false;
+        cycles += executed;
+        if (state.halted) {
+            --cycles;
+            return {cycles, StopReason::Halted};
         }
-
-        case Opcode::NOP:
-        default:
-            if (tracing) std::cout << "  [EXEC] NOP\n";
-            break;
+        if (takeStop(reason, cycles))
+            return {cycles, reason};
+        if (executed == 0)
+            break;      // Less than a block left: finish it below
     }
+    NoTrace trace;
+    return stepFor(trace, maxCycles, cycles);
 }
 
 // =============================================================================
-// RUN (until HALT)
+// THREADED ENGINE
 // =============================================================================
+// Instead of returning to one shared loop (a single indirect call that every
+// opcode shares), each handler body ends with its own copy of the dispatch
+// sequence: fetch the next predecoded entry and jump straight to its body.
+// The host branch predictor then learns per-opcode successor patterns.
+// Cycle counting matches run(): the HALT instruction itself is not counted.
+//
+// The budget is only compared at checkpoints: after JMP / JZ, on every fresh
+// decode, and before the word at 0xFFFF (never kept decoded here, so falling
+// through it to 0 always decodes). Between two checkpoints at most
+// MEMORY_SIZE instructions run, so once fewer than that are left the rest of
+// the budget is counted one instruction at a time by stepFor(). Stop requests
+// can only come from host code, which only LOAD and STORE reach.
+//
+// Superinstructions: a MOVI Rx whose next word is JMP / JZ / LOAD / STORE
+// through Rx (how the assembler expands branches and absolute accesses) is
+// decoded with a fused dispatch slot and runs both in one body, counting two
+// cycles. A pair advances PC linearly or ends in a branch check like its
+// second half, so the checkpoint bound above still holds.
+//
+// Extended ops count one cycle and always end in a branch check: MOVW steps
+// PC over two words, so it can wrap past 0xFFFF without decoding it.
+
+#if defined(__GNUC__)
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+RunResult GPRCPU::runThreaded(uint64_t maxCycles) {
+    static void* const DISPATCH[DISPATCH_SLOTS] = {
+        &&op_HALT, &&op_MOVI, &&op_MOV, &&op_LOAD, &&op_STORE, &&op_ADD, &&op_SUB, &&op_AND,
+        &&op_OR, &&op_XOR, &&op_NOT, &&op_SHL, &&op_SHR, &&op_JMP, &&op_JZ, &&op_NOP,
+        &&op_MOVI_JMP, &&op_MOVI_JZ, &&op_MOVI_LOAD, &&op_MOVI_STORE,
+        &&op_MOVW, &&op_JMPW, &&op_JZW
+    };
+
+    uint64_t cycles = 0;
+    StopReason reason;
+    if (takeStop(reason, cycles))
+        return {0, reason};
+    if (state.halted)
+        return {0, StopReason::Halted};
+
+    // Checkpoints hand over to stepFor() from here on
+    const uint64_t checkAt = maxCycles > MEMORY_SIZE ? maxCycles - MEMORY_SIZE : 0;
+    DecodedOp* d;
+    NoTrace trace;
+
+    decoded[0xFFFF].handler = nullptr;
+    if (checkAt == 0)
+        goto counted;
+
+#define DISPATCH_NEXT()                                   \
+    do {                                                  \
+        d = &decoded[state.PC];                           \
+        if (!d->handler) {                                \
+            if (cycles >= checkAt)                        \
+                goto counted;                             \
+            decodeAt(*d, state.PC);                       \
+            if (state.PC == 0xFFFF)                       \
+                d->handler = nullptr;                     \
+        }                                                 \
+        state.PC += 1;                                    \
+        goto *DISPATCH[d->dispatch];                      \
+    } while (0)
+
+#define OP_CASE(name, check)                              \
+    op_##name:                                            \
+        OpHandlers::name(*this, *d);                      \
+        ++cycles;                                         \
+        check;                                            \
+        DISPATCH_NEXT();
+
+#define PAIR_CASE(name, check)                            \
+    op_##name:                                            \
+        OpHandlers::name(*this, *d);                      \
+        cycles += 2;                                      \
+        check;                                            \
+        DISPATCH_NEXT();
+
+#define BRANCH_CHECK()  if (cycles >= checkAt) goto counted
+#define STOP_CHECK()    if (stopPending) goto stopped
+
+    DISPATCH_NEXT();
+
+    OP_CASE(MOVI, )
+    OP_CASE(MOV, )
+    OP_CASE(LOAD, STOP_CHECK())
+    OP_CASE(STORE, STOP_CHECK())
+    OP_CASE(ADD, )
+    OP_CASE(SUB, )
+    OP_CASE(AND, )
+    OP_CASE(OR, )
+    OP_CASE(XOR, )
+    OP_CASE(NOT, )
+    OP_CASE(SHL, )
+    OP_CASE(SHR, )
+    OP_CASE(JMP, BRANCH_CHECK())
+    OP_CASE(JZ, BRANCH_CHECK())
+    OP_CASE(NOP, )
+    PAIR_CASE(MOVI_JMP, BRANCH_CHECK())
+    PAIR_CASE(MOVI_JZ, BRANCH_CHECK())
+    PAIR_CASE(MOVI_LOAD, STOP_CHECK())
+    PAIR_CASE(MOVI_STORE, STOP_CHECK())
+    OP_CASE(MOVW, BRANCH_CHECK())
+    OP_CASE(JMPW, BRANCH_CHECK())
+    OP_CASE(JZW, BRANCH_CHECK())
+
+op_HALT:
+    OpHandlers::HALT(*this, *d);
+    return {cycles, StopReason::Halted};
+
+stopped:
+    takeStop(reason, cycles);
+    return {cycles, reason};
+
+counted:
+    return stepFor(trace, maxCycles, cycles);
+
+#undef STOP_CHECK
+#undef BRANCH_CHECK
+#undef PAIR_CASE
+#undef OP_CASE
+#undef DISPATCH_NEXT
+}
 
-size_t GPRCPU::run() {
-    size_t cycles = 0;
-    while (step())
-        ++cycles;
-    return cycles;
+#pragma GCC diagnostic pop
+
+#else
+
+// Portable fallback: handlers are called through their predecoded pointers
+// from the counted step loop (no computed goto, no reliance on tail calls).
+RunResult GPRCPU::runThreaded(uint64_t maxCycles) {
+    NoTrace trace;
+    return stepFor(trace, maxCycles, 0);
 }
+
+#endif
@@ -6,8 +6,13 @@
 #ifndef GPR_CPU_H
 #define GPR_CPU_H
 
+#include "metrics.h"
+#include <chrono>
 #include <cstdint>
 #include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
 
 // =============================================================================
 // MEMORY & BUS
@@ -16,27 +21,273 @@
 /** 64KB addressable memory (2^16 = 65536 words, each 16 bits) */
 constexpr size_t MEMORY_SIZE = 65536;
 
+/** Memory is managed in 256-word pages (copy-on-write and reset granularity). */
+constexpr unsigned PAGE_SHIFT = 8;
+constexpr size_t PAGE_WORDS = size_t(1) << PAGE_SHIFT;
+constexpr size_t PAGE_COUNT = MEMORY_SIZE / PAGE_WORDS;
+
+/**
+ * BusWatcher: Notified after every Bus::write to a watched page (see
+ * Bus::watchPage). Used by the CPU to drop cached decodes of memory words
+ * that were overwritten (self-modifying code).
+ */
+class BusWatcher {
+public:
+    virtual ~BusWatcher() = default;
+    virtual void onBusWrite(uint16_t address) = 0;
+
+    /**
+     * Words [first, first + count) were replaced at once (rebase, device
+     * mapping). Single pages restored or loaded are only reported if watched.
+     */
+    virtual void onBusReload(uint16_t first, size_t count) {
+        for (size_t i = 0; i < count; ++i)
+            onBusWrite(static_cast<uint16_t>(first + i));
+    }
+};
+
+/**
+ * MmioDevice: Host I/O device mapped into one or more Bus pages. Every guest
+ * read or write inside its pages is forwarded here with the full address.
+ */
+class MmioDevice {
+public:
+    virtual ~MmioDevice() = default;
+    virtual uint16_t read(uint16_t address) = 0;
+    virtual void write(uint16_t address, uint16_t value) = 0;
+};
+
+/**
+ * MemoryImage: Immutable MEMORY_SIZE-word memory contents, shared by every Bus
+ * that uses it as its base (e.g. one assembled program run against many inputs).
+ * Stored as a table of page pointers into storage the image keeps alive, so
+ * an image can be a heap copy or pages mapped straight from a file.
+ */
+class MemoryImage {
+public:
+    /** Image holding a copy of MEMORY_SIZE words (e.g. a buffer filled by assemble()). */
+    static std::shared_ptr<const MemoryImage> copyOf(const uint16_t* words);
+
+    /** Shared all-zero image: the base of a default-constructed Bus. */
+    static std::shared_ptr<const MemoryImage> zero();
+
+    /**
+     * Image over existing pages (no copy): pages[p] is PAGE_WORDS words or
+     * nullptr for an all-zero page. storage is held for the image's lifetime.
+     */
+    static std::shared_ptr<const MemoryImage> fromPages(const uint16_t* const* pages,
+                                                        std::shared_ptr<const void> storage);
+
+    const uint16_t* page(size_t p) const { return pages[p]; }
+
+    /** Copy all MEMORY_SIZE words into out. */
+    void copyTo(uint16_t* out) const;
+
+private:
+    explicit MemoryImage(std::shared_ptr<const void> storage) : storage(std::move(storage)) {}
+
+    const uint16_t* pages[PAGE_COUNT];
+    std::shared_ptr<const void> storage;
+};
+
 /**
  * Bus: Simple abstraction for memory reads/writes.
- * Decouples the CPU from raw memory and allows future expansion (e.g., MMIO).
+ * Decouples the CPU from raw memory and maps MMIO devices at page granularity.
+ *
+ * Memory is copy-on-write over a shared base image: a page is copied into
+ * this Bus only when first written, and a dirty-page bitmap lets reset()
+ * restore just those pages. Untouched pages cost no memory.
+ *
+ * read()/write() are inline: one page-table lookup, then the array access.
+ * A nullptr entry sends the access down the out-of-line slow path, which
+ * handles device pages, the first write to a page (copy-on-write), the first
+ * write since clearChanged() (change tracking for snapshots) and writes to
+ * watched pages (watcher notification).
+ *
+ * Cache-line aligned so Buses of different threads never share a line.
  */
-class Bus {
+class alignas(64) Bus {
 public:
+    /** All-zero memory. */
     Bus();
-    ~Bus();
 
-    /** Read 16-bit word at address. Returns 0 if address out of range. */
-    uint16_t read(uint16_t address) const;
+    /** Memory initialized from base (no copy until pages are written). */
+    explicit Bus(std::shared_ptr<const MemoryImage> base);
+
+    /**
+     * Memory initialized from base, with private pages kept in storage
+     * (MEMORY_SIZE words, owned by the caller and outliving the Bus) instead
+     * of a heap allocation. Used by InstancePool.
+     */
+    Bus(std::shared_ptr<const MemoryImage> base, uint16_t* storage);
 
-    /** Write 16-bit word at address. No-op if address out of range. */
-    void write(uint16_t address, uint16_t value);
+    ~Bus();
+
+    Bus(const Bus&) = delete;
+    Bus& operator=(const Bus&) = delete;
+
+    /** Read 16-bit word at address. */
+    uint16_t read(uint16_t address) const {
+        const uint16_t* page = readMap[address >> PAGE_SHIFT];
+        if (page)
+            return page[address & (PAGE_WORDS - 1)];
+        return readSlow(address);
+    }
+
+    /** Write 16-bit word at address. */
+    void write(uint16_t address, uint16_t value) {
+        uint16_t* page = writeMap[address >> PAGE_SHIFT];
+        if (page)
+            page[address & (PAGE_WORDS - 1)] = value;
+        else
+            writeSlow(address, value);
+    }
+
+    /**
+     * Map device over pageCount pages starting at firstPage. Returns false
+     * (and maps nothing) if the range is out of bounds or overlaps a device.
+     * The device must outlive the mapping.
+     */
+    bool mapDevice(size_t firstPage, size_t pageCount, MmioDevice* device);
+
+    /** Remove any device from the given pages; they show memory again. */
+    void unmapDevice(size_t firstPage, size_t pageCount);
+
+    /** Device mapped at page p, or nullptr for RAM. */
+    MmioDevice* deviceAt(size_t p) const { return devices[p]; }
+
+    /** Restore every page written since the base was set. Cost scales with dirty pages. */
+    void reset();
 
-    /** Direct pointer to memory for loading programs (use with care). */
-    uint16_t* getMemory() { return memory; }
-    const uint16_t* getMemory() const { return memory; }
+    /** Switch to another base image; every page reverts to it. */
+    void setBase(std::shared_ptr<const MemoryImage> base);
+    const std::shared_ptr<const MemoryImage>& getBase() const { return base; }
+
+    /**
+     * Fork: make this Bus's contents equal other's by sharing its base and
+     * copying only the pages either Bus has dirtied.
+     */
+    void copyFrom(const Bus& other);
+
+    /** True if page p holds a private (written) copy. */
+    bool isDirty(size_t p) const { return (dirty[p >> 6] >> (p & 63)) & 1u; }
+
+    /** Number of private pages. */
+    size_t dirtyPages() const;
+
+    /**
+     * Change tracking (used by Snapshot): page p was written, restored or
+     * rebased since the last clearChanged(). The first write to each page
+     * after clearChanged() takes the slow path once to set its bit.
+     */
+    bool isChanged(size_t p) const { return (changed[p >> 6] >> (p & 63)) & 1u; }
+
+    /** Changed bits of pages 64 * w .. 64 * w + 63 (bit i = page 64 * w + i). */
+    uint64_t changedMask(size_t w) const { return changed[w]; }
+
+    /** Start a new change interval, labelled tag (0 = untracked). */
+    void clearChanged(uint64_t tag);
+
+    /** Label of the current change interval; 0 after getMemory() (untracked writes). */
+    uint64_t changeTag() const { return tag; }
+
+    /** Replace page p with PAGE_WORDS words, or revert it to the base (nullptr). */
+    void loadPage(size_t p, const uint16_t* words);
+
+    /**
+     * Block copy of count words from src to dst, as if every source word were
+     * read before any is written (memmove). RAM moves a page run at a time;
+     * words in device pages go through the device one at a time, in transfer
+     * order. The watcher hears of every destination word, and change tracking
+     * and copy-on-write work as for write(). Returns false, moving nothing,
+     * if either range runs past 0xFFFF.
+     */
+    bool copyWords(uint16_t dst, uint16_t src, size_t count);
+
+    /** Block fill of count words at dst with value; otherwise like copyWords(). */
+    bool fillWords(uint16_t dst, uint16_t value, size_t count);
+
+    /**
+     * Direct pointer to memory for loading programs (use with care).
+     * Makes every RAM page private and dirty first, so prefer a base image
+     * when the same contents are loaded repeatedly. Device pages are not
+     * reachable through it, and change tracking stops (changeTag() is 0).
+     * Writes through this pointer bypass the watcher; call
+     * GPRCPU::invalidateDecodeCache() if code is changed after it has run.
+     */
+    uint16_t* getMemory();
+
+    /** Page tables for translated code: readable / writable words per page,
+     *  nullptr where the access must go through read() / write(). */
+    const uint16_t* const* readTable() const { return readMap; }
+    uint16_t* const* writeTable() const { return writeMap; }
+
+    /** Install (or clear with nullptr) the watcher; clears all page watches. */
+    void setWatcher(BusWatcher* w);
+    BusWatcher* getWatcher() const { return watcher; }
+
+    /** Notify the watcher of writes to page p (from now until clearWatches()). */
+    void watchPage(size_t p) {
+        if (!((watched[p >> 6] >> (p & 63)) & 1u))
+            addWatch(p);
+    }
+
+    /** True if writes to page p are reported to the watcher. */
+    bool isWatched(size_t p) const { return (watched[p >> 6] >> (p & 63)) & 1u; }
+
+    /** Stop notifying for every page. */
+    void clearWatches();
+
+    /** MmioDevice reads / writes made through this Bus since construction. */
+    uint64_t deviceReads() const { return deviceReadCount; }
+    uint64_t deviceWrites() const { return deviceWriteCount; }
+
+    /** Add the device accesses made since the last call to shard (GPRCPU does, once per run). */
+    void publishMetrics(MetricShard& shard) {
+        if (deviceReadCount != publishedReads || deviceWriteCount != publishedWrites)
+            publishDeviceCounts(shard);
+    }
 
 private:
-    uint16_t* memory;
+    std::shared_ptr<const MemoryImage> base;
+    uint16_t* memory;                      // Private page copies (valid where dirty)
+    const uint16_t* readMap[PAGE_COUNT];   // Base page or private copy; nullptr = device
+    uint16_t* writeMap[PAGE_COUNT];        // Private unwatched copy; nullptr = slow path
+    MmioDevice* devices[PAGE_COUNT];       // Region table
+    uint64_t dirty[PAGE_COUNT / 64];
+    uint64_t watched[PAGE_COUNT / 64];
+    uint64_t changed[PAGE_COUNT / 64];     // Since clearChanged(); clear = write via slow path
+    uint64_t tag;
+    BusWatcher* watcher;
+    bool ownsMemory;                       // memory came from new[] (not caller storage)
+    mutable uint64_t deviceReadCount;
+    uint64_t deviceWriteCount;
+    uint64_t publishedReads;               // Counts as of the last publishMetrics()
+    uint64_t publishedWrites;
+
+    uint16_t readSlow(uint16_t address) const;
+    void writeSlow(uint16_t address, uint16_t value);
+    void publishDeviceCounts(MetricShard& shard);
+
+    /** Recompute page p's readMap / writeMap entries from its state. */
+    void remap(size_t p);
+
+    /** Copy page p from the base into private memory and mark it dirty. */
+    void makePrivate(size_t p);
+
+    /** Point page p back at the base and clear its dirty bit. */
+    void restorePage(size_t p);
+
+    /** Set page p's changed bit (and give it back its fast write path). */
+    void markChanged(size_t p);
+
+    /** Page p's private words, made private and marked changed first if needed. */
+    uint16_t* writablePage(size_t p);
+
+    /** One page run of copyWords(): [dst, dst + n) and [src, src + n) each in one page. */
+    void copyRun(size_t dst, size_t src, size_t n, bool backward);
+
+    void addWatch(size_t p);
 };
 
 // =============================================================================
@@ -68,26 +319,202 @@ enum class Opcode : uint8_t {
     SHR,    // Shift right logical by 1
     JMP,    // PC = Rs (jump to address in Rs)
     JZ,     // If Zero flag set, PC = Rs
-    NOP
+    NOP     // Also the extended instructions (see ExtOp)
+};
+
+/**
+ * Extended instructions, in the NOP opcode: bits [5:0] of a NOP word select
+ * one (0 and unassigned values stay a one-word NOP). Each is two words, the
+ * second a 16-bit literal, and executes as one instruction. The literal is
+ * read when the instruction is decoded, like the instruction word.
+ */
+enum class ExtOp : uint8_t {
+    NOP = 0,
+    MOVW,   // Rd = literal, flags as MOVI
+    JMPW,   // Rd = literal, PC = literal (MOVI Rd + JMP Rd for any target)
+    JZW     // Rd = literal, then JZ Rd on the flags that set (MOVI Rd + JZ Rd)
 };
 
+/** Extended-op field of a NOP word. */
+constexpr uint16_t EXT_MASK = 0x3Fu;
+
+/** Extended op of word, or ExtOp::NOP for every other instruction. */
+constexpr ExtOp extOp(uint16_t word) {
+    return (word >> 12) == static_cast<unsigned>(Opcode::NOP) && (word & EXT_MASK) <= static_cast<unsigned>(ExtOp::JZW)
+               ? static_cast<ExtOp>(word & EXT_MASK)
+               : ExtOp::NOP;
+}
+
+/** Words the instruction starting with word occupies (1, or 2 for an extended op). */
+constexpr unsigned instructionWords(uint16_t word) {
+    return extOp(word) == ExtOp::NOP ? 1u : 2u;
+}
+
+/** First word of an extended op (the literal follows it). */
+constexpr uint16_t encodeExt(ExtOp op, unsigned rd) {
+    return static_cast<uint16_t>((static_cast<unsigned>(Opcode::NOP) << 12) | ((rd & 7u) << 9) |
+                                 static_cast<unsigned>(op));
+}
+
 // =============================================================================
 // CPU STATE
 // =============================================================================
 
+/**
+ * Lazy flags: ALU instructions record which kind of operation ran plus its
+ * result and first operand; Z/C/N are only computed when something reads them.
+ */
+enum class FlagOp : uint8_t {
+    Materialized = 0,   // FLAGS holds the current value
+    Result,             // Z/N from result, C = 0 (MOVI, MOV, LOAD, logic ops)
+    Add,                // C = carry out of bit 15 (result < operand)
+    Sub,                // C = no borrow (operand >= b, i.e. result <= operand)
+    Shl,                // C = bit 15 of operand
+    Shr                 // C = bit 0 of operand
+};
+
 struct CPUState {
     uint16_t R[8];       // General Purpose Registers R0-R7
     uint16_t PC;         // Program Counter (next instruction address)
-    uint16_t FLAGS;      // Flags: Zero, Carry, Negative
+    uint16_t FLAGS;      // Flags: Zero, Carry, Negative (stale while flagOp is pending)
+    uint16_t flagResult; // Lazy flags: result of the last flag-setting instruction
+    uint16_t flagOperand;// Lazy flags: its first operand (for Carry)
+    FlagOp flagOp;       // Lazy flags: kind of operation, or Materialized
     bool halted;         // True after HALT instruction
+
+    /** Architectural FLAGS value (computes Z/C/N if still pending). */
+    uint16_t flags() const {
+        if (flagOp == FlagOp::Materialized)
+            return FLAGS;
+        uint16_t f = FLAGS & ~(FLAG_ZERO | FLAG_CARRY | FLAG_NEGATIVE);
+        if (flagResult == 0)
+            f |= FLAG_ZERO;
+        if (flagResult & 0x8000u)
+            f |= FLAG_NEGATIVE;
+        bool carry = false;
+        switch (flagOp) {
+            case FlagOp::Add: carry = flagResult < flagOperand; break;
+            case FlagOp::Sub: carry = flagResult <= flagOperand; break;
+            case FlagOp::Shl: carry = (flagOperand & 0x8000u) != 0; break;
+            case FlagOp::Shr: carry = (flagOperand & 1u) != 0; break;
+            default: break;
+        }
+        if (carry)
+            f |= FLAG_CARRY;
+        return f;
+    }
+
+    /** Zero flag, the only flag JZ reads; no need to build the full value. */
+    bool zero() const {
+        return flagOp == FlagOp::Materialized ? (FLAGS & FLAG_ZERO) != 0 : flagResult == 0;
+    }
+
+    /** Fold pending lazy flags into FLAGS. */
+    void materializeFlags() {
+        FLAGS = flags();
+        flagOp = FlagOp::Materialized;
+    }
+};
+
+class GPRCPU;
+
+class Jit;
+
+/**
+ * Execution engine used by GPRCPU::run(). All produce identical results;
+ * they differ only in how instructions are dispatched. Engine::Jit falls
+ * back to Engine::Interpreter on hosts without a JIT backend.
+ */
+enum class Engine : uint8_t {
+    Interpreter,   // Call each predecoded entry's handler pointer in a loop
+    Threaded,      // Direct-threaded dispatch (computed goto on GCC/Clang)
+    Jit            // Basic blocks translated to host code (see jit.h)
+};
+
+/**
+ * Predecoded instruction: the decode fields of one memory word, cached so the
+ * hot loop pays for a table lookup instead of shifts, masks and a switch.
+ * An entry with handler == nullptr is empty and is filled on its next fetch.
+ */
+struct DecodedOp {
+    using Handler = void (*)(GPRCPU& cpu, const DecodedOp& d);
+
+    Handler handler;     // Executes this instruction (nullptr = not decoded)
+    uint16_t word;       // Raw instruction word (for trace)
+    uint16_t imm;        // 9-bit immediate (MOVI), or the literal of an extended op
+    uint8_t op;          // Opcode
+    uint8_t rd;          // Destination register
+    uint8_t rs;          // Source register
+    uint8_t dispatch;    // Threaded engine: op, or a PAIR_* superinstruction
+};
+
+/**
+ * Threaded engine dispatch slots after the 16 opcodes. Superinstructions: a
+ * MOVI Rx fused with the next word when that word uses Rx as its address.
+ * Both instructions still update R, FLAGS and PC exactly as they would apart.
+ * Then one slot per extended op.
+ */
+enum : uint8_t {
+    PAIR_MOVI_JMP = 16,
+    PAIR_MOVI_JZ,
+    PAIR_MOVI_LOAD,
+    PAIR_MOVI_STORE,
+    EXT_MOVW,
+    EXT_JMPW,
+    EXT_JZW,
+    DISPATCH_SLOTS
+};
+
+/**
+ * Trace policy: GPRCPU::step<Trace>() / run<Trace>() call
+ *   trace.beforeExecute(cpu, d)  after fetch, PC still at the instruction
+ *   trace.afterExecute(cpu, d)   after the handler has run
+ * NoTrace has empty inline hooks, so its instantiation carries no trace code.
+ * TextTrace (trace.h) prints the human-readable per-cycle trace.
+ */
+struct NoTrace {
+    void beforeExecute(const GPRCPU&, const DecodedOp&) {}
+    void afterExecute(const GPRCPU&, const DecodedOp&) {}
+};
+
+/** Why GPRCPU::runFor() / runUntil() returned. */
+enum class StopReason : uint8_t {
+    Halted,       // HALT executed (or the CPU was already halted)
+    Budget,       // maxCycles instructions executed
+    Deadline,     // runUntil(): the deadline passed
+    Breakpoint,   // PC reached a breakpoint; that instruction has not run yet
+    Fault,        // stop(StopReason::Fault), e.g. a device rejecting an access
+    Yield         // stop(StopReason::Yield), e.g. a device with no data yet
+};
+
+/** Outcome of one bounded run. */
+struct RunResult {
+    uint64_t cycles;      // Counted like GPRCPU::run(): HALT itself is not counted
+    StopReason reason;
 };
 
 /**
  * 16-bit GPR CPU: Implements Fetch-Decode-Execute cycle and full ISA.
+ * Cache-line aligned, with what every dispatch touches (bus, predecode
+ * table, registers) in the first line.
  */
-class GPRCPU {
+class alignas(64) GPRCPU : private BusWatcher {
 public:
-    GPRCPU(Bus& bus);
+    /**
+     * CPU running from bus. One CPU per Bus: the CPU is the Bus's watcher
+     * (its code writes invalidate decoded and translated code), so
+     * constructing a second CPU on a Bus before the first is destroyed
+     * aborts.
+     */
+    GPRCPU(Bus& bus, Engine engine = Engine::Interpreter);
+
+    /**
+     * As above, with the predecode table in decodeStorage: MEMORY_SIZE
+     * zero-filled entries, owned by the caller and outliving the CPU, instead
+     * of a heap allocation. Used by InstancePool.
+     */
+    GPRCPU(Bus& bus, Engine engine, DecodedOp* decodeStorage);
+    ~GPRCPU() override;
 
     /** Reset CPU: clear registers, PC=0, clear flags, not halted. */
     void reset();
@@ -95,21 +522,156 @@ public:
     /** Execute one FDE cycle. Returns false if CPU is halted. */
     bool step();
 
-    /** Run until HALT. Returns number of cycles executed. */
+    /** Execute one FDE cycle, reporting it to the given trace policy. */
+    template <class Trace>
+    bool step(Trace& trace);
+
+    /**
+     * Run until HALT. Returns number of cycles executed. Picks the trace
+     * policy once from trace(bool); untraced runs use the construction engine.
+     * Also returns early at a breakpoint or stop(), like runFor().
+     */
     size_t run();
 
-    /** Access current state (for debugger/trace). */
-    const CPUState& getState() const { return state; }
-    CPUState& getState() { return state; }
+    /** Run until HALT under the given trace policy (see NoTrace). */
+    template <class Trace>
+    size_t run(Trace& trace);
+
+    /**
+     * Run at most maxCycles instructions (counted like run()); a HALT is only
+     * executed if reached within the budget. Resumable: calling again continues
+     * where the last call stopped. The budget is not tested per instruction:
+     * the threaded engine checks it at JMP / JZ, fresh decodes and the wrap
+     * from 0xFFFF to 0, and the JIT once per block; only the last MEMORY_SIZE
+     * (threaded) or one block's worth (JIT) of instructions are counted one by
+     * one. Untraced runs with no breakpoints use the construction engine.
+     */
+    RunResult runFor(uint64_t maxCycles);
+
+    /** runFor() under the given trace policy (always the predecoded step loop). */
+    template <class Trace>
+    RunResult runFor(Trace& trace, uint64_t maxCycles);
+
+    /**
+     * Run until deadline passes (checked every DEADLINE_SLICE instructions),
+     * or until any other stop reason. Returns Deadline when time ran out.
+     */
+    RunResult runUntil(std::chrono::steady_clock::time_point deadline);
+
+    /** Instructions run between clock reads in runUntil(). */
+    static constexpr uint64_t DEADLINE_SLICE = uint64_t(1) << 18;
+
+    /**
+     * Make the current run return with reason (Fault or Yield) once the
+     * instruction in flight has finished, counting it. Meant for code the
+     * run calls into, i.e. MmioDevice::read() / write(). A stop requested
+     * outside a run ends the next one before it executes anything.
+     */
+    void stop(StopReason reason);
+
+    /**
+     * For MmioDevice::read() when the data is not there yet (e.g. an empty
+     * input FIFO): stop the run with StopReason::Yield and undo the LOAD in
+     * flight, so it executes again when the CPU resumes. Returns the value
+     * read() must return (the destination register's current value). PC and
+     * FLAGS are put back; the blocked attempt is not counted as a cycle.
+     */
+    uint16_t retryLoad();
+
+    /**
+     * Breakpoints: runs stop with StopReason::Breakpoint before executing
+     * the instruction at a breakpoint address. The next run starts by
+     * executing it, so calling runFor() again continues past it. While any
+     * breakpoint is set, runs use the predecoded step loop.
+     */
+    void setBreakpoint(uint16_t address);
+    void clearBreakpoint(uint16_t address);
+    void clearBreakpoints();
+    bool isBreakpoint(uint16_t address) const {
+        return breakpointCount && ((breakpoints[address >> 6] >> (address & 63)) & 1u);
+    }
+    bool hasBreakpoints() const { return breakpointCount != 0; }
+
+    /**
+     * Whether the next run executes the instruction at PC even if it is a
+     * breakpoint (as after a Breakpoint stop) or stops there first. For host
+     * code that moves the CPU to another point in its run, e.g. Timeline.
+     */
+    void resumePastBreakpoint(bool resume) { resumePC = resume ? state.PC : UINT32_MAX; }
+
+    /** Engine in use (Interpreter if Engine::Jit was unavailable). */
+    Engine getEngine() const { return engine; }
+
+    /** Access current state (for debugger/trace). FLAGS is materialized first. */
+    const CPUState& getState() const { state.materializeFlags(); return state; }
+    CPUState& getState() { state.materializeFlags(); return state; }
+
+    /** Program counter, without materializing FLAGS (cheap enough for per-cycle policies). */
+    uint16_t getPC() const { return state.PC; }
 
     /** Trace: print registers, PC, flags, and current instruction. */
     void trace(bool enable) { tracing = enable; }
     bool isTracing() const { return tracing; }
 
+    /**
+     * Drop every predecoded entry and translated block (e.g. after rewriting
+     * code via getMemory()).
+     */
+    void invalidateDecodeCache();
+
+    /**
+     * Drop the entries and blocks covering [first, first + count) only, e.g.
+     * the dirty ranges of an IncrementalAssembler writing via getMemory().
+     */
+    void invalidateDecodeCache(uint16_t first, size_t count) { onBusReload(first, count); }
+
+    /**
+     * This CPU's counters since construction, in the shape of scrapeMetrics()
+     * (the device entries are its Bus's, the assembler entries zero). They
+     * reach the calling thread's shard at the end of every runFor() /
+     * runUntil() call; step() is not counted.
+     */
+    MetricValues getMetrics() const;
+
 private:
+    friend struct OpHandlers;
+
+    // --- Hot: read on every dispatch (first cache line) ---
     Bus& bus;
-    CPUState state;
+
+    /** One predecoded entry per memory word, filled lazily on first fetch. */
+    DecodedOp* decoded;
+
+    mutable CPUState state;   // mutable: getState() const folds lazy flags
     bool tracing;
+    Engine engine;
+
+    /** decoded, when the CPU allocated it (nullptr for caller storage). */
+    std::unique_ptr<DecodedOp[]> ownedDecoded;
+
+    /** Translated-code backend when engine == Engine::Jit. */
+    std::unique_ptr<Jit> jit;
+
+    // --- Run control ---
+    bool stopPending;               // stop() called; checked after LOAD / STORE
+    StopReason stopCause;
+    bool retryPending;              // retryLoad(): rewind the LOAD when the run stops
+    bool jitRunning;                // Live registers are in the JIT, not state
+    uint16_t retryFlags;            // FLAGS before the retried LOAD
+    uint32_t resumePC;              // Breakpoint just reported (skipped once); > 0xFFFF = none
+    size_t breakpointCount;
+    std::unique_ptr<uint64_t[]> breakpoints;   // MEMORY_SIZE bits, allocated on first use
+
+    // --- Metrics (updated per run call and per invalidation, never per instruction) ---
+    MetricValues counts;
+    MetricValues published;         // Invalidation counts as of the last publishEvents()
+    bool eventsPending;             // Invalidations counted since then
+
+    /** Count a finished runFor() / runUntil() in counts and the calling thread's shard. */
+    void countRun(const RunResult& r);
+
+    /** Add the invalidations counted since the last call to shard. */
+    void publishEvents(MetricShard& shard);
 
     // --- Decoding helpers (bitwise masking and shifting) ---
     // Instruction format: [15:12] opcode, [11:9] Rd, [8:6] Rs, [5:0] extra/imm
@@ -127,17 +689,152 @@ private:
     /** Extract 9-bit immediate (bits 8-0) for MOVI: mask with 0x1FF. */
     static uint16_t decodeImm9(uint16_t inst);
 
-    /** Update Zero and Negative flags from 16-bit result. Clear Carry. */
+    // --- Flag updates (recorded lazily, see FlagOp) ---
+
+    /** Zero and Negative from 16-bit result. Clear Carry. */
     void setResultFlags(uint16_t result);
 
-    /** Update Zero, Carry, and Negative after ADD. */
-    void setAddFlags(uint16_t a, uint16_t b, uint16_t result);
+    /** Zero, Carry, and Negative after ADD (a = first operand). */
+    void setAddFlags(uint16_t a, uint16_t result);
+
+    /** Zero, Carry, and Negative after SUB (Carry = !borrow). */
+    void setSubFlags(uint16_t a, uint16_t result);
+
+    /** Zero, Carry, and Negative after SHL/SHR (val = value before shifting). */
+    void setShiftFlags(FlagOp op, uint16_t val, uint16_t result);
+
+    /** Predecoded entry at PC, decoding it first if the entry is empty. */
+    DecodedOp& fetch() {
+        DecodedOp& d = decoded[state.PC];
+        if (!d.handler)
+            decodeAt(d, state.PC);
+        return d;
+    }
+
+    /** Fill entry d from memory at pc; its page is watched from now on. */
+    void decodeAt(DecodedOp& d, uint16_t pc) {
+        bus.watchPage(pc >> PAGE_SHIFT);
+        predecode(d, bus.read(pc));
+        if (d.op == static_cast<uint8_t>(Opcode::MOVI))
+            fusePair(d, pc);
+        else if (d.op == static_cast<uint8_t>(Opcode::NOP) && extOp(d.word) != ExtOp::NOP)
+            decodeExt(d, pc);
+    }
+
+    /** Decode instruction into entry d and select its handler. */
+    static void predecode(DecodedOp& d, uint16_t instruction);
+
+    /** Extended op entry d at pc: read its literal and select its handler. */
+    void decodeExt(DecodedOp& d, uint16_t pc);
+
+    /** MOVI entry d at pc: set a PAIR_* dispatch slot if the next word fuses with it. */
+    void fusePair(DecodedOp& d, uint16_t pc);
+
+    /** Threaded engine: run with one dispatch per handler (see runFor()). */
+    RunResult runThreaded(uint64_t maxCycles);
+
+    /** runFor() without counting (also runUntil()'s slices); picks the trace policy. */
+    RunResult runSlice(uint64_t maxCycles);
+
+    template <class Trace>
+    RunResult runSlice(Trace& trace, uint64_t maxCycles);
+
+    /** JIT engine: run translated blocks, then finish the budget stepping. */
+    RunResult runJit(uint64_t maxCycles);
+
+    /** Step loop shared by every engine: continue a run at cycles of maxCycles. */
+    template <class Trace>
+    RunResult stepFor(Trace& trace, uint64_t maxCycles, uint64_t cycles);
+
+    /** Consume a pending stop(); false if there is none. A retried LOAD is rewound and uncounted. */
+    bool takeStop(StopReason& reason, uint64_t& cycles) {
+        if (!stopPending)
+            return false;
+        stopPending = false;
+        reason = stopCause;
+        if (retryPending) {
+            retryPending = false;
+            state.PC -= 1;
+            state.FLAGS = retryFlags;
+            state.flagOp = FlagOp::Materialized;
+            --cycles;
+        }
+        return true;
+    }
+
+    /** BusWatcher: a write to address invalidates its predecoded entry. */
+    void onBusWrite(uint16_t address) override;
+
+    /** BusWatcher: reloaded pages invalidate their predecoded entries. */
+    void onBusReload(uint16_t first, size_t count) override;
+};
 
-    /** Update Zero, Carry, and Negative after SUB (Carry = !borrow). */
-    void setSubFlags(uint16_t a, uint16_t b, uint16_t result);
+// =============================================================================
+// TRACE-POLICY EXECUTION CORE (templates; instantiated per policy)
+// =============================================================================
 
-    /** Execute one instruction (after fetch and decode). */
-    void execute(uint16_t instruction);
-};
+template <class Trace>
+bool GPRCPU::step(Trace& trace) {
+    if (state.halted)
+        return false;
+
+    // --- FETCH + DECODE: Look up the predecoded entry; decode on first use ---
+    DecodedOp& d = fetch();
+    trace.beforeExecute(*this, d);
+
+    // Advance PC to next instruction (most instructions are 1 word)
+    state.PC += 1;
+
+    // --- EXECUTE: Perform the operation ---
+    // A STORE may clear d.handler (self-modifying code); the other fields stay
+    // valid, so the trace can still describe the instruction that ran.
+    d.handler(*this, d);
+    trace.afterExecute(*this, d);
+
+    return !state.halted;
+}
+
+template <class Trace>
+size_t GPRCPU::run(Trace& trace) {
+    return static_cast<size_t>(runFor(trace, UINT64_MAX).cycles);
+}
+
+template <class Trace>
+RunResult GPRCPU::runFor(Trace& trace, uint64_t maxCycles) {
+    RunResult r = runSlice(trace, maxCycles);
+    countRun(r);
+    return r;
+}
+
+template <class Trace>
+RunResult GPRCPU::runSlice(Trace& trace, uint64_t maxCycles) {
+    if (std::is_same<Trace, NoTrace>::value && !breakpointCount && engine == Engine::Threaded)
+        return runThreaded(maxCycles);
+    if (std::is_same<Trace, NoTrace>::value && !breakpointCount && engine == Engine::Jit)
+        return runJit(maxCycles);
+    return stepFor(trace, maxCycles, 0);
+}
+
+template <class Trace>
+RunResult GPRCPU::stepFor(Trace& trace, uint64_t maxCycles, uint64_t cycles) {
+    StopReason reason;
+    if (takeStop(reason, cycles))
+        return {cycles, reason};
+    while (cycles < maxCycles) {
+        if (breakpointCount) {
+            if (isBreakpoint(state.PC) && state.PC != resumePC && !state.halted) {
+                resumePC = state.PC;
+                return {cycles, StopReason::Breakpoint};
+            }
+            resumePC = UINT32_MAX;
+        }
+        if (!step(trace))
+            return {cycles, StopReason::Halted};
+        ++cycles;
+        if (takeStop(reason, cycles))
+            return {cycles, reason};
+    }
+    return {cycles, state.halted ? StopReason::Halted : StopReason::Budget};
+}
 
 #endif // GPR_CPU_H
@@ -0,0 +1,66 @@
+/**
+ * 16-bit GPR CPU Emulator - Basic-block JIT
+ * Translates straight-line runs of guest instructions (ending at JMP, JZ or
+ * HALT) into host machine code, cached by entry PC.
+ */
+
+#ifndef GPR_JIT_H
+#define GPR_JIT_H
+
+#include "gpr_cpu.h"
+#include <cstdint>
+#include <memory>
+
+/**
+ * Jit: host code backend behind Engine::Jit.
+ *
+ * - Blocks are cached by entry PC and chained: an exit to a known target
+ *   (e.g. the MOVI R7, label / JMP R7 pair emitted by the assembler) is
+ *   patched into a direct jump once the target block exists.
+ * - R0-R7 live in host registers for the whole block (and across chained
+ *   blocks); FLAGS are only materialized where JZ or a block exit reads them.
+ * - A write to an address covered by a block (Bus::write -> invalidate())
+ *   unlinks that block so it is retranslated on its next entry.
+ */
+class Jit {
+public:
+    virtual ~Jit() = default;
+
+    /**
+     * Create the backend for this host. Returns nullptr when there is none
+     * (currently only x86-64 Linux is supported) or no executable memory.
+     * Pages translated from are watched (Bus::watchPage), so guest stores
+     * into code take the Bus::write path and invalidate what they overwrite.
+     */
+    static std::unique_ptr<Jit> create(Bus& bus);
+
+    /**
+     * Run translated code starting at state.PC until HALT or until budget
+     * instructions would be exceeded. Returns instructions executed
+     * (HALT included). Stops early, with fewer than a block's worth of budget
+     * left, so the caller can finish those instructions in the interpreter.
+     */
+    virtual uint64_t execute(CPUState& state, uint64_t budget) = 0;
+
+    /**
+     * Make the running execute() return at its next exit to the dispatcher.
+     * Device accesses always exit after the access, so a request made from
+     * an MmioDevice takes effect right after the instruction that made it.
+     */
+    virtual void requestExit() = 0;
+
+    /**
+     * Registers, PC (the next instruction) and FLAGS of the running
+     * execute(), for Bus callbacks: translated code stores them before every
+     * device access.
+     */
+    virtual void peekState(CPUState& out) const = 0;
+
+    /** Unlink every block that covers address; returns how many there were. */
+    virtual size_t invalidate(uint16_t address) = 0;
+
+    /** Drop all translated code. */
+    virtual void flush() = 0;
+};
+
+#endif // GPR_JIT_H
@@ -0,0 +1,675 @@
+/**
+ * 16-bit GPR CPU Emulator - x86-64 JIT backend
+ *
+ * Register pinning inside translated code:
+ *   r8d..r15d  guest R0..R7 (always zero-extended 16-bit values)
+ *   rbx        JitContext*
+ *   rbp        guest page table for reads (Bus::readTable())
+ *   esi        first operand of the last ADD/SUB/SHL/SHR (for lazy Carry)
+ *   eax/ecx/edx scratch
+ */
+
+#include "jit.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h>
+#include <cstddef>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// =============================================================================
+// HOST REGISTERS & SHARED CONTEXT
+// =============================================================================
+
+enum HostReg : unsigned { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7 };
+
+/** Guest Rn is pinned to host r(8+n). */
+unsigned hostReg(unsigned guest) { return 8 + guest; }
+
+class JitX64;
+
+enum ExitReason : uint8_t { EXIT_NORMAL = 0, EXIT_BUDGET = 1 };
+
+/** State shared by the dispatcher and translated code (rbx points here). */
+struct JitContext {
+    uint16_t R[8];
+    uint16_t PC;
+    uint16_t FLAGS;
+    uint8_t halted;
+    uint8_t exitReason;
+    int64_t budget;       // Instructions left; every block subtracts its length on entry
+    const uint16_t* const* readMap;   // Loaded into rbp by the entry stub
+    uint16_t* const* writeMap;        // nullptr entry: page not yet private
+    JitX64* jit;
+};
+
+constexpr uint8_t CTX_R      = offsetof(JitContext, R);
+constexpr uint8_t CTX_PC     = offsetof(JitContext, PC);
+constexpr uint8_t CTX_FLAGS  = offsetof(JitContext, FLAGS);
+constexpr uint8_t CTX_HALTED = offsetof(JitContext, halted);
+constexpr uint8_t CTX_EXIT   = offsetof(JitContext, exitReason);
+constexpr uint8_t CTX_BUDGET = offsetof(JitContext, budget);
+constexpr uint8_t CTX_RMAP   = offsetof(JitContext, readMap);
+constexpr uint8_t CTX_WMAP   = offsetof(JitContext, writeMap);
+static_assert(offsetof(JitContext, jit) < 128, "context fields must be reachable with disp8");
+
+// =============================================================================
+// X86-64 EMITTER (just the encodings the translator needs)
+// =============================================================================
+
+struct Emitter {
+    uint8_t* p;
+
+    void b(uint8_t v) { *p++ = v; }
+    void d32(uint32_t v) { std::memcpy(p, &v, 4); p += 4; }
+    void d64(uint64_t v) { std::memcpy(p, &v, 8); p += 8; }
+
+    void rex(bool w, unsigned r, unsigned x, unsigned base) {
+        uint8_t v = static_cast<uint8_t>(0x40 | (w ? 8 : 0) | ((r >> 3) << 2) | ((x >> 3) << 1) | (base >> 3));
+        if (v != 0x40)
+            b(v);
+    }
+    void modrm(unsigned mod, unsigned reg, unsigned rm) { b(static_cast<uint8_t>((mod << 6) | ((reg & 7) << 3) | (rm & 7))); }
+    void sib(unsigned scale, unsigned idx, unsigned base) { b(static_cast<uint8_t>((scale << 6) | ((idx & 7) << 3) | (base & 7))); }
+
+    /** opc r/m32(dst), r32(src): 01 add, 29 sub, 21 and, 09 or, 31 xor, 39 cmp, 89 mov, 85 test */
+    void rr(uint8_t opc, unsigned dst, unsigned src) { rex(false, src, 0, dst); b(opc); modrm(3, src, dst); }
+    void movzx16(unsigned dst, unsigned src) { rex(false, dst, 0, src); b(0x0F); b(0xB7); modrm(3, dst, src); }
+    void movImm(unsigned dst, uint32_t imm) { rex(false, 0, 0, dst); b(static_cast<uint8_t>(0xB8 + (dst & 7))); d32(imm); }
+    void movImm64(unsigned dst, uint64_t imm) { rex(true, 0, 0, dst); b(static_cast<uint8_t>(0xB8 + (dst & 7))); d64(imm); }
+    void xorImm(unsigned dst, uint32_t imm) { rex(false, 0, 0, dst); b(0x81); modrm(3, 6, dst); d32(imm); }
+    void testImm(unsigned dst, uint32_t imm) { rex(false, 0, 0, dst); b(0xF7); modrm(3, 0, dst); d32(imm); }
+    /** shl (ext 4) / shr (ext 5) r32, 1 */
+    void shift1(unsigned ext, unsigned dst) { rex(false, 0, 0, dst); b(0xD1); modrm(3, ext, dst); }
+    /** setcc al/cl (cc: 2 = b, 3 = ae, 4 = z, 5 = nz) */
+    void setcc(uint8_t cc, unsigned dst8) { b(0x0F); b(static_cast<uint8_t>(0x90 | cc)); modrm(3, 0, dst8); }
+
+    // --- JitContext fields: [rbx + disp8] ---
+    void loadCtx16(unsigned dst, uint8_t off) { rex(false, dst, 0, RBX); b(0x0F); b(0xB7); modrm(1, dst, RBX); b(off); }
+    void storeCtx16(uint8_t off, unsigned src) { b(0x66); rex(false, src, 0, RBX); b(0x89); modrm(1, src, RBX); b(off); }
+    void storeCtx16Imm(uint8_t off, uint16_t v) { b(0x66); b(0xC7); modrm(1, 0, RBX); b(off); b(v & 0xFF); b(v >> 8); }
+    void storeCtx8Imm(uint8_t off, uint8_t v) { b(0xC6); modrm(1, 0, RBX); b(off); b(v); }
+    void testCtx8(uint8_t off, uint8_t v) { b(0xF6); modrm(1, 0, RBX); b(off); b(v); }
+    /** add (ext 0) / sub (ext 5) / cmp (ext 7) qword [rbx+off], imm8 */
+    void ctx64Imm8(unsigned ext, uint8_t off, uint8_t v) { b(0x48); b(0x83); modrm(1, ext, RBX); b(off); b(v); }
+    void loadCtx64(unsigned dst, uint8_t off) { rex(true, dst, 0, RBX); b(0x8B); modrm(1, dst, RBX); b(off); }
+
+    // --- Guest memory: page table entry, then [page + offset*2] ---
+    /** eax = page number of the guest address in reg (addr >> PAGE_SHIFT) */
+    void pageIndex(unsigned reg) { rr(0x89, RAX, reg); b(0xC1); modrm(3, 5, RAX); b(PAGE_SHIFT); }
+    /** ecx = offset within the page (low byte of the guest address in reg) */
+    void pageOffset(unsigned reg) { rex(false, RCX, 0, reg); b(0x0F); b(0xB6); modrm(3, RCX, reg); }
+    /** movzx dst, word [rax + rcx*2] */
+    void loadPage16(unsigned dst) { rex(false, dst, RCX, RAX); b(0x0F); b(0xB7); modrm(0, dst, 4); sib(1, RCX, RAX); }
+    /** mov word [rax + rcx*2], src */
+    void storePage16(unsigned src) { b(0x66); rex(false, src, RCX, RAX); b(0x89); modrm(0, src, 4); sib(1, RCX, RAX); }
+
+    /** mov r64, [base + idx*8] (disp8 form, so rbp/r13 work as base) */
+    void loadQword8(unsigned dst, unsigned base, unsigned idx) { rex(true, dst, idx, base); b(0x8B); modrm(1, dst, 4); sib(3, idx, base); b(0); }
+
+    /** jmp rel32; returns address of the rel32 field. */
+    uint8_t* jmp(const uint8_t* target) { b(0xE9); uint8_t* site = p; d32(0); patchRel(site, target); return site; }
+    /** jcc rel32 (cc: 4 = z, 5 = nz, 0xC = l); returns address of the rel32 field. */
+    uint8_t* jcc(uint8_t cc, const uint8_t* target) { b(0x0F); b(static_cast<uint8_t>(0x80 | cc)); uint8_t* site = p; d32(0); patchRel(site, target); return site; }
+
+    static void patchRel(uint8_t* site, const uint8_t* target) {
+        int32_t rel = target ? static_cast<int32_t>(target - (site + 4)) : 0;
+        std::memcpy(site, &rel, 4);
+    }
+};
+
+// =============================================================================
+// LAZY FLAGS (tracked at translation time)
+// =============================================================================
+// Every flag-setting instruction leaves its result in its Rd host register, and
+// nothing between it and the next exit/JZ can write registers without itself
+// setting flags. So the translator only remembers which instruction set flags
+// last and computes Z/C/N from that register (plus esi for Carry) on demand.
+
+enum class FlagKind : uint8_t { None, Result, Add, Sub, Shl, Shr };
+
+struct FlagSource {
+    FlagKind kind;
+    unsigned reg;   // Host register holding the result
+};
+
+/** Write FLAGS for src into the context (no-op if no flag setter ran). */
+void materializeFlags(Emitter& e, FlagSource src) {
+    if (src.kind == FlagKind::None)
+        return;
+    unsigned r = src.reg;
+    e.rr(0x31, RAX, RAX);                  // xor eax, eax
+    e.rr(0x31, RCX, RCX);                  // xor ecx, ecx
+    e.rr(0x85, r, r);                      // test r, r
+    e.setcc(4, RAX);                       // setz al           -> Z (bit 0)
+    e.testImm(r, 0x8000);
+    e.setcc(5, RCX);                       // setnz cl
+    e.b(0x8D); e.modrm(0, RAX, 4); e.sib(2, RCX, RAX);   // lea eax, [rax+rcx*4] -> N (bit 2)
+
+    bool carry = true;
+    e.rr(0x31, RCX, RCX);
+    switch (src.kind) {
+        case FlagKind::Add: e.rr(0x39, r, RSI); e.setcc(2, RCX); break;         // result < a
+        case FlagKind::Sub: e.rr(0x39, RSI, r); e.setcc(3, RCX); break;         // a >= result (no borrow)
+        case FlagKind::Shl: e.testImm(RSI, 0x8000); e.setcc(5, RCX); break;     // old bit 15
+        case FlagKind::Shr: e.testImm(RSI, 1); e.setcc(5, RCX); break;          // old bit 0
+        default: carry = false; break;
+    }
+    if (carry) {
+        e.b(0x8D); e.modrm(0, RAX, 4); e.sib(1, RCX, RAX);   // lea eax, [rax+rcx*2] -> C (bit 1)
+    }
+
+    e.loadCtx16(RCX, CTX_FLAGS);
+    e.b(0x83); e.modrm(3, 4, RCX); e.b(0xF8);              // and ecx, ~7
+    e.rr(0x09, RCX, RAX);                                  // or ecx, eax
+    e.storeCtx16(CTX_FLAGS, RCX);
+}
+
+// =============================================================================
+// BACKEND
+// =============================================================================
+
+constexpr size_t CODE_SIZE = 8u << 20;
+constexpr unsigned MAX_BLOCK = 64;               // Guest instructions per block
+constexpr size_t MAX_BLOCK_BYTES = 16u << 10;    // Worst-case host code per block
+constexpr unsigned PAGE_SHIFT_JIT = 8;           // Invalidation bucket: 256 words
+
+using EnterFn = void (*)(JitContext* ctx, const uint8_t* body);
+
+struct Block {
+    uint16_t start;
+    uint16_t length;   // Guest words covered
+    bool live;
+};
+
+/** Slow path for a STORE whose target may be cached code (goes through Bus::write). */
+void storeHelper(JitContext* ctx, uint32_t address, uint32_t value);
+
+/** Slow path for a LOAD from a device page: R[rd] = Bus::read, then its flags. */
+void loadHelper(JitContext* ctx, uint32_t address, uint32_t rd);
+
+class JitX64 : public Jit {
+public:
+    JitX64(Bus& bus, uint8_t* code)
+        : bus(bus), code(code),
+          bodyAt(new const uint8_t*[MEMORY_SIZE]()), coverage(new uint8_t[MEMORY_SIZE]()) {
+        emitStubs();
+        flush();
+    }
+
+    ~JitX64() override {
+        munmap(code, CODE_SIZE);
+    }
+
+    uint64_t execute(CPUState& state, uint64_t budget) override {
+        for (unsigned i = 0; i < 8; ++i)
+            ctx.R[i] = state.R[i];
+        ctx.PC = state.PC;
+        ctx.FLAGS = state.flags();
+        ctx.halted = state.halted;
+        ctx.budget = budget > static_cast<uint64_t>(INT64_MAX) ? INT64_MAX : static_cast<int64_t>(budget);
+        ctx.readMap = bus.readTable();
+        ctx.writeMap = bus.writeTable();
+        ctx.jit = this;
+
+        const int64_t initial = ctx.budget;
+        exitRequested = false;
+        while (!ctx.halted) {
+            const uint8_t* body = bodyAt[ctx.PC];
+            if (!body)
+                body = compile(ctx.PC);
+            ctx.exitReason = EXIT_NORMAL;
+            enter(&ctx, body);
+            if (ctx.exitReason == EXIT_BUDGET || exitRequested)
+                break;
+        }
+
+        for (unsigned i = 0; i < 8; ++i)
+            state.R[i] = ctx.R[i];
+        state.PC = ctx.PC;
+        state.FLAGS = ctx.FLAGS;
+        state.flagOp = FlagOp::Materialized;
+        state.halted = ctx.halted != 0;
+        return static_cast<uint64_t>(initial - ctx.budget);
+    }
+
+    void requestExit() override {
+        exitRequested = true;
+    }
+
+    void peekState(CPUState& out) const override {
+        for (unsigned i = 0; i < 8; ++i)
+            out.R[i] = ctx.R[i];
+        out.PC = ctx.PC;
+        out.FLAGS = ctx.FLAGS;
+        out.flagOp = FlagOp::Materialized;
+        out.halted = ctx.halted != 0;
+    }
+
+    size_t invalidate(uint16_t address) override {
+        if (!coverage[address])
+            return 0;
+        // kill() removes the block from this list (swapping in the last entry),
+        // so only advance past blocks that survive.
+        std::vector<Block*>& list = pageBlocks[address >> PAGE_SHIFT_JIT];
+        size_t killed = 0;
+        for (size_t i = 0; i < list.size();) {
+            Block* blk = list[i];
+            if (static_cast<uint16_t>(address - blk->start) < blk->length) {
+                kill(blk);
+                ++killed;
+            } else {
+                ++i;
+            }
+        }
+        return killed;
+    }
+
+    void flush() override {
+        cur = codeStart;
+        blocks.clear();
+        linksTo.clear();
+        for (auto& list : pageBlocks)
+            list.clear();
+        std::memset(bodyAt.get(), 0, MEMORY_SIZE * sizeof(bodyAt[0]));
+        std::memset(coverage.get(), 0, MEMORY_SIZE);
+    }
+
+    Bus& bus;
+
+private:
+    uint8_t* code;
+    uint8_t* codeStart = nullptr;    // First byte after the shared stubs
+    uint8_t* cur = nullptr;          // Next free byte
+    EnterFn enter = nullptr;
+    uint8_t* exitCommon = nullptr;   // Store guest regs, return to dispatcher
+    uint8_t* exitNoStore = nullptr;  // Return to dispatcher (regs already stored)
+
+    JitContext ctx{};
+    bool exitRequested = false;      // requestExit() during execute()
+    std::unique_ptr<const uint8_t*[]> bodyAt;   // Entry PC -> translated body
+    std::unique_ptr<uint8_t[]> coverage;         // Blocks covering each word
+    std::vector<Block*> pageBlocks[MEMORY_SIZE >> PAGE_SHIFT_JIT];
+    std::unordered_map<uint16_t, std::vector<uint8_t*>> linksTo;   // Target PC -> chain sites
+    std::vector<std::unique_ptr<Block>> blocks;
+
+    // --- Shared entry/exit stubs ---
+
+    void emitStubs() {
+        Emitter e{code};
+
+        // enter(ctx = rdi, body = rsi)
+        std::memcpy(&enter, &e.p, sizeof(enter));
+        e.b(0x53); e.b(0x55);                                 // push rbx; push rbp
+        e.b(0x41); e.b(0x54); e.b(0x41); e.b(0x55);           // push r12; push r13
+        e.b(0x41); e.b(0x56); e.b(0x41); e.b(0x57);           // push r14; push r15
+        e.b(0x48); e.b(0x83); e.b(0xEC); e.b(0x08);           // sub rsp, 8 (16-byte aligned calls)
+        e.b(0x48); e.b(0x89); e.b(0xFB);                      // mov rbx, rdi
+        e.loadCtx64(RBP, CTX_RMAP);
+        for (unsigned i = 0; i < 8; ++i)
+            e.loadCtx16(hostReg(i), static_cast<uint8_t>(CTX_R + 2 * i));
+        e.b(0xFF); e.b(0xE6);                                 // jmp rsi
+
+        exitCommon = e.p;
+        for (unsigned i = 0; i < 8; ++i)
+            e.storeCtx16(static_cast<uint8_t>(CTX_R + 2 * i), hostReg(i));
+        exitNoStore = e.p;
+        e.b(0x48); e.b(0x83); e.b(0xC4); e.b(0x08);           // add rsp, 8
+        e.b(0x41); e.b(0x5F); e.b(0x41); e.b(0x5E);           // pop r15; pop r14
+        e.b(0x41); e.b(0x5D); e.b(0x41); e.b(0x5C);           // pop r13; pop r12
+        e.b(0x5D); e.b(0x5B);                                 // pop rbp; pop rbx
+        e.b(0xC3);                                            // ret
+
+        codeStart = e.p;
+    }
+
+    // --- Block exits ---
+
+    /** Exit to a constant guest PC; patched into a direct jump once target is translated. */
+    void chainExit(Emitter& e, uint16_t target) {
+        uint8_t* site = e.jmp(nullptr);     // rel32 = 0: falls through until linked
+        e.storeCtx16Imm(CTX_PC, target);
+        e.jmp(exitCommon);
+        linksTo[target].push_back(site);
+        if (bodyAt[target])
+            Emitter::patchRel(site, bodyAt[target]);
+    }
+
+    /** Exit to the PC held in a host register; jumps straight in if already translated. */
+    void indirectExit(Emitter& e, unsigned reg) {
+        e.storeCtx16(CTX_PC, reg);
+        e.movImm64(RAX, reinterpret_cast<uint64_t>(bodyAt.get()));
+        e.loadQword8(RAX, RAX, reg);
+        e.b(0x48); e.b(0x85); e.b(0xC0);                      // test rax, rax
+        e.jcc(4, exitCommon);                                 // jz exitCommon
+        e.b(0xFF); e.b(0xE0);                                 // jmp rax
+    }
+
+    /** Out-of-line LOAD/STORE through the Bus; exits the block afterwards. */
+    struct ColdAccess {
+        uint8_t* site;
+        FlagSource flags;
+        uint16_t nextPc;
+        uint8_t refund;
+        unsigned addrReg;
+        unsigned value;     // STORE: host register holding the value; LOAD: guest Rd
+        bool load;
+    };
+
+    // --- Translation ---
+
+    const uint8_t* compile(uint16_t start) {
+        if (static_cast<size_t>(code + CODE_SIZE - cur) < MAX_BLOCK_BYTES)
+            flush();
+
+        // n instructions (the budget unit) over length words
+        uint16_t words[MAX_BLOCK];
+        uint16_t literal[MAX_BLOCK];     // Second word of an extended op
+        uint16_t nextPc[MAX_BLOCK];
+        unsigned n = 0;
+        for (uint16_t pc = start;;) {
+            bus.watchPage(pc >> PAGE_SHIFT);
+            uint16_t w = bus.read(pc);
+            uint16_t after = static_cast<uint16_t>(pc + 1);
+            ExtOp ext = extOp(w);
+            if (ext != ExtOp::NOP) {
+                bus.watchPage(after >> PAGE_SHIFT);
+                literal[n] = bus.read(after);
+                after = static_cast<uint16_t>(after + 1);
+            }
+            words[n] = w;
+            nextPc[n++] = after;
+            Opcode op = static_cast<Opcode>(w >> 12);
+            if (op == Opcode::JMP || op == Opcode::JZ || op == Opcode::HALT || ext == ExtOp::JMPW ||
+                ext == ExtOp::JZW || n == MAX_BLOCK || pc == 0xFFFF || after == 0)
+                break;
+            pc = after;
+        }
+        const uint16_t length = static_cast<uint16_t>(nextPc[n - 1] - start);
+
+        Emitter e{cur};
+        const uint8_t* body = e.p;
+
+        // Reserve the whole block's budget up front; bail to the dispatcher
+        // (unexecuted) if fewer instructions than that are left.
+        e.ctx64Imm8(7, CTX_BUDGET, static_cast<uint8_t>(n));
+        uint8_t* bailSite = e.jcc(0xC, nullptr);
+        e.ctx64Imm8(5, CTX_BUDGET, static_cast<uint8_t>(n));
+
+        bool known[8] = {};
+        uint16_t value[8] = {};
+        FlagSource flags{FlagKind::None, 0};
+        std::vector<ColdAccess> cold;
+        bool terminated = false;
+
+        for (unsigned k = 0; k < n && !terminated; ++k) {
+            uint16_t w = words[k];
+            uint16_t next = nextPc[k];
+            unsigned rd = (w >> 9) & 7u, rs = (w >> 6) & 7u;
+            unsigned hd = hostReg(rd), hs = hostReg(rs);
+
+            switch (static_cast<Opcode>(w >> 12)) {
+                case Opcode::HALT:
+                    materializeFlags(e, flags);
+                    e.storeCtx8Imm(CTX_HALTED, 1);
+                    e.storeCtx16Imm(CTX_PC, next);
+                    e.jmp(exitCommon);
+                    terminated = true;
+                    break;
+
+                case Opcode::MOVI:
+                    e.movImm(hd, w & 0x1FFu);
+                    known[rd] = true; value[rd] = w & 0x1FFu;
+                    flags = {FlagKind::Result, hd};
+                    break;
+
+                case Opcode::MOV:
+                    if (hd != hs) e.rr(0x89, hd, hs);
+                    known[rd] = known[rs]; value[rd] = value[rs];
+                    flags = {FlagKind::Result, hd};
+                    break;
+
+                case Opcode::LOAD: {
+                    // Device pages have no readable page; Bus::read handles them
+                    ColdAccess c{nullptr, flags, next, static_cast<uint8_t>(n - k - 1), hs, rd, true};
+                    e.pageIndex(hs);
+                    e.loadQword8(RAX, RBP, RAX);
+                    e.b(0x48); e.b(0x85); e.b(0xC0);                  // test rax, rax
+                    c.site = e.jcc(4, nullptr);
+                    e.pageOffset(hs);
+                    e.loadPage16(hd);
+                    cold.push_back(c);
+                    known[rd] = false;
+                    flags = {FlagKind::Result, hd};
+                    break;
+                }
+
+                case Opcode::STORE: {
+                    // Fast path only if the page has a writable entry: code
+                    // pages (watched), devices and not-yet-copied pages have
+                    // none, so Bus::write invalidates / forwards / copies.
+                    ColdAccess c{nullptr, flags, next, static_cast<uint8_t>(n - k - 1), hs, hd, false};
+                    e.pageIndex(hs);
+                    e.loadCtx64(RCX, CTX_WMAP);
+                    e.loadQword8(RAX, RCX, RAX);
+                    e.b(0x48); e.b(0x85); e.b(0xC0);                  // test rax, rax
+                    c.site = e.jcc(4, nullptr);
+                    e.pageOffset(hs);
+                    e.storePage16(hd);
+                    cold.push_back(c);
+                    break;
+                }
+
+                case Opcode::ADD:
+                    e.rr(0x89, RSI, hd);
+                    e.rr(0x01, hd, hs);
+                    e.movzx16(hd, hd);
+                    known[rd] = known[rd] && known[rs]; value[rd] = static_cast<uint16_t>(value[rd] + value[rs]);
+                    flags = {FlagKind::Add, hd};
+                    break;
+
+                case Opcode::SUB:
+                    e.rr(0x89, RSI, hd);
+                    e.rr(0x29, hd, hs);
+                    e.movzx16(hd, hd);
+                    known[rd] = known[rd] && known[rs]; value[rd] = static_cast<uint16_t>(value[rd] - value[rs]);
+                    flags = {FlagKind::Sub, hd};
+                    break;
+
+                case Opcode::AND:
+                    e.rr(0x21, hd, hs);
+                    known[rd] = known[rd] && known[rs]; value[rd] &= value[rs];
+                    flags = {FlagKind::Result, hd};
+                    break;
+
+                case Opcode::OR:
+                    e.rr(0x09, hd, hs);
+                    known[rd] = known[rd] && known[rs]; value[rd] |= value[rs];
+                    flags = {FlagKind::Result, hd};
+                    break;
+
+                case Opcode::XOR:
+                    e.rr(0x31, hd, hs);
+                    known[rd] = known[rd] && known[rs]; value[rd] ^= value[rs];
+                    flags = {FlagKind::Result, hd};
+                    break;
+
+                case Opcode::NOT:
+                    if (hd != hs) e.rr(0x89, hd, hs);
+                    e.xorImm(hd, 0xFFFF);
+                    known[rd] = known[rs]; value[rd] = static_cast<uint16_t>(~value[rs]);
+                    flags = {FlagKind::Result, hd};
+                    break;
+
+                case Opcode::SHL:
+                    e.rr(0x89, RSI, hd);
+                    e.shift1(4, hd);
+                    e.movzx16(hd, hd);
+                    value[rd] = static_cast<uint16_t>(value[rd] << 1);
+                    flags = {FlagKind::Shl, hd};
+                    break;
+
+                case Opcode::SHR:
+                    e.rr(0x89, RSI, hd);
+                    e.shift1(5, hd);
+                    value[rd] = static_cast<uint16_t>(value[rd] >> 1);
+                    flags = {FlagKind::Shr, hd};
+                    break;
+
+                case Opcode::JMP:
+                    materializeFlags(e, flags);
+                    if (known[rs]) chainExit(e, value[rs]);
+                    else indirectExit(e, hs);
+                    terminated = true;
+                    break;
+
+                case Opcode::JZ: {
+                    materializeFlags(e, flags);
+                    e.testCtx8(CTX_FLAGS, static_cast<uint8_t>(FLAG_ZERO));
+                    uint8_t* notTaken = e.jcc(4, nullptr);
+                    if (known[rs]) chainExit(e, value[rs]);
+                    else indirectExit(e, hs);
+                    Emitter::patchRel(notTaken, e.p);
+                    chainExit(e, next);
+                    terminated = true;
+                    break;
+                }
+
+                case Opcode::NOP: {
+                    ExtOp ext = extOp(w);
+                    if (ext == ExtOp::NOP)
+                        break;
+                    uint16_t lit = literal[k];
+                    e.movImm(hd, lit);
+                    known[rd] = true; value[rd] = lit;
+                    flags = {FlagKind::Result, hd};
+                    if (ext == ExtOp::MOVW)
+                        break;
+                    materializeFlags(e, flags);
+                    // JZW tests the flags of its own literal: the exit is known now
+                    if (ext == ExtOp::JMPW) chainExit(e, lit);
+                    else chainExit(e, lit == 0 ? 0 : next);
+                    terminated = true;
+                    break;
+                }
+
+                default:
+                    break;
+            }
+        }
+
+        if (!terminated) {
+            materializeFlags(e, flags);
+            chainExit(e, static_cast<uint16_t>(start + length));
+        }
+
+        // --- Cold paths ---
+        Emitter::patchRel(bailSite, e.p);
+        e.storeCtx8Imm(CTX_EXIT, EXIT_BUDGET);
+        e.storeCtx16Imm(CTX_PC, start);
+        e.jmp(exitCommon);
+
+        for (const ColdAccess& c : cold) {
+            Emitter::patchRel(c.site, e.p);
+            materializeFlags(e, c.flags);
+            e.storeCtx16Imm(CTX_PC, c.nextPc);
+            if (c.refund)
+                e.ctx64Imm8(0, CTX_BUDGET, c.refund);
+            for (unsigned i = 0; i < 8; ++i)
+                e.storeCtx16(static_cast<uint8_t>(CTX_R + 2 * i), hostReg(i));
+            e.b(0x48); e.b(0x89); e.b(0xDF);                  // mov rdi, rbx
+            e.rr(0x89, RSI, c.addrReg);                       // mov esi, addr
+            if (c.load)
+                e.movImm(RDX, c.value);                       // mov edx, rd
+            else
+                e.rr(0x89, RDX, c.value);                     // mov edx, value
+            e.movImm64(RAX, reinterpret_cast<uint64_t>(c.load ? &loadHelper : &storeHelper));
+            e.b(0xFF); e.b(0xD0);                             // call rax
+            e.jmp(exitNoStore);                               // block may now be stale
+        }
+        cur = e.p;
+
+        // --- Register the block ---
+        blocks.emplace_back(new Block{start, length, true});
+        Block* blk = blocks.back().get();
+        unsigned firstPage = start >> PAGE_SHIFT_JIT;
+        unsigned lastPage = static_cast<uint16_t>(start + length - 1) >> PAGE_SHIFT_JIT;
+        pageBlocks[firstPage].push_back(blk);
+        if (lastPage != firstPage)
+            pageBlocks[lastPage].push_back(blk);
+        for (unsigned k = 0; k < length; ++k)
+            ++coverage[static_cast<uint16_t>(start + k)];
+        bodyAt[start] = body;
+        link(start, body);
+        return body;
+    }
+
+    /** Point every chain site for target at body (nullptr = unlink). */
+    void link(uint16_t target, const uint8_t* body) {
+        auto it = linksTo.find(target);
+        if (it == linksTo.end())
+            return;
+        for (uint8_t* site : it->second)
+            Emitter::patchRel(site, body);
+    }
+
+    void kill(Block* blk) {
+        if (!blk->live)
+            return;
+        blk->live = false;
+        for (unsigned k = 0; k < blk->length; ++k)
+            --coverage[static_cast<uint16_t>(blk->start + k)];
+        bodyAt[blk->start] = nullptr;
+        link(blk->start, nullptr);
+
+        // The block may also sit in the other page it spans.
+        unsigned firstPage = blk->start >> PAGE_SHIFT_JIT;
+        unsigned lastPage = static_cast<uint16_t>(blk->start + blk->length - 1) >> PAGE_SHIFT_JIT;
+        for (unsigned page : {firstPage, lastPage}) {
+            std::vector<Block*>& list = pageBlocks[page];
+            for (size_t i = 0; i < list.size(); ++i) {
+                if (list[i] == blk) {
+                    list[i] = list.back();
+                    list.pop_back();
+                    break;
+                }
+            }
+        }
+    }
+};
+
+void storeHelper(JitContext* ctx, uint32_t address, uint32_t value) {
+    ctx->jit->bus.write(static_cast<uint16_t>(address), static_cast<uint16_t>(value));
+}
+
+void loadHelper(JitContext* ctx, uint32_t address, uint32_t rd) {
+    uint16_t v = ctx->jit->bus.read(static_cast<uint16_t>(address));
+    ctx->R[rd] = v;
+    uint16_t f = ctx->FLAGS & ~(FLAG_ZERO | FLAG_CARRY | FLAG_NEGATIVE);
+    if (v == 0)
+        f |= FLAG_ZERO;
+    if (v & 0x8000u)
+        f |= FLAG_NEGATIVE;
+    ctx->FLAGS = f;
+}
+
+} // namespace
+
+std::unique_ptr<Jit> Jit::create(Bus& bus) {
+    void* mem = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        return nullptr;
+    return std::unique_ptr<Jit>(new JitX64(bus, static_cast<uint8_t*>(mem)));
+}
+
+#else
+
+std::unique_ptr<Jit> Jit::create(Bus&) {
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,75 @@
+/**
+ * 16-bit GPR CPU Emulator - Metrics (per-thread shards and scrape)
+ */
+
+#include "metrics.h"
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+/** Every live shard, plus what the shards of exited threads had counted. */
+struct Registry {
+    std::mutex lock;
+    std::vector<const MetricShard*> shards;
+    MetricValues retired;
+};
+
+Registry& registry() {
+    // Never destroyed: threads may still exit (and retire their shard) during static destruction
+    static Registry* r = new Registry;
+    return *r;
+}
+
+MetricValues valuesOf(const MetricShard& shard) {
+    MetricValues v;
+    for (size_t i = 0; i < METRIC_COUNT; ++i)
+        v.values[i] = shard.get(static_cast<Metric>(i));
+    return v;
+}
+
+/** A thread's shard; registers itself on construction and retires its counts on exit. */
+struct LocalShard {
+    MetricShard shard;
+
+    LocalShard() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        r.shards.push_back(&shard);
+    }
+
+    ~LocalShard() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        r.retired += valuesOf(shard);
+        r.shards.erase(std::find(r.shards.begin(), r.shards.end(), &shard));
+    }
+};
+
+} // namespace
+
+MetricValues& MetricValues::operator+=(const MetricValues& other) {
+    for (size_t i = 0; i < METRIC_COUNT; ++i)
+        values[i] += other.values[i];
+    return *this;
+}
+
+MetricShard::MetricShard() {
+    for (std::atomic<uint64_t>& v : values)
+        v.store(0, std::memory_order_relaxed);
+}
+
+MetricShard& localMetrics() {
+    thread_local LocalShard local;
+    return local.shard;
+}
+
+MetricValues scrapeMetrics() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    MetricValues total = r.retired;
+    for (const MetricShard* shard : r.shards)
+        total += valuesOf(*shard);
+    return total;
+}
@@ -0,0 +1,85 @@
+/**
+ * 16-bit GPR CPU Emulator - Metrics
+ *
+ * Counters for hosting the emulator in a long-running service: guest work,
+ * how runs ended, code-cache invalidations, device accesses and assembler
+ * time. Each CPU counts its own (GPRCPU::getMetrics()) and hands what changed
+ * to the calling thread's shard once per runFor() / runUntil() call, so no
+ * counting happens per instruction. scrapeMetrics() merges every thread's
+ * shard; runtime/metrics_report.h formats the result for Prometheus.
+ */
+
+#ifndef GPR_METRICS_H
+#define GPR_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+/** Counted events. The Runs* entries follow StopReason's order. */
+enum class Metric : uint8_t {
+    Instructions,           // Guest instructions run by runFor() / runUntil() / run()
+    RunsHalted,             // Calls that stopped for each StopReason
+    RunsBudget,
+    RunsDeadline,
+    RunsBreakpoint,
+    RunsFault,
+    RunsYield,
+    CodeWrites,             // Words of predecoded or translated code overwritten
+    DecodeFlushes,          // Whole predecode / translation caches dropped
+    JitBlocksInvalidated,   // Translated blocks dropped by writes to their code
+    DeviceReads,            // MmioDevice accesses through a Bus
+    DeviceWrites,
+    Assembles,              // assemble(), assembleFile(), incremental and link calls
+    AssembledLines,
+    AssembleNanoseconds,
+};
+
+constexpr size_t METRIC_COUNT = static_cast<size_t>(Metric::AssembleNanoseconds) + 1;
+
+/** One value per Metric. */
+struct MetricValues {
+    uint64_t values[METRIC_COUNT] = {};
+
+    uint64_t& operator[](Metric m) { return values[static_cast<size_t>(m)]; }
+    uint64_t operator[](Metric m) const { return values[static_cast<size_t>(m)]; }
+    MetricValues& operator+=(const MetricValues& other);
+};
+
+/**
+ * MetricShard: one thread's counters. Only that thread adds to them (a
+ * relaxed load and store, no locked instruction); scrapeMetrics() reads them
+ * from any thread at any time.
+ */
+class alignas(64) MetricShard {
+public:
+    MetricShard();
+
+    void add(Metric m, uint64_t n) {
+        std::atomic<uint64_t>& v = values[static_cast<size_t>(m)];
+        v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    uint64_t get(Metric m) const { return values[static_cast<size_t>(m)].load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> values[METRIC_COUNT];
+};
+
+/** The calling thread's shard, registered on first use. Its counts outlive the thread. */
+MetricShard& localMetrics();
+
+/** Totals over every thread that has counted, including threads that have exited. */
+MetricValues scrapeMetrics();
+
+/** Count one assembler call over lines source lines that began at start. */
+inline void countAssemble(size_t lines, std::chrono::steady_clock::time_point start) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    MetricShard& shard = localMetrics();
+    shard.add(Metric::Assembles, 1);
+    shard.add(Metric::AssembledLines, lines);
+    shard.add(Metric::AssembleNanoseconds, static_cast<uint64_t>(ns.count()));
+}
+
+#endif // GPR_METRICS_H
@@ -0,0 +1,23 @@
+/**
+ * 16-bit GPR CPU Emulator - Profiler policy (counter storage)
+ */
+
+#include "profile.h"
+#include <algorithm>
+
+Profiler::Profiler()
+    : hitCount(MEMORY_SIZE, 0), jzCount(MEMORY_SIZE, 0), jzTakenCount(MEMORY_SIZE, 0), opCount(), pc(0) {}
+
+void Profiler::clear() {
+    std::fill(hitCount.begin(), hitCount.end(), 0);
+    std::fill(jzCount.begin(), jzCount.end(), 0);
+    std::fill(jzTakenCount.begin(), jzTakenCount.end(), 0);
+    std::fill(opCount, opCount + OP_SLOTS, 0);
+}
+
+uint64_t Profiler::total() const {
+    uint64_t n = 0;
+    for (uint64_t c : opCount)
+        n += c;
+    return n;
+}
@@ -0,0 +1,74 @@
+/**
+ * 16-bit GPR CPU Emulator - Profiler policy
+ * Counts every executed instruction by address and opcode, plus the outcome
+ * of every JZ and JZW, for GPRCPU::step<Profiler>() / run<Profiler>(). Runs
+ * without a profiler use NoTrace and carry no counting code.
+ */
+
+#ifndef GPR_PROFILE_H
+#define GPR_PROFILE_H
+
+#include "gpr_cpu.h"
+#include <vector>
+
+/**
+ * Profiler: exact (not sampled) per-PC hit counts, per-opcode counts and
+ * taken / not-taken counts per JZ address. Counters accumulate across runs
+ * until clear(). A JZ counts as taken when execution continues anywhere but
+ * the next instruction; a JZW is counted as a JZ, its next instruction two
+ * words on.
+ */
+class Profiler {
+public:
+    /** Opcode-mix slots: opcodes 0-15 (15 = NOP alone), then MOVW, JMPW, JZW. */
+    static constexpr unsigned OP_SLOTS = 16 + static_cast<unsigned>(ExtOp::JZW);
+
+    /** Slot of an instruction word in the opcode mix. */
+    static constexpr unsigned opSlot(uint16_t word) {
+        return (word >> 12) + static_cast<unsigned>(extOp(word));
+    }
+
+    Profiler();
+
+    void beforeExecute(const GPRCPU& cpu, const DecodedOp& d) {
+        pc = cpu.getPC();
+        ++hitCount[pc];
+        ++opCount[opSlot(d.word)];
+    }
+
+    void afterExecute(const GPRCPU& cpu, const DecodedOp& d) {
+        unsigned size;
+        if (d.op == static_cast<uint8_t>(Opcode::JZ))
+            size = 1;
+        else if (extOp(d.word) == ExtOp::JZW)
+            size = 2;
+        else
+            return;
+        ++jzCount[pc];
+        if (cpu.getPC() != static_cast<uint16_t>(pc + size))
+            ++jzTakenCount[pc];
+    }
+
+    /** Reset every counter to zero. */
+    void clear();
+
+    /** Instructions executed so far. */
+    uint64_t total() const;
+
+    uint64_t hits(uint16_t address) const { return hitCount[address]; }
+    /** Executions per opcode-mix slot (see opSlot()). */
+    uint64_t opcodeCount(unsigned slot) const { return slot < OP_SLOTS ? opCount[slot] : 0; }
+
+    /** JZ / JZW executions at address, and how many of them jumped. */
+    uint64_t jzExecuted(uint16_t address) const { return jzCount[address]; }
+    uint64_t jzTaken(uint16_t address) const { return jzTakenCount[address]; }
+
+private:
+    std::vector<uint64_t> hitCount;      // Per address (MEMORY_SIZE entries)
+    std::vector<uint64_t> jzCount;
+    std::vector<uint64_t> jzTakenCount;
+    uint64_t opCount[OP_SLOTS];
+    uint16_t pc;                         // Address of the instruction in flight
+};
+
+#endif // GPR_PROFILE_H
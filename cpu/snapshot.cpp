@@ -0,0 +1,262 @@
+/**
+ * 16-bit GPR CPU Emulator - Machine snapshots
+ */
+
+#include "snapshot.h"
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+/** Snapshot ids double as Bus change tags; 0 means "untracked". */
+std::atomic<uint64_t> nextSnapshotId(1);
+
+// =============================================================================
+// RUN-LENGTH ENCODING (per page, 16-bit units)
+// =============================================================================
+// A unit with bit 15 set is a run: (unit & 0x7FFF) copies of the next word.
+// Otherwise it is a literal: that many words follow as they are.
+
+constexpr uint16_t RLE_RUN = 0x8000;
+constexpr size_t RLE_MIN_RUN = 3;      // Shorter runs stay in literals
+
+size_t runLength(const uint16_t* w, size_t i) {
+    size_t j = i + 1;
+    while (j < PAGE_WORDS && w[j] == w[i])
+        ++j;
+    return j - i;
+}
+
+void encodeRle(const uint16_t* w, std::vector<uint16_t>& units) {
+    units.clear();
+    size_t i = 0;
+    while (i < PAGE_WORDS) {
+        size_t run = runLength(w, i);
+        if (run >= RLE_MIN_RUN) {
+            units.push_back(static_cast<uint16_t>(RLE_RUN | run));
+            units.push_back(w[i]);
+            i += run;
+            continue;
+        }
+        size_t start = i;
+        while (i < PAGE_WORDS && runLength(w, i) < RLE_MIN_RUN)
+            ++i;
+        units.push_back(static_cast<uint16_t>(i - start));
+        units.insert(units.end(), w + start, w + i);
+    }
+}
+
+/** False if units do not decode to exactly one page. */
+bool decodeRle(const uint16_t* units, size_t count, uint16_t* out) {
+    size_t n = 0;
+    for (size_t i = 0; i < count;) {
+        uint16_t u = units[i++];
+        size_t len = u & ~RLE_RUN;
+        if (len == 0 || len > PAGE_WORDS - n)
+            return false;
+        if (u & RLE_RUN) {
+            if (i >= count)
+                return false;
+            for (size_t k = 0; k < len; ++k)
+                out[n++] = units[i];
+            ++i;
+        } else {
+            if (len > count - i)
+                return false;
+            std::memcpy(out + n, units + i, len * sizeof(uint16_t));
+            n += len;
+            i += len;
+        }
+    }
+    return n == PAGE_WORDS;
+}
+
+void append(std::string& out, const void* data, size_t bytes) {
+    out.append(static_cast<const char*>(data), bytes);
+}
+
+} // namespace
+
+// =============================================================================
+// TAKE / RESTORE
+// =============================================================================
+
+Snapshot::Snapshot() : cpu(), id(nextSnapshotId.fetch_add(1)), copied(0) {}
+
+std::shared_ptr<const Snapshot> Snapshot::take(const GPRCPU& cpu, Bus& bus, const Snapshot* previous) {
+    std::shared_ptr<Snapshot> s(new Snapshot());
+    s->cpu = cpu.getState();
+    s->image = bus.getBase();
+
+    // Pages untouched since previous was taken or restored are still its pages
+    bool incremental = previous && bus.changeTag() == previous->id && previous->image == s->image;
+    for (size_t p = 0; p < PAGE_COUNT; ++p) {
+        if (incremental && !bus.isChanged(p)) {
+            s->pages[p] = previous->pages[p];
+            continue;
+        }
+        const uint16_t* words = bus.readTable()[p];
+        if (bus.isDirty(p) && words) {
+            std::shared_ptr<SnapshotPage> copy(new SnapshotPage);
+            std::memcpy(copy->words, words, sizeof copy->words);
+            s->pages[p] = std::move(copy);
+            ++s->copied;
+        }
+    }
+    bus.clearChanged(s->id);
+    return s;
+}
+
+void Snapshot::restore(GPRCPU& target, Bus& bus) const {
+    // Bus last matched this snapshot: only pages written since differ
+    bool incremental = bus.changeTag() == id && bus.getBase() == image;
+    if (bus.getBase() != image)
+        bus.setBase(image);
+    for (size_t w = 0; w < PAGE_COUNT / 64; ++w) {
+        // Incremental: 64 pages at a time, so a run that wrote one page costs ~one word test
+        uint64_t bits = incremental ? bus.changedMask(w) : ~uint64_t(0);
+        for (size_t p = w * 64; bits; ++p, bits >>= 1) {
+            bool differs = incremental ? (bits & 1u) != 0 : (bus.isDirty(p) || pages[p]);
+            if (differs)
+                bus.loadPage(p, pages[p] ? pages[p]->words : nullptr);
+        }
+    }
+    bus.clearChanged(id);
+    target.getState() = cpu;
+}
+
+size_t Snapshot::pageCount() const {
+    size_t n = 0;
+    for (const auto& page : pages)
+        n += page != nullptr;
+    return n;
+}
+
+// =============================================================================
+// SERIALIZATION
+// =============================================================================
+
+void Snapshot::serialize(std::string& out, bool compress, const Snapshot* parent) const {
+    SnapshotHeader h;
+    std::memcpy(h.magic, SNAPSHOT_MAGIC, sizeof h.magic);
+    h.version = SNAPSHOT_VERSION;
+    h.flags = parent ? SNAPSHOT_DELTA : 0;
+    std::memcpy(h.R, cpu.R, sizeof h.R);
+    h.PC = cpu.PC;
+    h.FLAGS = cpu.FLAGS;
+    h.halted = cpu.halted ? 1 : 0;
+    h.pageCount = 0;
+    size_t headerAt = out.size();
+    append(out, &h, sizeof h);
+
+    std::vector<uint16_t> units;
+    for (size_t p = 0; p < PAGE_COUNT; ++p) {
+        const SnapshotPage* mine = pages[p].get();
+        if (parent) {
+            const SnapshotPage* theirs = parent->pages[p].get();
+            if (mine == theirs || (mine && theirs && std::memcmp(mine, theirs, sizeof *mine) == 0))
+                continue;
+        } else if (!mine) {
+            continue;
+        }
+
+        SnapshotPageHeader ph;
+        ph.page = static_cast<uint16_t>(p);
+        const uint16_t* data = nullptr;
+        if (!mine) {
+            ph.encoding = SnapshotEncoding::Base;
+            ph.words = 0;
+        } else {
+            if (compress)
+                encodeRle(mine->words, units);
+            if (compress && units.size() < PAGE_WORDS) {
+                ph.encoding = SnapshotEncoding::Rle;
+                ph.words = static_cast<uint16_t>(units.size());
+                data = units.data();
+            } else {
+                ph.encoding = SnapshotEncoding::Raw;
+                ph.words = static_cast<uint16_t>(PAGE_WORDS);
+                data = mine->words;
+            }
+        }
+        append(out, &ph, sizeof ph);
+        if (data)
+            append(out, data, ph.words * sizeof(uint16_t));
+        ++h.pageCount;
+    }
+    std::memcpy(&out[headerAt], &h, sizeof h);
+}
+
+std::shared_ptr<const Snapshot> Snapshot::deserialize(const void* data, size_t size,
+                                                      std::shared_ptr<const MemoryImage> base,
+                                                      const Snapshot* parent, std::string& error) {
+    const char* bytes = static_cast<const char*>(data);
+    SnapshotHeader h;
+    if (size < sizeof h) {
+        error = "Snapshot too short";
+        return nullptr;
+    }
+    std::memcpy(&h, bytes, sizeof h);
+    if (std::memcmp(h.magic, SNAPSHOT_MAGIC, sizeof h.magic) != 0 || h.version != SNAPSHOT_VERSION) {
+        error = "Not a snapshot (bad magic or version)";
+        return nullptr;
+    }
+    bool delta = (h.flags & SNAPSHOT_DELTA) != 0;
+    if (delta && (!parent || parent->image != base)) {
+        error = "Delta snapshot needs its parent over the same base";
+        return nullptr;
+    }
+
+    std::shared_ptr<Snapshot> s(new Snapshot());
+    s->image = std::move(base);
+    std::memcpy(s->cpu.R, h.R, sizeof h.R);
+    s->cpu.PC = h.PC;
+    s->cpu.FLAGS = h.FLAGS;
+    s->cpu.flagOp = FlagOp::Materialized;
+    s->cpu.halted = h.halted != 0;
+    if (delta)
+        for (size_t p = 0; p < PAGE_COUNT; ++p)
+            s->pages[p] = parent->pages[p];
+
+    size_t pos = sizeof h;
+    std::vector<uint16_t> units;
+    for (uint16_t i = 0; i < h.pageCount; ++i) {
+        SnapshotPageHeader ph;
+        if (size - pos < sizeof ph) {
+            error = "Snapshot truncated";
+            return nullptr;
+        }
+        std::memcpy(&ph, bytes + pos, sizeof ph);
+        pos += sizeof ph;
+        size_t dataBytes = ph.words * sizeof(uint16_t);
+        if (ph.page >= PAGE_COUNT || size - pos < dataBytes) {
+            error = "Snapshot page entry out of range";
+            return nullptr;
+        }
+        units.resize(ph.words);
+        if (dataBytes)
+            std::memcpy(units.data(), bytes + pos, dataBytes);
+        pos += dataBytes;
+
+        if (ph.encoding == SnapshotEncoding::Base && ph.words == 0) {
+            s->pages[ph.page] = nullptr;
+            continue;
+        }
+        std::shared_ptr<SnapshotPage> page(new SnapshotPage);
+        bool ok = false;
+        if (ph.encoding == SnapshotEncoding::Raw && ph.words == PAGE_WORDS) {
+            std::memcpy(page->words, units.data(), dataBytes);
+            ok = true;
+        } else if (ph.encoding == SnapshotEncoding::Rle) {
+            ok = decodeRle(units.data(), units.size(), page->words);
+        }
+        if (!ok) {
+            error = "Snapshot page data is invalid";
+            return nullptr;
+        }
+        s->pages[ph.page] = std::move(page);
+        ++s->copied;
+    }
+    return s;
+}
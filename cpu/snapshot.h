@@ -0,0 +1,112 @@
+/**
+ * 16-bit GPR CPU Emulator - Machine snapshots
+ * Checkpoints of the CPU registers plus Bus memory, taken and restored in
+ * place, optionally saved to a compact (run-length encoded) byte format.
+ */
+
+#ifndef GPR_SNAPSHOT_H
+#define GPR_SNAPSHOT_H
+
+#include "gpr_cpu.h"
+#include <memory>
+#include <string>
+
+// =============================================================================
+// SERIALIZED FORMAT
+// =============================================================================
+//
+// SnapshotHeader, then pageCount entries of SnapshotPageHeader + data, in
+// host byte order. Memory is stored relative to the program's base image
+// (which is not included): only pages that differ from the base, or with
+// SNAPSHOT_DELTA from the parent snapshot, are written.
+
+constexpr char SNAPSHOT_MAGIC[4] = {'G', 'P', 'R', 'S'};
+constexpr uint16_t SNAPSHOT_VERSION = 1;
+constexpr uint16_t SNAPSHOT_DELTA = 1u << 0;    // Pages are relative to a parent snapshot
+
+struct SnapshotHeader {
+    char magic[4];           // SNAPSHOT_MAGIC
+    uint16_t version;        // SNAPSHOT_VERSION
+    uint16_t flags;          // SNAPSHOT_*
+    uint16_t R[8];
+    uint16_t PC;
+    uint16_t FLAGS;
+    uint16_t halted;
+    uint16_t pageCount;      // Entries that follow
+};
+
+enum class SnapshotEncoding : uint16_t {
+    Base,   // Page equals the base image (no data)
+    Raw,    // PAGE_WORDS words
+    Rle     // words run-length units (see snapshot.cpp)
+};
+
+struct SnapshotPageHeader {
+    uint16_t page;
+    SnapshotEncoding encoding;
+    uint16_t words;          // Data words that follow
+};
+
+// =============================================================================
+// SNAPSHOT
+// =============================================================================
+
+/** Immutable copy of one memory page; shared by the snapshots that saved it. */
+struct SnapshotPage {
+    uint16_t words[PAGE_WORDS];
+};
+
+/**
+ * Snapshot: registers, flags, halt state and memory of one CPU + Bus.
+ *
+ * Memory is held per page on top of the Bus's base image. Taking a snapshot
+ * right after taking or restoring `previous` on the same Bus copies only the
+ * pages written since (Bus change tracking) and shares the rest with it.
+ * Restoring the snapshot a Bus was last taken from or restored to copies
+ * back only the pages written since, so a restore / run / restore loop costs
+ * the pages one run touches. Device (MMIO) state is not part of a snapshot.
+ */
+class Snapshot {
+public:
+    /** Capture cpu and its bus; pages unchanged since previous are shared with it. */
+    static std::shared_ptr<const Snapshot> take(const GPRCPU& cpu, Bus& bus,
+                                                const Snapshot* previous = nullptr);
+
+    /** Put cpu and its bus back into this state (rebasing the bus if needed). */
+    void restore(GPRCPU& cpu, Bus& bus) const;
+
+    /** CPU state at the snapshot (FLAGS materialized). */
+    const CPUState& state() const { return cpu; }
+
+    /** Base image the pages are relative to. */
+    const std::shared_ptr<const MemoryImage>& base() const { return image; }
+
+    /** Memory pages that differ from the base. */
+    size_t pageCount() const;
+
+    /** Pages this snapshot copied itself (the rest are shared with previous). */
+    size_t copiedPages() const { return copied; }
+
+    /**
+     * Append the serialized form to out. With compress, pages are run-length
+     * encoded where that is smaller. With parent, only pages that differ from
+     * it are written (read back with the same parent).
+     */
+    void serialize(std::string& out, bool compress, const Snapshot* parent = nullptr) const;
+
+    /** Read a serialized snapshot over base (and parent, for delta snapshots); nullptr + error if invalid. */
+    static std::shared_ptr<const Snapshot> deserialize(const void* data, size_t size,
+                                                       std::shared_ptr<const MemoryImage> base,
+                                                       const Snapshot* parent, std::string& error);
+
+private:
+    Snapshot();
+
+    CPUState cpu;
+    std::shared_ptr<const MemoryImage> image;
+    std::shared_ptr<const SnapshotPage> pages[PAGE_COUNT];  // nullptr = base page
+    uint64_t id;            // Bus change tag while the Bus matches this snapshot
+    size_t copied;
+};
+
+#endif // GPR_SNAPSHOT_H
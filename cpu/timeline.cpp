@@ -0,0 +1,206 @@
+/**
+ * 16-bit GPR CPU Emulator - Time-travel debugging (checkpoints, replay, delta log)
+ */
+
+#include "timeline.h"
+#include <algorithm>
+
+namespace {
+
+enum : uint8_t {
+    DELTA_REGISTER,     // Undo: PC, FLAGS and R[rd]
+    DELTA_STORE,        // ... and the word at address
+    DELTA_OPAQUE        // STORE to a device: only a replay can undo it
+};
+
+} // namespace
+
+/** Trace policy for recorded replays: appends the Delta of each instruction before it runs. */
+struct Timeline::Recorder {
+    std::vector<Delta>& log;
+    const Bus& bus;
+
+    void beforeExecute(const GPRCPU& cpu, const DecodedOp& d) {
+        const CPUState& s = cpu.getState();
+        Delta e;
+        e.pc = s.PC;
+        e.flags = s.FLAGS;
+        e.reg = s.R[d.rd];
+        e.address = 0;
+        e.memory = 0;
+        e.rd = d.rd;
+        e.kind = DELTA_REGISTER;
+        if (d.op == static_cast<uint8_t>(Opcode::STORE)) {
+            e.address = s.R[d.rs];
+            if (bus.deviceAt(e.address >> PAGE_SHIFT)) {
+                e.kind = DELTA_OPAQUE;      // Reading it back would be a guest-visible access
+            } else {
+                e.kind = DELTA_STORE;
+                e.memory = bus.read(e.address);
+            }
+        }
+        log.push_back(e);
+    }
+
+    void afterExecute(const GPRCPU&, const DecodedOp&) {}
+};
+
+Timeline::Timeline(GPRCPU& cpu, Bus& bus, uint64_t interval, size_t maxCheckpoints)
+    : cpu(cpu), bus(bus), interval(std::max<uint64_t>(interval, 1)),
+      maxCheckpoints(std::max<size_t>(maxCheckpoints, 2)), now(0), last(0), logStart(0) {
+    marks.push_back({0, Snapshot::take(cpu, bus)});
+}
+
+// =============================================================================
+// RECORDING
+// =============================================================================
+
+RunResult Timeline::runFor(uint64_t maxCycles) {
+    truncate();
+    RunResult total = {0, StopReason::Budget};
+    for (;;) {
+        uint64_t next = marks.back().cycle + interval;
+        RunResult r = cpu.runFor(std::min(maxCycles - total.cycles, next - now));
+        total.cycles += r.cycles;
+        total.reason = r.reason;
+        now += r.cycles;
+        last = now;
+        if (r.reason != StopReason::Budget)
+            return total;
+        if (now == next)
+            checkpoint();
+        if (total.cycles == maxCycles)
+            return total;
+    }
+}
+
+void Timeline::checkpoint() {
+    truncate();
+    std::shared_ptr<const Snapshot> previous = marks.back().snapshot;
+    if (marks.back().cycle == now)
+        marks.pop_back();
+    marks.push_back({now, Snapshot::take(cpu, bus, previous.get())});
+
+    if (marks.size() > maxCheckpoints) {
+        // Keep every second checkpoint and the latest (the Bus's change tracking follows it)
+        size_t kept = 0;
+        for (size_t i = 0; i < marks.size(); ++i)
+            if (i % 2 == 0 || i + 1 == marks.size())
+                marks[kept++] = std::move(marks[i]);
+        marks.resize(kept);
+        interval *= 2;
+    }
+}
+
+void Timeline::truncate() {
+    log.clear();
+    while (marks.size() > 1 && marks.back().cycle > now)
+        marks.pop_back();
+    last = now;
+}
+
+// =============================================================================
+// MOVING THROUGH HISTORY
+// =============================================================================
+
+bool Timeline::seek(uint64_t cycle) {
+    if (cycle > last)
+        return false;
+    if (cycle <= now && undoTo(cycle)) {
+        cpu.resumePastBreakpoint(true);
+        return true;
+    }
+    log.clear();
+    uint64_t from = restoreBefore(cycle);
+    bool ok = replay(cycle - from, nullptr, false) == cycle - from;
+    cpu.resumePastBreakpoint(true);
+    return ok;
+}
+
+bool Timeline::reverseStep() {
+    // HALT is not counted: just before it is the same cycle
+    if (cpu.getState().halted)
+        return seek(now) && !cpu.getState().halted;
+    if (now == 0)
+        return false;
+    uint64_t target = now - 1;
+    if (undoTo(target)) {
+        cpu.resumePastBreakpoint(true);
+        return true;
+    }
+    // Replay up to the target with the log on; further steps back undo from it
+    log.clear();
+    logStart = restoreBefore(target);
+    bool ok = replay(target - logStart, nullptr, true) == target - logStart;
+    cpu.resumePastBreakpoint(true);
+    return ok;
+}
+
+bool Timeline::reverseContinue() {
+    uint64_t limit = now;
+    std::vector<uint64_t> hits;
+    // Search the intervals before limit from the latest back, replaying each once
+    for (size_t i = marks.size(); i-- > 0;) {
+        uint64_t from = marks[i].cycle;
+        if (from >= limit)
+            continue;
+        uint64_t to = i + 1 < marks.size() ? std::min(marks[i + 1].cycle, limit) : limit;
+        marks[i].snapshot->restore(cpu, bus);
+        now = from;
+        cpu.resumePastBreakpoint(false);
+        replay(to - from, &hits, false);
+        if (!hits.empty())
+            return seek(hits.back());
+    }
+    seek(0);
+    return false;
+}
+
+uint64_t Timeline::restoreBefore(uint64_t cycle) {
+    auto it = std::upper_bound(marks.begin(), marks.end(), cycle,
+                               [](uint64_t c, const Checkpoint& m) { return c < m.cycle; });
+    const Checkpoint& m = *(it - 1);    // marks[0] is cycle 0
+    m.snapshot->restore(cpu, bus);
+    now = m.cycle;
+    return now;
+}
+
+uint64_t Timeline::replay(uint64_t count, std::vector<uint64_t>* hits, bool record) {
+    Recorder recorder{log, bus};
+    uint64_t done = 0;
+    while (done < count) {
+        RunResult r = record ? cpu.runFor(recorder, count - done) : cpu.runFor(count - done);
+        done += r.cycles;
+        if (r.reason == StopReason::Breakpoint) {
+            if (hits)
+                hits->push_back(now + done);
+            continue;       // The next run executes the breakpoint instruction
+        }
+        if (r.reason != StopReason::Budget)
+            break;
+    }
+    if (record)
+        log.resize(done);   // A retried LOAD logs a step it did not count
+    now += done;
+    return done;
+}
+
+bool Timeline::undoTo(uint64_t cycle) {
+    if (cycle < logStart || now != logStart + log.size() || cpu.getState().halted)
+        return false;
+    for (size_t i = cycle - logStart; i < log.size(); ++i)
+        if (log[i].kind == DELTA_OPAQUE)
+            return false;
+    CPUState& s = cpu.getState();
+    for (; now > cycle; --now) {
+        const Delta& e = log.back();
+        if (e.kind == DELTA_STORE)
+            bus.write(e.address, e.memory);
+        s.R[e.rd] = e.reg;
+        s.PC = e.pc;
+        s.FLAGS = e.flags;
+        s.flagOp = FlagOp::Materialized;
+        log.pop_back();
+    }
+    return true;
+}
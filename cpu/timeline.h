@@ -0,0 +1,131 @@
+/**
+ * 16-bit GPR CPU Emulator - Time-travel debugging
+ * Records a run as periodic incremental snapshots, so any earlier cycle can
+ * be reached again with one restore plus a short replay, and steps backwards
+ * through a replayed interval with a log of register and memory deltas.
+ */
+
+#ifndef GPR_TIMELINE_H
+#define GPR_TIMELINE_H
+
+#include "gpr_cpu.h"
+#include "snapshot.h"
+#include <memory>
+#include <vector>
+
+/**
+ * Timeline: the history of one CPU + Bus, from construction to the furthest
+ * cycle run through it. Cycles are counted like runFor(): cycle n is the
+ * state after n instructions, before the next one.
+ *
+ * runFor() runs on the CPU's own engine and takes a checkpoint (Snapshot)
+ * every interval cycles; a checkpoint copies only the pages written since the
+ * previous one. seek(), reverseStep() and reverseContinue() restore the last
+ * checkpoint at or before their target and replay from it, at most interval
+ * instructions. reverseStep() replays with a delta log (the PC, FLAGS,
+ * destination register and STORE target before each instruction), so
+ * further steps back through the same interval undo one entry each.
+ *
+ * Replay is exact as long as the guest is deterministic: device accesses are
+ * made again, and device state is not restored. Changes made from outside
+ * (getState(), getMemory(), bus writes) are not recorded; make them at the end
+ * of history and call checkpoint(). With more than maxCheckpoints, every
+ * second checkpoint is dropped and the interval doubles.
+ */
+class Timeline {
+public:
+    /** Record from the current state of cpu and bus (cycle 0). */
+    Timeline(GPRCPU& cpu, Bus& bus, uint64_t interval = uint64_t(1) << 16, size_t maxCheckpoints = 4096);
+
+    Timeline(const Timeline&) = delete;
+    Timeline& operator=(const Timeline&) = delete;
+
+    /**
+     * cpu.runFor(maxCycles), recorded. Starting before the end of history
+     * discards the history after the current cycle first.
+     */
+    RunResult runFor(uint64_t maxCycles);
+
+    /** Start a new checkpoint at the current cycle, discarding any history after it. */
+    void checkpoint();
+
+    /**
+     * Move to cycle (0 .. end()). False if it is past the end, or if the
+     * replay stopped short (a device called stop()); cycle() tells where.
+     */
+    bool seek(uint64_t cycle);
+
+    /**
+     * Move back one instruction: to the cycle before, or from a halted CPU to
+     * just before its HALT. False at the start of history.
+     */
+    bool reverseStep();
+
+    /**
+     * Move back to the latest earlier cycle whose PC is a breakpoint (the
+     * instruction there not yet run). Returns false, at cycle 0, if there is
+     * none.
+     */
+    bool reverseContinue();
+
+    /** Current cycle. */
+    uint64_t cycle() const { return now; }
+
+    /** Furthest cycle recorded. */
+    uint64_t end() const { return last; }
+
+    /** Checkpoints held, and the replay distance between them. */
+    size_t checkpoints() const { return marks.size(); }
+    uint64_t checkpointInterval() const { return interval; }
+
+    /** Delta log entries held (one per instruction of the interval last stepped back through). */
+    size_t deltas() const { return log.size(); }
+
+private:
+    struct Checkpoint {
+        uint64_t cycle;
+        std::shared_ptr<const Snapshot> snapshot;
+    };
+
+    /** State before one instruction: enough to undo it. */
+    struct Delta {
+        uint16_t pc;
+        uint16_t flags;
+        uint16_t reg;        // R[rd]
+        uint16_t address;    // STORE: word written
+        uint16_t memory;     // STORE: its value before
+        uint8_t rd;
+        uint8_t kind;        // DELTA_* (timeline.cpp)
+    };
+
+    struct Recorder;
+
+    GPRCPU& cpu;
+    Bus& bus;
+    uint64_t interval;
+    size_t maxCheckpoints;
+    std::vector<Checkpoint> marks;   // By cycle; marks[0] is cycle 0
+    uint64_t now;
+    uint64_t last;
+    std::vector<Delta> log;          // Deltas of cycles logStart .. logStart + size - 1
+    uint64_t logStart;
+
+    /** Drop the history after now. */
+    void truncate();
+
+    /** Restore the last checkpoint at or before cycle; its cycle. */
+    uint64_t restoreBefore(uint64_t cycle);
+
+    /**
+     * Run count instructions from a restored checkpoint, through breakpoint
+     * stops (appending the cycles they stopped at to hits), recording deltas
+     * if record. Returns the instructions run (count unless a device stopped
+     * the run).
+     */
+    uint64_t replay(uint64_t count, std::vector<uint64_t>* hits, bool record);
+
+    /** Undo the log back to cycle; false (changing nothing) if it does not reach. */
+    bool undoTo(uint64_t cycle);
+};
+
+#endif // GPR_TIMELINE_H
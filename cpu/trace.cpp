@@ -0,0 +1,372 @@
+/**
+ * 16-bit GPR CPU Emulator - Trace policies
+ */
+
+#include "trace.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+// =============================================================================
+// TEXT FORMATTING
+// =============================================================================
+// Hand-rolled: every traced cycle prints ~15 numbers, and iostream
+// manipulators cost more than executing the instruction itself.
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+/** Four hex digits, zero padded. */
+static void appendHex4(std::string& out, uint16_t v) {
+    char buf[4] = {HEX_DIGITS[v >> 12], HEX_DIGITS[(v >> 8) & 0xF],
+                   HEX_DIGITS[(v >> 4) & 0xF], HEX_DIGITS[v & 0xF]};
+    out.append(buf, 4);
+}
+
+/** Hex without padding. */
+static void appendHex(std::string& out, uint16_t v) {
+    int shift = 12;
+    while (shift > 0 && !(v >> shift))
+        shift -= 4;
+    for (; shift >= 0; shift -= 4)
+        out += HEX_DIGITS[(v >> shift) & 0xF];
+}
+
+static void appendDec(std::string& out, unsigned v) {
+    char buf[8];
+    size_t n = 0;
+    do {
+        buf[n++] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n)
+        out += buf[--n];
+}
+
+/** " R<rd>, R<rs>" style register operand. */
+static void appendReg(std::string& out, const char* prefix, unsigned r) {
+    out += prefix;
+    out += static_cast<char>('0' + r);
+}
+
+// =============================================================================
+// TRACE RENDERER
+// =============================================================================
+
+TraceRenderer::TraceRenderer() : R(), flags(0) {}
+
+void TraceRenderer::sync(const uint16_t regs[8], uint16_t f) {
+    std::memcpy(R, regs, sizeof R);
+    flags = f;
+}
+
+void TraceRenderer::render(const TraceRecord& r, std::string& out) {
+    if (r.kind == TraceKind::Sync) {
+        if (r.reg < 8)
+            R[r.reg] = r.value;
+        else
+            flags = r.value;
+        return;
+    }
+
+    // --- State before the instruction ---
+    out += "\n--- Cycle @ PC=0x";
+    appendHex4(out, r.pc);
+    out += " ---\n  Instruction: 0x";
+    appendHex4(out, r.word);
+    out += "\n ";
+    for (unsigned i = 0; i < 8; ++i) {
+        appendReg(out, " R", i);
+        out += '=';
+        appendHex4(out, R[i]);
+    }
+    out += "\n  FLAGS: Z=";
+    out += (flags & FLAG_ZERO) ? '1' : '0';
+    out += " C=";
+    out += (flags & FLAG_CARRY) ? '1' : '0';
+    out += " N=";
+    out += (flags & FLAG_NEGATIVE) ? '1' : '0';
+    out += '\n';
+
+    // --- What it did ---
+    unsigned rd = (r.word >> 9) & 0x7u;
+    unsigned rs = (r.word >> 6) & 0x7u;
+    switch (static_cast<Opcode>((r.word >> 12) & 0xFu)) {
+        case Opcode::HALT:
+            out += "  [EXEC] HALT\n";
+            break;
+        case Opcode::MOVI:
+            appendReg(out, "  [EXEC] MOVI R", rd);
+            out += ", ";
+            appendDec(out, r.word & 0x1FFu);
+            out += '\n';
+            break;
+        case Opcode::MOV:
+            appendReg(out, "  [EXEC] MOV R", rd);
+            appendReg(out, ", R", rs);
+            out += '\n';
+            break;
+        case Opcode::LOAD:
+            appendReg(out, "  [EXEC] LOAD R", rd);
+            appendReg(out, ", (R", rs);
+            appendReg(out, ")  ; R", rd);
+            out += " = mem[0x";
+            appendHex4(out, r.address);
+            out += "] = 0x";
+            appendHex(out, r.value);
+            out += '\n';
+            break;
+        case Opcode::STORE:
+            appendReg(out, "  [EXEC] STORE R", rd);
+            appendReg(out, ", (R", rs);
+            out += ")  ; mem[0x";
+            appendHex4(out, r.address);
+            out += "] = 0x";
+            appendHex(out, r.value);
+            out += '\n';
+            break;
+        case Opcode::ADD:
+        case Opcode::SUB:
+            appendReg(out, (r.word >> 12) == static_cast<unsigned>(Opcode::ADD) ? "  [EXEC] ADD R" : "  [EXEC] SUB R", rd);
+            appendReg(out, ", R", rs);
+            appendReg(out, "  ; R", rd);
+            out += " = 0x";
+            appendHex4(out, R[rd]);
+            out += (r.word >> 12) == static_cast<unsigned>(Opcode::ADD) ? " + 0x" : " - 0x";
+            appendHex(out, R[rs]);
+            out += " = 0x";
+            appendHex(out, r.value);
+            out += '\n';
+            break;
+        case Opcode::AND:
+            appendReg(out, "  [EXEC] AND R", rd);
+            appendReg(out, ", R", rs);
+            out += '\n';
+            break;
+        case Opcode::OR:
+            appendReg(out, "  [EXEC] OR R", rd);
+            appendReg(out, ", R", rs);
+            out += '\n';
+            break;
+        case Opcode::XOR:
+            appendReg(out, "  [EXEC] XOR R", rd);
+            appendReg(out, ", R", rs);
+            out += '\n';
+            break;
+        case Opcode::NOT:
+            appendReg(out, "  [EXEC] NOT R", rd);
+            appendReg(out, ", R", rs);
+            appendReg(out, "  ; R", rd);
+            appendReg(out, " = ~R", rs);
+            out += '\n';
+            break;
+        case Opcode::SHL:
+        case Opcode::SHR:
+            appendReg(out, (r.word >> 12) == static_cast<unsigned>(Opcode::SHL) ? "  [EXEC] SHL R" : "  [EXEC] SHR R", rd);
+            appendReg(out, "  ; R", rd);
+            out += " = 0x";
+            appendHex4(out, R[rd]);
+            out += (r.word >> 12) == static_cast<unsigned>(Opcode::SHL) ? " << 1 = 0x" : " >> 1 = 0x";
+            appendHex(out, r.value);
+            out += '\n';
+            break;
+        case Opcode::JMP:
+            appendReg(out, "  [EXEC] JMP R", rs);
+            out += "  ; PC = 0x";
+            appendHex4(out, R[rs]);
+            out += '\n';
+            break;
+        case Opcode::JZ:
+            appendReg(out, "  [EXEC] JZ R", rs);
+            if (r.flags & FLAG_ZERO) {
+                out += "  ; Z=1, PC = 0x";
+                appendHex4(out, R[rs]);
+                out += '\n';
+            } else {
+                out += "  ; Z=0, no jump\n";
+            }
+            break;
+        case Opcode::NOP:
+        default:
+            // Extended ops leave their literal in Rd, so value is the literal
+            switch (extOp(r.word)) {
+                case ExtOp::MOVW:
+                    appendReg(out, "  [EXEC] MOVW R", rd);
+                    out += ", 0x";
+                    appendHex(out, r.value);
+                    out += '\n';
+                    break;
+                case ExtOp::JMPW:
+                    appendReg(out, "  [EXEC] JMPW R", rd);
+                    out += ", 0x";
+                    appendHex(out, r.value);
+                    out += "  ; PC = 0x";
+                    appendHex4(out, r.value);
+                    out += '\n';
+                    break;
+                case ExtOp::JZW:
+                    appendReg(out, "  [EXEC] JZW R", rd);
+                    out += ", 0x";
+                    appendHex(out, r.value);
+                    out += (r.flags & FLAG_ZERO) ? "  ; Z=1, PC = 0x0000\n" : "  ; Z=0, no jump\n";
+                    break;
+                default:
+                    out += "  [EXEC] NOP\n";
+                    break;
+            }
+            break;
+    }
+
+    R[rd] = r.value;
+    flags = r.flags;
+}
+
+// =============================================================================
+// RECORD CAPTURE (shared by the text and binary policies)
+// =============================================================================
+
+/** Fields known before the instruction runs. */
+static void beginRecord(TraceRecord& r, const CPUState& s, const DecodedOp& d) {
+    r.pc = s.PC;
+    r.word = d.word;
+    r.address = s.R[d.rs];
+    r.reg = d.rd;
+    r.kind = TraceKind::Step;
+}
+
+/** Fields known once it has run. */
+static void finishRecord(TraceRecord& r, const CPUState& s) {
+    r.flags = s.FLAGS;
+    r.value = s.R[r.reg];
+}
+
+// =============================================================================
+// TEXT TRACE
+// =============================================================================
+
+TextTrace::TextTrace() : out(std::cout), pending() {}
+
+TextTrace::TextTrace(std::ostream& out) : out(out), pending() {}
+
+void TextTrace::beforeExecute(const GPRCPU& cpu, const DecodedOp& d) {
+    const CPUState& state = cpu.getState();
+    renderer.sync(state.R, state.FLAGS);
+    beginRecord(pending, state, d);
+}
+
+void TextTrace::afterExecute(const GPRCPU& cpu, const DecodedOp&) {
+    finishRecord(pending, cpu.getState());
+    text.clear();
+    renderer.render(pending, text);
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+// =============================================================================
+// BINARY TRACE
+// =============================================================================
+
+std::unique_ptr<BinaryTrace> BinaryTrace::open(const char* path, size_t capacity) {
+    std::FILE* f = std::fopen(path, "wb");
+    if (!f)
+        return nullptr;
+    TraceFileHeader header;
+    std::memcpy(header.magic, TRACE_MAGIC, sizeof header.magic);
+    header.version = TRACE_VERSION;
+    header.recordSize = sizeof(TraceRecord);
+    if (std::fwrite(&header, sizeof header, 1, f) != 1) {
+        std::fclose(f);
+        return nullptr;
+    }
+    // Round the ring up to a power of two so positions wrap with a mask
+    size_t n = 1;
+    while (n < capacity)
+        n <<= 1;
+    return std::unique_ptr<BinaryTrace>(new BinaryTrace(f, n));
+}
+
+BinaryTrace::BinaryTrace(std::FILE* f, size_t capacity)
+    : file(f), ring(capacity), mask(capacity - 1), tail(0), cachedHead(0),
+      shadow(), shadowFlags(0), synced(false), pending(), head(0),
+      stopping(false), failed(false) {
+    writer = std::thread(&BinaryTrace::writerLoop, this);
+}
+
+BinaryTrace::~BinaryTrace() {
+    close();
+}
+
+bool BinaryTrace::close() {
+    if (writer.joinable()) {
+        stopping.store(true, std::memory_order_release);
+        writer.join();
+    }
+    if (file) {
+        if (std::fclose(file) != 0)
+            failed.store(true, std::memory_order_relaxed);
+        file = nullptr;
+    }
+    return !failed.load(std::memory_order_relaxed);
+}
+
+void BinaryTrace::beforeExecute(const GPRCPU& cpu, const DecodedOp& d) {
+    const CPUState& state = cpu.getState();
+
+    // Registers moved since the last step (first step, reset, debugger):
+    // emit their values so the dump's "before" block stays exact
+    if (!synced || state.FLAGS != shadowFlags || std::memcmp(state.R, shadow, sizeof shadow) != 0) {
+        TraceRecord sync = TraceRecord();
+        sync.kind = TraceKind::Sync;
+        for (uint8_t i = 0; i < 8; ++i) {
+            sync.reg = i;
+            sync.value = state.R[i];
+            push(sync);
+        }
+        sync.reg = 8;
+        sync.value = state.FLAGS;
+        push(sync);
+        synced = true;
+    }
+    beginRecord(pending, state, d);
+}
+
+void BinaryTrace::afterExecute(const GPRCPU& cpu, const DecodedOp&) {
+    const CPUState& state = cpu.getState();
+    finishRecord(pending, state);
+    push(pending);
+    std::memcpy(shadow, state.R, sizeof shadow);
+    shadowFlags = state.FLAGS;
+}
+
+void BinaryTrace::push(const TraceRecord& r) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - cachedHead == ring.size()) {
+        // Full: wait for the writer to free a slot
+        while ((cachedHead = head.load(std::memory_order_acquire)) + ring.size() == t)
+            std::this_thread::yield();
+    }
+    ring[t & mask] = r;
+    tail.store(t + 1, std::memory_order_release);
+}
+
+void BinaryTrace::writerLoop() {
+    size_t h = head.load(std::memory_order_relaxed);
+    for (;;) {
+        bool last = stopping.load(std::memory_order_acquire);
+        size_t t = tail.load(std::memory_order_acquire);
+        if (h == t) {
+            if (last)
+                return;     // Stop was requested after the final push
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            continue;
+        }
+        // Write up to the end of the ring; the wrapped rest goes next round
+        size_t first = h & mask;
+        size_t n = t - h;
+        if (n > ring.size() - first)
+            n = ring.size() - first;
+        if (!failed.load(std::memory_order_relaxed) &&
+            std::fwrite(&ring[first], sizeof(TraceRecord), n, file) != n)
+            failed.store(true, std::memory_order_relaxed);
+        h += n;
+        head.store(h, std::memory_order_release);
+    }
+}
@@ -0,0 +1,173 @@
+/**
+ * 16-bit GPR CPU Emulator - Trace policies
+ * Human-readable per-cycle trace used by GPRCPU::step<Trace>() / run<Trace>(),
+ * and a compact binary trace recorded to a file for gpr_tracedump.
+ */
+
+#ifndef GPR_TRACE_H
+#define GPR_TRACE_H
+
+#include "gpr_cpu.h"
+#include <atomic>
+#include <cstdio>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// =============================================================================
+// BINARY TRACE FORMAT
+// =============================================================================
+//
+// File: TraceFileHeader, then TraceRecord entries in host byte order.
+// A Step record per executed instruction; Sync records (one per register,
+// then FLAGS) precede the first step and any step whose registers or flags
+// were changed from outside the CPU (reset, debugger pokes).
+
+constexpr char TRACE_MAGIC[4] = {'G', 'P', 'R', 'T'};
+constexpr uint16_t TRACE_VERSION = 1;
+
+struct TraceFileHeader {
+    char magic[4];           // TRACE_MAGIC
+    uint16_t version;        // TRACE_VERSION
+    uint16_t recordSize;     // sizeof(TraceRecord)
+};
+
+enum class TraceKind : uint8_t {
+    Step,   // One executed instruction
+    Sync    // Register reg (0-7) or FLAGS (reg == 8) holds value
+};
+
+/** One executed instruction, or one register of a Sync block. */
+struct TraceRecord {
+    uint16_t pc;         // Address of the instruction
+    uint16_t word;       // Instruction word as executed
+    uint16_t flags;      // FLAGS after the instruction
+    uint16_t value;      // R[rd] after the instruction (LOAD: word read, STORE: word written)
+    uint16_t address;    // Memory address for LOAD/STORE (R[rs] before the instruction)
+    uint8_t reg;         // Destination register rd (Sync: register index, 8 = FLAGS)
+    TraceKind kind;
+};
+
+static_assert(sizeof(TraceRecord) == 12, "TraceRecord is a fixed on-disk layout");
+
+/**
+ * TraceRenderer: turns records back into the TextTrace format. Tracks the
+ * register file and flags from Sync records and each step's result, so the
+ * "before" block of every step can be printed from the record stream alone.
+ */
+class TraceRenderer {
+public:
+    TraceRenderer();
+
+    /** Append the text of one record to out (Sync records only update state). */
+    void render(const TraceRecord& r, std::string& out);
+
+    /** Set the state the next step is printed against. */
+    void sync(const uint16_t R[8], uint16_t flags);
+
+private:
+    uint16_t R[8];
+    uint16_t flags;
+};
+
+// =============================================================================
+// COMBINED POLICIES
+// =============================================================================
+
+/** Forwards each hook to two policies, e.g. a trace and a Profiler. */
+template <class First, class Second>
+struct TeeTrace {
+    First& first;
+    Second& second;
+
+    void beforeExecute(const GPRCPU& cpu, const DecodedOp& d) {
+        first.beforeExecute(cpu, d);
+        second.beforeExecute(cpu, d);
+    }
+    void afterExecute(const GPRCPU& cpu, const DecodedOp& d) {
+        first.afterExecute(cpu, d);
+        second.afterExecute(cpu, d);
+    }
+};
+
+// =============================================================================
+// TEXT TRACE
+// =============================================================================
+
+/**
+ * TextTrace: prints PC, instruction, registers and flags before each
+ * instruction, then a one-line description of what it did.
+ */
+class TextTrace {
+public:
+    /** Trace to std::cout. */
+    TextTrace();
+    explicit TextTrace(std::ostream& out);
+
+    void beforeExecute(const GPRCPU& cpu, const DecodedOp& d);
+    void afterExecute(const GPRCPU& cpu, const DecodedOp& d);
+
+private:
+    std::ostream& out;
+    TraceRenderer renderer;
+    std::string text;
+    TraceRecord pending;     // Filled in by beforeExecute, completed after
+};
+
+// =============================================================================
+// BINARY TRACE (ring buffer + background writer)
+// =============================================================================
+
+/**
+ * BinaryTrace: records a TraceRecord per instruction into a single-producer,
+ * single-consumer ring; a background thread drains it to the file in large
+ * writes. The CPU thread never blocks on I/O and only waits if the writer
+ * falls a full ring behind, so no record is dropped.
+ */
+class BinaryTrace {
+public:
+    /** Open path for writing; nullptr if it cannot be created. */
+    static std::unique_ptr<BinaryTrace> open(const char* path, size_t capacity = 1u << 16);
+
+    ~BinaryTrace();
+
+    BinaryTrace(const BinaryTrace&) = delete;
+    BinaryTrace& operator=(const BinaryTrace&) = delete;
+
+    void beforeExecute(const GPRCPU& cpu, const DecodedOp& d);
+    void afterExecute(const GPRCPU& cpu, const DecodedOp& d);
+
+    /** Drain the ring and close the file. False if any write failed. */
+    bool close();
+
+    /** Records produced so far (Sync records included). */
+    uint64_t records() const { return tail.load(std::memory_order_relaxed); }
+
+private:
+    BinaryTrace(std::FILE* file, size_t capacity);
+
+    void push(const TraceRecord& r);
+    void writerLoop();
+
+    std::FILE* file;
+    std::vector<TraceRecord> ring;
+    size_t mask;
+
+    // Producer side (CPU thread)
+    alignas(64) std::atomic<size_t> tail;
+    size_t cachedHead;       // Last head seen, so most pushes skip reading it
+    uint16_t shadow[8];      // Registers after the last recorded step
+    uint16_t shadowFlags;
+    bool synced;
+    TraceRecord pending;
+
+    // Consumer side (writer thread)
+    alignas(64) std::atomic<size_t> head;
+    std::atomic<bool> stopping;
+    std::atomic<bool> failed;
+    std::thread writer;
+};
+
+#endif // GPR_TRACE_H
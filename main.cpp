@@ -1,35 +1,98 @@
 /**
  * 16-bit GPR CPU Emulator - Load and run .asm programs
  *
- * Usage: gpr_emulator [program.asm]
+ * Usage: gpr_emulator [program.asm | program.gpri]
  * If no file given, runs program.asm in current directory.
  * Trace is enabled by default.
+ *
+ * Headless mode (any option below; no prompts, trace off unless --trace):
+ *   gpr_emulator [options] program.asm
+ *     --headless           Headless run with the defaults below
+ *     --set ADDR=VALUE     Preload a memory word before every run (repeatable)
+ *     --budget N           Stop after N cycles (result reports halted=0)
+ *     --format F           text (default), csv or json (one JSON object per line)
+ *     --input FILE         Stream operand sets, one run per line ("-" = stdin)
+ *     --operands A,B,...   Addresses the values of each input line go to (default 0x100,0x101)
+ *     --output A,B,...     Memory words reported per run (default 0x102)
+ *     --engine E           interp (default), threaded or jit
+ *     --dma PAGE           Map the block-transfer device (cpu/dma.h) on page PAGE (0..255)
+ *     --trace              Print the per-cycle trace
+ *     --trace-file PATH    Record a binary trace of every run (see gpr_tracedump)
+ *     --profile PATH       Count instructions over all runs; write a hot-spot report ("-" = stderr)
+ *     --metrics PATH       Write counters (runs, invalidations, device accesses, assembler time)
+ *                          in the Prometheus text format after the runs ("-" = stderr)
+ *     --host-counters      Count host cycles, instructions, branch and L1I/L1D misses around the
+ *                          runs; report them per guest instruction (in the profile, else on stderr)
+ *   Numbers are decimal or 0x-prefixed hex. Input lines hold values separated
+ *   by spaces or commas; blank lines and lines starting with '#' are skipped.
  */
 
 #include "gpr_cpu.h"
 #include "assembler.h"
+#include "trace.h"
+#include "program_image.h"
+#include "profile_report.h"
+#include "host_counters.h"
+#include "dma.h"
+#include "metrics_report.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <string>
+#include <type_traits>
 #include <iostream>
 #include <iomanip>
+#include <vector>
 
 static void printTraceHeader() {
     std::cout << "\n  PC    | R0    R1    R2    R3    R4    R5    R6    R7    | Z C N | Instruction\n";
     std::cout << "--------+--------------------------------------------------+-------+----------------\n";
 }
 
-int main(int argc, char** argv) {
-    const char* asmPath = "addition.asm";
-    if (argc >= 2)
-        asmPath = argv[1];
-
-    Bus bus;
-    GPRCPU cpu(bus);
+/**
+ * Program memory from a .asm file or a binary image (gpr_asm output, mapped
+ * in place). nullptr after printing the error. If info is given it receives
+ * the labels (and, for .asm files, the source line of each word).
+ */
+static std::shared_ptr<const MemoryImage> loadProgram(const char* path, uint16_t& entry,
+                                                      AssembleInfo* info = nullptr) {
+    entry = 0;
+    if (ProgramImage::isImage(path)) {
+        std::string error;
+        std::shared_ptr<const ProgramImage> program = ProgramImage::open(path, error);
+        if (!program) {
+            std::cerr << path << ": " << error << "\n";
+            return nullptr;
+        }
+        entry = program->entry();
+        if (info) {
+            info->segments = program->segments();
+            info->symbols = program->symbols();
+        }
+        return program->memory();
+    }
 
-    AssembleResult ar = assembleFile(asmPath, bus.getMemory(), MEMORY_SIZE);
+    std::vector<uint16_t> words(MEMORY_SIZE);
+    AssembleResult ar = assembleFile(path, words.data(), MEMORY_SIZE, info);
     if (!ar.ok) {
         std::cerr << "Assembly error at line " << ar.lineNum << ": " << ar.error << "\n";
-        return 1;
+        return nullptr;
     }
+    return MemoryImage::copyOf(words.data());
+}
+
+// =============================================================================
+// INTERACTIVE MODE
+// =============================================================================
+
+static int runInteractive(const char* asmPath) {
+    uint16_t entry;
+    std::shared_ptr<const MemoryImage> program = loadProgram(asmPath, entry);
+    if (!program)
+        return 1;
+    Bus bus(program);
+    GPRCPU cpu(bus);
+    cpu.getState().PC = entry;
 
     // Optional: place operands at 0x100 and 0x101 for math programs
     std::cout << "Operand A at 0x100 (decimal or 0x...): ";
@@ -53,9 +116,7 @@ int main(int argc, char** argv) {
     std::cout << "Program: " << asmPath << "\n";
     printTraceHeader();
 
-    size_t cycles = 0;
-    while (cpu.step())
-        cycles++;
+    size_t cycles = cpu.run();
 
     std::cout << "\n--- HALTED ---\n";
     std::cout << "Total cycles: " << cycles << "\n";
@@ -65,3 +126,508 @@ int main(int argc, char** argv) {
 
     return 0;
 }
+
+// =============================================================================
+// HEADLESS MODE: OPTIONS
+// =============================================================================
+
+enum class OutputFormat { Text, Csv, Json };
+
+struct HeadlessOptions {
+    std::vector<std::pair<uint16_t, uint16_t>> sets;
+    uint64_t budget = UINT64_MAX;
+    OutputFormat format = OutputFormat::Text;
+    const char* inputPath = nullptr;
+    std::vector<uint16_t> operands = {0x100, 0x101};
+    std::vector<uint16_t> outputs = {0x102};
+    Engine engine = Engine::Interpreter;
+    int dmaPage = -1;       // -1 = no DMA device
+    bool trace = false;
+    bool hostCounters = false;
+    const char* traceFile = nullptr;
+    const char* profileFile = nullptr;
+    const char* metricsFile = nullptr;
+};
+
+/** Parse a decimal or 0x-prefixed word. False if s is not a number in 0..0xFFFF. */
+static bool parseWord(const char* s, size_t len, uint16_t& out) {
+    std::string text(s, len);
+    char* end = nullptr;
+    unsigned long v = std::strtoul(text.c_str(), &end, 0);
+    if (text.empty() || *end != '\0' || v > 0xFFFFu || text[0] == '-')
+        return false;
+    out = static_cast<uint16_t>(v);
+    return true;
+}
+
+/** Parse "A,B,..." into words. */
+static bool parseWordList(const std::string& s, std::vector<uint16_t>& out) {
+    out.clear();
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t comma = s.find(',', pos);
+        if (comma == std::string::npos)
+            comma = s.size();
+        uint16_t w;
+        if (!parseWord(s.data() + pos, comma - pos, w))
+            return false;
+        out.push_back(w);
+        pos = comma + 1;
+    }
+    return !out.empty();
+}
+
+static const char HEADLESS_USAGE[] =
+    "Usage: gpr_emulator [options] program.asm|program.gpri\n"
+    "  --headless  --trace  --host-counters\n"
+    "  --set ADDR=VALUE  --budget N  --format text|csv|json  --input FILE\n"
+    "  --operands A,B,...  --output A,B,...  --engine interp|threaded|jit  --dma PAGE\n"
+    "  --trace-file PATH  --profile PATH  --metrics PATH\n";
+
+/** Options followed by a value. */
+static bool takesValue(const std::string& arg) {
+    static const char* const OPTIONS[] = {"--set", "--budget", "--format", "--input", "--operands", "--output",
+                                          "--engine", "--dma", "--trace-file", "--profile", "--metrics"};
+    for (const char* option : OPTIONS)
+        if (arg == option)
+            return true;
+    return false;
+}
+
+/**
+ * Parse headless options; returns false with a message on a bad option.
+ * asmPath receives the positional program argument, if any.
+ */
+static bool parseHeadless(int argc, char** argv, HeadlessOptions& o, const char*& asmPath) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--headless") {
+            continue;
+        } else if (arg == "--trace") {
+            o.trace = true;
+        } else if (arg == "--host-counters") {
+            o.hostCounters = true;
+        } else if (arg[0] != '-' || arg == "-") {
+            asmPath = argv[i];
+        } else if (!takesValue(arg)) {
+            std::cerr << "Unknown option " << arg << "\n" << HEADLESS_USAGE;
+            return false;
+        } else if (!hasValue) {
+            std::cerr << "Option " << arg << " requires a value\n";
+            return false;
+        } else {
+            std::string value = argv[++i];
+            if (arg == "--set") {
+                size_t eq = value.find('=');
+                uint16_t addr, word;
+                if (eq == std::string::npos || !parseWord(value.data(), eq, addr) ||
+                    !parseWord(value.data() + eq + 1, value.size() - eq - 1, word)) {
+                    std::cerr << "--set expects ADDR=VALUE, got " << value << "\n";
+                    return false;
+                }
+                o.sets.push_back({addr, word});
+            } else if (arg == "--budget") {
+                char* end = nullptr;
+                o.budget = std::strtoull(value.c_str(), &end, 0);
+                if (value.empty() || *end != '\0') {
+                    std::cerr << "--budget expects a cycle count, got " << value << "\n";
+                    return false;
+                }
+            } else if (arg == "--format") {
+                if (value == "text") o.format = OutputFormat::Text;
+                else if (value == "csv") o.format = OutputFormat::Csv;
+                else if (value == "json") o.format = OutputFormat::Json;
+                else {
+                    std::cerr << "--format expects text, csv or json, got " << value << "\n";
+                    return false;
+                }
+            } else if (arg == "--input") {
+                o.inputPath = argv[i];
+            } else if (arg == "--trace-file") {
+                o.traceFile = argv[i];
+            } else if (arg == "--profile") {
+                o.profileFile = argv[i];
+            } else if (arg == "--metrics") {
+                o.metricsFile = argv[i];
+            } else if (arg == "--operands" || arg == "--output") {
+                if (!parseWordList(value, arg == "--operands" ? o.operands : o.outputs)) {
+                    std::cerr << arg << " expects a comma-separated address list, got " << value << "\n";
+                    return false;
+                }
+            } else if (arg == "--engine") {
+                if (value == "interp") o.engine = Engine::Interpreter;
+                else if (value == "threaded") o.engine = Engine::Threaded;
+                else if (value == "jit") o.engine = Engine::Jit;
+                else {
+                    std::cerr << "--engine expects interp, threaded or jit, got " << value << "\n";
+                    return false;
+                }
+            } else if (arg == "--dma") {
+                uint16_t page;
+                if (!parseWord(value.data(), value.size(), page) || page >= PAGE_COUNT) {
+                    std::cerr << "--dma expects a page number 0..255, got " << value << "\n";
+                    return false;
+                }
+                o.dmaPage = page;
+            } else {
+                std::cerr << "Unknown option " << arg << "\n" << HEADLESS_USAGE;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// =============================================================================
+// HEADLESS MODE: OUTPUT
+// =============================================================================
+// Records are formatted by hand into one buffer that is written in large
+// chunks; no per-value stream formatting.
+
+static void appendDec(std::string& out, uint64_t v) {
+    char buf[20];
+    size_t n = 0;
+    do {
+        buf[n++] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n)
+        out += buf[--n];
+}
+
+static void appendHex4(std::string& out, uint16_t v) {
+    static const char DIGITS[] = "0123456789abcdef";
+    out += "0x";
+    for (int shift = 12; shift >= 0; shift -= 4)
+        out += DIGITS[(v >> shift) & 0xF];
+}
+
+static void appendHeader(std::string& out, const HeadlessOptions& o) {
+    if (o.format != OutputFormat::Csv)
+        return;
+    out += "run,cycles,halted,PC,FLAGS,R0,R1,R2,R3,R4,R5,R6,R7";
+    for (uint16_t a : o.outputs) {
+        out += ",mem_";
+        appendHex4(out, a);
+    }
+    out += '\n';
+}
+
+static void appendRecord(std::string& out, const HeadlessOptions& o, uint64_t run, uint64_t cycles,
+                         const CPUState& s, const Bus& bus) {
+    switch (o.format) {
+        case OutputFormat::Text:
+            out += "run=";
+            appendDec(out, run);
+            out += " cycles=";
+            appendDec(out, cycles);
+            out += s.halted ? " halted=1 PC=" : " halted=0 PC=";
+            appendHex4(out, s.PC);
+            out += " FLAGS=";
+            appendHex4(out, s.FLAGS);
+            for (unsigned r = 0; r < 8; ++r) {
+                out += " R";
+                out += static_cast<char>('0' + r);
+                out += '=';
+                appendHex4(out, s.R[r]);
+            }
+            for (uint16_t a : o.outputs) {
+                out += " [";
+                appendHex4(out, a);
+                out += "]=";
+                appendHex4(out, bus.read(a));
+            }
+            break;
+
+        case OutputFormat::Csv:
+            appendDec(out, run);
+            out += ',';
+            appendDec(out, cycles);
+            out += s.halted ? ",1," : ",0,";
+            appendDec(out, s.PC);
+            out += ',';
+            appendDec(out, s.FLAGS);
+            for (unsigned r = 0; r < 8; ++r) {
+                out += ',';
+                appendDec(out, s.R[r]);
+            }
+            for (uint16_t a : o.outputs) {
+                out += ',';
+                appendDec(out, bus.read(a));
+            }
+            break;
+
+        case OutputFormat::Json:
+            out += "{\"run\":";
+            appendDec(out, run);
+            out += ",\"cycles\":";
+            appendDec(out, cycles);
+            out += s.halted ? ",\"halted\":true,\"pc\":" : ",\"halted\":false,\"pc\":";
+            appendDec(out, s.PC);
+            out += ",\"flags\":";
+            appendDec(out, s.FLAGS);
+            out += ",\"r\":[";
+            for (unsigned r = 0; r < 8; ++r) {
+                if (r)
+                    out += ',';
+                appendDec(out, s.R[r]);
+            }
+            out += "],\"mem\":{";
+            for (size_t i = 0; i < o.outputs.size(); ++i) {
+                if (i)
+                    out += ',';
+                out += '"';
+                appendHex4(out, o.outputs[i]);
+                out += "\":";
+                appendDec(out, bus.read(o.outputs[i]));
+            }
+            out += "}}";
+            break;
+    }
+    out += '\n';
+}
+
+/** Write buffered output once it grows past this many bytes. */
+constexpr size_t OUTPUT_CHUNK = 64u << 10;
+
+static void flushOutput(std::string& out) {
+    std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+    out.clear();
+}
+
+// =============================================================================
+// HEADLESS MODE: RUN
+// =============================================================================
+
+/** Split an input line into operand values. False on a malformed value. */
+static bool parseInputLine(const std::string& line, std::vector<uint16_t>& values) {
+    values.clear();
+    size_t pos = 0;
+    while (pos < line.size()) {
+        while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t' || line[pos] == ',' || line[pos] == '\r'))
+            ++pos;
+        size_t start = pos;
+        while (pos < line.size() && line[pos] != ' ' && line[pos] != '\t' && line[pos] != ',' && line[pos] != '\r')
+            ++pos;
+        if (pos == start)
+            break;
+        uint16_t w;
+        if (!parseWord(line.data() + start, pos - start, w))
+            return false;
+        values.push_back(w);
+    }
+    return true;
+}
+
+/**
+ * Streaming input: one run per non-blank, non-comment line of path ("-" =
+ * stdin). False with a message on an unreadable file or malformed line.
+ */
+template <class RunOnce>
+static bool runInput(const char* path, const HeadlessOptions& o, RunOnce& runOnce) {
+    std::ifstream file;
+    std::istream* in = &std::cin;
+    if (std::strcmp(path, "-") != 0) {
+        file.open(path);
+        if (!file) {
+            std::cerr << "Cannot open input " << path << "\n";
+            return false;
+        }
+        in = &file;
+    }
+
+    std::string line;
+    std::vector<uint16_t> values;
+    uint64_t run = 0;
+    size_t lineNum = 0;
+    while (std::getline(*in, line)) {
+        ++lineNum;
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+        if (!parseInputLine(line, values) || values.size() > o.operands.size()) {
+            std::cerr << "Input line " << lineNum << ": expected up to " << o.operands.size()
+                      << " values, got \"" << line << "\"\n";
+            return false;
+        }
+        runOnce(run++, values);
+    }
+    return true;
+}
+
+/**
+ * Write the profile report for the program at asmPath to path ("-" = stderr),
+ * followed by hostReport if not empty.
+ */
+static bool writeProfile(const char* path, const Profiler& profiler, const AssembleInfo& info,
+                         const char* asmPath, const std::string& hostReport) {
+    std::string source;
+    if (!ProgramImage::isImage(asmPath)) {
+        std::ifstream in(asmPath, std::ios::binary);
+        source.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    std::string report;
+    writeProfileReport(report, profiler, info, source);
+    if (!hostReport.empty())
+        report += "\n" + hostReport;
+    if (std::strcmp(path, "-") == 0) {
+        std::cerr << report;
+        return true;
+    }
+    std::ofstream out(path, std::ios::binary);
+    out << report;
+    return static_cast<bool>(out);
+}
+
+/** Write scrapeMetrics() in the Prometheus text format to path ("-" = stderr). */
+static bool writeMetrics(const char* path) {
+    std::string text;
+    writePrometheusMetrics(text, scrapeMetrics());
+    if (std::strcmp(path, "-") == 0) {
+        std::cerr << text;
+        return true;
+    }
+    std::ofstream out(path, std::ios::binary);
+    out << text;
+    return static_cast<bool>(out);
+}
+
+static int runHeadless(const char* asmPath, const HeadlessOptions& o) {
+    std::ios::sync_with_stdio(false);
+    std::cin.tie(nullptr);
+
+    uint16_t entry;
+    AssembleInfo info;
+    std::shared_ptr<const MemoryImage> program = loadProgram(asmPath, entry, o.profileFile ? &info : nullptr);
+    if (!program)
+        return 1;
+
+    // One Bus over the program image: each run restores only dirtied pages
+    Bus bus(program);
+    GPRCPU cpu(bus, o.engine);
+    cpu.trace(o.trace);
+    DmaDevice dma(bus);
+    if (o.dmaPage >= 0)
+        bus.mapDevice(static_cast<size_t>(o.dmaPage), 1, &dma);
+
+    std::unique_ptr<BinaryTrace> recorder;
+    if (o.traceFile) {
+        recorder = BinaryTrace::open(o.traceFile);
+        if (!recorder) {
+            std::cerr << "Cannot create trace file " << o.traceFile << "\n";
+            return 1;
+        }
+    }
+
+    // Counts accumulate over every run
+    std::unique_ptr<Profiler> profiler;
+    if (o.profileFile)
+        profiler.reset(new Profiler());
+
+    // Host counters: summed over the runFor() calls only, not loading or output
+    HostCounters counters;
+    HostSample hostTotal;
+    uint64_t guestTotal = 0;
+    if (o.hostCounters) {
+        std::string error;
+        if (!counters.open(error))
+            std::cerr << "Host counters unavailable: " << error << "\n";
+    }
+
+    std::string out;
+    appendHeader(out, o);
+
+    auto runOnce = [&](uint64_t run, const std::vector<uint16_t>& values) {
+        bus.reset();
+        for (const auto& s : o.sets)
+            bus.write(s.first, s.second);
+        for (size_t i = 0; i < values.size(); ++i)
+            bus.write(o.operands[i], values[i]);
+        cpu.reset();
+        cpu.getState().PC = entry;
+
+        if (o.trace) {
+            flushOutput(out);
+            printTraceHeader();
+        }
+        // --trace prints alongside whichever of the recorder and profiler are on
+        auto runWith = [&](auto& policy) {
+            if (!o.trace)
+                return cpu.runFor(policy, o.budget).cycles;
+            TextTrace text;
+            TeeTrace<TextTrace, std::remove_reference_t<decltype(policy)>> tee{text, policy};
+            return cpu.runFor(tee, o.budget).cycles;
+        };
+        uint64_t cycles;
+        HostSample before = counters.read();
+        if (profiler && recorder) {
+            TeeTrace<BinaryTrace, Profiler> both{*recorder, *profiler};
+            cycles = runWith(both);
+        } else if (profiler) {
+            cycles = runWith(*profiler);
+        } else if (recorder) {
+            cycles = runWith(*recorder);
+        } else {
+            cycles = cpu.runFor(o.budget).cycles;     // Text trace if --trace
+        }
+        if (counters.isOpen()) {
+            hostTotal += counters.read() - before;
+            guestTotal += cycles;
+        }
+        appendRecord(out, o, run, cycles, cpu.getState(), bus);
+        if (out.size() >= OUTPUT_CHUNK)
+            flushOutput(out);
+    };
+
+    if (!o.inputPath) {
+        runOnce(0, std::vector<uint16_t>());
+    } else if (!runInput(o.inputPath, o, runOnce)) {
+        flushOutput(out);
+        return 1;
+    }
+    flushOutput(out);
+
+    if (recorder && !recorder->close()) {
+        std::cerr << "Error writing trace file " << o.traceFile << "\n";
+        return 1;
+    }
+    std::string hostReport;
+    if (counters.isOpen())
+        writeHostCounterReport(hostReport, hostTotal, guestTotal);
+    if (!profiler && !hostReport.empty())
+        std::cerr << hostReport;
+    if (profiler && !writeProfile(o.profileFile, *profiler, info, asmPath, hostReport)) {
+        std::cerr << "Error writing profile " << o.profileFile << "\n";
+        return 1;
+    }
+    if (o.metricsFile && !writeMetrics(o.metricsFile)) {
+        std::cerr << "Error writing metrics " << o.metricsFile << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+// =============================================================================
+// ENTRY
+// =============================================================================
+
+int main(int argc, char** argv) {
+    // Any option switches to headless mode; a lone path keeps the interactive run
+    bool headless = false;
+    for (int i = 1; i < argc; ++i)
+        if (argv[i][0] == '-' && argv[i][1] != '\0')
+            headless = true;
+
+    const char* asmPath = "addition.asm";
+    if (!headless) {
+        if (argc >= 2)
+            asmPath = argv[1];
+        return runInteractive(asmPath);
+    }
+
+    HeadlessOptions options;
+    if (!parseHeadless(argc, argv, options, asmPath))
+        return 1;
+    return runHeadless(asmPath, options);
+}
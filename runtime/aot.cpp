@@ -0,0 +1,532 @@
+/**
+ * 16-bit GPR CPU Emulator - Ahead-of-time translation to C++
+ */
+
+#include "aot.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+/** One decoded instruction of the program. */
+struct Instr {
+    uint16_t word;
+    uint16_t literal;   // Extended ops: the second word
+    Opcode op;
+    ExtOp ext;
+    uint8_t rd;
+    uint8_t rs;
+    uint8_t words;
+};
+
+/** An instruction of a block; target is its JMP / JZ destination when known (-1 if not). */
+struct Step {
+    uint16_t address;
+    Instr in;
+    int32_t target;
+};
+
+enum class BlockEnd : uint8_t {
+    Transfer,       // The last step jumps or halts
+    Fallthrough,    // Continues into the block at endAddress
+    Untranslated    // endAddress is not program code
+};
+
+/** From a root to the next root or control transfer. */
+struct Block {
+    uint16_t root;
+    std::vector<Step> steps;
+    BlockEnd end;
+    uint16_t endAddress;
+};
+
+std::string hex(unsigned v) {
+    char buf[8];
+    std::snprintf(buf, sizeof buf, "0x%04X", v & 0xFFFFu);
+    return buf;
+}
+
+std::string label(uint16_t address) {
+    char buf[8];
+    std::snprintf(buf, sizeof buf, "L_%04X", address);
+    return buf;
+}
+
+/**
+ * Translator: finds the code reachable from the entry point, then emits one
+ * labelled block per root: the entry, every static JMP / JZ target, every
+ * JZ fallthrough and every program address a MOVI / MOVW loads.
+ */
+class Translator {
+public:
+    Translator(const uint16_t* mem, const std::vector<AssembleSegment>& segments)
+        : mem(mem), segments(segments), isRoot(MEMORY_SIZE, false), covered(MEMORY_SIZE, false) {}
+
+    /** Walk every block reachable from entry; false if entry is not program code. */
+    bool discover(uint16_t entry);
+
+    void emit(std::string& out, const AotOptions& options, AotResult& result);
+
+private:
+    const uint16_t* mem;
+    const std::vector<AssembleSegment>& segments;
+    std::vector<bool> isRoot;
+    std::vector<uint16_t> pending;      // Roots not walked yet
+    std::vector<Block> blocks;          // In discovery order
+    std::vector<bool> covered;          // Words of translated instructions
+
+    bool inProgram(uint32_t address) const {
+        for (const AssembleSegment& s : segments)
+            if (address >= s.address && address < s.address + s.length)
+                return true;
+        return false;
+    }
+
+    void addRoot(uint16_t address) {
+        if (!isRoot[address]) {
+            isRoot[address] = true;
+            pending.push_back(address);
+        }
+    }
+
+    /**
+     * A program address loaded into a register may be jumped to from another
+     * block (MOVI R3, loop ... JMP R3), where the value is not known: give it
+     * a block so the switch reaches it.
+     */
+    void addressTaken(uint16_t value) {
+        if (inProgram(value))
+            addRoot(value);
+    }
+
+    /** Decode the instruction at address; false if any of its words is not program code. */
+    bool decodeAt(uint16_t address, Instr& in) const;
+
+    /** Follow one block from root, adding the roots it reveals. */
+    Block walk(uint16_t root);
+
+    /** Jump to target: a goto, or through the switch if no block starts there. */
+    std::string jumpTo(uint16_t target, bool& usesDispatch) const;
+
+    void emitBlock(std::string& out, const Block& b, bool& usesHalt, bool& usesFinish, bool& usesDispatch) const;
+};
+
+bool Translator::decodeAt(uint16_t address, Instr& in) const {
+    if (!inProgram(address))
+        return false;
+    in.word = mem[address];
+    in.op = static_cast<Opcode>((in.word >> 12) & 0xFu);
+    in.rd = static_cast<uint8_t>((in.word >> 9) & 0x7u);
+    in.rs = static_cast<uint8_t>((in.word >> 6) & 0x7u);
+    in.ext = extOp(in.word);
+    in.words = static_cast<uint8_t>(instructionWords(in.word));
+    in.literal = 0;
+    if (in.words == 2) {
+        // A literal past 0xFFFF (or outside the program) is left to the interpreter
+        if (address == 0xFFFF || !inProgram(address + 1u))
+            return false;
+        in.literal = mem[address + 1u];
+    }
+    return true;
+}
+
+Block Translator::walk(uint16_t root) {
+    Block b;
+    b.root = root;
+    // Registers holding a value set in this block (MOVI / MOVW), for static jump targets
+    bool known[8] = {};
+    uint16_t value[8] = {};
+    uint16_t pc = root;
+    for (;;) {
+        Instr in;
+        if (!decodeAt(pc, in)) {
+            b.end = BlockEnd::Untranslated;
+            b.endAddress = pc;
+            return b;
+        }
+        for (unsigned w = 0; w < in.words; ++w)
+            covered[static_cast<uint16_t>(pc + w)] = true;
+        Step s = {pc, in, -1};
+        const uint16_t next = static_cast<uint16_t>(pc + in.words);
+        bool ends = false;
+        switch (in.op) {
+            case Opcode::HALT:
+                ends = true;
+                break;
+            case Opcode::MOVI:
+                known[in.rd] = true;
+                value[in.rd] = in.word & 0x1FFu;
+                addressTaken(value[in.rd]);
+                break;
+            case Opcode::MOV:
+                known[in.rd] = known[in.rs];
+                value[in.rd] = value[in.rs];
+                break;
+            case Opcode::STORE:
+                break;
+            case Opcode::JMP:
+            case Opcode::JZ:
+                if (known[in.rs]) {
+                    s.target = value[in.rs];
+                    addRoot(value[in.rs]);
+                }
+                if (in.op == Opcode::JZ)
+                    addRoot(next);
+                ends = true;
+                break;
+            case Opcode::NOP:
+                if (in.ext == ExtOp::NOP)
+                    break;
+                known[in.rd] = true;
+                value[in.rd] = in.literal;
+                addressTaken(in.literal);
+                if (in.ext == ExtOp::JMPW) {
+                    s.target = in.literal;
+                    addRoot(in.literal);
+                    ends = true;
+                } else if (in.ext == ExtOp::JZW && in.literal == 0) {
+                    // Flags come from the literal: only a zero literal is taken (to 0)
+                    s.target = 0;
+                    addRoot(0);
+                    addRoot(next);
+                    ends = true;
+                }
+                break;
+            default:
+                known[in.rd] = false;   // LOAD, ALU
+                break;
+        }
+        b.steps.push_back(s);
+        if (ends) {
+            b.end = BlockEnd::Transfer;
+            b.endAddress = next;
+            return b;
+        }
+        pc = next;
+        if (isRoot[pc]) {
+            b.end = BlockEnd::Fallthrough;
+            b.endAddress = pc;
+            return b;
+        }
+    }
+}
+
+bool Translator::discover(uint16_t entry) {
+    Instr in;
+    if (!decodeAt(entry, in))
+        return false;
+    addRoot(entry);
+    while (!pending.empty()) {
+        uint16_t root = pending.back();
+        pending.pop_back();
+        blocks.push_back(walk(root));
+    }
+    // Roots found after a walk passed them split that walk's block: walk again
+    std::vector<Block> walked;
+    walked.swap(blocks);
+    for (const Block& b : walked)
+        blocks.push_back(walk(b.root));
+    std::sort(blocks.begin(), blocks.end(), [](const Block& x, const Block& y) { return x.root < y.root; });
+    return true;
+}
+
+std::string Translator::jumpTo(uint16_t target, bool& usesDispatch) const {
+    if (isRoot[target])
+        return "goto " + label(target) + ";";
+    usesDispatch = true;
+    return "{ pc = " + hex(target) + "; goto dispatch; }";
+}
+
+void Translator::emitBlock(std::string& out, const Block& b, bool& usesHalt, bool& usesFinish,
+                           bool& usesDispatch) const {
+    out += label(b.root) + ":\n";
+    const size_t need = b.steps.size();     // HALT is not counted but must fit in the budget
+    const size_t count = need && b.steps.back().in.op == Opcode::HALT ? need - 1 : need;
+    if (need) {
+        out += "    if (maxCycles - cycles < " + std::to_string(need) + ") {\n";
+        out += "        pc = " + hex(b.root) + ";\n        goto interpret;\n    }\n";
+        if (count)
+            out += "    cycles += " + std::to_string(count) + ";\n";
+    }
+    for (size_t k = 0; k < b.steps.size(); ++k) {
+        const Step& s = b.steps[k];
+        const Instr& in = s.in;
+        const std::string rd = "R[" + std::to_string(in.rd) + "]";
+        const std::string rs = "R[" + std::to_string(in.rs) + "]";
+        const uint16_t next = static_cast<uint16_t>(s.address + in.words);
+        // Leave before an instruction: it and the rest of the block were not run natively
+        const std::string before = "{\n        cycles -= " + std::to_string(count - k) + ";\n        pc = " +
+                                   hex(s.address) + ";\n        goto interpret;\n    }\n";
+        const std::string result = "    fres = " + rd + ";\n    fop = FlagOp::Result;\n";
+        // Address comment, matching the gpr_asm listing
+        char comment[40];
+        std::snprintf(comment, sizeof comment, "    // %04X: %04X\n", s.address, in.word);
+        out += comment;
+        switch (in.op) {
+            case Opcode::HALT:
+                out += "    pc = " + hex(next) + ";\n    goto halt;\n";
+                usesHalt = true;
+                break;
+            case Opcode::MOVI:
+                out += "    " + rd + " = " + hex(in.word & 0x1FFu) + ";\n" + result;
+                break;
+            case Opcode::MOV:
+                out += "    " + rd + " = " + rs + ";\n" + result;
+                break;
+            case Opcode::LOAD:
+                // Readable pages are RAM: no entry means a device
+                out += "    a = " + rs + ";\n    if (!rt[a >> PAGE_SHIFT]) " + before;
+                out += "    " + rd + " = rt[a >> PAGE_SHIFT][a & (PAGE_WORDS - 1)];\n" + result;
+                break;
+            case Opcode::STORE:
+                out += "    a = " + rs + ";\n    if (wt[a >> PAGE_SHIFT])\n";
+                out += "        wt[a >> PAGE_SHIFT][a & (PAGE_WORDS - 1)] = " + rd + ";\n";
+                out += "    else if (bus.deviceAt(a >> PAGE_SHIFT)) " + before;
+                out += "    else\n        bus.write(a, " + rd + ");\n";
+                out += "    if (inCode(a)) {\n";
+                if (count - k - 1)
+                    out += "        cycles -= " + std::to_string(count - k - 1) + ";\n";
+                out += "        pc = " + hex(next) + ";\n        goto finish;\n    }\n";
+                usesFinish = true;
+                break;
+            case Opcode::ADD:
+            case Opcode::SUB: {
+                const char* sign = in.op == Opcode::ADD ? " + " : " - ";
+                const char* kind = in.op == Opcode::ADD ? "Add" : "Sub";
+                out += "    fopd = " + rd + ";\n    " + rd + " = uint16_t(fopd" + sign + rs + ");\n";
+                out += "    fres = " + rd + ";\n    fop = FlagOp::" + kind + ";\n";
+                break;
+            }
+            case Opcode::AND:
+            case Opcode::OR:
+            case Opcode::XOR: {
+                const char* sign = in.op == Opcode::AND ? " & " : in.op == Opcode::OR ? " | " : " ^ ";
+                out += "    " + rd + " = uint16_t(" + rd + sign + rs + ");\n" + result;
+                break;
+            }
+            case Opcode::NOT:
+                out += "    " + rd + " = uint16_t(~" + rs + ");\n" + result;
+                break;
+            case Opcode::SHL:
+            case Opcode::SHR: {
+                const bool left = in.op == Opcode::SHL;
+                out += "    fopd = " + rd + ";\n    " + rd + " = uint16_t(fopd" + (left ? " << 1" : " >> 1") + ");\n";
+                out += "    fres = " + rd + ";\n    fop = FlagOp::" + (left ? "Shl" : "Shr") + ";\n";
+                break;
+            }
+            case Opcode::JMP:
+                if (s.target >= 0) {
+                    out += "    " + jumpTo(static_cast<uint16_t>(s.target), usesDispatch) + "\n";
+                } else {
+                    out += "    pc = " + rs + ";\n    goto dispatch;\n";
+                    usesDispatch = true;
+                }
+                break;
+            case Opcode::JZ:
+                if (s.target >= 0) {
+                    out += "    if (fres == 0)\n        " + jumpTo(static_cast<uint16_t>(s.target), usesDispatch) + "\n";
+                } else {
+                    out += "    if (fres == 0) {\n        pc = " + rs + ";\n        goto dispatch;\n    }\n";
+                    usesDispatch = true;
+                }
+                out += "    " + jumpTo(next, usesDispatch) + "\n";
+                break;
+            case Opcode::NOP:
+                if (in.ext == ExtOp::NOP)
+                    break;
+                out += "    " + rd + " = " + hex(in.literal) + ";\n" + result;
+                if (in.ext == ExtOp::JMPW) {
+                    out += "    " + jumpTo(in.literal, usesDispatch) + "\n";
+                } else if (s.target >= 0) {
+                    out += "    " + jumpTo(0, usesDispatch) + "     // JZW with literal 0: always taken\n";
+                }
+                break;
+        }
+    }
+    if (b.end == BlockEnd::Fallthrough)
+        out += "    " + jumpTo(b.endAddress, usesDispatch) + "\n";
+    else if (b.end == BlockEnd::Untranslated)
+        out += "    pc = " + hex(b.endAddress) + ";\n    goto interpret;\n";
+    out += "\n";
+}
+
+void Translator::emit(std::string& out, const AotOptions& options, AotResult& result) {
+    bool usesHalt = false, usesFinish = false, usesDispatch = false, usesLoad = false, usesStore = false;
+    std::string body;
+    for (const Block& b : blocks) {
+        emitBlock(body, b, usesHalt, usesFinish, usesDispatch);
+        for (const Step& s : b.steps) {
+            usesLoad |= s.in.op == Opcode::LOAD;
+            usesStore |= s.in.op == Opcode::STORE;
+        }
+        result.instructions += b.steps.size();
+    }
+    result.blocks = blocks.size();
+
+    // Translated words as ranges, for the code check and inCode()
+    std::vector<AotRange> ranges;
+    std::string words;
+    uint32_t offset = 0;
+    for (uint32_t a = 0; a < MEMORY_SIZE;) {
+        if (!covered[a]) {
+            ++a;
+            continue;
+        }
+        AotRange r = {static_cast<uint16_t>(a), 0, offset};
+        for (; a < MEMORY_SIZE && covered[a]; ++a, ++r.count, ++offset)
+            words += (offset % 8 ? " " : "\n    ") + hex(mem[a]) + ",";
+        ranges.push_back(r);
+    }
+
+    out += "// Generated by gpr_aot";
+    if (!options.source.empty())
+        out += " from " + options.source;
+    out += ": do not edit.\n";
+    out += "// " + std::to_string(result.blocks) + " blocks, " + std::to_string(result.instructions) +
+           " instructions. See runtime/aot.h.\n\n";
+    out += "#include \"aot.h\"\n\nnamespace {\n\n";
+    out += "const uint16_t WORDS[] = {" + words + "\n};\n\n";
+    out += "const AotRange RANGES[] = {\n";
+    for (const AotRange& r : ranges)
+        out += "    {" + hex(r.first) + ", " + std::to_string(r.count) + ", " + std::to_string(r.offset) + "},\n";
+    out += "};\n\n";
+
+    if (usesFinish) {
+        out += "/** True if a STORE to a overwrites translated code. */\n";
+        out += "bool inCode(uint16_t a) {\n    return ";
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            out += i ? " ||\n           " : "";
+            out += ranges[i].count == MEMORY_SIZE ? std::string("true")
+                                                  : "uint16_t(a - " + hex(ranges[i].first) + ") < " +
+                                                        std::to_string(ranges[i].count);
+        }
+        out += ";\n}\n\n";
+    }
+
+    // Blocks that start with an instruction (the others only hand over to the interpreter)
+    out += "/** True if pc starts a translated block. */\nbool translated(uint16_t pc) {\n    switch (pc) {\n";
+    for (const Block& b : blocks)
+        if (!b.steps.empty())
+            out += "        case " + hex(b.root) + ":\n";
+    out += "            return true;\n        default:\n            return false;\n    }\n}\n\n";
+
+    out += "void save(CPUState& s, const uint16_t* R, uint16_t pc, uint16_t flags, uint16_t fres, uint16_t fopd,\n"
+           "          FlagOp fop) {\n"
+           "    for (unsigned i = 0; i < 8; ++i)\n        s.R[i] = R[i];\n"
+           "    s.PC = pc;\n    s.FLAGS = flags;\n    s.flagResult = fres;\n    s.flagOperand = fopd;\n"
+           "    s.flagOp = fop;\n}\n\n} // namespace\n\n";
+
+    out += "RunResult " + options.name + "(GPRCPU& cpu, Bus& bus, uint64_t maxCycles) {\n";
+    out += "    if (cpu.hasBreakpoints() || !aotCodeMatches(bus, RANGES, " + std::to_string(ranges.size()) +
+           ", WORDS))\n        return cpu.runFor(maxCycles);\n";
+    out += "    CPUState& s = cpu.getState();\n    RunResult result;\n    uint64_t cycles = 0;\n";
+    out += "    uint16_t R[8], pc, flags, fres, fopd;\n";
+    if (usesLoad)
+        out += "    const uint16_t* const* rt = bus.readTable();\n";
+    if (usesStore)
+        out += "    uint16_t* const* wt = bus.writeTable();\n";
+    if (usesLoad || usesStore)
+        out += "    uint16_t a;\n";
+    out += "    FlagOp fop;\n\n";
+
+    out += "load:\n    s.materializeFlags();\n    if (s.halted)\n        return {cycles, StopReason::Halted};\n"
+           "    for (unsigned i = 0; i < 8; ++i)\n        R[i] = s.R[i];\n"
+           "    pc = s.PC;\n    flags = s.FLAGS;\n"
+           "    fres = (flags & FLAG_ZERO) ? 0 : 1;     // JZ tests fres == 0\n"
+           "    fopd = 0;\n    fop = FlagOp::Materialized;\n\n";
+    out += usesDispatch ? "dispatch:\n" : "";
+    out += "    switch (pc) {\n";
+    for (const Block& b : blocks)
+        if (!b.steps.empty())
+            out += "        case " + hex(b.root) + ": goto " + label(b.root) + ";\n";
+    out += "        default: break;\n    }\n\n";
+    // The interpreter may have stored into translated code: check again before going back
+    out += "interpret:\n    save(s, R, pc, flags, fres, fopd, fop);\n"
+           "    if (aotInterpret(cpu, maxCycles, cycles, translated, result)) {\n"
+           "        if (aotCodeMatches(bus, RANGES, " + std::to_string(ranges.size()) + ", WORDS))\n"
+           "            goto load;\n"
+           "        result = cpu.runFor(maxCycles - cycles);\n        result.cycles += cycles;\n    }\n"
+           "    return result;\n\n";
+    if (usesHalt)
+        out += "halt:\n    save(s, R, pc, flags, fres, fopd, fop);\n    s.halted = true;\n"
+               "    return {cycles, StopReason::Halted};\n\n";
+    if (usesFinish)
+        out += "finish:     // A STORE overwrote translated code\n    save(s, R, pc, flags, fres, fopd, fop);\n"
+               "    result = cpu.runFor(maxCycles - cycles);\n    result.cycles += cycles;\n    return result;\n\n";
+    body.pop_back();    // The blank line after the last block
+    out += body;
+    out += "}\n";
+}
+
+bool validName(const std::string& name) {
+    if (name.empty() || (name[0] >= '0' && name[0] <= '9'))
+        return false;
+    for (char c : name)
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'))
+            return false;
+    return true;
+}
+
+} // namespace
+
+AotResult translateToCpp(const uint16_t* mem, const std::vector<AssembleSegment>& segments,
+                         std::string& out, const AotOptions& options) {
+    AotResult result = {false, "", 0, 0};
+    if (!validName(options.name)) {
+        result.error = "Invalid function name: " + options.name;
+        return result;
+    }
+    Translator t(mem, segments);
+    if (!t.discover(options.entry)) {
+        result.error = "No code at entry point " + hex(options.entry);
+        return result;
+    }
+    t.emit(out, options, result);
+    result.ok = true;
+    return result;
+}
+
+// =============================================================================
+// RUNTIME SUPPORT
+// =============================================================================
+
+bool aotCodeMatches(const Bus& bus, const AotRange* ranges, size_t rangeCount, const uint16_t* words) {
+    const uint16_t* const* pages = bus.readTable();
+    for (size_t i = 0; i < rangeCount; ++i) {
+        // One page run at a time; code in a device page never matches (reading it is an access)
+        const uint16_t* expected = words + ranges[i].offset;
+        for (uint32_t a = ranges[i].first, left = ranges[i].count; left;) {
+            const uint16_t* page = pages[a >> PAGE_SHIFT];
+            uint32_t at = a & (PAGE_WORDS - 1);
+            uint32_t n = std::min<uint32_t>(left, PAGE_WORDS - at);
+            if (!page || std::memcmp(page + at, expected, n * sizeof(uint16_t)) != 0)
+                return false;
+            a = (a + n) & 0xFFFFu;
+            expected += n;
+            left -= n;
+        }
+    }
+    return true;
+}
+
+bool aotInterpret(GPRCPU& cpu, uint64_t maxCycles, uint64_t& cycles, bool (*translated)(uint16_t),
+                  RunResult& result) {
+    for (unsigned n = 0; n < AOT_STEP_LIMIT; ++n) {
+        if (cycles == maxCycles) {
+            result = {cycles, cpu.getState().halted ? StopReason::Halted : StopReason::Budget};
+            return false;
+        }
+        RunResult r = cpu.runFor(1);
+        cycles += r.cycles;
+        if (r.reason != StopReason::Budget) {
+            result = {cycles, r.reason};
+            return false;
+        }
+        if (translated(cpu.getPC()))
+            return true;
+    }
+    result = cpu.runFor(maxCycles - cycles);
+    result.cycles += cycles;
+    return false;
+}
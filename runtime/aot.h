@@ -0,0 +1,94 @@
+/**
+ * 16-bit GPR CPU Emulator - Ahead-of-time translation
+ * Turns an assembled program into C++ source for one function that runs it
+ * natively, to be compiled into the host binary (gpr_aot is the front end).
+ * Also the runtime support the generated code calls.
+ */
+
+#ifndef GPR_AOT_H
+#define GPR_AOT_H
+
+#include "gpr_cpu.h"
+#include "assembler.h"
+#include <string>
+#include <vector>
+
+// =============================================================================
+// TRANSLATOR
+// =============================================================================
+
+/** Options for translateToCpp(). */
+struct AotOptions {
+    std::string name = "aot_program";   // Function name (a C++ identifier)
+    std::string source;                 // Program name for the header comment
+    uint16_t entry = 0;                 // Where execution starts
+};
+
+struct AotResult {
+    bool ok;
+    std::string error;
+    size_t blocks;          // Translated basic blocks
+    size_t instructions;    // Translated instructions
+};
+
+/**
+ * Append C++ source to out defining
+ *
+ *     RunResult name(GPRCPU& cpu, Bus& bus, uint64_t maxCycles);
+ *
+ * which behaves like cpu.runFor(maxCycles) for the program in mem (bus must
+ * be cpu's Bus). Code is found by following control flow from the entry
+ * point through the words of segments. JMP / JZ targets loaded by a MOVI
+ * or MOVW in the same block, and JMPW / JZW, become gotos. Other JMP / JZ
+ * targets go through a switch over the translated blocks, which also start
+ * at every program address a MOVI or MOVW loads.
+ *
+ * Registers and lazy flags live in locals, and the budget is checked once
+ * per block. The generated function falls back to the interpreter in these
+ * cases:
+ * - breakpoints are set, or the translated words differ in bus memory
+ *   (checked on entry and whenever the interpreter hands back): the whole
+ *   call, or the rest of it;
+ * - a jump to an untranslated address: stepping until a block is reached;
+ * - a LOAD or STORE to a device page: the access and what follows, up to
+ *   the next block;
+ * - a block that does not fit in the budget: the same as device accesses;
+ * - a STORE into translated code: the rest of the call.
+ * Instructions run natively are not counted in GPRCPU::getMetrics().
+ */
+AotResult translateToCpp(const uint16_t* mem, const std::vector<AssembleSegment>& segments,
+                         std::string& out, const AotOptions& options = AotOptions());
+
+/** Signature of a translated program. */
+using AotFunction = RunResult (*)(GPRCPU& cpu, Bus& bus, uint64_t maxCycles);
+
+// =============================================================================
+// RUNTIME SUPPORT (called by generated code)
+// =============================================================================
+
+/** Words the translation was made from: WORDS[offset .. offset + count) at first. */
+struct AotRange {
+    uint16_t first;
+    uint32_t count;
+    uint32_t offset;
+};
+
+/**
+ * True if bus holds words at every range (the translation still applies).
+ * False if a range is on a device page, which is never read.
+ */
+bool aotCodeMatches(const Bus& bus, const AotRange* ranges, size_t rangeCount, const uint16_t* words);
+
+/** Interpreted instructions aotInterpret() runs looking for a block before it runs the rest. */
+constexpr unsigned AOT_STEP_LIMIT = 64;
+
+/**
+ * Continue a run from cpu's state in the interpreter, one instruction at a
+ * time, until PC is translated (true) or the run is over (false, with
+ * result). After AOT_STEP_LIMIT instructions, the rest of the budget runs
+ * in the interpreter. cycles counts the instructions run so far.
+ */
+bool aotInterpret(GPRCPU& cpu, uint64_t maxCycles, uint64_t& cycles, bool (*translated)(uint16_t),
+                  RunResult& result);
+
+#endif // GPR_AOT_H
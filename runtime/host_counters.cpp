@@ -0,0 +1,179 @@
+/**
+ * 16-bit GPR CPU Emulator - Host performance counters
+ */
+
+#include "host_counters.h"
+#include <cstdio>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace {
+
+const char* const EVENT_NAMES[HOST_EVENT_COUNT] = {
+    "cycles", "instructions", "branch-misses", "L1I-misses", "L1D-misses"
+};
+
+#if defined(__linux__)
+
+/** perf type / config of each HostEvent. */
+struct EventCode {
+    uint32_t type;
+    uint64_t config;
+};
+
+constexpr uint64_t cacheReadMiss(uint64_t cache) {
+    return cache | (uint64_t(PERF_COUNT_HW_CACHE_OP_READ) << 8) | (uint64_t(PERF_COUNT_HW_CACHE_RESULT_MISS) << 16);
+}
+
+const EventCode EVENT_CODES[HOST_EVENT_COUNT] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_L1I)},
+    {PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_L1D)},
+};
+
+int openEvent(HostEvent e, int group) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.type = EVENT_CODES[static_cast<size_t>(e)].type;
+    attr.config = EVENT_CODES[static_cast<size_t>(e)].config;
+    attr.disabled = group < 0;      // The leader enables the whole group
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // This thread, any CPU
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, group, 0));
+}
+
+#endif
+
+} // namespace
+
+const char* hostEventName(HostEvent e) {
+    return EVENT_NAMES[static_cast<size_t>(e)];
+}
+
+HostSample HostSample::operator-(const HostSample& before) const {
+    HostSample d;
+    for (size_t i = 0; i < HOST_EVENT_COUNT; ++i)
+        d.values[i] = values[i] - before.values[i];
+    d.valid = valid & before.valid;
+    d.enabled = enabled - before.enabled;
+    d.running = running - before.running;
+    return d;
+}
+
+HostSample& HostSample::operator+=(const HostSample& other) {
+    for (size_t i = 0; i < HOST_EVENT_COUNT; ++i)
+        values[i] += other.values[i];
+    valid = enabled ? valid & other.valid : other.valid;
+    enabled += other.enabled;
+    running += other.running;
+    return *this;
+}
+
+HostCounters::~HostCounters() {
+#if defined(__linux__)
+    for (size_t i = 0; i < members; ++i)
+        close(fds[i]);
+#endif
+}
+
+bool HostCounters::open(std::string& error) {
+#if defined(__linux__)
+    if (isOpen())
+        return true;
+    leader = openEvent(HostEvent::Cycles, -1);
+    if (leader < 0) {
+        int err = errno;
+        error = std::string("perf_event_open(cycles): ") + std::strerror(err);
+        if (err == EACCES || err == EPERM)
+            error += " (see /proc/sys/kernel/perf_event_paranoid)";
+        else if (err == ENOENT || err == EOPNOTSUPP || err == ENODEV)
+            error += " (no hardware counters on this host)";
+        return false;
+    }
+    fds[0] = leader;
+    order[0] = HostEvent::Cycles;
+    members = 1;
+    for (size_t i = 1; i < HOST_EVENT_COUNT; ++i) {
+        HostEvent e = static_cast<HostEvent>(i);
+        int fd = openEvent(e, leader);
+        if (fd < 0)
+            continue;       // Not on this host: leave it out
+        fds[members] = fd;
+        order[members++] = e;
+    }
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+#else
+    error = "host counters need Linux perf_event_open";
+    return false;
+#endif
+}
+
+HostSample HostCounters::read() const {
+    HostSample s;
+#if defined(__linux__)
+    if (!isOpen())
+        return s;
+    // { nr, time_enabled, time_running, value[nr] }
+    uint64_t buf[3 + HOST_EVENT_COUNT];
+    ssize_t n = ::read(leader, buf, sizeof buf);
+    if (n < static_cast<ssize_t>(3 * sizeof(uint64_t)) || buf[0] != members)
+        return s;
+    s.enabled = buf[1];
+    s.running = buf[2];
+    if (s.running == 0)
+        return s;           // Never scheduled onto the PMU: nothing valid
+    for (size_t i = 0; i < members; ++i) {
+        uint64_t v = buf[3 + i];
+        if (s.running < s.enabled)
+            v = static_cast<uint64_t>(static_cast<double>(v) * s.enabled / s.running);
+        size_t e = static_cast<size_t>(order[i]);
+        s.values[e] = v;
+        s.valid |= 1u << e;
+    }
+#endif
+    return s;
+}
+
+void writeHostCounterReport(std::string& out, const HostSample& sample, uint64_t guestInstructions) {
+    char buf[128];
+    std::snprintf(buf, sizeof buf, "Host counters per guest instruction (%llu instructions):\n",
+                  static_cast<unsigned long long>(guestInstructions));
+    out += buf;
+    if (!sample.valid || !guestInstructions) {
+        out += "  (nothing counted)\n";
+        return;
+    }
+    double n = static_cast<double>(guestInstructions);
+    for (size_t i = 0; i < HOST_EVENT_COUNT; ++i) {
+        HostEvent e = static_cast<HostEvent>(i);
+        if (sample.has(e))
+            std::snprintf(buf, sizeof buf, "  %-14s %12.4f\n", hostEventName(e), sample[e] / n);
+        else
+            std::snprintf(buf, sizeof buf, "  %-14s %12s\n", hostEventName(e), "-");
+        out += buf;
+    }
+    if (sample.has(HostEvent::Cycles) && sample.has(HostEvent::Instructions) && sample[HostEvent::Cycles]) {
+        std::snprintf(buf, sizeof buf, "  %-14s %12.4f\n", "host IPC",
+                      static_cast<double>(sample[HostEvent::Instructions]) / sample[HostEvent::Cycles]);
+        out += buf;
+    }
+    if (sample.running < sample.enabled) {
+        std::snprintf(buf, sizeof buf, "  (multiplexed: counted %.1f%% of the time, values scaled)\n",
+                      100.0 * sample.running / sample.enabled);
+        out += buf;
+    }
+}
@@ -0,0 +1,86 @@
+/**
+ * 16-bit GPR CPU Emulator - Host performance counters
+ * Hardware events of the host CPU (Linux perf_event_open) counted around
+ * emulator code, so engines can be compared by where their time goes rather
+ * than by instructions per second alone.
+ */
+
+#ifndef GPR_HOST_COUNTERS_H
+#define GPR_HOST_COUNTERS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+/** Host events counted by HostCounters, in report order. */
+enum class HostEvent : uint8_t {
+    Cycles,
+    Instructions,
+    BranchMisses,
+    L1IMisses,      // L1 instruction cache read misses (front end)
+    L1DMisses,      // L1 data cache read misses
+};
+
+constexpr size_t HOST_EVENT_COUNT = static_cast<size_t>(HostEvent::L1DMisses) + 1;
+
+/** Report name of e ("cycles", "branch-misses", ...). */
+const char* hostEventName(HostEvent e);
+
+/**
+ * Counter totals. Values are scaled up by enabled / running when the kernel
+ * had to multiplex the counters, so they are estimates in that case.
+ */
+struct HostSample {
+    uint64_t values[HOST_EVENT_COUNT] = {};
+    uint32_t valid = 0;         // Bit per HostEvent this host counts
+    uint64_t enabled = 0;       // ns the counters were enabled
+    uint64_t running = 0;       // ns they were actually counting
+
+    bool has(HostEvent e) const { return (valid >> static_cast<unsigned>(e)) & 1; }
+    uint64_t operator[](HostEvent e) const { return values[static_cast<size_t>(e)]; }
+
+    /** Counts between two reads (after - before, same valid set). */
+    HostSample operator-(const HostSample& before) const;
+    HostSample& operator+=(const HostSample& other);
+};
+
+/**
+ * HostCounters: one perf event group for the calling thread, user-space
+ * events only. open() starts counting; read() returns the totals so far and
+ * is a single syscall, so regions are measured as the difference of two
+ * reads. Work done by other threads is not counted.
+ *
+ * Events the host does not support are left out of the group (their valid
+ * bit stays clear); open() fails only if cycles cannot be counted, e.g.
+ * inside most VMs, on non-Linux hosts or with perf_event_paranoid > 2.
+ */
+class HostCounters {
+public:
+    HostCounters() = default;
+    ~HostCounters();
+
+    HostCounters(const HostCounters&) = delete;
+    HostCounters& operator=(const HostCounters&) = delete;
+
+    /** Open and enable the counters; false with the reason in error. */
+    bool open(std::string& error);
+
+    bool isOpen() const { return leader >= 0; }
+
+    /** Totals since open(); an empty sample if not open. */
+    HostSample read() const;
+
+private:
+    int leader = -1;
+    int fds[HOST_EVENT_COUNT] = {-1, -1, -1, -1, -1};
+    HostEvent order[HOST_EVENT_COUNT] = {};     // Event of each group member, in read order
+    size_t members = 0;
+};
+
+/**
+ * Append sample per guest instruction to out: one line per counted event,
+ * then host IPC, and a note if the counts were multiplexed.
+ */
+void writeHostCounterReport(std::string& out, const HostSample& sample, uint64_t guestInstructions);
+
+#endif // GPR_HOST_COUNTERS_H
@@ -0,0 +1,181 @@
+/**
+ * 16-bit GPR CPU Emulator - Instance pool implementation
+ */
+
+#include "instance_pool.h"
+#include <cstring>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define GPR_POOL_MMAP 1
+#endif
+
+// =============================================================================
+// SLOT LAYOUT
+// =============================================================================
+//
+//   Slot (Bus, GPRCPU, free-list link)   rounded up to SLOT_ALIGN
+//   DecodedOp[MEMORY_SIZE]               predecode table (zero = empty)
+//   uint16_t[MEMORY_SIZE]                Bus private-page storage
+//
+// Every slot starts on a SLOT_ALIGN boundary.
+
+/** Slot alignment: one OS page, which is also a whole number of cache lines. */
+constexpr size_t SLOT_ALIGN = 4096;
+
+/** Slab size granularity with options.hugePages. */
+constexpr size_t HUGE_PAGE_BYTES = size_t(2) << 20;
+
+static constexpr size_t roundUp(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+}
+
+struct InstancePool::Slot : Instance {
+    Slot* next;     // Free list
+
+    Slot(Engine engine, uint16_t* memory, DecodedOp* decoded)
+        : Instance(engine, memory, decoded), next(nullptr) {}
+};
+
+constexpr size_t DECODE_BYTES = MEMORY_SIZE * sizeof(DecodedOp);
+constexpr size_t MEMORY_BYTES = MEMORY_SIZE * sizeof(uint16_t);
+
+// =============================================================================
+// CONSTRUCTION & SHUTDOWN
+// =============================================================================
+
+InstancePool::InstancePool(const Options& opts)
+    : options(opts), freeList(nullptr), used(0) {
+    static_assert(alignof(Slot) <= SLOT_ALIGN, "SLOT_ALIGN must satisfy Slot's alignment");
+    if (options.slabInstances == 0)
+        options.slabInstances = 1;
+    headerSize = roundUp(sizeof(Slot), SLOT_ALIGN);
+    slotSize = roundUp(headerSize + DECODE_BYTES + MEMORY_BYTES, SLOT_ALIGN);
+    slabBytes = slotSize * options.slabInstances;
+    if (options.hugePages)
+        slabBytes = roundUp(slabBytes, HUGE_PAGE_BYTES);
+}
+
+InstancePool::~InstancePool() {
+    for (Slab& s : slabs) {
+        for (size_t i = 0; i < s.carved; ++i)
+            reinterpret_cast<Slot*>(s.base + i * slotSize)->~Slot();
+#ifdef GPR_POOL_MMAP
+        if (s.mapped) {
+            munmap(s.base, s.bytes);
+            continue;
+        }
+#endif
+        ::operator delete(s.base, std::align_val_t(SLOT_ALIGN));
+    }
+}
+
+// =============================================================================
+// ACQUIRE / RELEASE
+// =============================================================================
+
+InstancePool::Instance* InstancePool::acquire(std::shared_ptr<const MemoryImage> image) {
+    Slot* slot;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        slot = freeList;
+        if (slot)
+            freeList = slot->next;
+        else if (!(slot = carve()))
+            return nullptr;
+        ++used;
+    }
+
+    // Same image: restore the dirty pages only; otherwise rebase
+    if (slot->bus.getBase() == image)
+        slot->bus.reset();
+    else
+        slot->bus.setBase(std::move(image));
+    slot->cpu.reset();
+    return slot;
+}
+
+void InstancePool::release(Instance* instance) {
+    for (size_t p = 0; p < PAGE_COUNT; ++p) {
+        if (instance->bus.deviceAt(p)) {
+            instance->bus.unmapDevice(0, PAGE_COUNT);
+            break;
+        }
+    }
+    instance->cpu.clearBreakpoints();
+    instance->cpu.trace(false);
+
+    Slot* slot = static_cast<Slot*>(instance);
+    std::lock_guard<std::mutex> guard(lock);
+    slot->next = freeList;
+    freeList = slot;
+    --used;
+}
+
+size_t InstancePool::capacity() const {
+    std::lock_guard<std::mutex> guard(lock);
+    size_t n = 0;
+    for (const Slab& s : slabs)
+        n += s.carved;
+    return n;
+}
+
+size_t InstancePool::inUse() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return used;
+}
+
+// =============================================================================
+// SLABS (lock held)
+// =============================================================================
+
+InstancePool::Slot* InstancePool::carve() {
+    if (slabs.empty() || (slabs.back().carved + 1) * slotSize > slabs.back().bytes)
+        if (!addSlab())
+            return nullptr;
+    Slab& s = slabs.back();
+    unsigned char* at = s.base + s.carved * slotSize;
+    DecodedOp* decoded = reinterpret_cast<DecodedOp*>(at + headerSize);
+    uint16_t* memory = reinterpret_cast<uint16_t*>(at + headerSize + DECODE_BYTES);
+    // Anonymous mappings are already zero; touching them would commit the pages
+    if (!s.mapped)
+        std::memset(static_cast<void*>(decoded), 0, DECODE_BYTES);
+    ++s.carved;
+    return new (at) Slot(options.engine, memory, decoded);
+}
+
+bool InstancePool::addSlab() {
+    Slab s = {nullptr, slabBytes, 0, false};
+#ifdef GPR_POOL_MMAP
+    const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    // Explicit huge pages only exist if the administrator reserved some. Not
+    // MAP_NORESERVE here: without a reservation a fault past the pool is SIGBUS
+    if (options.hugePages)
+        p = mmap(nullptr, s.bytes, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+#endif
+    if (p == MAP_FAILED) {
+        int lazy = flags;
+#ifdef MAP_NORESERVE
+        lazy |= MAP_NORESERVE;
+#endif
+        p = mmap(nullptr, s.bytes, PROT_READ | PROT_WRITE, lazy, -1, 0);
+#ifdef MADV_HUGEPAGE
+        if (p != MAP_FAILED && options.hugePages)
+            madvise(p, s.bytes, MADV_HUGEPAGE);
+#endif
+    }
+    if (p != MAP_FAILED) {
+        s.base = static_cast<unsigned char*>(p);
+        s.mapped = true;
+    }
+#endif
+    if (!s.base)
+        s.base = static_cast<unsigned char*>(::operator new(s.bytes, std::align_val_t(SLOT_ALIGN), std::nothrow));
+    if (!s.base)
+        return false;
+    slabs.push_back(s);
+    return true;
+}
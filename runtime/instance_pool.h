@@ -0,0 +1,107 @@
+/**
+ * 16-bit GPR CPU Emulator - Instance pool
+ * Arena of reusable CPU + Bus instances: creating and destroying one costs
+ * no heap allocation once the pool has grown to the number in use.
+ */
+
+#ifndef GPR_INSTANCE_POOL_H
+#define GPR_INSTANCE_POOL_H
+
+#include "gpr_cpu.h"
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * InstancePool: instances live in slots carved from large mappings (slabs).
+ * A slot holds the Bus, the GPRCPU, the Bus's private-page storage and the
+ * predecode table, and starts on an OS page boundary, so two instances never
+ * share a cache line (or a page) whichever threads run them.
+ *
+ * Slabs are anonymous mappings where the host has them: only pages that are
+ * used get committed, so an instance costs roughly its dirty memory pages
+ * plus one 4 KiB predecode page per code page it runs. With hugePages the
+ * slabs are backed by huge pages (explicit ones if reserved, else a
+ * transparent huge page hint): fewer TLB misses for guests that run code all
+ * over memory, but each slot is committed in full.
+ *
+ * release() keeps the slot's objects alive, and acquire() reuses them:
+ * the same image only restores the dirtied pages (predecoded entries and
+ * JIT blocks for untouched code stay valid), another image rebases. Only
+ * growing the pool allocates, one slab of options.slabInstances at a time.
+ * acquire() / release() may be called from any thread.
+ */
+class InstancePool {
+public:
+    struct Options {
+        Engine engine = Engine::Interpreter;
+        size_t slabInstances = 64;          // Slots reserved per mapping
+        bool hugePages = false;
+    };
+
+    /** One pooled guest. Valid from acquire() until release(). */
+    struct Instance {
+        Bus bus;
+        GPRCPU cpu;
+
+        Instance(Engine engine, uint16_t* memory, DecodedOp* decoded)
+            : bus(MemoryImage::zero(), memory), cpu(bus, engine, decoded) {}
+    };
+
+    explicit InstancePool(const Options& options);
+
+    /** Destroys every instance; none may be in use. */
+    ~InstancePool();
+
+    InstancePool(const InstancePool&) = delete;
+    InstancePool& operator=(const InstancePool&) = delete;
+
+    /**
+     * An instance with memory equal to image and a reset CPU (PC = 0, no
+     * breakpoints, no devices, tracing off). Returns nullptr only if a new
+     * slab could not be mapped.
+     */
+    Instance* acquire(std::shared_ptr<const MemoryImage> image);
+
+    /** Return instance to the pool; it must not be used afterwards. */
+    void release(Instance* instance);
+
+    /** Slots carved so far (in use + free). */
+    size_t capacity() const;
+
+    /** Instances acquired and not yet released. */
+    size_t inUse() const;
+
+    /** Bytes reserved per slot (objects, memory and predecode table). */
+    size_t slotBytes() const { return slotSize; }
+
+private:
+    struct Slot;
+
+    /** One mapping, carved front to back into slots. */
+    struct Slab {
+        unsigned char* base;
+        size_t bytes;
+        size_t carved;      // Slots constructed so far
+        bool mapped;        // From mmap (else aligned operator new)
+    };
+
+    Options options;
+    size_t headerSize;      // Slot objects, rounded up to the slot alignment
+    size_t slotSize;
+    size_t slabBytes;
+
+    mutable std::mutex lock;
+    std::vector<Slab> slabs;
+    Slot* freeList;
+    size_t used;
+
+    /** Construct an instance in the next uncarved slot, mapping a slab if needed. */
+    Slot* carve();
+
+    bool addSlab();
+};
+
+#endif // GPR_INSTANCE_POOL_H
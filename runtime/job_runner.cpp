@@ -0,0 +1,179 @@
+/**
+ * 16-bit GPR CPU Emulator - Job runner implementation
+ */
+
+#include "job_runner.h"
+#include <cstring>
+
+// =============================================================================
+// WORKER STATE
+// =============================================================================
+
+/** Bus and CPU owned by one worker thread for the runner's lifetime. */
+struct JobRunner::Worker {
+    Bus bus;
+    GPRCPU cpu;
+
+    explicit Worker(Engine engine) : cpu(bus, engine) {}
+};
+
+// =============================================================================
+// CONSTRUCTION & SHUTDOWN
+// =============================================================================
+
+JobRunner::JobRunner(const Options& opts)
+    : options(opts), jobs(nullptr), generation(0), running(0), stopping(false) {
+    unsigned n = options.threads ? options.threads : std::thread::hardware_concurrency();
+    if (n == 0)
+        n = 1;
+    for (unsigned i = 0; i < n; ++i) {
+        workers.emplace_back(new Worker(options.engine));
+        queues.emplace_back(new Queue);
+    }
+    for (unsigned i = 0; i < n; ++i)
+        threadPool.emplace_back(&JobRunner::workerLoop, this, i);
+}
+
+JobRunner::~JobRunner() {
+    {
+        std::lock_guard<std::mutex> guard(controlLock);
+        stopping = true;
+    }
+    startSignal.notify_all();
+    for (std::thread& t : threadPool)
+        t.join();
+}
+
+// =============================================================================
+// RUN (caller thread)
+// =============================================================================
+
+void JobRunner::run(const std::vector<Job>& jobList) {
+    // Size result buffers once; workers only write into their own slots
+    resultBuffer.assign(jobList.size(), JobResult());
+    captureBuffer.assign(jobList.size() * options.capture.size(), 0);
+    if (jobList.empty())
+        return;
+
+    // Contiguous range per worker: neighbouring jobs often share an image
+    size_t n = queues.size();
+    for (size_t i = 0; i < n; ++i) {
+        std::lock_guard<std::mutex> guard(queues[i]->lock);
+        queues[i]->begin = jobList.size() * i / n;
+        queues[i]->end = jobList.size() * (i + 1) / n;
+    }
+
+    std::unique_lock<std::mutex> control(controlLock);
+    jobs = &jobList;
+    running = static_cast<unsigned>(n);
+    ++generation;
+    startSignal.notify_all();
+    doneSignal.wait(control, [this] { return running == 0; });
+    jobs = nullptr;
+}
+
+// =============================================================================
+// WORKERS
+// =============================================================================
+
+void JobRunner::workerLoop(unsigned index) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> control(controlLock);
+            startSignal.wait(control, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+
+        size_t job;
+        while (takeJob(index, job))
+            runJob(*workers[index], job);
+
+        std::lock_guard<std::mutex> guard(controlLock);
+        if (--running == 0)
+            doneSignal.notify_one();
+    }
+}
+
+bool JobRunner::takeJob(unsigned index, size_t& job) {
+    // --- Own range, front first ---
+    Queue& own = *queues[index];
+    {
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (own.begin < own.end) {
+            job = own.begin++;
+            return true;
+        }
+    }
+
+    // --- Steal the back half of the fullest other range ---
+    // Jobs only ever move between ranges, so if every range is empty the
+    // remaining work is already held by other workers and this one can stop.
+    for (;;) {
+        size_t victim = queues.size();
+        size_t most = 0;
+        for (size_t i = 0; i < queues.size(); ++i) {
+            if (i == index)
+                continue;
+            std::lock_guard<std::mutex> guard(queues[i]->lock);
+            size_t left = queues[i]->end - queues[i]->begin;
+            if (left > most) {
+                most = left;
+                victim = i;
+            }
+        }
+        if (victim == queues.size())
+            return false;
+
+        size_t first, last;
+        {
+            std::lock_guard<std::mutex> guard(queues[victim]->lock);
+            Queue& v = *queues[victim];
+            size_t left = v.end - v.begin;
+            if (left == 0)
+                continue;   // Drained meanwhile; pick another victim
+            size_t take = (left + 1) / 2;
+            last = v.end;
+            first = v.end - take;
+            v.end = first;
+        }
+        job = first;
+        std::lock_guard<std::mutex> guard(own.lock);
+        own.begin = first + 1;
+        own.end = last;
+        return true;
+    }
+}
+
+void JobRunner::runJob(Worker& w, size_t index) {
+    const Job& job = (*jobs)[index];
+
+    // --- LOAD: same image -> restore only the dirty pages (predecoded
+    // entries and JIT blocks for untouched code stay valid); else rebase ---
+    if (job.image == w.bus.getBase())
+        w.bus.reset();
+    else
+        w.bus.setBase(job.image);
+    for (size_t i = 0; i < job.patchCount; ++i)
+        w.bus.write(job.patches[i].address, job.patches[i].value);
+
+    // --- RUN ---
+    w.cpu.reset();
+    RunResult run = w.cpu.runFor(job.budget);
+
+    // --- COLLECT ---
+    const CPUState& s = w.cpu.getState();
+    JobResult& r = resultBuffer[index];
+    std::memcpy(r.R, s.R, sizeof r.R);
+    r.PC = s.PC;
+    r.FLAGS = s.FLAGS;
+    r.cycles = run.cycles;
+    r.halted = s.halted;
+    r.reason = run.reason;
+
+    const size_t k = options.capture.size();
+    for (size_t i = 0; i < k; ++i)
+        captureBuffer[index * k + i] = w.bus.read(options.capture[i]);
+}
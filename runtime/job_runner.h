@@ -0,0 +1,113 @@
+/**
+ * 16-bit GPR CPU Emulator - Job runner
+ * Runs many independent (program, input) jobs on a work-stealing thread pool.
+ */
+
+#ifndef GPR_JOB_RUNNER_H
+#define GPR_JOB_RUNNER_H
+
+#include "gpr_cpu.h"
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** One word written into memory after the image is loaded (e.g. an operand). */
+struct MemoryPatch {
+    uint16_t address;
+    uint16_t value;
+};
+
+/**
+ * Job: a program image plus its inputs. patches are not owned and must
+ * outlive JobRunner::run(). Jobs that share an image reuse the worker's
+ * decoded program, and switching inputs only restores the pages dirtied.
+ */
+struct Job {
+    std::shared_ptr<const MemoryImage> image;   // e.g. MemoryImage::copyOf(assembled words)
+    const MemoryPatch* patches;
+    size_t patchCount;
+    uint64_t budget;        // Max cycles; UINT64_MAX = run to HALT
+};
+
+/** Final CPU state of one job. */
+struct JobResult {
+    uint16_t R[8];
+    uint16_t PC;
+    uint16_t FLAGS;
+    uint64_t cycles;        // Counted like GPRCPU::run() (HALT not included)
+    bool halted;            // False if the budget ran out first
+    StopReason reason;      // Why the run ended (Halted or Budget unless a device stopped it)
+};
+
+/**
+ * JobRunner: fixed pool of worker threads, each with its own Bus and GPRCPU
+ * that are reused from job to job.
+ *
+ * run() splits the job list into one contiguous range per worker; a worker
+ * takes jobs from the front of its own range and, once it is empty, steals
+ * the back half of the fullest other range. Results land in buffers sized
+ * once per run(), indexed like the job list, so workers never allocate.
+ */
+class JobRunner {
+public:
+    struct Options {
+        unsigned threads = 0;               // 0 = std::thread::hardware_concurrency()
+        Engine engine = Engine::Interpreter;
+        std::vector<uint16_t> capture;      // Memory words to record per job (e.g. 0x102)
+    };
+
+    explicit JobRunner(const Options& options);
+    ~JobRunner();
+
+    JobRunner(const JobRunner&) = delete;
+    JobRunner& operator=(const JobRunner&) = delete;
+
+    unsigned threads() const { return static_cast<unsigned>(workers.size()); }
+
+    /** Run every job; blocks until all are done. Replaces previous results. */
+    void run(const std::vector<Job>& jobs);
+
+    const std::vector<JobResult>& results() const { return resultBuffer; }
+
+    /** Word options.capture[k] of job i's final memory. */
+    uint16_t captured(size_t job, size_t k) const {
+        return captureBuffer[job * options.capture.size() + k];
+    }
+
+private:
+    /** Per-worker job range [begin, end); other workers steal from its back. */
+    struct Queue {
+        std::mutex lock;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    struct Worker;
+
+    Options options;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threadPool;
+
+    const std::vector<Job>* jobs;
+    std::vector<JobResult> resultBuffer;
+    std::vector<uint16_t> captureBuffer;
+
+    // Run start / completion handshake
+    std::mutex controlLock;
+    std::condition_variable startSignal;
+    std::condition_variable doneSignal;
+    uint64_t generation;
+    unsigned running;
+    bool stopping;
+
+    void workerLoop(unsigned index);
+    bool takeJob(unsigned index, size_t& job);
+    void runJob(Worker& worker, size_t job);
+};
+
+#endif // GPR_JOB_RUNNER_H
@@ -0,0 +1,97 @@
+/**
+ * 16-bit GPR CPU Emulator - Metrics export
+ */
+
+#include "metrics_report.h"
+#include <cstdio>
+
+namespace {
+
+const char* const STOP_REASONS[] = {"halted", "budget", "deadline", "breakpoint", "fault", "yield"};
+const char* const DEVICE_OPS[] = {"read", "write"};
+
+/** One exported family: count consecutive Metrics, told apart by label when count > 1. */
+struct Family {
+    const char* name;
+    const char* help;
+    Metric first;
+    unsigned count;
+    const char* label;
+    const char* const* labelValues;
+    bool nanoseconds;       // Exported as seconds
+};
+
+constexpr Family FAMILIES[] = {
+    {"gpr_instructions_total", "Guest instructions executed by runFor(), runUntil() and run().",
+     Metric::Instructions, 1, nullptr, nullptr, false},
+    {"gpr_runs_total", "runFor() / runUntil() calls by the reason they stopped.",
+     Metric::RunsHalted, 6, "reason", STOP_REASONS, false},
+    {"gpr_code_writes_total", "Words of predecoded or translated code overwritten.",
+     Metric::CodeWrites, 1, nullptr, nullptr, false},
+    {"gpr_decode_flushes_total", "Whole predecode and translation caches dropped.",
+     Metric::DecodeFlushes, 1, nullptr, nullptr, false},
+    {"gpr_jit_blocks_invalidated_total", "Translated blocks dropped by writes to their code.",
+     Metric::JitBlocksInvalidated, 1, nullptr, nullptr, false},
+    {"gpr_device_accesses_total", "MMIO device accesses through a Bus.",
+     Metric::DeviceReads, 2, "op", DEVICE_OPS, false},
+    {"gpr_assembles_total", "Assembler calls: assemble(), incremental assemble / edit, link.",
+     Metric::Assembles, 1, nullptr, nullptr, false},
+    {"gpr_assembled_lines_total", "Source lines read by those calls.",
+     Metric::AssembledLines, 1, nullptr, nullptr, false},
+    {"gpr_assemble_seconds_total", "Wall-clock time spent in those calls.",
+     Metric::AssembleNanoseconds, 1, nullptr, nullptr, true},
+};
+
+constexpr unsigned exportedMetrics() {
+    unsigned n = 0;
+    for (const Family& f : FAMILIES)
+        n += f.count;
+    return n;
+}
+static_assert(exportedMetrics() == METRIC_COUNT, "every Metric belongs to one family");
+
+void appendSample(std::string& out, const Family& f, unsigned k, const MetricSeries& s) {
+    out += f.name;
+    if (f.label || !s.labels.empty()) {
+        out += '{';
+        out += s.labels;
+        if (f.label) {
+            if (!s.labels.empty())
+                out += ',';
+            out += f.label;
+            out += "=\"";
+            out += f.labelValues[k];
+            out += '"';
+        }
+        out += '}';
+    }
+    uint64_t v = s.values.values[static_cast<size_t>(f.first) + k];
+    char buf[32];
+    if (f.nanoseconds)
+        std::snprintf(buf, sizeof buf, " %llu.%09llu\n", static_cast<unsigned long long>(v / 1000000000u),
+                      static_cast<unsigned long long>(v % 1000000000u));
+    else
+        std::snprintf(buf, sizeof buf, " %llu\n", static_cast<unsigned long long>(v));
+    out += buf;
+}
+
+} // namespace
+
+void writePrometheusMetrics(std::string& out, const std::vector<MetricSeries>& series) {
+    for (const Family& f : FAMILIES) {
+        out += "# HELP ";
+        out += f.name;
+        out += ' ';
+        out += f.help;
+        out += "\n# TYPE ";
+        out += f.name;
+        out += " counter\n";
+        for (const MetricSeries& s : series)
+            for (unsigned k = 0; k < f.count; ++k)
+                appendSample(out, f, k, s);
+    }
+}
+
+void writePrometheusMetrics(std::string& out, const MetricValues& values) {
+    writePrometheusMetrics(out, std::vector<MetricSeries>{MetricSeries{"", values}});
+}
@@ -0,0 +1,31 @@
+/**
+ * 16-bit GPR CPU Emulator - Metrics export
+ * Formats MetricValues (cpu/metrics.h) in the Prometheus text exposition
+ * format, for a service's /metrics endpoint or a file scraped by a sidecar.
+ */
+
+#ifndef GPR_METRICS_REPORT_H
+#define GPR_METRICS_REPORT_H
+
+#include "metrics.h"
+#include <string>
+#include <vector>
+
+/** Values to export, with the labels that tell them apart (e.g. instance="7"; empty for none). */
+struct MetricSeries {
+    std::string labels;
+    MetricValues values;
+};
+
+/**
+ * Append every series to out in the Prometheus text format (version 0.0.4):
+ * one counter family per kind of event (gpr_instructions_total,
+ * gpr_runs_total{reason=...}, ...), each with its HELP and TYPE lines and
+ * then one sample per series. Assembler time is reported in seconds.
+ */
+void writePrometheusMetrics(std::string& out, const std::vector<MetricSeries>& series);
+
+/** As above for one unlabelled series, e.g. scrapeMetrics(). */
+void writePrometheusMetrics(std::string& out, const MetricValues& values);
+
+#endif // GPR_METRICS_REPORT_H
@@ -0,0 +1,203 @@
+/**
+ * 16-bit GPR CPU Emulator - Profile report
+ */
+
+#include "profile_report.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+const char* const OPCODE_NAMES[Profiler::OP_SLOTS] = {"HALT", "MOVI", "MOV", "LOAD", "STORE", "ADD", "SUB",
+                                                     "AND", "OR", "XOR", "NOT", "SHL", "SHR", "JMP",
+                                                     "JZ", "NOP", "MOVW", "JMPW", "JZW"};
+
+/** Resolves addresses to label+offset and source lines. */
+class Locator {
+public:
+    Locator(const AssembleInfo& info, std::string_view source) : lines(info.lines) {
+        for (const AssembleSymbol& s : info.symbols)
+            labels.push_back(&s);
+        // By address; among equal addresses the first defined wins
+        std::stable_sort(labels.begin(), labels.end(),
+                         [](const AssembleSymbol* a, const AssembleSymbol* b) { return a->value < b->value; });
+        for (size_t pos = 0; pos < source.size();) {
+            size_t eol = source.find('\n', pos);
+            if (eol == std::string_view::npos)
+                eol = source.size();
+            std::string_view line = source.substr(pos, eol - pos);
+            if (!line.empty() && line.back() == '\r')
+                line.remove_suffix(1);
+            sourceLines.push_back(line);
+            pos = eol + 1;
+        }
+    }
+
+    /** Index into labels() of the label covering address, or -1. */
+    int labelIndex(uint16_t address) const {
+        auto it = std::upper_bound(labels.begin(), labels.end(), address,
+                                   [](uint16_t a, const AssembleSymbol* s) { return a < s->value; });
+        if (it == labels.begin())
+            return -1;
+        // Skip back over labels sharing one address to the first defined
+        uint16_t value = (*(it - 1))->value;
+        while (it != labels.begin() && (*(it - 1))->value == value)
+            --it;
+        return static_cast<int>(it - labels.begin());
+    }
+
+    const std::vector<const AssembleSymbol*>& sortedLabels() const { return labels; }
+
+    /** "label+3", "label", or the hex address when no label precedes it. */
+    std::string location(uint16_t address) const {
+        char buf[16];
+        int i = labelIndex(address);
+        if (i < 0) {
+            std::snprintf(buf, sizeof buf, "0x%04X", address);
+            return buf;
+        }
+        std::string s = labels[i]->name;
+        if (address != labels[i]->value) {
+            std::snprintf(buf, sizeof buf, "+%u", unsigned(address - labels[i]->value));
+            s += buf;
+        }
+        return s;
+    }
+
+    /** Source line number of address, 0 if unknown. */
+    uint32_t line(uint16_t address) const {
+        auto it = std::lower_bound(lines.begin(), lines.end(), address,
+                                   [](const AssembleLine& l, uint16_t a) { return l.address < a; });
+        return it != lines.end() && it->address == address ? it->line : 0;
+    }
+
+    /** Source text of a line, trimmed; empty if unknown. */
+    std::string_view text(uint32_t line) const {
+        if (line == 0 || line > sourceLines.size())
+            return std::string_view();
+        std::string_view s = sourceLines[line - 1];
+        size_t a = s.find_first_not_of(" \t");
+        return a == std::string_view::npos ? std::string_view() : s.substr(a);
+    }
+
+private:
+    const std::vector<AssembleLine>& lines;
+    std::vector<const AssembleSymbol*> labels;
+    std::vector<std::string_view> sourceLines;
+};
+
+double percent(uint64_t n, uint64_t total) {
+    return total ? 100.0 * static_cast<double>(n) / static_cast<double>(total) : 0.0;
+}
+
+/** "  LINE  source" columns for address (blank if unknown). */
+void appendSource(std::string& out, const Locator& loc, uint16_t address) {
+    uint32_t line = loc.line(address);
+    if (line == 0) {
+        while (!out.empty() && out.back() == ' ')
+            out.pop_back();     // No trailing location padding
+        return;
+    }
+    char buf[24];
+    std::snprintf(buf, sizeof buf, "  %6u  ", line);
+    out += buf;
+    out += loc.text(line);
+}
+
+} // namespace
+
+void writeProfileReport(std::string& out, const Profiler& profile, const AssembleInfo& info,
+                        std::string_view source, size_t top) {
+    Locator loc(info, source);
+    uint64_t total = profile.total();
+    char buf[128];
+
+    std::snprintf(buf, sizeof buf, "Profile: %llu instructions\n", static_cast<unsigned long long>(total));
+    out += buf;
+
+    // --- Opcodes, most frequent first ---
+    out += "\nOpcodes:\n";
+    unsigned order[Profiler::OP_SLOTS];
+    for (unsigned i = 0; i < Profiler::OP_SLOTS; ++i)
+        order[i] = i;
+    std::stable_sort(order, order + Profiler::OP_SLOTS,
+                     [&](unsigned a, unsigned b) { return profile.opcodeCount(a) > profile.opcodeCount(b); });
+    for (unsigned op : order) {
+        uint64_t n = profile.opcodeCount(op);
+        if (n == 0)
+            break;
+        std::snprintf(buf, sizeof buf, "  %-6s %14llu %6.2f%%\n", OPCODE_NAMES[op],
+                      static_cast<unsigned long long>(n), percent(n, total));
+        out += buf;
+    }
+
+    // --- Hottest addresses ---
+    std::vector<uint16_t> hot;
+    for (size_t a = 0; a < MEMORY_SIZE; ++a)
+        if (profile.hits(static_cast<uint16_t>(a)))
+            hot.push_back(static_cast<uint16_t>(a));
+    std::stable_sort(hot.begin(), hot.end(),
+                     [&](uint16_t a, uint16_t b) { return profile.hits(a) > profile.hits(b); });
+    std::snprintf(buf, sizeof buf, "\nHot addresses (top %zu of %zu):\n", std::min(top, hot.size()), hot.size());
+    out += buf;
+    out += "  ADDR            COUNT        %  LOCATION                LINE  SOURCE\n";
+    for (size_t i = 0; i < hot.size() && i < top; ++i) {
+        uint16_t a = hot[i];
+        std::snprintf(buf, sizeof buf, "  0x%04X %14llu %7.2f%%  %-20s", a,
+                      static_cast<unsigned long long>(profile.hits(a)), percent(profile.hits(a), total),
+                      loc.location(a).c_str());
+        out += buf;
+        appendSource(out, loc, a);
+        out += '\n';
+    }
+
+    // --- Per label: code from each label up to the next ---
+    const std::vector<const AssembleSymbol*>& labels = loc.sortedLabels();
+    if (!labels.empty()) {
+        std::vector<uint64_t> perLabel(labels.size(), 0);
+        uint64_t unlabeled = 0;
+        for (uint16_t a : hot) {
+            int i = loc.labelIndex(a);
+            (i < 0 ? unlabeled : perLabel[static_cast<size_t>(i)]) += profile.hits(a);
+        }
+        std::vector<size_t> byCount;
+        for (size_t i = 0; i < labels.size(); ++i)
+            if (perLabel[i])
+                byCount.push_back(i);
+        std::stable_sort(byCount.begin(), byCount.end(),
+                         [&](size_t a, size_t b) { return perLabel[a] > perLabel[b]; });
+        out += "\nLabels (each up to the next label):\n";
+        for (size_t i : byCount) {
+            std::snprintf(buf, sizeof buf, "  %-20s %14llu %7.2f%%\n", labels[i]->name.c_str(),
+                          static_cast<unsigned long long>(perLabel[i]), percent(perLabel[i], total));
+            out += buf;
+        }
+        if (unlabeled) {
+            std::snprintf(buf, sizeof buf, "  %-20s %14llu %7.2f%%\n", "(before any label)",
+                          static_cast<unsigned long long>(unlabeled), percent(unlabeled, total));
+            out += buf;
+        }
+    }
+
+    // --- Conditional branches, in address order ---
+    bool header = false;
+    for (size_t a = 0; a < MEMORY_SIZE; ++a) {
+        uint16_t address = static_cast<uint16_t>(a);
+        uint64_t n = profile.jzExecuted(address);
+        if (n == 0)
+            continue;
+        if (!header) {
+            out += "\nJZ / JZW branches:\n";
+            out += "  ADDR         EXECUTED          TAKEN      NOT TAKEN  LOCATION                LINE  SOURCE\n";
+            header = true;
+        }
+        uint64_t taken = profile.jzTaken(address);
+        std::snprintf(buf, sizeof buf, "  0x%04X %14llu %14llu %14llu  %-20s", address,
+                      static_cast<unsigned long long>(n), static_cast<unsigned long long>(taken),
+                      static_cast<unsigned long long>(n - taken), loc.location(address).c_str());
+        out += buf;
+        appendSource(out, loc, address);
+        out += '\n';
+    }
+}
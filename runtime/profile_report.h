@@ -0,0 +1,27 @@
+/**
+ * 16-bit GPR CPU Emulator - Profile report
+ * Maps the counters of a Profiler (cpu/profile.h) back to the program's
+ * labels and source lines.
+ */
+
+#ifndef GPR_PROFILE_REPORT_H
+#define GPR_PROFILE_REPORT_H
+
+#include "profile.h"
+#include "assembler.h"
+#include <string>
+#include <string_view>
+
+/**
+ * Append a text report to out: total and per-opcode counts, the top hottest
+ * addresses, time per label (each label covers the code up to the next one)
+ * and every executed JZ / JZW with its taken / not-taken counts.
+ *
+ * Addresses are shown as label+offset from info.symbols. When info.lines is
+ * filled (assembled from source rather than loaded from an image) each row
+ * also names its source line, and its text if source is given.
+ */
+void writeProfileReport(std::string& out, const Profiler& profile, const AssembleInfo& info,
+                        std::string_view source = std::string_view(), size_t top = 20);
+
+#endif // GPR_PROFILE_REPORT_H
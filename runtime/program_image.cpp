@@ -0,0 +1,256 @@
+/**
+ * 16-bit GPR CPU Emulator - Binary program image implementation
+ */
+
+#include "program_image.h"
+#include <cstdio>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GPR_IMAGE_MMAP 1
+#endif
+
+static_assert(sizeof(ImageHeader) == 24, "ImageHeader is a fixed on-disk layout");
+static_assert(sizeof(ImageSegment) == 8 && sizeof(ImagePage) == 8 && sizeof(ImageSymbol) == 8,
+              "Image tables are fixed on-disk layouts");
+
+// =============================================================================
+// WRITER
+// =============================================================================
+
+bool writeProgramImage(const char* path, const uint16_t* mem, const AssembleInfo& info,
+                       uint16_t entry, std::string& error) {
+    // --- Collect pages: every page a segment touches, zero outside segments ---
+    std::vector<std::vector<uint16_t>> pageData(PAGE_COUNT);
+    std::vector<uint32_t> pageOrder;
+    for (const AssembleSegment& s : info.segments) {
+        if (s.address + s.length > MEMORY_SIZE) {
+            error = "Segment outside memory";
+            return false;
+        }
+        for (uint32_t a = s.address; a < s.address + s.length; ++a) {
+            std::vector<uint16_t>& page = pageData[a >> PAGE_SHIFT];
+            if (page.empty()) {
+                page.assign(PAGE_WORDS, 0);
+                pageOrder.push_back(a >> PAGE_SHIFT);
+            }
+            page[a & (PAGE_WORDS - 1)] = mem[a];
+        }
+    }
+
+    std::string strings;
+    std::vector<ImageSymbol> symbols;
+    for (const AssembleSymbol& sym : info.symbols) {
+        if (sym.name.size() > UINT16_MAX) {
+            error = "Symbol name too long: " + sym.name.substr(0, 32) + "...";
+            return false;
+        }
+        symbols.push_back(ImageSymbol{static_cast<uint32_t>(strings.size()),
+                                      static_cast<uint16_t>(sym.name.size()), sym.value});
+        strings += sym.name;
+    }
+
+    // --- Layout: tables, then page data from the next alignment boundary ---
+    ImageHeader header;
+    std::memcpy(header.magic, IMAGE_MAGIC, sizeof header.magic);
+    header.version = IMAGE_VERSION;
+    header.entry = entry;
+    header.segmentCount = static_cast<uint32_t>(info.segments.size());
+    header.pageCount = static_cast<uint32_t>(pageOrder.size());
+    header.symbolCount = static_cast<uint32_t>(symbols.size());
+    header.stringBytes = static_cast<uint32_t>(strings.size());
+
+    size_t tablesEnd = sizeof header + info.segments.size() * sizeof(ImageSegment) +
+                       pageOrder.size() * sizeof(ImagePage) + symbols.size() * sizeof(ImageSymbol) +
+                       strings.size();
+    size_t dataStart = (tablesEnd + IMAGE_PAGE_ALIGN - 1) / IMAGE_PAGE_ALIGN * IMAGE_PAGE_ALIGN;
+
+    std::vector<ImagePage> pages;
+    for (size_t i = 0; i < pageOrder.size(); ++i)
+        pages.push_back(ImagePage{pageOrder[i], static_cast<uint32_t>(dataStart + i * IMAGE_PAGE_ALIGN)});
+
+    std::FILE* f = std::fopen(path, "wb");
+    if (!f) {
+        error = std::string("Cannot create ") + path;
+        return false;
+    }
+    std::vector<ImageSegment> segments;
+    for (const AssembleSegment& s : info.segments)
+        segments.push_back(ImageSegment{s.address, s.length});
+    std::vector<char> padding(dataStart - tablesEnd, 0);
+
+    bool ok = std::fwrite(&header, sizeof header, 1, f) == 1 &&
+              std::fwrite(segments.data(), sizeof(ImageSegment), segments.size(), f) == segments.size() &&
+              std::fwrite(pages.data(), sizeof(ImagePage), pages.size(), f) == pages.size() &&
+              std::fwrite(symbols.data(), sizeof(ImageSymbol), symbols.size(), f) == symbols.size() &&
+              std::fwrite(strings.data(), 1, strings.size(), f) == strings.size() &&
+              std::fwrite(padding.data(), 1, padding.size(), f) == padding.size();
+    for (size_t i = 0; ok && i < pageOrder.size(); ++i)
+        ok = std::fwrite(pageData[pageOrder[i]].data(), sizeof(uint16_t), PAGE_WORDS, f) == PAGE_WORDS;
+    if (std::fclose(f) != 0)
+        ok = false;
+    if (!ok)
+        error = std::string("Error writing ") + path;
+    return ok;
+}
+
+// =============================================================================
+// FILE MAPPING
+// =============================================================================
+
+namespace {
+
+/** Read-only file contents: mapped where possible, else read into the heap. */
+struct FileData {
+    const unsigned char* bytes = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+
+    ~FileData() {
+#ifdef GPR_IMAGE_MMAP
+        if (mapped) {
+            munmap(const_cast<unsigned char*>(bytes), size);
+            return;
+        }
+#endif
+        delete[] bytes;
+    }
+
+    bool load(const char* path) {
+#ifdef GPR_IMAGE_MMAP
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0 && st.st_size > 0;
+        if (ok) {
+            void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            ok = p != MAP_FAILED;
+            if (ok) {
+                bytes = static_cast<const unsigned char*>(p);
+                size = static_cast<size_t>(st.st_size);
+                mapped = true;
+            }
+        }
+        ::close(fd);
+        return ok;
+#else
+        std::FILE* f = std::fopen(path, "rb");
+        if (!f)
+            return false;
+        std::fseek(f, 0, SEEK_END);
+        long n = std::ftell(f);
+        std::fseek(f, 0, SEEK_SET);
+        bool ok = n > 0;
+        if (ok) {
+            unsigned char* buf = new unsigned char[static_cast<size_t>(n)];
+            ok = std::fread(buf, 1, static_cast<size_t>(n), f) == static_cast<size_t>(n);
+            bytes = buf;
+            size = static_cast<size_t>(n);
+        }
+        std::fclose(f);
+        return ok;
+#endif
+    }
+};
+
+} // namespace
+
+// =============================================================================
+// LOADER
+// =============================================================================
+
+bool ProgramImage::isImage(const char* path) {
+    std::FILE* f = std::fopen(path, "rb");
+    if (!f)
+        return false;
+    char magic[sizeof IMAGE_MAGIC];
+    bool match = std::fread(magic, 1, sizeof magic, f) == sizeof magic &&
+                 std::memcmp(magic, IMAGE_MAGIC, sizeof magic) == 0;
+    std::fclose(f);
+    return match;
+}
+
+std::shared_ptr<const ProgramImage> ProgramImage::open(const char* path, std::string& error) {
+    std::shared_ptr<FileData> file = std::make_shared<FileData>();
+    if (!file->load(path)) {
+        error = std::string("Cannot read ") + path;
+        return nullptr;
+    }
+    const unsigned char* bytes = file->bytes;
+
+    ImageHeader header;
+    if (file->size < sizeof header) {
+        error = "Not a program image (too short)";
+        return nullptr;
+    }
+    std::memcpy(&header, bytes, sizeof header);
+    if (std::memcmp(header.magic, IMAGE_MAGIC, sizeof header.magic) != 0) {
+        error = "Not a program image (bad magic)";
+        return nullptr;
+    }
+    if (header.version != IMAGE_VERSION) {
+        error = "Unsupported program image version " + std::to_string(header.version);
+        return nullptr;
+    }
+
+    // --- Tables must fit in the file ---
+    uint64_t segmentsAt = sizeof header;
+    uint64_t pagesAt = segmentsAt + uint64_t(header.segmentCount) * sizeof(ImageSegment);
+    uint64_t symbolsAt = pagesAt + uint64_t(header.pageCount) * sizeof(ImagePage);
+    uint64_t stringsAt = symbolsAt + uint64_t(header.symbolCount) * sizeof(ImageSymbol);
+    if (stringsAt + header.stringBytes > file->size || header.pageCount > PAGE_COUNT) {
+        error = "Corrupt program image (tables exceed file)";
+        return nullptr;
+    }
+
+    std::shared_ptr<ProgramImage> program(new ProgramImage);
+    program->entryPc = header.entry;
+
+    for (uint32_t i = 0; i < header.segmentCount; ++i) {
+        ImageSegment s;
+        std::memcpy(&s, bytes + segmentsAt + i * sizeof s, sizeof s);
+        if (s.address > MEMORY_SIZE || s.length > MEMORY_SIZE - s.address) {
+            error = "Corrupt program image (segment outside memory)";
+            return nullptr;
+        }
+        program->segmentList.push_back(AssembleSegment{s.address, s.length});
+    }
+
+    // --- Pages point straight into the file; unlisted pages stay zero ---
+    const uint16_t* pages[PAGE_COUNT] = {};
+    for (uint32_t i = 0; i < header.pageCount; ++i) {
+        ImagePage pg;
+        std::memcpy(&pg, bytes + pagesAt + i * sizeof pg, sizeof pg);
+        if (pg.page >= PAGE_COUNT || pages[pg.page] || pg.offset % IMAGE_PAGE_ALIGN != 0 ||
+            uint64_t(pg.offset) + IMAGE_PAGE_ALIGN > file->size) {
+            error = "Corrupt program image (bad page entry)";
+            return nullptr;
+        }
+        pages[pg.page] = reinterpret_cast<const uint16_t*>(bytes + pg.offset);
+    }
+
+    const char* strings = reinterpret_cast<const char*>(bytes + stringsAt);
+    for (uint32_t i = 0; i < header.symbolCount; ++i) {
+        ImageSymbol sym;
+        std::memcpy(&sym, bytes + symbolsAt + i * sizeof sym, sizeof sym);
+        if (uint64_t(sym.nameOffset) + sym.nameLength > header.stringBytes) {
+            error = "Corrupt program image (symbol name outside string pool)";
+            return nullptr;
+        }
+        program->symbolList.push_back(AssembleSymbol{std::string(strings + sym.nameOffset, sym.nameLength), sym.value});
+    }
+
+    program->image = MemoryImage::fromPages(pages, file);
+    return program;
+}
+
+void ProgramImage::copyInto(Bus& bus) const {
+    for (const AssembleSegment& s : segmentList)
+        for (uint32_t a = s.address; a < s.address + s.length; ++a)
+            bus.write(static_cast<uint16_t>(a), image->page(a >> PAGE_SHIFT)[a & (PAGE_WORDS - 1)]);
+}
@@ -0,0 +1,105 @@
+/**
+ * 16-bit GPR CPU Emulator - Binary program image
+ * Assembled program saved with its segments and labels, loaded back without
+ * assembling: the file is memory-mapped and its pages become a MemoryImage.
+ */
+
+#ifndef GPR_PROGRAM_IMAGE_H
+#define GPR_PROGRAM_IMAGE_H
+
+#include "gpr_cpu.h"
+#include "assembler.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// =============================================================================
+// FILE FORMAT (host byte order)
+// =============================================================================
+//
+//   ImageHeader
+//   ImageSegment[segmentCount]   Word ranges written by the program
+//   ImagePage[pageCount]         Memory pages stored in the file
+//   ImageSymbol[symbolCount]     Labels; names live in the string pool
+//   char[stringBytes]            String pool
+//   (padding)                    Up to an IMAGE_PAGE_ALIGN boundary
+//   uint16_t[PAGE_WORDS] per ImagePage, each at its own offset
+//
+// Pages not listed are all zero. Page data is stored at IMAGE_PAGE_ALIGN
+// multiples, so a mapped file can be used as guest memory in place.
+
+constexpr char IMAGE_MAGIC[4] = {'G', 'P', 'R', 'I'};
+constexpr uint16_t IMAGE_VERSION = 1;
+constexpr size_t IMAGE_PAGE_ALIGN = PAGE_WORDS * sizeof(uint16_t);
+
+struct ImageHeader {
+    char magic[4];           // IMAGE_MAGIC
+    uint16_t version;        // IMAGE_VERSION
+    uint16_t entry;          // PC to start at (the CPU resets to 0)
+    uint32_t segmentCount;
+    uint32_t pageCount;
+    uint32_t symbolCount;
+    uint32_t stringBytes;
+};
+
+struct ImageSegment {
+    uint32_t address;
+    uint32_t length;         // Words
+};
+
+struct ImagePage {
+    uint32_t page;           // Guest page index (address >> PAGE_SHIFT)
+    uint32_t offset;         // Byte offset of its words in the file
+};
+
+struct ImageSymbol {
+    uint32_t nameOffset;     // Into the string pool
+    uint16_t nameLength;
+    uint16_t value;
+};
+
+/**
+ * Write the words of mem covered by info.segments, plus info.symbols, as an
+ * image file. False with a message in error on failure.
+ */
+bool writeProgramImage(const char* path, const uint16_t* mem, const AssembleInfo& info,
+                       uint16_t entry, std::string& error);
+
+// =============================================================================
+// LOADER
+// =============================================================================
+
+/**
+ * ProgramImage: a loaded image file. On POSIX hosts the file is mapped
+ * read-only and memory() points straight at the mapped pages, so only pages
+ * the guest touches are ever read from disk; elsewhere it is read into memory.
+ */
+class ProgramImage {
+public:
+    /** Open and validate path; nullptr with a message in error on failure. */
+    static std::shared_ptr<const ProgramImage> open(const char* path, std::string& error);
+
+    /** True if path starts with IMAGE_MAGIC (cheap check before open()). */
+    static bool isImage(const char* path);
+
+    uint16_t entry() const { return entryPc; }
+    const std::vector<AssembleSegment>& segments() const { return segmentList; }
+    const std::vector<AssembleSymbol>& symbols() const { return symbolList; }
+
+    /** Program memory as a Bus base image, backed by the file's pages (no copy). */
+    const std::shared_ptr<const MemoryImage>& memory() const { return image; }
+
+    /** Write every segment word into bus (through Bus::write, so MMIO and watchers see it). */
+    void copyInto(Bus& bus) const;
+
+private:
+    ProgramImage() : entryPc(0) {}
+
+    uint16_t entryPc;
+    std::vector<AssembleSegment> segmentList;
+    std::vector<AssembleSymbol> symbolList;
+    std::shared_ptr<const MemoryImage> image;
+};
+
+#endif // GPR_PROGRAM_IMAGE_H
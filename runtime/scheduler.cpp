@@ -0,0 +1,269 @@
+/**
+ * 16-bit GPR CPU Emulator - Guest scheduler implementation
+ */
+
+#include "scheduler.h"
+#include <chrono>
+
+// =============================================================================
+// GUEST STATE
+// =============================================================================
+
+/** One tenant program: its machine plus the I/O device on GUEST_IO_PAGE. */
+struct Scheduler::Guest : MmioDevice {
+    Bus bus;
+    GPRCPU cpu;
+    std::atomic<unsigned> home;     // Queue it returns to when woken (read by push())
+    uint64_t cycles;
+
+    // Guarded by lock: push() runs on other threads
+    std::mutex lock;
+    std::deque<uint16_t> input;
+    GuestStatus status;
+
+    std::vector<uint16_t> output;   // Only touched by the worker running it
+
+    Guest(std::shared_ptr<const MemoryImage> image, Engine engine, unsigned home)
+        : bus(std::move(image)), cpu(bus, engine), home(home), cycles(0), status(GuestStatus::Runnable) {
+        bus.mapDevice(GUEST_IO_PAGE, 1, this);
+    }
+
+    uint16_t read(uint16_t address) override {
+        std::lock_guard<std::mutex> guard(lock);
+        if (address == GUEST_IO_STATUS)
+            return static_cast<uint16_t>(input.size() > 0xFFFF ? 0xFFFF : input.size());
+        if (address != GUEST_IO_DATA)
+            return 0;
+        if (input.empty())
+            return cpu.retryLoad();     // Yield; runGuest() parks it unless input arrives first
+        uint16_t value = input.front();
+        input.pop_front();
+        return value;
+    }
+
+    void write(uint16_t address, uint16_t value) override {
+        if (address == GUEST_IO_DATA)
+            output.push_back(value);
+    }
+};
+
+// =============================================================================
+// CONSTRUCTION & SHUTDOWN
+// =============================================================================
+
+Scheduler::Scheduler(const Options& opts)
+    : options(opts), runnable(0), generation(0), running(0), stopping(false) {
+    unsigned n = options.threads ? options.threads : std::thread::hardware_concurrency();
+    if (n == 0)
+        n = 1;
+    if (options.quantum == 0)
+        options.quantum = 1;
+    for (unsigned i = 0; i < n; ++i)
+        queues.emplace_back(new Queue);
+    for (unsigned i = 0; i < n; ++i)
+        threadPool.emplace_back(&Scheduler::workerLoop, this, i);
+}
+
+Scheduler::~Scheduler() {
+    {
+        std::lock_guard<std::mutex> guard(controlLock);
+        stopping = true;
+    }
+    startSignal.notify_all();
+    for (std::thread& t : threadPool)
+        t.join();
+}
+
+// =============================================================================
+// GUESTS (caller thread, between runs)
+// =============================================================================
+
+size_t Scheduler::spawn(std::shared_ptr<const MemoryImage> image, uint16_t entry) {
+    // New guests are dealt round robin over the queues
+    unsigned home = static_cast<unsigned>(guestList.size() % queues.size());
+    guestList.emplace_back(new Guest(std::move(image), options.engine, home));
+    Guest& g = *guestList.back();
+    g.cpu.getState().PC = entry;
+    ++runnable;
+    std::lock_guard<std::mutex> guard(queues[home]->lock);
+    queues[home]->guests.push_back(&g);
+    return guestList.size() - 1;
+}
+
+void Scheduler::push(size_t index, uint16_t value) {
+    Guest& g = *guestList[index];
+    bool wake;
+    {
+        std::lock_guard<std::mutex> guard(g.lock);
+        g.input.push_back(value);
+        wake = g.status == GuestStatus::Blocked;
+        if (wake)
+            g.status = GuestStatus::Runnable;
+    }
+    if (wake) {
+        ++runnable;
+        enqueue(g.home.load(), g);
+    }
+}
+
+GuestStatus Scheduler::status(size_t guest) const {
+    Guest& g = *guestList[guest];
+    std::lock_guard<std::mutex> guard(g.lock);
+    return g.status;
+}
+
+const CPUState& Scheduler::state(size_t guest) const {
+    return guestList[guest]->cpu.getState();
+}
+
+uint64_t Scheduler::cycles(size_t guest) const {
+    return guestList[guest]->cycles;
+}
+
+const std::vector<uint16_t>& Scheduler::output(size_t guest) const {
+    return guestList[guest]->output;
+}
+
+Bus& Scheduler::bus(size_t guest) {
+    return guestList[guest]->bus;
+}
+
+// =============================================================================
+// RUN (caller thread)
+// =============================================================================
+
+void Scheduler::run() {
+    std::unique_lock<std::mutex> control(controlLock);
+    running = static_cast<unsigned>(threadPool.size());
+    ++generation;
+    startSignal.notify_all();
+    doneSignal.wait(control, [this] { return running == 0; });
+}
+
+// =============================================================================
+// WORKERS
+// =============================================================================
+
+void Scheduler::workerLoop(unsigned index) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> control(controlLock);
+            startSignal.wait(control, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+
+        for (;;) {
+            Guest* g;
+            if (takeGuest(index, g)) {
+                runGuest(index, *g);
+                continue;
+            }
+            if (runnable.load() == 0)
+                break;
+            // The remaining guests are running elsewhere; wait for one to be queued
+            std::unique_lock<std::mutex> control(controlLock);
+            workSignal.wait_for(control, std::chrono::milliseconds(1));
+        }
+
+        std::lock_guard<std::mutex> guard(controlLock);
+        if (--running == 0)
+            doneSignal.notify_one();
+        workSignal.notify_all();
+    }
+}
+
+bool Scheduler::takeGuest(unsigned index, Guest*& guest) {
+    // --- Own queue, front first ---
+    Queue& own = *queues[index];
+    {
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.guests.empty()) {
+            guest = own.guests.front();
+            own.guests.pop_front();
+            return true;
+        }
+    }
+
+    // --- Steal the back half of the fullest other queue ---
+    for (;;) {
+        size_t victim = queues.size();
+        size_t most = 0;
+        for (size_t i = 0; i < queues.size(); ++i) {
+            if (i == index)
+                continue;
+            std::lock_guard<std::mutex> guard(queues[i]->lock);
+            if (queues[i]->guests.size() > most) {
+                most = queues[i]->guests.size();
+                victim = i;
+            }
+        }
+        if (victim == queues.size())
+            return false;
+
+        std::deque<Guest*> stolen;
+        {
+            std::lock_guard<std::mutex> guard(queues[victim]->lock);
+            std::deque<Guest*>& v = queues[victim]->guests;
+            if (v.empty())
+                continue;   // Drained meanwhile; pick another victim
+            size_t take = (v.size() + 1) / 2;
+            stolen.assign(v.end() - static_cast<std::ptrdiff_t>(take), v.end());
+            v.resize(v.size() - take);
+        }
+        guest = stolen.front();
+        stolen.pop_front();
+        guest->home = index;
+        std::lock_guard<std::mutex> guard(own.lock);
+        for (Guest* g : stolen) {
+            g->home = index;
+            own.guests.push_back(g);
+        }
+        return true;
+    }
+}
+
+void Scheduler::runGuest(unsigned index, Guest& g) {
+    RunResult r = g.cpu.runFor(options.quantum);
+    g.cycles += r.cycles;
+
+    switch (r.reason) {
+        case StopReason::Budget:
+            enqueue(index, g);
+            return;
+        case StopReason::Yield: {
+            // Blocked on input, unless push() filled it while the quantum ran
+            std::lock_guard<std::mutex> guard(g.lock);
+            if (g.input.empty()) {
+                g.status = GuestStatus::Blocked;
+                break;
+            }
+            enqueue(index, g);
+            return;
+        }
+        case StopReason::Fault: {
+            std::lock_guard<std::mutex> guard(g.lock);
+            g.status = GuestStatus::Faulted;
+            break;
+        }
+        default: {      // Halted (no breakpoints are set on guests)
+            std::lock_guard<std::mutex> guard(g.lock);
+            g.status = GuestStatus::Halted;
+            break;
+        }
+    }
+    if (--runnable == 0) {
+        std::lock_guard<std::mutex> guard(controlLock);
+        workSignal.notify_all();
+    }
+}
+
+void Scheduler::enqueue(unsigned index, Guest& g) {
+    {
+        std::lock_guard<std::mutex> guard(queues[index]->lock);
+        queues[index]->guests.push_back(&g);
+    }
+    workSignal.notify_one();
+}
@@ -0,0 +1,115 @@
+/**
+ * 16-bit GPR CPU Emulator - Guest scheduler
+ * Multiplexes many long-running guests (CPU + Bus each) over a small pool
+ * of threads, in fixed runFor() quanta, with per-thread run queues and
+ * work stealing.
+ */
+
+#ifndef GPR_SCHEDULER_H
+#define GPR_SCHEDULER_H
+
+#include "gpr_cpu.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** Every guest's I/O page: its input FIFO and output log (see Scheduler). */
+constexpr size_t GUEST_IO_PAGE = 0xFF;
+constexpr uint16_t GUEST_IO_DATA = 0xFF00;      // LOAD: next input (blocks while empty); STORE: output
+constexpr uint16_t GUEST_IO_STATUS = 0xFF01;    // LOAD: inputs queued (never blocks)
+
+enum class GuestStatus : uint8_t {
+    Runnable,   // In a run queue (or running)
+    Blocked,    // LOAD from an empty input FIFO; push() wakes it
+    Halted,     // Executed HALT
+    Faulted     // A device stopped it with StopReason::Fault
+};
+
+/**
+ * Scheduler: guests are independent CPU + Bus pairs over shared program
+ * images. A guest is its own continuation: runFor() stops on a budget and
+ * simply resumes, so no coroutine frames or fiber stacks are needed.
+ *
+ * run() lets the worker threads take turns on the guests: each worker pops
+ * a guest from the front of its own queue, runs it for one quantum and, if
+ * it is still runnable, puts it at the back (round robin). A worker whose
+ * queue is empty steals the back half of the fullest other queue.
+ *
+ * A guest that LOADs GUEST_IO_DATA while its input is empty yields (the
+ * LOAD is retried on resume, see GPRCPU::retryLoad()) and leaves the
+ * queues until push() gives it input. STOREs to GUEST_IO_DATA append to
+ * its output. run() returns once no guest is runnable: all are halted,
+ * faulted or blocked.
+ *
+ * spawn() and the per-guest accessors are for the caller thread between
+ * runs; push() may be called from any thread at any time.
+ */
+class Scheduler {
+public:
+    struct Options {
+        unsigned threads = 0;               // 0 = std::thread::hardware_concurrency()
+        Engine engine = Engine::Interpreter;
+        uint64_t quantum = 10000;           // Instructions per turn
+    };
+
+    explicit Scheduler(const Options& options);
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    unsigned threads() const { return static_cast<unsigned>(threadPool.size()); }
+
+    /** Add a runnable guest executing image from entry; returns its index. */
+    size_t spawn(std::shared_ptr<const MemoryImage> image, uint16_t entry = 0);
+
+    /** Append value to guest's input FIFO, waking it if it is blocked on it. */
+    void push(size_t guest, uint16_t value);
+
+    /** Run until no guest is runnable. Guests woken afterwards run on the next call. */
+    void run();
+
+    size_t guests() const { return guestList.size(); }
+    GuestStatus status(size_t guest) const;
+    const CPUState& state(size_t guest) const;
+    uint64_t cycles(size_t guest) const;
+    const std::vector<uint16_t>& output(size_t guest) const;
+    Bus& bus(size_t guest);
+
+private:
+    struct Guest;
+
+    /** Per-worker run queue; other workers steal from its back. */
+    struct Queue {
+        std::mutex lock;
+        std::deque<Guest*> guests;
+    };
+
+    Options options;
+    std::vector<std::unique_ptr<Guest>> guestList;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threadPool;
+    std::atomic<size_t> runnable;           // Guests queued or running
+
+    // Run start / completion handshake (as in JobRunner)
+    std::mutex controlLock;
+    std::condition_variable startSignal;
+    std::condition_variable doneSignal;
+    std::condition_variable workSignal;     // A guest was queued
+    uint64_t generation;
+    unsigned running;
+    bool stopping;
+
+    void workerLoop(unsigned index);
+    bool takeGuest(unsigned index, Guest*& guest);
+    void runGuest(unsigned index, Guest& guest);
+    void enqueue(unsigned index, Guest& guest);
+};
+
+#endif // GPR_SCHEDULER_H
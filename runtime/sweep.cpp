@@ -0,0 +1,136 @@
+/**
+ * 16-bit GPR CPU Emulator - Input sweep implementation
+ */
+
+#include "sweep.h"
+#include <atomic>
+#include <thread>
+
+namespace {
+
+/** Inputs taken from the shared counter at a time. */
+constexpr uint64_t SWEEP_CHUNK = 1024;
+
+/** Sweeps larger than this are rejected (keeps the chunk counter from wrapping). */
+constexpr uint64_t SWEEP_MAX_INPUTS = uint64_t(1) << 62;
+
+void clear(SweepResult& r, size_t observed) {
+    r = SweepResult();
+    for (uint64_t& first : r.firstInput)
+        first = UINT64_MAX;
+    r.values.assign(observed, std::vector<uint64_t>(MEMORY_SIZE, 0));
+}
+
+/** Fold partial into total; sums, minimums and maximums only, so order does not matter. */
+void merge(SweepResult& total, const SweepResult& partial) {
+    total.inputs += partial.inputs;
+    total.cycles += partial.cycles;
+    if (partial.maxCycles > total.maxCycles)
+        total.maxCycles = partial.maxCycles;
+    for (size_t i = 0; i < STOP_REASON_COUNT; ++i) {
+        total.reasons[i] += partial.reasons[i];
+        if (partial.firstInput[i] < total.firstInput[i])
+            total.firstInput[i] = partial.firstInput[i];
+    }
+    for (size_t i = 0; i < 8; ++i)
+        total.flags[i] += partial.flags[i];
+    for (size_t k = 0; k < total.values.size(); ++k)
+        for (size_t v = 0; v < MEMORY_SIZE; ++v)
+            total.values[k][v] += partial.values[k][v];
+}
+
+/** One thread: its own Bus + CPU, chunks of inputs until none are left. */
+void sweepWorker(const Snapshot& start, const SweepOptions& o, uint64_t total,
+                 std::atomic<uint64_t>& next, SweepResult& out) {
+    Bus bus(start.base());
+    GPRCPU cpu(bus, o.engine);
+    const size_t axisCount = o.axes.size();
+    std::vector<uint16_t> words(axisCount);
+
+    for (;;) {
+        uint64_t first = next.fetch_add(SWEEP_CHUNK);
+        if (first >= total)
+            return;
+        uint64_t last = first + SWEEP_CHUNK < total ? first + SWEEP_CHUNK : total;
+        sweepInput(o, first, words.data());
+
+        for (uint64_t input = first; input < last; ++input) {
+            // --- RUN: fork from the start state, apply this input ---
+            start.restore(cpu, bus);
+            for (size_t a = 0; a < axisCount; ++a)
+                bus.write(o.axes[a].address, words[a]);
+            RunResult run = cpu.runFor(o.budget);
+
+            // --- RECORD ---
+            size_t reason = static_cast<size_t>(run.reason);
+            ++out.inputs;
+            out.cycles += run.cycles;
+            if (run.cycles > out.maxCycles)
+                out.maxCycles = run.cycles;
+            if (out.reasons[reason]++ == 0)
+                out.firstInput[reason] = input;     // Chunks are taken in order
+            ++out.flags[cpu.getState().FLAGS & (FLAG_ZERO | FLAG_CARRY | FLAG_NEGATIVE)];
+            for (size_t k = 0; k < o.observe.size(); ++k)
+                ++out.values[k][bus.read(o.observe[k])];
+
+            // --- NEXT: step the axes like an odometer, axes[0] fastest ---
+            for (size_t a = 0; a < axisCount; ++a) {
+                const SweepAxis& axis = o.axes[a];
+                if (static_cast<uint32_t>(words[a] - axis.first) + 1 < axis.count) {
+                    ++words[a];
+                    break;
+                }
+                words[a] = axis.first;
+            }
+        }
+    }
+}
+
+} // namespace
+
+void sweepInput(const SweepOptions& options, uint64_t index, uint16_t* words) {
+    for (const SweepAxis& axis : options.axes) {
+        *words++ = static_cast<uint16_t>(axis.first + index % axis.count);
+        index /= axis.count;
+    }
+}
+
+bool runSweep(const Snapshot& start, const SweepOptions& options, SweepResult& result, std::string& error) {
+    // --- Validate: total input count ---
+    uint64_t total = 1;
+    for (const SweepAxis& axis : options.axes) {
+        if (axis.count == 0 || axis.first + axis.count > MEMORY_SIZE) {
+            error = "input range past 0xFFFF or empty";
+            return false;
+        }
+        if (total > SWEEP_MAX_INPUTS / axis.count) {
+            error = "too many inputs";
+            return false;
+        }
+        total *= axis.count;
+    }
+
+    unsigned n = options.threads ? options.threads : std::thread::hardware_concurrency();
+    if (n == 0)
+        n = 1;
+    uint64_t chunks = (total + SWEEP_CHUNK - 1) / SWEEP_CHUNK;
+    if (n > chunks)
+        n = static_cast<unsigned>(chunks);
+
+    // --- Run: one partial result per thread, merged afterwards ---
+    std::vector<SweepResult> partials(n);
+    for (SweepResult& p : partials)
+        clear(p, options.observe.size());
+    std::atomic<uint64_t> next(0);
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < n; ++i)
+        threads.emplace_back(sweepWorker, std::cref(start), std::cref(options), total, std::ref(next),
+                             std::ref(partials[i]));
+    for (std::thread& t : threads)
+        t.join();
+
+    clear(result, options.observe.size());
+    for (const SweepResult& p : partials)
+        merge(result, p);
+    return true;
+}
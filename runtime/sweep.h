@@ -0,0 +1,60 @@
+/**
+ * 16-bit GPR CPU Emulator - Input sweep
+ * Runs one loaded machine state against every combination of a set of input
+ * words, on all cores, and aggregates the outcomes into histograms.
+ */
+
+#ifndef GPR_SWEEP_H
+#define GPR_SWEEP_H
+
+#include "gpr_cpu.h"
+#include "snapshot.h"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/** StopReason values, for tables indexed by reason. */
+constexpr size_t STOP_REASON_COUNT = static_cast<size_t>(StopReason::Yield) + 1;
+
+/** One swept input word: address takes first, first + 1, ... (count values). */
+struct SweepAxis {
+    uint16_t address;
+    uint16_t first;
+    uint32_t count;          // 1 .. 65536 - first
+};
+
+struct SweepOptions {
+    unsigned threads = 0;               // 0 = std::thread::hardware_concurrency()
+    Engine engine = Engine::Interpreter;
+    uint64_t budget = 100000;           // Max cycles per input; Budget = timed out
+    std::vector<SweepAxis> axes;        // Input index: axes[0] varies fastest
+    std::vector<uint16_t> observe;      // Memory words histogrammed (e.g. 0x102)
+};
+
+/**
+ * Aggregated outcomes. Every field is a sum, minimum or maximum over the
+ * inputs, so the result is identical for any thread count.
+ */
+struct SweepResult {
+    uint64_t inputs = 0;
+    uint64_t cycles = 0;                          // Total over all inputs
+    uint64_t maxCycles = 0;
+    uint64_t reasons[STOP_REASON_COUNT] = {};     // Inputs per StopReason
+    uint64_t firstInput[STOP_REASON_COUNT] = {};  // Lowest input index per reason (UINT64_MAX = none)
+    uint64_t flags[8] = {};                       // Inputs per final FLAGS & (Z | C | N)
+    std::vector<std::vector<uint64_t>> values;    // values[k][v]: inputs leaving observe[k] == v
+};
+
+/** Input index -> the value of each axis (one word per axis, in order). */
+void sweepInput(const SweepOptions& options, uint64_t index, uint16_t* words);
+
+/**
+ * Run every input: restore start, write the input words, runFor(budget),
+ * record the outcome. Each worker forks its own Bus from start's base image,
+ * and restoring start after a run copies back only the pages the run wrote.
+ * False with a message in error if the options are invalid.
+ */
+bool runSweep(const Snapshot& start, const SweepOptions& options, SweepResult& result, std::string& error);
+
+#endif // GPR_SWEEP_H
@@ -0,0 +1,305 @@
+/**
+ * 16-bit GPR CPU Emulator - Assembler equivalence test
+ *
+ * Assembles random programs with assemble() and checks the output against:
+ *  - the original two-pass assembler (kept below as referenceAssemble), on
+ *    programs in the syntax both accept: no label branches before the last
+ *    label (the old first pass counted them as one word) and MOVI values
+ *    below 512 (the old one truncated, assemble() widens to MOVW);
+ *  - IncrementalAssembler and a one-module linkSources(), which must write
+ *    exactly what assemble() does, or fail with the same error, on programs
+ *    with label branches anywhere and labels past 511.
+ * Sources mix case, number bases, comments, CRLF, .ORG and both .WORD forms.
+ *
+ * Usage: test_assembler_equiv [programs]   (exit status 0 on success)
+ */
+
+#include "assembler.h"
+#include "incremental.h"
+#include "linker.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// =============================================================================
+// REFERENCE: THE ORIGINAL TWO-PASS ASSEMBLER
+// =============================================================================
+
+int referenceOpcode(const std::string& mnem) {
+    static const char* const NAMES[] = {"HALT", "MOVI", "MOV", "LOAD", "STORE", "ADD", "SUB", "AND",
+                                        "OR",   "XOR",  "NOT", "SHL",  "SHR",   "JMP", "JZ",  "NOP"};
+    for (int op = 0; op < 16; ++op)
+        if (mnem == NAMES[op])
+            return op;
+    return -1;
+}
+
+std::string upper(std::string s) {
+    for (char& c : s)
+        if (c >= 'a' && c <= 'z')
+            c = static_cast<char>(c - 32);
+    return s;
+}
+
+uint16_t referenceNumber(const std::string& s) {
+    return static_cast<uint16_t>(std::stoul(s, nullptr, 0) & 0xFFFFu);
+}
+
+bool referenceReg(const std::string& s, uint8_t& r) {
+    std::string t = s;
+    while (t.size() >= 2 && t[0] == '(' && t.back() == ')')
+        t = t.substr(1, t.size() - 2);
+    if (t.size() < 2 || (t[0] != 'R' && t[0] != 'r'))
+        return false;
+    int n = std::stoi(t.substr(1), nullptr, 10);
+    if (n < 0 || n > 7)
+        return false;
+    r = static_cast<uint8_t>(n);
+    return true;
+}
+
+std::string trim(const std::string& s) {
+    size_t a = s.find_first_not_of(" \t\r\n");
+    if (a == std::string::npos)
+        return "";
+    return s.substr(a, s.find_last_not_of(" \t\r\n") - a + 1);
+}
+
+/** Comment-stripped line split at blanks and commas. */
+std::vector<std::string> referenceTokens(const std::string& rest) {
+    std::vector<std::string> tokens;
+    std::string cur;
+    for (size_t i = 0; i <= rest.size(); ++i) {
+        char c = i < rest.size() ? rest[i] : ' ';
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',') {
+            if (!cur.empty())
+                tokens.push_back(cur);
+            cur.clear();
+        } else {
+            cur += c;
+        }
+    }
+    return tokens;
+}
+
+uint16_t encRR(unsigned op, unsigned rd, unsigned rs) {
+    return static_cast<uint16_t>(((op & 15u) << 12) | ((rd & 7u) << 9) | ((rs & 7u) << 6));
+}
+
+uint16_t encMovi(unsigned rd, unsigned imm) {
+    return static_cast<uint16_t>((1u << 12) | ((rd & 7u) << 9) | (imm & 0x1FFu));
+}
+
+/** The assembler as first shipped: labels in pass one, words in pass two. */
+AssembleResult referenceAssemble(const std::string& source, uint16_t* mem, size_t memSize) {
+    AssembleResult res{true, "", 0};
+    auto failAt = [&](size_t lineNum, const char* error) {
+        res = AssembleResult{false, error, lineNum};
+        return res;
+    };
+    std::map<std::string, uint16_t> labels;
+    for (int pass = 0; pass < 2; ++pass) {
+        std::istringstream in(source);
+        std::string line;
+        size_t lineNum = 0;
+        uint16_t pc = 0;
+        while (std::getline(in, line)) {
+            ++lineNum;
+            std::string rest = trim(line.substr(0, line.find(';')));
+            if (rest.empty())
+                continue;
+            if (rest.back() == ':') {
+                std::string name = trim(rest.substr(0, rest.size() - 1));
+                if (pass == 0 && !name.empty())
+                    labels[upper(name)] = pc;
+                continue;
+            }
+            std::vector<std::string> tok = referenceTokens(rest);
+            std::string cmd = upper(tok[0]);
+            if (cmd == ".ORG") {
+                if (tok.size() < 2)
+                    return failAt(lineNum, ".ORG requires address");
+                pc = referenceNumber(tok[1]);
+                continue;
+            }
+            if (cmd == ".WORD") {
+                if (tok.size() == 1)
+                    return failAt(lineNum, ".WORD requires value");
+                if (tok.size() >= 3) {
+                    uint16_t addr = referenceNumber(tok[1]);
+                    if (pass == 1 && addr < memSize)
+                        mem[addr] = referenceNumber(tok[2]);
+                } else {
+                    if (pass == 1 && pc < memSize)
+                        mem[pc] = referenceNumber(tok[1]);
+                    pc++;
+                }
+                continue;
+            }
+            int op = referenceOpcode(cmd);
+            if (op < 0)
+                return failAt(lineNum, "Unknown");
+            if (pass == 0) {
+                pc++;                                       // Label branches counted as one word
+                continue;
+            }
+            if (pc >= memSize)
+                return failAt(lineNum, "Program too large");
+            auto value = [&](const std::string& arg) {
+                return labels.count(upper(arg)) ? labels[upper(arg)] : referenceNumber(arg);
+            };
+            uint8_t rd = 0, rs = 0;
+            uint16_t inst = 0;
+            if (op == 1) {
+                if (tok.size() < 3)
+                    return failAt(lineNum, "MOVI Rd, imm");
+                if (!referenceReg(tok[1], rd))
+                    return failAt(lineNum, "Invalid register");
+                inst = encMovi(rd, value(tok[2]));
+            } else if (op == 13 || op == 14) {
+                if (tok.size() < 2)
+                    return failAt(lineNum, "JMP/JZ needs target");
+                if (referenceReg(tok[1], rs)) {
+                    inst = encRR(op, 0, rs);
+                } else {
+                    uint16_t target = value(tok[1]);
+                    if (target > 0x1FF)
+                        return failAt(lineNum, "Jump target > 511");
+                    mem[pc++] = encMovi(7, target);
+                    inst = encRR(op, 0, 7);
+                }
+            } else if (op >= 2 && op <= 12) {
+                if (tok.size() < 2)
+                    return failAt(lineNum, "Needs operands");
+                if (!referenceReg(tok[1], rd))
+                    return failAt(lineNum, "Invalid Rd");
+                if (op >= 10)
+                    rs = rd;
+                else if (tok.size() >= 3 && !referenceReg(tok[2], rs))
+                    rs = static_cast<uint8_t>(value(tok[2]) & 7);
+                inst = encRR(op, rd, rs);
+            } else if (op == 15) {
+                inst = 0xF000;
+            }
+            mem[pc++] = inst;
+        }
+    }
+    return res;
+}
+
+// =============================================================================
+// PROGRAM GENERATOR
+// =============================================================================
+
+/**
+ * Random source of up to 60 lines. With oldSyntax, label branches only follow
+ * the last label and MOVI numbers and labels stay below 512; otherwise labels
+ * past 511 make far branches and MOVI label errors.
+ */
+std::string generate(std::mt19937& rng, bool oldSyntax) {
+    static const char* const OPS[] = {"HALT", "MOVI", "mov", "LOAD", "Store", "ADD", "SUB", "AND", "OR", "XOR",
+                                      "NOT",  "SHL",  "SHR", "JMP",  "JZ",    "NOP", ".ORG", ".WORD", "nop"};
+    auto reg = [&] {
+        static const char* const FORMS[] = {"(R%u)", "r%u", "R%u", "R%u"};
+        char b[8];
+        std::snprintf(b, sizeof b, FORMS[rng() % 4], static_cast<unsigned>(rng() % 8));
+        return std::string(b);
+    };
+    auto num = [&](unsigned limit) {
+        static const char* const FORMS[] = {"%u", "0x%x", "0%o"};
+        char b[16];
+        std::snprintf(b, sizeof b, FORMS[rng() % 3], static_cast<unsigned>(rng() % limit));
+        return std::string(b);
+    };
+    std::vector<std::string> labels;
+    std::string src;
+    unsigned lines = 1 + rng() % 60;
+    for (unsigned i = 0; i < lines; ++i) {
+        unsigned k = rng() % 22;
+        bool labelsDone = !oldSyntax || i >= lines / 2;
+        if (k >= 19) {
+            if (oldSyntax && labelsDone) {
+                src += "NOP\n";
+                continue;
+            }
+            std::string name = "L" + std::to_string(labels.size());
+            labels.push_back(name);
+            src += (rng() % 2 ? name : "  " + name) + ":  ; c\n";
+            continue;
+        }
+        auto label = [&] { return labels[rng() % labels.size()]; };
+        std::string line = OPS[k];
+        if (k == 1) {
+            line += " " + reg() + ", " + (!labels.empty() && rng() % 2 ? label() : num(oldSyntax ? 512 : 600));
+        } else if (k >= 2 && k <= 12) {
+            line += " " + reg();
+            if (rng() % 3)
+                line += ", " + (rng() % 5 == 0 && !labels.empty() ? label() : reg());
+        } else if (k == 13 || k == 14) {
+            if (labelsDone && !labels.empty() && rng() % 2)
+                line += " " + label();
+            else if (!labelsDone || rng() % 2)
+                line += " " + reg();
+            else
+                line += " " + std::to_string(rng() % 512);
+        } else if (k == 16) {
+            line += " " + std::to_string(rng() % (oldSyntax ? 400 : 700));
+        } else if (k == 17) {
+            line += " " + num(600);
+            if (rng() % 2)
+                line += " " + num(600);
+        }
+        if (rng() % 4 == 0)
+            line += " ; comment, x";
+        src += line + (rng() % 5 == 0 ? "\r\n" : "\n");
+    }
+    return src;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int programs = argc > 1 ? std::atoi(argv[1]) : 20000;
+    int failures = 0;
+    auto report = [&](int seed, const char* against, const AssembleResult& want, const AssembleResult& got,
+                      const std::string& src) {
+        if (++failures <= 5)
+            std::printf("program %d, %s: ok %d/%d, error '%s' @%zu / '%s' @%zu\n%s\n", seed, against, want.ok,
+                        got.ok, want.error.c_str(), want.lineNum, got.error.c_str(), got.lineNum, src.c_str());
+    };
+    std::vector<uint16_t> mem(65536), ref(65536), inc(65536), linked(65536);
+    for (int seed = 0; seed < programs; ++seed) {
+        std::mt19937 rng(seed);
+        bool oldSyntax = seed % 2 == 0;
+        std::string src = generate(rng, oldSyntax);
+        for (std::vector<uint16_t>* buffer : {&mem, &ref, &inc, &linked})
+            std::fill(buffer->begin(), buffer->end(), 0);
+        AssembleResult ar = assemble(src, mem.data(), mem.size());
+
+        if (oldSyntax) {
+            AssembleResult rr = referenceAssemble(src, ref.data(), ref.size());
+            if (rr.ok != ar.ok || (ar.ok && ref != mem) || (!ar.ok && rr.lineNum != ar.lineNum))
+                report(seed, "two-pass reference", rr, ar, src);
+        }
+
+        IncrementalAssembler incremental(inc.data(), inc.size());
+        AssembleResult ir = incremental.assemble(src);
+        if (ir.ok != ar.ok || (ar.ok && inc != mem) || (!ar.ok && (ir.error != ar.error || ir.lineNum != ar.lineNum)))
+            report(seed, "incremental", ar, ir, src);
+
+        LinkResult lr = linkSources({src}, linked.data(), linked.size());
+        AssembleResult lar{lr.ok, lr.error, lr.lineNum};
+        if (lr.ok != ar.ok || (ar.ok && linked != mem) ||
+            (!ar.ok && (lr.error != ar.error || lr.lineNum != ar.lineNum)))
+            report(seed, "linker", ar, lar, src);
+    }
+    std::printf("%d programs, %d mismatches\n", programs, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,259 @@
+/**
+ * 16-bit GPR CPU Emulator - Budgeted run test
+ *
+ * Checks that runFor() stops at the same instruction on every engine as a
+ * counted step() loop: for one whole budget and for the same budget cut
+ * into random slices, including the final HALT. Also checks breakpoint
+ * stops and resumes, and stop() requests from a device. Programs include
+ * endless NOP / ADD runs across the wrap from 0xFFFF, an endless loop and
+ * random halting code.
+ *
+ * Usage: test_budget_slicing [programs]   (exit status 0 on success)
+ */
+
+#include "gpr_cpu.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+const Engine ENGINES[] = {Engine::Interpreter, Engine::Threaded, Engine::Jit};
+
+const char* engineName(Engine e) {
+    return e == Engine::Interpreter ? "interp" : e == Engine::Threaded ? "threaded" : "jit";
+}
+
+uint16_t enc(unsigned op, unsigned rd, unsigned rs) {
+    return static_cast<uint16_t>((op << 12) | (rd << 9) | (rs << 6));
+}
+
+uint16_t encMovi(unsigned rd, unsigned imm) {
+    return static_cast<uint16_t>((1u << 12) | (rd << 9) | (imm & 0x1FFu));
+}
+
+/** Registers, PC, flags, halt state, cycles and a memory hash. */
+struct Outcome {
+    uint16_t R[8];
+    uint16_t PC;
+    uint16_t FLAGS;
+    bool halted;
+    uint64_t cycles;
+    uint64_t memory;
+
+    bool operator==(const Outcome& o) const {
+        return std::memcmp(R, o.R, sizeof R) == 0 && PC == o.PC && FLAGS == o.FLAGS && halted == o.halted &&
+               cycles == o.cycles && memory == o.memory;
+    }
+};
+
+Outcome outcome(GPRCPU& cpu, const Bus& bus, uint64_t cycles) {
+    const CPUState& s = cpu.getState();
+    Outcome o;
+    std::memcpy(o.R, s.R, sizeof o.R);
+    o.PC = s.PC;
+    o.FLAGS = s.FLAGS;
+    o.halted = s.halted;
+    o.cycles = cycles;
+    o.memory = 1469598103934665603ull;
+    for (size_t a = 0; a < MEMORY_SIZE; ++a)
+        o.memory = (o.memory ^ bus.read(static_cast<uint16_t>(a))) * 1099511628211ull;
+    return o;
+}
+
+// =============================================================================
+// PROGRAMS
+// =============================================================================
+
+/** Program for seed: kinds 0-2 never halt, the rest halt after a loop. */
+void generate(int seed, std::mt19937& rng, std::vector<uint16_t>& mem) {
+    std::fill(mem.begin(), mem.end(), 0);
+    unsigned kind = seed % 10;
+    if (kind == 0) {
+        std::fill(mem.begin(), mem.end(), 0xF000);                  // NOPs, wrapping forever
+        return;
+    }
+    if (kind == 1) {
+        std::fill(mem.begin(), mem.end(), enc(5, 1, 2));            // ADD R1, R2, wrapping forever
+        mem[0] = encMovi(2, 3);
+        return;
+    }
+    for (unsigned i = 0; i < 64; ++i)
+        mem[0x100 + i] = static_cast<uint16_t>(rng());
+    unsigned len = 20 + rng() % 200;
+    mem[0] = encMovi(6, 1 + rng() % 200);
+    mem[1] = encMovi(5, 1);
+    for (unsigned pc = 2; pc < len + 2;) {
+        unsigned pick = rng() % 20, rd = rng() % 5, rs = rng() % 5;
+        if (pick < 3) {
+            mem[pc++] = encMovi(rd, rng() % 512);
+        } else if (pick < 5 && pc + 3 < len + 2) {
+            unsigned target = pc + 2 + rng() % 10;
+            mem[pc++] = encMovi(7, target < len + 2 ? target : len + 2);
+            mem[pc++] = enc(rng() & 1 ? 13 : 14, 0, 7);             // JMP / JZ R7
+        } else if (pick < 7 && pc + 2 < len + 2) {
+            mem[pc++] = encMovi(rs, 0x100 + rng() % 64);
+            mem[pc++] = enc(pick == 5 ? 3 : 4, rd, rs);             // LOAD / STORE
+        } else {
+            mem[pc++] = enc(5 + rng() % 8, rd, rs);                 // ADD .. SHR
+        }
+    }
+    unsigned end = len + 2;
+    if (kind == 2) {
+        mem[end] = encMovi(7, 2);                                   // Loop forever
+        mem[end + 1] = enc(13, 0, 7);
+        return;
+    }
+    mem[end] = encMovi(7, end + 5);
+    mem[end + 1] = enc(6, 6, 5);                                    // SUB R6, R5
+    mem[end + 2] = enc(14, 0, 7);                                   // JZ R7 (HALT)
+    mem[end + 3] = encMovi(7, 2);
+    mem[end + 4] = enc(13, 0, 7);
+    mem[end + 5] = 0x0000;
+}
+
+// =============================================================================
+// CHECKS
+// =============================================================================
+
+int failures = 0;
+
+void fail(const char* what, int seed, Engine e, uint64_t budget) {
+    if (++failures <= 10)
+        std::printf("%s: program %d, %s engine, budget %llu\n", what, seed, engineName(e),
+                    (unsigned long long)budget);
+}
+
+/** Whole and sliced runs of budget against step(). */
+void checkBudget(int seed, std::mt19937& rng, const std::shared_ptr<const MemoryImage>& image, uint64_t budget) {
+    Bus refBus(image);
+    GPRCPU ref(refBus, Engine::Interpreter);
+    uint64_t steps = 0;
+    while (steps < budget && ref.step())
+        ++steps;
+    Outcome want = outcome(ref, refBus, steps);
+
+    for (Engine e : ENGINES) {
+        {
+            Bus bus(image);
+            GPRCPU cpu(bus, e);
+            RunResult r = cpu.runFor(budget);
+            if (!(outcome(cpu, bus, r.cycles) == want) ||
+                r.reason != (want.halted ? StopReason::Halted : StopReason::Budget))
+                fail("whole budget", seed, e, budget);
+        }
+        {
+            Bus bus(image);
+            GPRCPU cpu(bus, e);
+            uint64_t total = 0;
+            while (total < budget) {
+                uint64_t slice = 1 + rng() % (rng() % 2 ? 100 : 100000);
+                RunResult r = cpu.runFor(std::min(slice, budget - total));
+                total += r.cycles;
+                if (r.reason != StopReason::Budget)
+                    break;
+            }
+            if (!(outcome(cpu, bus, total) == want))
+                fail("sliced budget", seed, e, budget);
+        }
+    }
+}
+
+/** Every hit of a breakpoint stops the run once, and the totals match step(). */
+void checkBreakpoint(int seed, std::mt19937& rng, const std::shared_ptr<const MemoryImage>& image) {
+    const uint64_t LIMIT = 200000;
+    uint16_t address = static_cast<uint16_t>(2 + rng() % 20);
+    Bus refBus(image);
+    GPRCPU ref(refBus, Engine::Interpreter);
+    uint64_t hits = 0, steps = 0;
+    while (steps < LIMIT) {
+        if (ref.getPC() == address)
+            ++hits;
+        if (!ref.step())
+            break;
+        ++steps;
+    }
+    for (Engine e : ENGINES) {
+        Bus bus(image);
+        GPRCPU cpu(bus, e);
+        cpu.setBreakpoint(address);
+        uint64_t stops = 0, total = 0;
+        for (;;) {
+            RunResult r = cpu.runFor(LIMIT - total);
+            total += r.cycles;
+            if (r.reason != StopReason::Breakpoint)
+                break;
+            ++stops;
+            if (cpu.getPC() != address)
+                break;
+        }
+        if (stops != hits || total != steps)
+            fail("breakpoint", seed, e, LIMIT);
+    }
+}
+
+/** A device that yields on reads and faults on writes. */
+class StoppingDevice : public MmioDevice {
+public:
+    GPRCPU* cpu = nullptr;
+
+    uint16_t read(uint16_t) override {
+        cpu->stop(StopReason::Yield);
+        return 7;
+    }
+
+    void write(uint16_t, uint16_t) override { cpu->stop(StopReason::Fault); }
+};
+
+/** stop() from a device ends the run after the access, on every engine. */
+void checkDeviceStop() {
+    std::vector<uint16_t> mem(MEMORY_SIZE);
+    unsigned pc = 0;
+    mem[pc++] = encMovi(1, 0x100);
+    for (int i = 0; i < 7; ++i)
+        mem[pc++] = enc(11, 1, 0);              // SHL R1: 0x8000
+    mem[pc++] = enc(3, 2, 1);                   // 8: LOAD R2, (R1)
+    mem[pc++] = enc(5, 3, 2);                   // ADD R3, R2
+    mem[pc++] = enc(4, 3, 1);                   // STORE R3, (R1)
+    mem[pc++] = encMovi(7, 8);
+    mem[pc++] = enc(13, 0, 7);                  // JMP 8
+    auto image = MemoryImage::copyOf(mem.data());
+    for (Engine e : ENGINES) {
+        Bus bus(image);
+        StoppingDevice device;
+        bus.mapDevice(0x80, 1, &device);
+        GPRCPU cpu(bus, e);
+        device.cpu = &cpu;
+        RunResult r1 = cpu.runFor(1000000);     // MOVI, 7 SHL, LOAD
+        RunResult r2 = cpu.runFor(1000000);     // ADD, STORE
+        RunResult r3 = cpu.runFor(1000000);     // MOVI, JMP, LOAD
+        if (r1.cycles != 9 || r1.reason != StopReason::Yield || r2.cycles != 2 || r2.reason != StopReason::Fault ||
+            r3.cycles != 3 || r3.reason != StopReason::Yield || cpu.getState().R[3] != 7)
+            fail("device stop", -1, e, 1000000);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int programs = argc > 1 ? std::atoi(argv[1]) : 200;
+    std::vector<uint16_t> mem(MEMORY_SIZE);
+    for (int seed = 0; seed < programs; ++seed) {
+        std::mt19937 rng(seed);
+        generate(seed, rng, mem);
+        auto image = MemoryImage::copyOf(mem.data());
+        // Short, long and past the threaded engine's 65,536-instruction check window
+        for (uint64_t budget : {uint64_t(rng() % 50), uint64_t(rng() % 5000), uint64_t(65536 + rng() % 300000),
+                                uint64_t(rng() % 300000)})
+            checkBudget(seed, rng, image, budget);
+        if (seed % 10 >= 3)
+            checkBreakpoint(seed, rng, image);
+    }
+    checkDeviceStop();
+    std::printf("%d programs, %d failures\n", programs, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,155 @@
+/**
+ * 16-bit GPR CPU Emulator - Engine differential test
+ *
+ * Runs random programs on the threaded and JIT engines and compares the
+ * final registers, flags, PC, halt state, cycle count and memory with the
+ * interpreter. The programs mix ALU ops, loads, stores (some into their own
+ * code), MOVI / JMP / JZ pairs, two-word extended ops and a closing loop, and
+ * are placed low, high and across the wrap from 0xFFFF to 0.
+ *
+ * Usage: test_engine_diff [programs]   (exit status 0 on success)
+ */
+
+#include "gpr_cpu.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+const uint64_t CYCLE_LIMIT = 300000;
+
+uint16_t enc(unsigned op, unsigned rd, unsigned rs) {
+    return static_cast<uint16_t>((op << 12) | (rd << 9) | (rs << 6));
+}
+
+uint16_t encMovi(unsigned rd, unsigned imm) {
+    return static_cast<uint16_t>((1u << 12) | (rd << 9) | (imm & 0x1FFu));
+}
+
+uint16_t encExt(unsigned ext, unsigned rd) {
+    return static_cast<uint16_t>(0xF000u | (rd << 9) | ext);
+}
+
+// =============================================================================
+// PROGRAM GENERATOR
+// =============================================================================
+
+/**
+ * Fill mem[base .. base + len) with random code. Branch targets stay inside
+ * the block or at its end; with smc, some stores hit the code itself. Data
+ * lives at 0x100 .. 0x13F.
+ */
+void generate(std::mt19937& rng, std::vector<uint16_t>& mem, unsigned base, unsigned len, bool smc) {
+    unsigned pc = 0;
+    auto put = [&](uint16_t w) { mem[static_cast<uint16_t>(base + pc++)] = w; };
+    while (pc < len) {
+        unsigned kind = rng() % 24;
+        unsigned rd = rng() % 5, rs = rng() % 5;
+        unsigned target = pc + 2 + rng() % 10;
+        if (target > len)
+            target = len;
+        if (kind < 3) {
+            put(encMovi(rd, rng() % 512));
+        } else if (kind < 5 && pc + 3 < len) {
+            // Far form of a label branch: JMPW/JZW R7, target
+            put(encExt(rng() % 4 == 0 ? 3 : 2, 7));
+            put(static_cast<uint16_t>(base + target));
+        } else if (kind == 5 && pc + 2 < len) {
+            put(encMovi(rs, 0x100 + rng() % 64));
+            put(enc(3, rd, rs));                            // LOAD
+        } else if (kind == 6 && pc + 3 < len) {
+            unsigned address = smc && rng() % 3 == 0 ? base + rng() % len : 0x100 + rng() % 64;
+            put(encExt(1, rs));                             // MOVW rs, address
+            put(static_cast<uint16_t>(address));
+            put(enc(4, rd, rs));                            // STORE
+        } else if (kind == 7) {
+            put(0xF000);                                    // NOP
+        } else if (kind == 8 && pc + 2 < len) {
+            put(encExt(1, rd));                             // MOVW rd, random
+            put(static_cast<uint16_t>(rng()));
+        } else if (kind == 9 && pc + 2 < len) {
+            put(encMovi(rs, 0x100 + rng() % 64));
+            put(enc(2, rd, rs));                            // MOV
+        } else {
+            put(enc(5 + rng() % 8, rd, rs));                // ADD .. SHR
+        }
+    }
+    // Loop back R6 times (R5 = 1), then halt
+    unsigned end = base + len;
+    auto at = [&](unsigned offset, uint16_t w) { mem[static_cast<uint16_t>(end + offset)] = w; };
+    at(0, encExt(1, 7));
+    at(1, static_cast<uint16_t>(end + 7));
+    at(2, enc(6, 6, 5));                                    // SUB R6, R5
+    at(3, enc(14, 0, 7));                                   // JZ R7
+    at(4, encExt(2, 7));                                    // JMPW R7, base
+    at(5, static_cast<uint16_t>(base));
+    at(6, 0xF000);
+    at(7, 0x0000);                                          // HALT
+}
+
+// =============================================================================
+// RUNS
+// =============================================================================
+
+/** Final machine state of one run, as text. */
+std::string runProgram(const std::shared_ptr<const MemoryImage>& image, uint16_t start, Engine engine,
+                       uint64_t quantum) {
+    Bus bus(image);
+    GPRCPU cpu(bus, engine);
+    cpu.getState().PC = start;
+    uint64_t cycles = 0;
+    while (cycles < CYCLE_LIMIT) {
+        RunResult r = cpu.runFor(std::min(quantum, CYCLE_LIMIT - cycles));
+        cycles += r.cycles;
+        if (r.reason != StopReason::Budget)
+            break;
+    }
+    const CPUState& s = cpu.getState();
+    uint64_t hash = 1469598103934665603ull;
+    for (size_t a = 0; a < MEMORY_SIZE; ++a)
+        hash = (hash ^ bus.read(static_cast<uint16_t>(a))) * 1099511628211ull;
+    char buf[160];
+    int n = std::snprintf(buf, sizeof buf, "cycles=%llu PC=%04X FLAGS=%04X halted=%d", (unsigned long long)cycles,
+                          s.PC, s.FLAGS, s.halted ? 1 : 0);
+    for (unsigned i = 0; i < 8; ++i)
+        n += std::snprintf(buf + n, sizeof buf - n, " R%u=%04X", i, s.R[i]);
+    std::snprintf(buf + n, sizeof buf - n, " mem=%016llx", (unsigned long long)hash);
+    return buf;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int programs = argc > 1 ? std::atoi(argv[1]) : 1000;
+    int failures = 0;
+    std::vector<uint16_t> mem(MEMORY_SIZE);
+    for (int seed = 0; seed < programs; ++seed) {
+        std::mt19937 rng(seed);
+        std::fill(mem.begin(), mem.end(), 0);
+        for (unsigned i = 0; i < 64; ++i)
+            mem[0x100 + i] = static_cast<uint16_t>(rng());
+        unsigned len = 20 + rng() % 300;
+        unsigned base = seed % 3 == 0 ? 0x400 : seed % 3 == 1 ? 0x2000 + rng() % 0x100 : 0xFF80;
+        mem[base] = encMovi(6, 1 + rng() % 20);
+        mem[base + 1] = encMovi(5, 1);
+        generate(rng, mem, base + 2, len, seed % 2 != 0);
+        auto image = MemoryImage::copyOf(mem.data());
+
+        std::string want = runProgram(image, static_cast<uint16_t>(base), Engine::Interpreter, CYCLE_LIMIT);
+        for (Engine engine : {Engine::Threaded, Engine::Jit}) {
+            for (uint64_t quantum : {CYCLE_LIMIT, uint64_t(7), uint64_t(100), uint64_t(70000)}) {
+                std::string got = runProgram(image, static_cast<uint16_t>(base), engine, quantum);
+                if (got != want && ++failures <= 10)
+                    std::printf("program %d, %s engine, quantum %llu:\n  want %s\n  got  %s\n", seed,
+                                engine == Engine::Jit ? "jit" : "threaded", (unsigned long long)quantum,
+                                want.c_str(), got.c_str());
+            }
+        }
+    }
+    std::printf("%d programs, %d mismatches\n", programs, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+/**
+ * 16-bit GPR CPU Emulator - Peephole regression test
+ *
+ * Programs that the -O pass once got wrong, or must keep optimizing. Each
+ * runs assembled with and without the pass and must halt with the same
+ * R0-R6 and flags (R7 holds a label address, which may move); the note says
+ * whether the pass was expected to apply.
+ *
+ * Usage: test_peephole_regression   (exit status 0 on success)
+ */
+
+#include "assembler.h"
+#include "gpr_cpu.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Case {
+    const char* name;
+    std::string source;
+    bool optimized;         // The pass applies (else it must refuse)
+};
+
+std::string nops(unsigned count) {
+    std::string s;
+    for (unsigned i = 0; i < count; ++i)
+        s += "NOP\n";
+    return s;
+}
+
+/** State after running mem from address 0 until it halts (or 100,000 instructions). */
+CPUState runProgram(const std::vector<uint16_t>& mem) {
+    Bus bus(MemoryImage::copyOf(mem.data()));
+    GPRCPU cpu(bus);
+    cpu.runFor(100000);
+    return cpu.getState();
+}
+
+} // namespace
+
+int main() {
+    const Case cases[] = {
+        // Falls from the NOPs at 0 into the block at 0x10: compacting the NOPs
+        // away left zero words (HALT) at 0 and R1 was never set
+        {"fall into an earlier .ORG block", ".ORG 0x10\nMOVI R1, 5\nHALT\n.ORG 0\n" + nops(16), false},
+        {"jump into an earlier .ORG block",
+         ".ORG 0x10\nstart:\nMOVI R1, 5\nHALT\n.ORG 0\n" + nops(8) + "JMP start\n", true},
+        {"fall into the next word of the same block", "MOVI R1, 5\n" + nops(8) + "ADD R1, R1\nHALT\n", true},
+    };
+    int failures = 0;
+    for (const Case& c : cases) {
+        std::vector<uint16_t> plain(MEMORY_SIZE, 0), optimized(MEMORY_SIZE, 0);
+        AssembleInfo info;
+        AssembleOptions options;
+        options.optimize = true;
+        AssembleResult pr = assemble(c.source, plain.data(), plain.size());
+        AssembleResult orr = assemble(c.source, optimized.data(), optimized.size(), &info, options);
+        if (!pr.ok || !orr.ok) {
+            std::printf("%s: does not assemble: %s\n", c.name, (pr.ok ? orr : pr).error.c_str());
+            ++failures;
+            continue;
+        }
+        CPUState want = runProgram(plain);
+        CPUState got = runProgram(optimized);
+        bool same = want.halted && got.halted && want.FLAGS == got.FLAGS;
+        for (unsigned r = 0; r < 7; ++r)
+            same = same && want.R[r] == got.R[r];
+        bool applied = info.optimizeNote.compare(0, 14, "not optimized:") != 0;
+        if (!same || applied != c.optimized) {
+            std::printf("%s: R1 %04X / %04X, halted %d / %d, %s\n", c.name, want.R[1], got.R[1], want.halted,
+                        got.halted, info.optimizeNote.c_str());
+            ++failures;
+        }
+    }
+    std::printf("%zu programs, %d failures\n", sizeof cases / sizeof cases[0], failures);
+    return failures ? 1 : 0;
+}
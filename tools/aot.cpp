@@ -0,0 +1,105 @@
+/**
+ * 16-bit GPR CPU Emulator - Ahead-of-time translator front end
+ *
+ * Usage: gpr_aot program.asm|program.gpri [-o program_aot.cpp] [-n name] [-e entry]
+ * Translates a program to C++ source for one function,
+ *
+ *     RunResult name(GPRCPU& cpu, Bus& bus, uint64_t maxCycles);
+ *
+ * to compile into a host program (see runtime/aot.h). The default output is
+ * the input with its extension replaced by _aot.cpp, the default name aot_
+ * plus the input's file name, and the default entry point 0 for .asm files
+ * or the image's entry point.
+ */
+
+#include "aot.h"
+#include "assembler.h"
+#include "program_image.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    const char* input = nullptr;
+    unsigned inputs = 0;
+    std::string output;
+    AotOptions options;
+    options.name.clear();
+    long entry = -1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            options.name = argv[++i];
+        } else if (std::strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            entry = std::strtol(argv[++i], nullptr, 0) & 0xFFFF;
+        } else if (argv[i][0] == '-') {
+            std::fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        } else {
+            ++inputs;
+            input = argv[i];
+        }
+    }
+    if (inputs != 1) {
+        std::fprintf(stderr, "Usage: %s program.asm|program.gpri [-o program_aot.cpp] [-n name] [-e entry]\n",
+                     argv[0]);
+        return 1;
+    }
+    // path/to/file.ext: file names the function and the source, path/to/file the output
+    std::string path = input;
+    size_t slash = path.find_last_of('/');
+    std::string file = slash == std::string::npos ? path : path.substr(slash + 1);
+    std::string base = file.substr(0, file.find_last_of('.'));
+    std::string stem = path.substr(0, path.size() - (file.size() - base.size()));
+    if (output.empty())
+        output = stem + "_aot.cpp";
+    if (options.name.empty()) {
+        options.name = "aot_";
+        for (char c : base)
+            options.name += (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ? c : '_';
+    }
+
+    std::vector<uint16_t> mem(MEMORY_SIZE);
+    std::vector<AssembleSegment> segments;
+    uint16_t imageEntry = 0;
+    if (ProgramImage::isImage(input)) {
+        std::string error;
+        std::shared_ptr<const ProgramImage> image = ProgramImage::open(input, error);
+        if (!image) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        image->memory()->copyTo(mem.data());
+        segments = image->segments();
+        imageEntry = image->entry();
+    } else {
+        AssembleInfo info;
+        AssembleResult ar = assembleFile(input, mem.data(), mem.size(), &info);
+        if (!ar.ok) {
+            std::fprintf(stderr, "%s:%zu: %s\n", input, ar.lineNum, ar.error.c_str());
+            return 1;
+        }
+        segments = info.segments;
+    }
+    options.entry = entry < 0 ? imageEntry : static_cast<uint16_t>(entry);
+    options.source = file;
+
+    std::string source;
+    AotResult result = translateToCpp(mem.data(), segments, source, options);
+    if (!result.ok) {
+        std::fprintf(stderr, "%s: %s\n", input, result.error.c_str());
+        return 1;
+    }
+    FILE* f = std::fopen(output.c_str(), "w");
+    if (!f || std::fwrite(source.data(), 1, source.size(), f) != source.size()) {
+        std::fprintf(stderr, "Cannot write %s\n", output.c_str());
+        if (f)
+            std::fclose(f);
+        return 1;
+    }
+    std::fclose(f);
+    return 0;
+}
@@ -0,0 +1,108 @@
+/**
+ * 16-bit GPR CPU Emulator - Assembler front end
+ *
+ * Usage: gpr_asm program.asm [-o program.gpri] [-O] [-l listing.lst]
+ *        gpr_asm module.asm... [-o program.gpri] [-j threads]
+ * Assembles to a binary program image (see runtime/program_image.h) that
+ * gpr_emulator loads without reassembling. The default output name is the
+ * (first) input with its extension replaced by .gpri. -O runs the peephole
+ * pass, -l writes an address / word / source listing ("-" = stdout).
+ * Several inputs are assembled in parallel as modules and linked (see
+ * assembler/linker.h); -j caps the threads.
+ */
+
+#include "assembler.h"
+#include "linker.h"
+#include "program_image.h"
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static int usage(const char* program) {
+    std::fprintf(stderr, "Usage: %s program.asm [-o program.gpri] [-O] [-l listing.lst]\n"
+                         "       %s module.asm... [-o program.gpri] [-j threads]\n", program, program);
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> inputs;
+    std::string output;
+    LinkOptions linkOptions;
+    const char* listing = nullptr;
+    AssembleOptions options;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (std::strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            listing = argv[++i];
+            options.listing = true;
+        } else if (std::strcmp(argv[i], "-O") == 0) {
+            options.optimize = true;
+        } else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            const char* value = argv[++i];
+            char* end;
+            unsigned long threads = std::strtoul(value, &end, 10);
+            if (end == value || *end || value[0] == '-' || threads > UINT_MAX) {
+                std::fprintf(stderr, "-j expects a thread count, got %s\n", value);
+                return usage(argv[0]);
+            }
+            linkOptions.threads = static_cast<unsigned>(threads);
+        } else if (argv[i][0] == '-') {
+            std::fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+    if (inputs.empty() || (inputs.size() > 1 && (options.optimize || options.listing)))
+        return usage(argv[0]);
+    const char* input = inputs[0].c_str();
+    if (output.empty()) {
+        output = input;
+        size_t dot = output.find_last_of("./");
+        if (dot != std::string::npos && output[dot] == '.')
+            output.erase(dot);
+        output += ".gpri";
+    }
+
+    std::vector<uint16_t> mem(MEMORY_SIZE);
+    AssembleInfo info;
+    if (inputs.size() > 1) {
+        LinkResult lr = linkFiles(inputs, mem.data(), mem.size(), &info, linkOptions);
+        if (!lr.ok) {
+            std::fprintf(stderr, "%s:%zu: %s", inputs[lr.module].c_str(), lr.lineNum, lr.error.c_str());
+            if (lr.otherModule < inputs.size())
+                std::fprintf(stderr, " (%s:%zu)", inputs[lr.otherModule].c_str(), lr.otherLine);
+            std::fprintf(stderr, "\n");
+            return 1;
+        }
+    }
+    AssembleResult ar = inputs.size() > 1 ? AssembleResult{true, "", 0}
+                                          : assembleFile(input, mem.data(), mem.size(), &info, options);
+    if (!ar.ok) {
+        std::fprintf(stderr, "%s:%zu: %s\n", input, ar.lineNum, ar.error.c_str());
+        return 1;
+    }
+    if (options.optimize)
+        std::fprintf(stderr, "%s: %s\n", input, info.optimizeNote.c_str());
+    if (listing) {
+        FILE* f = std::strcmp(listing, "-") == 0 ? stdout : std::fopen(listing, "w");
+        if (!f) {
+            std::fprintf(stderr, "Cannot write %s\n", listing);
+            return 1;
+        }
+        std::fwrite(info.listing.data(), 1, info.listing.size(), f);
+        if (f != stdout)
+            std::fclose(f);
+    }
+
+    std::string error;
+    if (!writeProgramImage(output.c_str(), mem.data(), info, 0, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,707 @@
+/**
+ * 16-bit GPR CPU Emulator - Benchmark suite (gpr_bench)
+ *
+ * Usage: gpr_bench [--engines=interp,threaded,jit,batch] [--filter=name]
+ *                  [--min-time=seconds] [--host-counters] [program_dir]
+ *
+ * Microbenchmarks per opcode class (plus fusable MOVI pairs), a full assemble() pass over a large
+ * generated source and one-line incremental edits to it, linking 64 modules
+ * on one thread and on all cores, end-to-end runs of addition.asm / subtraction.asm, each
+ * reported for every selected engine in one table (plus their gpr_aot translations, built
+ * with the bench), many CPUs time-sliced
+ * with runFor(), snapshot restores, and instance create / destroy on the
+ * heap versus from an InstancePool, a block copy done by a guest loop
+ * versus the DMA device, and time travel: recorded runs, seeks back into
+ * them and reverse steps.
+ * program_dir defaults to the source tree (for the .asm programs).
+ * --host-counters adds a line under each row with the host's cycles,
+ * instructions, branch misses and L1I / L1D misses per unit (Linux perf
+ * events; the rows report why they are missing where the host has none).
+ */
+
+#include "gpr_cpu.h"
+#include "batch_cpu.h"
+#include "assembler.h"
+#include "incremental.h"
+#include "linker.h"
+#include "snapshot.h"
+#include "timeline.h"
+#include "instance_pool.h"
+#include "host_counters.h"
+#include "dma.h"
+#include "aot.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define GPR_HAVE_TSC 1
+#else
+#define GPR_HAVE_TSC 0
+#endif
+
+#ifndef GPR_PROGRAM_DIR
+#define GPR_PROGRAM_DIR "."
+#endif
+
+// Generated by gpr_aot at build time (CMakeLists.txt)
+RunResult aot_addition(GPRCPU& cpu, Bus& bus, uint64_t maxCycles);
+RunResult aot_subtraction(GPRCPU& cpu, Bus& bus, uint64_t maxCycles);
+
+// =============================================================================
+// TIMING
+// =============================================================================
+
+/** Open with --host-counters: every Stamp also reads the host's counters. */
+static HostCounters hostCounters;
+
+/** Wall-clock seconds plus TSC ticks (0 where there is no TSC) and host counters (if open). */
+struct Stamp {
+    std::chrono::steady_clock::time_point time;
+    uint64_t tsc;
+    HostSample host;
+};
+
+static Stamp now() {
+    HostSample host = hostCounters.read();
+#if GPR_HAVE_TSC
+    return {std::chrono::steady_clock::now(), __rdtsc(), host};
+#else
+    return {std::chrono::steady_clock::now(), 0, host};
+#endif
+}
+
+/** One benchmark result: units of work done (instructions or lines) and the cost. */
+struct Measurement {
+    uint64_t units = 0;
+    double seconds = 0;
+    uint64_t ticks = 0;
+    HostSample host;
+};
+
+static void accumulate(Measurement& m, const Stamp& start, const Stamp& end, uint64_t units) {
+    m.units += units;
+    m.seconds += std::chrono::duration<double>(end.time - start.time).count();
+    m.ticks += end.tsc - start.tsc;
+    m.host += end.host - start.host;
+}
+
+static void printHeader(const char* unit) {
+    std::string u(unit);
+    std::printf("\n%-22s %-9s %14s %14s %10s %12s\n", "benchmark", "engine", u.c_str(), (u + "/s").c_str(),
+                ("ns/" + u).c_str(), ("TSC/" + u).c_str());
+    std::printf("%s\n", std::string(86, '-').c_str());
+}
+
+static void printRow(const char* name, const char* engine, const Measurement& m) {
+    double rate = m.seconds > 0 ? m.units / m.seconds : 0;
+    double ns = m.units ? m.seconds * 1e9 / m.units : 0;
+    std::printf("%-22s %-9s %14llu %14.3e %10.3f", name, engine, static_cast<unsigned long long>(m.units), rate, ns);
+    if (GPR_HAVE_TSC && m.units)
+        std::printf(" %12.3f\n", static_cast<double>(m.ticks) / m.units);
+    else
+        std::printf(" %12s\n", "-");
+    if (!hostCounters.isOpen() || !m.host.valid || !m.units)
+        return;
+    // Host events per unit, e.g. branch misses per guest instruction
+    std::printf("%-22s", "  host per unit:");
+    for (size_t i = 0; i < HOST_EVENT_COUNT; ++i) {
+        HostEvent e = static_cast<HostEvent>(i);
+        if (m.host.has(e))
+            std::printf(" %s %.4f", hostEventName(e), static_cast<double>(m.host[e]) / m.units);
+    }
+    if (m.host.running < m.host.enabled)
+        std::printf(" (scaled)");
+    std::printf("\n");
+}
+
+// =============================================================================
+// BENCHMARK PROGRAMS
+// =============================================================================
+// Each loop program runs its body 65535 times. Loop targets are held in R3
+// (loop) and R4 (exit) so the loop control is MOVI-free: SUB R6, R5 sets the
+// flags that JZ R4 tests. Bodies only use R0-R2.
+
+static std::string loopProgram(const std::string& setup, const std::string& body, unsigned unroll) {
+    std::string src = ".ORG 0\n"
+                      "    MOVI R5, 1\n"
+                      "    MOVI R6, 0\n"
+                      "    NOT R6, R6\n"
+                      "    MOVI R3, loop\n"
+                      "    MOVI R4, exit\n" + setup +
+                      "loop:\n";
+    for (unsigned i = 0; i < unroll; ++i)
+        src += body;
+    src += "    SUB R6, R5\n"
+           "    JZ R4\n"
+           "    JMP R3\n"
+           "exit:\n"
+           "    HALT\n";
+    return src;
+}
+
+static std::string aluProgram() {
+    return loopProgram("    MOVI R0, 0x55\n    MOVI R1, 0x1A3\n    MOVI R2, 7\n",
+                       "    ADD R0, R1\n    XOR R1, R0\n    SUB R2, R0\n    AND R1, R2\n"
+                       "    OR R0, R2\n    NOT R2, R1\n    SHL R0\n    SHR R1\n", 4);
+}
+
+static std::string memoryProgram() {
+    return loopProgram("    MOVI R2, 0x100\n",
+                       "    LOAD R0, (R2)\n    ADD R0, R5\n    STORE R0, (R2)\n    LOAD R1, (R2)\n"
+                       "    STORE R1, (R2)\n", 4);
+}
+
+static std::string pairProgram() {
+    // Assembler-style absolute accesses and label jumps: MOVI Rx followed by
+    // LOAD / STORE / JMP through Rx (fused pairs on the threaded engine)
+    std::string body;
+    for (unsigned i = 0; i < 4; ++i) {
+        std::string next = "next" + std::to_string(i);
+        body += "    MOVI R2, 0x100\n    LOAD R0, (R2)\n    ADD R0, R5\n    MOVI R1, 0x101\n"
+                "    STORE R0, (R1)\n    MOVI R7, " + next + "\n    JMP R7\n" + next + ":\n";
+    }
+    return loopProgram("", body, 1);
+}
+
+static std::string branchProgram() {
+    // Body: not-taken JZs on top of the loop's own JZ/JMP pair (R2 = 0 is a
+    // valid target that is never reached)
+    return loopProgram("    MOVI R2, 0\n", "    MOV R0, R5\n    JZ R2\n", 4);
+}
+
+/** Block copied by the copy benchmarks: COPY_WORDS words from 0x4000 to 0x8000. */
+constexpr unsigned COPY_WORDS = 4096;
+constexpr size_t DMA_PAGE = 0xF0;
+
+static std::string copyLoopProgram() {
+    return ".ORG 0\n"
+           "    MOVW R2, 0x4000\n"
+           "    MOVW R3, 0x8000\n"
+           "    MOVW R6, " + std::to_string(COPY_WORDS) + "\n"
+           "    MOVI R5, 1\n"
+           "    MOVI R1, loop\n"
+           "    MOVI R4, exit\n"
+           "loop:\n"
+           "    LOAD R0, (R2)\n"
+           "    STORE R0, (R3)\n"
+           "    ADD R2, R5\n"
+           "    ADD R3, R5\n"
+           "    SUB R6, R5\n"
+           "    JZ R4\n"
+           "    JMP R1\n"
+           "exit:\n"
+           "    HALT\n";
+}
+
+static std::string copyDmaProgram() {
+    std::string src = ".ORG 0\n";
+    auto reg = [&src](uint16_t offset, unsigned value) {
+        src += "    MOVW R0, " + std::to_string(value) + "\n    MOVW R1, " +
+               std::to_string((DMA_PAGE << PAGE_SHIFT) + offset) + "\n    STORE R0, (R1)\n";
+    };
+    reg(DMA_SRC, 0x4000);
+    reg(DMA_DST, 0x8000);
+    reg(DMA_COUNT, COPY_WORDS);
+    reg(DMA_CTRL, DMA_COPY);
+    return src + "    HALT\n";
+}
+
+/** Large assemble() input: MEMORY_SIZE - 1 lines of mixed code, labels and comments. */
+static std::string largeSource(size_t& lines) {
+    static const char* const OPS[] = {
+        "    ADD R0, R1\n", "    SUB R2, R3 ; subtract\n", "    LOAD R4, (R5)\n", "    STORE R6, (R7)\n",
+        "    MOVI R1, 0x1FF\n", "    XOR R0, R0\n", "    SHL R3\n", "    JMP R7\n", "    MOVI R2, 42\n", "    NOP\n"
+    };
+    std::string src = ".ORG 0\n";
+    lines = 1;
+    char label[32];
+    for (size_t i = 0; i + 2 < MEMORY_SIZE - 1; ++i) {
+        if (i % 16 == 0) {
+            std::snprintf(label, sizeof label, "L%zu:\n", i);
+            src += label;
+            ++lines;
+        }
+        src += OPS[i % (sizeof OPS / sizeof OPS[0])];
+        ++lines;
+    }
+    src += "    HALT\n";
+    return src + "; end\n";
+}
+
+// =============================================================================
+// ENGINES
+// =============================================================================
+
+enum class BenchEngine { Interp, Threaded, Jit, Batch };
+
+struct EngineInfo {
+    BenchEngine id;
+    const char* name;
+};
+
+static const EngineInfo ENGINES[] = {
+    {BenchEngine::Interp, "interp"},
+    {BenchEngine::Threaded, "threaded"},
+    {BenchEngine::Jit, "jit"},
+    {BenchEngine::Batch, "batch"},
+};
+
+static Engine cpuEngine(BenchEngine e) {
+    switch (e) {
+        case BenchEngine::Threaded: return Engine::Threaded;
+        case BenchEngine::Jit:      return Engine::Jit;
+        default:                    return Engine::Interpreter;
+    }
+}
+
+constexpr size_t BATCH_LANES = 256;
+
+/**
+ * Run image (with optional operand patches) repeatedly for at least minTime
+ * seconds. Instructions are counted like GPRCPU::run(). The Bus and CPU are
+ * built once, so warm caches and translated code carry across repetitions.
+ */
+/** Run image on engine, or as the translated program aot if given. */
+static Measurement runProgram(BenchEngine engine, const std::shared_ptr<const MemoryImage>& image,
+                              const std::vector<std::pair<uint16_t, uint16_t>>& patches, double minTime,
+                              AotFunction aot = nullptr) {
+    Measurement m;
+    if (engine == BenchEngine::Batch) {
+        std::vector<uint16_t> words(MEMORY_SIZE);
+        image->copyTo(words.data());
+        BatchCPU batch(words.data(), BATCH_LANES);
+        while (m.seconds < minTime) {
+            batch.reset();
+            Stamp start = now();
+            for (size_t lane = 0; lane < BATCH_LANES; ++lane)
+                for (const auto& p : patches)
+                    batch.write(lane, p.first, static_cast<uint16_t>(p.second + lane));
+            batch.run();
+            Stamp end = now();
+            uint64_t units = 0;
+            for (size_t lane = 0; lane < BATCH_LANES; ++lane)
+                units += batch.cycles(lane);
+            accumulate(m, start, end, units);
+        }
+        return m;
+    }
+
+    Bus bus(image);
+    GPRCPU cpu(bus, cpuEngine(engine));
+    while (m.seconds < minTime) {
+        // Time many runs per sample so tiny programs are not dominated by the clock
+        Stamp start = now();
+        uint64_t units = 0;
+        for (unsigned rep = 0; rep < 64; ++rep) {
+            bus.reset();
+            for (const auto& p : patches)
+                bus.write(p.first, static_cast<uint16_t>(p.second + rep));
+            cpu.reset();
+            units += aot ? aot(cpu, bus, UINT64_MAX).cycles : cpu.run();
+        }
+        Stamp end = now();
+        accumulate(m, start, end, units);
+    }
+    return m;
+}
+
+// =============================================================================
+// DRIVER
+// =============================================================================
+
+struct Options {
+    std::vector<BenchEngine> engines;
+    std::string filter;
+    double minTime = 0.3;
+    bool hostCounters = false;
+    std::string programDir = GPR_PROGRAM_DIR;
+};
+
+static bool selected(const Options& o, const char* name) {
+    return o.filter.empty() || std::strstr(name, o.filter.c_str()) != nullptr;
+}
+
+static const char* engineName(BenchEngine e) {
+    for (const EngineInfo& info : ENGINES)
+        if (info.id == e)
+            return info.name;
+    return "?";
+}
+
+static bool parseArgs(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 10, "--engines=") == 0) {
+            o.engines.clear();
+            std::string list = arg.substr(10) + ",";
+            for (size_t pos = 0, comma; (comma = list.find(',', pos)) != std::string::npos; pos = comma + 1) {
+                std::string name = list.substr(pos, comma - pos);
+                bool found = false;
+                for (const EngineInfo& info : ENGINES)
+                    if (name == info.name) {
+                        o.engines.push_back(info.id);
+                        found = true;
+                    }
+                if (!found) {
+                    std::fprintf(stderr, "Unknown engine: %s\n", name.c_str());
+                    return false;
+                }
+            }
+        } else if (arg.compare(0, 9, "--filter=") == 0) {
+            o.filter = arg.substr(9);
+        } else if (arg.compare(0, 11, "--min-time=") == 0) {
+            o.minTime = std::strtod(arg.c_str() + 11, nullptr);
+        } else if (arg == "--host-counters") {
+            o.hostCounters = true;
+        } else if (!arg.empty() && arg[0] != '-') {
+            o.programDir = arg;
+        } else {
+            std::fprintf(stderr, "Usage: gpr_bench [--engines=interp,threaded,jit,batch] [--filter=name] "
+                                 "[--min-time=seconds] [--host-counters] [program_dir]\n");
+            return false;
+        }
+    }
+    if (o.engines.empty())
+        for (const EngineInfo& info : ENGINES)
+            o.engines.push_back(info.id);
+    return true;
+}
+
+/** Assemble source into a fresh image; nullptr (with a message) on error. */
+static std::shared_ptr<const MemoryImage> build(const char* name, const std::string& source, const char* path) {
+    std::vector<uint16_t> words(MEMORY_SIZE);
+    AssembleResult ar = path ? assembleFile(path, words.data(), MEMORY_SIZE)
+                             : assemble(source, words.data(), MEMORY_SIZE);
+    if (!ar.ok) {
+        std::fprintf(stderr, "%s: assembly error at line %zu: %s\n", name, ar.lineNum, ar.error.c_str());
+        return nullptr;
+    }
+    return MemoryImage::copyOf(words.data());
+}
+
+int main(int argc, char** argv) {
+    Options o;
+    if (!parseArgs(argc, argv, o))
+        return 1;
+
+    std::printf("=== 16-bit GPR CPU benchmarks (min %.2fs each%s) ===\n", o.minTime,
+                GPR_HAVE_TSC ? ", TSC = timestamp-counter ticks" : "");
+    std::string error;
+    if (o.hostCounters && !hostCounters.open(error))
+        std::printf("host counters unavailable: %s\n", error.c_str());
+
+    // --- Execution: opcode-class loops and the example programs ---
+    struct Program {
+        const char* name;
+        std::string source;
+        std::string path;
+        std::vector<std::pair<uint16_t, uint16_t>> patches;
+        AotFunction aot;    // Its translation, if built
+    };
+    std::vector<Program> programs = {
+        {"alu-loop", aluProgram(), "", {}, nullptr},
+        {"load-store-loop", memoryProgram(), "", {}, nullptr},
+        {"branch-loop", branchProgram(), "", {}, nullptr},
+        {"pair-loop", pairProgram(), "", {}, nullptr},
+        {"addition.asm", "", o.programDir + "/addition.asm", {{0x100, 1234}, {0x101, 4321}}, aot_addition},
+        {"subtraction.asm", "", o.programDir + "/subtraction.asm", {{0x100, 5000}, {0x101, 1234}},
+         aot_subtraction},
+    };
+
+    printHeader("instr");
+    for (const Program& p : programs) {
+        if (!selected(o, p.name))
+            continue;
+        auto image = build(p.name, p.source, p.path.empty() ? nullptr : p.path.c_str());
+        if (!image)
+            return 1;
+        for (BenchEngine e : o.engines)
+            printRow(p.name, engineName(e), runProgram(e, image, p.patches, o.minTime));
+        if (p.aot)
+            printRow(p.name, "aot", runProgram(BenchEngine::Interp, image, p.patches, o.minTime, p.aot));
+    }
+
+    // --- Time slicing: many CPUs round-robin on one thread, runFor() quanta ---
+    if (selected(o, "time-slice")) {
+        auto image = build("time-slice", aluProgram(), nullptr);
+        if (!image)
+            return 1;
+        const size_t CPUS = 64;
+        const uint64_t QUANTUM = 10000;
+        printHeader("instr");
+        for (BenchEngine e : o.engines) {
+            if (e == BenchEngine::Batch)
+                continue;
+            std::vector<std::unique_ptr<Bus>> buses;
+            std::vector<std::unique_ptr<GPRCPU>> cpus;
+            for (size_t i = 0; i < CPUS; ++i) {
+                buses.emplace_back(new Bus(image));
+                cpus.emplace_back(new GPRCPU(*buses.back(), cpuEngine(e)));
+            }
+            Measurement m;
+            while (m.seconds < o.minTime) {
+                for (auto& cpu : cpus)
+                    cpu->reset();
+                Stamp start = now();
+                uint64_t units = 0;
+                for (size_t running = CPUS; running;) {
+                    running = 0;
+                    for (auto& cpu : cpus) {
+                        RunResult r = cpu->runFor(QUANTUM);
+                        units += r.cycles;
+                        running += r.reason == StopReason::Budget;
+                    }
+                }
+                accumulate(m, start, now(), units);
+            }
+            printRow("time-slice-10k", engineName(e), m);
+        }
+    }
+
+    // --- Assembler: one full pass per sample ---
+    if (selected(o, "assemble")) {
+        size_t lines = 0;
+        std::string source = largeSource(lines);
+        std::vector<uint16_t> words(MEMORY_SIZE);
+        Measurement m;
+        while (m.seconds < o.minTime) {
+            Stamp start = now();
+            AssembleResult ar = assemble(source, words.data(), MEMORY_SIZE);
+            Stamp end = now();
+            if (!ar.ok) {
+                std::fprintf(stderr, "assemble: error at line %zu: %s\n", ar.lineNum, ar.error.c_str());
+                return 1;
+            }
+            accumulate(m, start, end, lines);
+        }
+        printHeader("line");
+        printRow("assemble", "-", m);
+        std::printf("%-22s %-9s %14zu bytes, %.1f MB/s\n", "", "", source.size(),
+                    source.size() * (m.units / static_cast<double>(lines)) / m.seconds / 1e6);
+
+        // Incremental: one-line edits to the same source, either keeping every
+        // address (a new MOVI immediate) or moving all later code (insert + delete)
+        IncrementalAssembler inc(words.data(), MEMORY_SIZE);
+        inc.assemble(source);
+        size_t line = 1 + static_cast<size_t>(std::count(source.begin(), source.begin() + source.find("MOVI R2, 42"), '\n'));
+        Measurement inPlace, shift;
+        for (unsigned i = 0; inPlace.seconds < o.minTime; ++i) {
+            Stamp start = now();
+            for (unsigned rep = 0; rep < 256; ++rep)
+                inc.edit(line, 1, (rep + i) & 1 ? "    MOVI R2, 42\n" : "    MOVI R2, 43\n");
+            accumulate(inPlace, start, now(), 256);
+        }
+        while (shift.seconds < o.minTime) {
+            Stamp start = now();
+            inc.edit(line, 0, "    NOP\n");
+            inc.edit(line, 1, "");
+            accumulate(shift, start, now(), 2);
+        }
+        printHeader("edit");
+        printRow("reassemble-in-place", "-", inPlace);
+        printRow("reassemble-shift", "-", shift);
+    }
+
+    // --- Linker: 64 modules with cross-module jumps, one thread vs all ---
+    if (selected(o, "link")) {
+        std::vector<std::string> modules(64);
+        size_t lines = 0;
+        for (size_t m = 0; m < modules.size(); ++m) {
+            std::string& src = modules[m];
+            src = ".ORG " + std::to_string(m * 1024) + "\nmod" + std::to_string(m) + ":\n";
+            for (size_t i = 0; i < 1000; ++i)
+                src += i % 100 == 99 ? "    MOVI R1, mod" + std::to_string((m + 1) % modules.size()) + "\n"
+                                     : "    ADD R0, R1 ; body\n";
+            lines += 1002;
+        }
+        std::vector<std::string_view> views(modules.begin(), modules.end());
+        std::vector<uint16_t> words(MEMORY_SIZE);
+        std::vector<unsigned> threadCounts = {1};
+        if (std::thread::hardware_concurrency() > 1)
+            threadCounts.push_back(std::thread::hardware_concurrency());
+        printHeader("line");
+        for (unsigned threads : threadCounts) {
+            LinkOptions options;
+            options.threads = threads;
+            Measurement m;
+            while (m.seconds < o.minTime) {
+                Stamp start = now();
+                LinkResult lr = linkSources(views, words.data(), MEMORY_SIZE, nullptr, options);
+                Stamp end = now();
+                if (!lr.ok) {
+                    std::fprintf(stderr, "link: module %zu line %zu: %s\n", lr.module, lr.lineNum, lr.error.c_str());
+                    return 1;
+                }
+                accumulate(m, start, end, lines);
+            }
+            std::string name = "link-" + std::to_string(threads) + "-thread";
+            printRow(name.c_str(), "-", m);
+        }
+    }
+
+    // --- Snapshots: restore a mid-run state, then run a short slice from it ---
+    if (selected(o, "snapshot-restore")) {
+        auto image = build("snapshot-restore", memoryProgram(), nullptr);
+        if (!image)
+            return 1;
+        const unsigned SLICE = 100;     // Instructions stepped after each restore
+        Bus bus(image);
+        GPRCPU cpu(bus);
+        for (unsigned i = 0; i < 10000; ++i)
+            cpu.step();
+        std::shared_ptr<const Snapshot> snapshot = Snapshot::take(cpu, bus);
+        Measurement m;
+        while (m.seconds < o.minTime) {
+            Stamp start = now();
+            for (unsigned n = 0; n < 1000; ++n) {
+                snapshot->restore(cpu, bus);
+                cpu.runFor(SLICE);
+            }
+            accumulate(m, start, now(), 1000);
+        }
+        printHeader("restore");
+        printRow("snapshot-restore", "interp", m);
+    }
+
+    // --- Block copy: the same copy by a LOAD / STORE loop and by the DMA device ---
+    if (selected(o, "copy")) {
+        struct Copy {
+            const char* name;
+            std::string source;
+        };
+        const Copy copies[] = {{"copy-loop", copyLoopProgram()}, {"copy-dma", copyDmaProgram()}};
+        printHeader("word");
+        for (const Copy& c : copies) {
+            std::vector<uint16_t> words(MEMORY_SIZE);
+            AssembleResult ar = assemble(c.source, words.data(), MEMORY_SIZE);
+            if (!ar.ok) {
+                std::fprintf(stderr, "%s: assembly error at line %zu: %s\n", c.name, ar.lineNum, ar.error.c_str());
+                return 1;
+            }
+            for (unsigned i = 0; i < COPY_WORDS; ++i)
+                words[0x4000 + i] = static_cast<uint16_t>(i * 0x9E37u);
+            auto image = MemoryImage::copyOf(words.data());
+            for (BenchEngine e : o.engines) {
+                if (e == BenchEngine::Batch)
+                    continue;
+                Bus bus(image);
+                GPRCPU cpu(bus, cpuEngine(e));
+                DmaDevice dma(bus);
+                bus.mapDevice(DMA_PAGE, 1, &dma);
+                Measurement m;
+                while (m.seconds < o.minTime) {
+                    Stamp start = now();
+                    for (unsigned rep = 0; rep < 16; ++rep) {
+                        bus.reset();
+                        cpu.reset();
+                        cpu.run();
+                    }
+                    accumulate(m, start, now(), 16 * COPY_WORDS);
+                }
+                if (bus.read(0x8000 + COPY_WORDS - 1) != words[0x4000 + COPY_WORDS - 1]) {
+                    std::fprintf(stderr, "%s: copy did not complete\n", c.name);
+                    return 1;
+                }
+                printRow(c.name, engineName(e), m);
+            }
+        }
+    }
+
+    // --- Instances: create, run addition.asm, destroy (heap vs pool) ---
+    if (selected(o, "instance")) {
+        auto image = build("instance", "", (o.programDir + "/addition.asm").c_str());
+        if (!image)
+            return 1;
+        const unsigned BATCH = 1000;
+        printHeader("instance");
+        Measurement heap;
+        while (heap.seconds < o.minTime) {
+            Stamp start = now();
+            for (unsigned n = 0; n < BATCH; ++n) {
+                std::unique_ptr<Bus> bus(new Bus(image));
+                std::unique_ptr<GPRCPU> cpu(new GPRCPU(*bus));
+                cpu->runFor(UINT64_MAX);
+            }
+            accumulate(heap, start, now(), BATCH);
+        }
+        printRow("instance-heap", "interp", heap);
+
+        InstancePool::Options po;
+        InstancePool pool(po);
+        Measurement pooled;
+        while (pooled.seconds < o.minTime) {
+            Stamp start = now();
+            for (unsigned n = 0; n < BATCH; ++n) {
+                InstancePool::Instance* inst = pool.acquire(image);
+                inst->cpu.runFor(UINT64_MAX);
+                pool.release(inst);
+            }
+            accumulate(pooled, start, now(), BATCH);
+        }
+        printRow("instance-pool", "interp", pooled);
+    }
+
+    // --- Time travel: recorded runs, then seeks back into the history and reverse steps ---
+    if (selected(o, "timeline")) {
+        auto image = build("timeline", memoryProgram(), nullptr);
+        if (!image)
+            return 1;
+        const uint64_t HISTORY = 1u << 20;      // Instructions recorded
+        const unsigned SEEKS = 16, STEPS = 4096;
+        struct Row {
+            const char* engine;
+            Measurement record, seek, step;
+        };
+        std::vector<Row> rows;
+        for (BenchEngine e : o.engines) {
+            if (e == BenchEngine::Batch)
+                continue;
+            Bus bus(image);
+            GPRCPU cpu(bus, cpuEngine(e));
+            std::unique_ptr<Timeline> timeline;
+            Row row = {engineName(e), {}, {}, {}};
+            while (row.record.seconds < o.minTime) {
+                bus.reset();
+                cpu.reset();
+                timeline.reset(new Timeline(cpu, bus));
+                Stamp start = now();
+                timeline->runFor(HISTORY);
+                accumulate(row.record, start, now(), timeline->cycle());
+            }
+            uint64_t x = 1;
+            while (row.seek.seconds < o.minTime) {
+                Stamp start = now();
+                for (unsigned n = 0; n < SEEKS; ++n) {
+                    x = x * 6364136223846793005u + 1442695040888963407u;
+                    timeline->seek((x >> 33) % timeline->end());
+                }
+                accumulate(row.seek, start, now(), SEEKS);
+            }
+            while (row.step.seconds < o.minTime) {
+                timeline->seek(timeline->end());
+                Stamp start = now();
+                for (unsigned n = 0; n < STEPS; ++n)
+                    timeline->reverseStep();
+                accumulate(row.step, start, now(), STEPS);
+            }
+            rows.push_back(row);
+        }
+        printHeader("instr");
+        for (const Row& r : rows)
+            printRow("timeline-record", r.engine, r.record);
+        printHeader("seek");
+        for (const Row& r : rows)
+            printRow("timeline-seek", r.engine, r.seek);
+        printHeader("step");
+        for (const Row& r : rows)
+            printRow("reverse-step", r.engine, r.step);
+    }
+    return 0;
+}
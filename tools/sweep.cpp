@@ -0,0 +1,215 @@
+/**
+ * 16-bit GPR CPU Emulator - Input sweep front end (gpr_sweep)
+ *
+ * Usage: gpr_sweep program.(asm|gpri) [--input=addr[:first[:count]]]...
+ *                  [--observe=addr]... [--budget=cycles] [--threads=n]
+ *                  [--engine=interp|threaded|jit] [--top=n]
+ *
+ * Loads the program once, snapshots it, and runs it for every combination
+ * of the --input words (each defaults to all 65536 values) on all cores.
+ * Prints how the runs ended, the final flags, the most common values of
+ * each --observe word and a digest of the whole result, which is the same
+ * for any --threads. Example, the full operand space of addition.asm:
+ *
+ *   gpr_sweep addition.asm --input=0x100 --input=0x101 --observe=0x102
+ */
+
+#include "sweep.h"
+#include "assembler.h"
+#include "program_image.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const char* const REASON_NAMES[STOP_REASON_COUNT] = {
+    "halted", "budget", "deadline", "breakpoint", "fault", "yield"
+};
+
+/** Parse a number (decimal or 0x hex) up to limit; false if malformed. */
+static bool parseNumber(const char* s, uint64_t limit, uint64_t& out, const char** end = nullptr) {
+    char* stop;
+    unsigned long long v = std::strtoull(s, &stop, 0);
+    if (stop == s || v > limit || (!end && *stop))
+        return false;
+    if (end)
+        *end = stop;
+    out = v;
+    return true;
+}
+
+/** addr[:first[:count]] */
+static bool parseAxis(const char* s, SweepAxis& axis) {
+    uint64_t address, first = 0, count;
+    if (!parseNumber(s, 0xFFFF, address, &s))
+        return false;
+    if (*s == ':' && !parseNumber(s + 1, 0xFFFF, first, &s))
+        return false;
+    count = MEMORY_SIZE - first;
+    if (*s == ':' && !parseNumber(s + 1, MEMORY_SIZE - first, count, &s))
+        return false;
+    if (*s || count == 0)
+        return false;
+    axis.address = static_cast<uint16_t>(address);
+    axis.first = static_cast<uint16_t>(first);
+    axis.count = static_cast<uint32_t>(count);
+    return true;
+}
+
+/** Program memory from a .asm file or a program image; nullptr after printing the error. */
+static std::shared_ptr<const MemoryImage> loadProgram(const char* path, uint16_t& entry) {
+    entry = 0;
+    if (ProgramImage::isImage(path)) {
+        std::string error;
+        std::shared_ptr<const ProgramImage> program = ProgramImage::open(path, error);
+        if (!program) {
+            std::fprintf(stderr, "%s: %s\n", path, error.c_str());
+            return nullptr;
+        }
+        entry = program->entry();
+        return program->memory();
+    }
+    std::vector<uint16_t> words(MEMORY_SIZE);
+    AssembleResult ar = assembleFile(path, words.data(), MEMORY_SIZE);
+    if (!ar.ok) {
+        std::fprintf(stderr, "%s:%zu: %s\n", path, ar.lineNum, ar.error.c_str());
+        return nullptr;
+    }
+    return MemoryImage::copyOf(words.data());
+}
+
+/** FNV-1a over every counter of the result. */
+static uint64_t digest(const SweepResult& r) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    auto mix = [&h](uint64_t v) {
+        for (unsigned i = 0; i < 8; ++i) {
+            h ^= (v >> (i * 8)) & 0xFF;
+            h *= 0x100000001b3ull;
+        }
+    };
+    mix(r.inputs);
+    mix(r.cycles);
+    mix(r.maxCycles);
+    for (size_t i = 0; i < STOP_REASON_COUNT; ++i) {
+        mix(r.reasons[i]);
+        mix(r.firstInput[i]);
+    }
+    for (uint64_t f : r.flags)
+        mix(f);
+    for (const std::vector<uint64_t>& histogram : r.values)
+        for (uint64_t count : histogram)
+            mix(count);
+    return h;
+}
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    SweepOptions options;
+    uint64_t top = 8;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        uint64_t v = 0;
+        bool ok = true;
+        if (std::strncmp(arg, "--input=", 8) == 0) {
+            SweepAxis axis;
+            ok = parseAxis(arg + 8, axis);
+            options.axes.push_back(axis);
+        } else if (std::strncmp(arg, "--observe=", 10) == 0) {
+            ok = parseNumber(arg + 10, 0xFFFF, v);
+            options.observe.push_back(static_cast<uint16_t>(v));
+        } else if (std::strncmp(arg, "--budget=", 9) == 0) {
+            ok = parseNumber(arg + 9, UINT64_MAX, options.budget);
+        } else if (std::strncmp(arg, "--threads=", 10) == 0) {
+            ok = parseNumber(arg + 10, 4096, v);
+            options.threads = static_cast<unsigned>(v);
+        } else if (std::strncmp(arg, "--top=", 6) == 0) {
+            ok = parseNumber(arg + 6, MEMORY_SIZE, top);
+        } else if (std::strcmp(arg, "--engine=interp") == 0) {
+            options.engine = Engine::Interpreter;
+        } else if (std::strcmp(arg, "--engine=threaded") == 0) {
+            options.engine = Engine::Threaded;
+        } else if (std::strcmp(arg, "--engine=jit") == 0) {
+            options.engine = Engine::Jit;
+        } else if (arg[0] != '-' && !path) {
+            path = arg;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::fprintf(stderr, "Bad argument %s\n", arg);
+            path = nullptr;
+            break;
+        }
+    }
+    if (!path) {
+        std::fprintf(stderr, "Usage: %s program.(asm|gpri) [--input=addr[:first[:count]]]... [--observe=addr]...\n"
+                             "       [--budget=cycles] [--threads=n] [--engine=interp|threaded|jit] [--top=n]\n",
+                     argv[0]);
+        return 1;
+    }
+
+    // --- Load once and snapshot the machine ready to run ---
+    uint16_t entry;
+    std::shared_ptr<const MemoryImage> image = loadProgram(path, entry);
+    if (!image)
+        return 1;
+    Bus bus(image);
+    GPRCPU cpu(bus);
+    cpu.getState().PC = entry;
+    std::shared_ptr<const Snapshot> start = Snapshot::take(cpu, bus);
+
+    SweepResult r;
+    std::string error;
+    auto t0 = std::chrono::steady_clock::now();
+    if (!runSweep(*start, options, r, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    // --- Report ---
+    std::printf("inputs    %llu in %.2fs (%.3e/s)\n", static_cast<unsigned long long>(r.inputs), seconds,
+                seconds > 0 ? r.inputs / seconds : 0.0);
+    std::printf("cycles    %llu total, %llu max\n", static_cast<unsigned long long>(r.cycles),
+                static_cast<unsigned long long>(r.maxCycles));
+    std::vector<uint16_t> words(options.axes.size());
+    for (size_t i = 0; i < STOP_REASON_COUNT; ++i) {
+        if (!r.reasons[i])
+            continue;
+        std::printf("%-9s %llu, first:", REASON_NAMES[i], static_cast<unsigned long long>(r.reasons[i]));
+        sweepInput(options, r.firstInput[i], words.data());
+        for (size_t a = 0; a < words.size(); ++a)
+            std::printf(" [0x%04X]=0x%04X", options.axes[a].address, words[a]);
+        std::printf("\n");
+    }
+    std::printf("flags    ");
+    for (unsigned f = 0; f < 8; ++f) {
+        if (r.flags[f])
+            std::printf(" %c%c%c=%llu", (f & FLAG_ZERO) ? 'Z' : '-', (f & FLAG_CARRY) ? 'C' : '-',
+                        (f & FLAG_NEGATIVE) ? 'N' : '-', static_cast<unsigned long long>(r.flags[f]));
+    }
+    std::printf("\n");
+
+    for (size_t k = 0; k < options.observe.size(); ++k) {
+        const std::vector<uint64_t>& histogram = r.values[k];
+        std::vector<uint32_t> order;
+        for (uint32_t v = 0; v < MEMORY_SIZE; ++v)
+            if (histogram[v])
+                order.push_back(v);
+        size_t shown = std::min<size_t>(order.size(), static_cast<size_t>(top));
+        // Most common first, then by value: the same listing for any thread count
+        std::partial_sort(order.begin(), order.begin() + static_cast<std::ptrdiff_t>(shown), order.end(),
+                          [&](uint32_t a, uint32_t b) {
+                              return histogram[a] != histogram[b] ? histogram[a] > histogram[b] : a < b;
+                          });
+        std::printf("[0x%04X]  %zu distinct", options.observe[k], order.size());
+        for (size_t i = 0; i < shown; ++i)
+            std::printf("%s 0x%04X=%llu", i ? "," : ":", order[i], static_cast<unsigned long long>(histogram[order[i]]));
+        std::printf("\n");
+    }
+    std::printf("digest    %016llx\n", static_cast<unsigned long long>(digest(r)));
+    return 0;
+}
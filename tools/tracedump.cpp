@@ -0,0 +1,60 @@
+/**
+ * 16-bit GPR CPU Emulator - Binary trace dump
+ *
+ * Usage: gpr_tracedump trace.bin
+ * Renders a trace recorded by BinaryTrace (gpr_emulator --trace-file) in the
+ * same per-cycle text format as the live trace.
+ */
+
+#include "trace.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::fprintf(stderr, "Usage: %s trace.bin\n", argv[0]);
+        return 1;
+    }
+
+    std::FILE* in = std::fopen(argv[1], "rb");
+    if (!in) {
+        std::fprintf(stderr, "Cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    TraceFileHeader header;
+    if (std::fread(&header, sizeof header, 1, in) != 1 ||
+        std::memcmp(header.magic, TRACE_MAGIC, sizeof header.magic) != 0) {
+        std::fprintf(stderr, "%s is not a GPR trace file\n", argv[1]);
+        std::fclose(in);
+        return 1;
+    }
+    if (header.version != TRACE_VERSION || header.recordSize != sizeof(TraceRecord)) {
+        std::fprintf(stderr, "%s: unsupported trace version %u (record size %u)\n",
+                     argv[1], header.version, header.recordSize);
+        std::fclose(in);
+        return 1;
+    }
+
+    // Read records in blocks and write text in blocks of similar size
+    TraceRenderer renderer;
+    std::vector<TraceRecord> block(4096);
+    std::string text;
+    size_t n;
+    while ((n = std::fread(block.data(), sizeof(TraceRecord), block.size(), in)) > 0) {
+        for (size_t i = 0; i < n; ++i)
+            renderer.render(block[i], text);
+        std::fwrite(text.data(), 1, text.size(), stdout);
+        text.clear();
+    }
+
+    bool truncated = std::ferror(in) != 0;
+    std::fclose(in);
+    if (truncated) {
+        std::fprintf(stderr, "%s: read error\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}